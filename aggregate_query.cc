@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aggregate_query.hh"
+#include "mutation_compactor.hh"
+#include "schema.hh"
+#include "service/priority_manager.hh"
+#include "cql3/functions/functions.hh"
+
+namespace query {
+
+shared_ptr<cql3::functions::aggregate_function> find_aggregate_function(const schema& s, const aggregate_spec& spec) {
+    std::vector<data_type> arg_types;
+    if (spec.column_name) {
+        auto cdef = s.get_column_definition(*spec.column_name);
+        if (!cdef || !cdef->is_atomic() || cdef->is_counter()) {
+            return nullptr;
+        }
+        arg_types.push_back(cdef->type->underlying_type());
+    }
+    auto name = cql3::functions::function_name::native_function(spec.function_name);
+    return dynamic_pointer_cast<cql3::functions::aggregate_function>(cql3::functions::functions::find(name, arg_types));
+}
+
+aggregates::aggregates(const schema& s, const std::vector<aggregate_spec>& specs) {
+    _aggregates.reserve(specs.size());
+    for (auto& spec : specs) {
+        auto fun = find_aggregate_function(s, spec);
+        if (!fun) {
+            throw std::runtime_error(format("No aggregate function {} for {}.{}", spec.function_name, s.ks_name(), s.cf_name()));
+        }
+        _aggregates.push_back(aggregate{fun->new_aggregate(), spec.column_name ? s.get_column_definition(*spec.column_name) : nullptr});
+    }
+    _args.resize(1);
+}
+
+static bytes_opt get_value(const schema& s, const column_definition& cdef, const partition_key& pk, const clustering_key_prefix* ck,
+        const row* static_cells, const row* cells) {
+    switch (cdef.kind) {
+    case column_kind::partition_key:
+        return to_bytes(pk.get_component(s, cdef.component_index()));
+    case column_kind::clustering_key:
+        if (!ck || cdef.component_index() >= ck->size(s)) {
+            return std::nullopt;
+        }
+        return to_bytes(ck->get_component(s, cdef.component_index()));
+    case column_kind::static_column:
+        cells = static_cells;
+        break;
+    case column_kind::regular_column:
+        break;
+    }
+    if (!cells) {
+        return std::nullopt;
+    }
+    auto cell = cells->find_cell(cdef.id);
+    if (!cell) {
+        return std::nullopt;
+    }
+    auto c = cell->as_atomic_cell(cdef);
+    if (!c.is_live()) {
+        return std::nullopt;
+    }
+    return c.value().linearize();
+}
+
+void aggregates::add_row(const schema& s, const partition_key& pk, const clustering_key_prefix* ck, const row* static_cells, const row* cells) {
+    for (auto& a : _aggregates) {
+        if (a.column) {
+            _args[0] = get_value(s, *a.column, pk, ck, static_cells, cells);
+            a.impl->add_input(cql_serialization_format::internal(), _args);
+        } else {
+            a.impl->add_input(cql_serialization_format::internal(), {});
+        }
+    }
+}
+
+void aggregates::merge(const aggregate_result& r) {
+    if (r.states.size() != _aggregates.size()) {
+        throw std::runtime_error(format("Expected {} aggregate states, got {}", _aggregates.size(), r.states.size()));
+    }
+    for (size_t i = 0; i < _aggregates.size(); ++i) {
+        _aggregates[i].impl->merge_state(r.states[i]);
+    }
+}
+
+aggregate_result aggregates::get_result() const {
+    aggregate_result r;
+    r.states.reserve(_aggregates.size());
+    for (auto& a : _aggregates) {
+        r.states.push_back(a.impl->get_state());
+    }
+    return r;
+}
+
+std::vector<bytes_opt> aggregates::compute(cql_serialization_format sf) const {
+    std::vector<bytes_opt> values;
+    values.reserve(_aggregates.size());
+    for (auto& a : _aggregates) {
+        values.push_back(a.impl->compute(sf));
+    }
+    return values;
+}
+
+// Feeds the live rows of compacted partitions to the aggregates. Follows the
+// same rules as the query result builders as to which rows are returned, so
+// that the aggregates see the rows the coordinator would have seen.
+class aggregating_result_builder {
+    const schema& _schema;
+    const partition_slice& _slice;
+    aggregates& _aggregates;
+    const dht::decorated_key* _dk = nullptr;
+    std::optional<row> _static_cells;
+    bool _static_row_live = false;
+    bool _has_ck_selector = false;
+    uint32_t _live_rows = 0;
+public:
+    aggregating_result_builder(const schema& s, const partition_slice& slice, aggregates& aggs)
+        : _schema(s)
+        , _slice(slice)
+        , _aggregates(aggs) {
+    }
+
+    void consume_new_partition(const dht::decorated_key& dk) {
+        _dk = &dk;
+        _static_cells.reset();
+        _static_row_live = false;
+        _has_ck_selector = has_ck_selector(_slice.row_ranges(_schema, dk.key()));
+        _live_rows = 0;
+    }
+
+    void consume(tombstone) {
+    }
+
+    stop_iteration consume(static_row&& sr, tombstone, bool is_alive) {
+        _static_row_live = is_alive;
+        _static_cells = std::move(sr.cells());
+        return stop_iteration::no;
+    }
+
+    stop_iteration consume(clustering_row&& cr, row_tombstone, bool is_alive) {
+        if (is_alive) {
+            ++_live_rows;
+            _aggregates.add_row(_schema, _dk->key(), &cr.key(), _static_cells ? &*_static_cells : nullptr, &cr.cells());
+        }
+        return stop_iteration::no;
+    }
+
+    stop_iteration consume(range_tombstone&&) {
+        return stop_iteration::no;
+    }
+
+    stop_iteration consume_end_of_partition() {
+        // #589 - a partition with only a live static row yields a row, unless
+        // clustering rows were explicitly selected.
+        if (!_live_rows && _static_row_live && !_has_ck_selector) {
+            _aggregates.add_row(_schema, _dk->key(), nullptr, &*_static_cells, nullptr);
+        }
+        return stop_iteration::no;
+    }
+
+    void consume_end_of_stream() {
+    }
+};
+
+future<aggregate_result> aggregate_query(schema_ptr s,
+        const mutation_source& source,
+        const dht::partition_range_vector& ranges,
+        const partition_slice& slice,
+        const std::vector<aggregate_spec>& specs,
+        gc_clock::time_point query_time,
+        tracing::trace_state_ptr trace_state,
+        db::timeout_clock::time_point timeout) {
+    auto reader = make_flat_multi_range_reader(s, source, ranges, slice, service::get_local_sstable_query_read_priority(),
+            std::move(trace_state), flat_mutation_reader::partition_range_forwarding::no);
+    return do_with(std::move(reader), aggregates(*s, specs), [s, &slice, query_time, timeout] (flat_mutation_reader& reader, aggregates& aggs) {
+        auto consumer = make_stable_flattened_mutations_consumer<compact_for_query<emit_only_live_rows::yes, aggregating_result_builder>>(
+                *s, query_time, slice, query::max_rows, query::max_partitions, aggregating_result_builder(*s, slice, aggs));
+        return reader.consume(std::move(consumer), timeout).then([&aggs] {
+            return aggs.get_result();
+        });
+    });
+}
+
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "query-request.hh"
+#include "mutation_reader.hh"
+#include "db/timeout_clock.hh"
+#include "cql3/functions/aggregate_function.hh"
+
+namespace query {
+
+/// Returns the native aggregate function computing `spec` on `s`, or a null
+/// pointer if there is none, e.g. because the column doesn't exist anymore.
+shared_ptr<cql3::functions::aggregate_function> find_aggregate_function(const schema& s, const aggregate_spec& spec);
+
+/// The aggregates of an aggregation query.
+///
+/// On the replicas, the rows selected by the query are fed to add_row().
+/// On the coordinator, the partial states returned by the replicas are
+/// combined with merge() and the final values are obtained with compute().
+class aggregates {
+    struct aggregate {
+        std::unique_ptr<cql3::functions::aggregate_function::aggregate> impl;
+        // The argument of the function, nullptr for COUNT(*).
+        const column_definition* column;
+    };
+    std::vector<aggregate> _aggregates;
+    std::vector<bytes_opt> _args;
+public:
+    aggregates(const schema& s, const std::vector<aggregate_spec>& specs);
+
+    /// Adds a live row. `ck` and `cells` are null for a partition which has
+    /// only a static row, `static_cells` is null if it has no static row.
+    void add_row(const schema& s, const partition_key& pk, const clustering_key_prefix* ck, const row* static_cells, const row* cells);
+
+    void merge(const aggregate_result& r);
+
+    aggregate_result get_result() const;
+
+    std::vector<bytes_opt> compute(cql_serialization_format sf) const;
+};
+
+/// Evaluates the aggregates on the rows selected by `ranges` and `slice` from
+/// `source`, and returns their partial states.
+future<aggregate_result> aggregate_query(schema_ptr s,
+        const mutation_source& source,
+        const dht::partition_range_vector& ranges,
+        const partition_slice& slice,
+        const std::vector<aggregate_spec>& specs,
+        gc_clock::time_point query_time,
+        tracing::trace_state_ptr trace_state,
+        db::timeout_clock::time_point timeout);
+
+}
@@ -379,6 +379,10 @@ scylla_tests = [
     'tests/data_listeners_test',
     'tests/truncation_migration_test',
     'tests/like_matcher_test',
+    'tests/endpoint_load_tracker_test',
+    'tests/messaging_service_test',
+    'tests/repair_hash_ibf_test',
+    'tests/repair_hash_set_test',
 ]
 
 perf_tests = [
@@ -387,6 +391,8 @@ perf_tests = [
     'tests/perf/perf_mutation_fragment',
     'tests/perf/perf_idl',
     'tests/perf/perf_vint',
+    'tests/perf/perf_like_matcher',
+    'tests/perf/perf_repair_hash',
 ]
 
 apps = [
@@ -491,6 +497,7 @@ scylla_core = (['database.cc',
                 'mutation_reader.cc',
                 'flat_mutation_reader.cc',
                 'mutation_query.cc',
+                'aggregate_query.cc',
                 'json.cc',
                 'keys.cc',
                 'counters.cc',
@@ -585,6 +592,7 @@ scylla_core = (['database.cc',
                 'cql3/column_specification.cc',
                 'cql3/constants.cc',
                 'cql3/query_processor.cc',
+                'cql3/simple_statement_parser.cc',
                 'cql3/query_options.cc',
                 'cql3/single_column_relation.cc',
                 'cql3/token_relation.cc',
@@ -653,6 +661,7 @@ scylla_core = (['database.cc',
                 'dht/range_streamer.cc',
                 'unimplemented.cc',
                 'query.cc',
+                'query_row_filter.cc',
                 'query-result-set.cc',
                 'locator/abstract_replication_strategy.cc',
                 'locator/simple_strategy.cc',
@@ -694,6 +703,8 @@ scylla_core = (['database.cc',
                 'lister.cc',
                 'repair/repair.cc',
                 'repair/row_level.cc',
+                'repair/hash_ibf.cc',
+                'repair/hash_set.cc',
                 'exceptions/exceptions.cc',
                 'auth/allow_all_authenticator.cc',
                 'auth/allow_all_authorizer.cc',
@@ -821,6 +832,7 @@ scylla_tests_generic_dependencies = [
 
 scylla_tests_dependencies = scylla_core + idls + scylla_tests_generic_dependencies + [
     'tests/cql_assertions.cc',
+    'tests/cql_test_connection.cc',
     'tests/result_set_assertions.cc',
     'tests/mutation_source_test.cc',
     'tests/data_model.cc',
@@ -863,6 +875,10 @@ pure_boost_tests = set([
     'tests/top_k_test',
     'tests/small_vector_test',
     'tests/like_matcher_test',
+    'tests/endpoint_load_tracker_test',
+    'tests/messaging_service_test',
+    'tests/repair_hash_ibf_test',
+    'tests/repair_hash_set_test',
 ])
 
 tests_not_using_seastar_test_framework = set([
@@ -1180,6 +1196,15 @@ xxhash_dir = 'xxHash'
 if not os.path.exists(xxhash_dir) or not os.listdir(xxhash_dir):
     raise Exception(xxhash_dir + ' is empty. Run "git submodule update --init".')
 
+# xxh3_hasher uses the streaming XXH3 API, which first shipped in xxHash 0.7.1.
+with open(os.path.join(xxhash_dir, 'xxhash.h')) as f:
+    xxhash_h = f.read()
+xxhash_version = tuple(int(re.search(r'#define XXH_VERSION_{}\s+(\d+)'.format(part), xxhash_h).group(1))
+                       for part in ['MAJOR', 'MINOR', 'RELEASE'])
+if xxhash_version < (0, 7, 1):
+    raise Exception('{} is at version {}, 0.7.1 or later is needed. Run "git submodule update --init".'.format(
+        xxhash_dir, '.'.join(map(str, xxhash_version))))
+
 if not args.staticboost:
     args.user_cflags += ' -DBOOST_TEST_DYN_LINK'
 
@@ -387,6 +387,7 @@ selectStatement returns [shared_ptr<raw::select_statement> expr]
         bool allow_filtering = false;
         bool is_json = false;
         bool bypass_cache = false;
+        bool parallel_scan = false;
     }
     : K_SELECT (
                 ( K_JSON { is_json = true; } )?
@@ -401,8 +402,9 @@ selectStatement returns [shared_ptr<raw::select_statement> expr]
       ( K_LIMIT rows=intValue { limit = rows; } )?
       ( K_ALLOW K_FILTERING  { allow_filtering = true; } )?
       ( K_BYPASS K_CACHE { bypass_cache = true; })?
+      ( K_PARALLEL K_SCAN { parallel_scan = true; })?
       {
-          auto params = ::make_shared<raw::select_statement::parameters>(std::move(orderings), is_distinct, allow_filtering, is_json, bypass_cache);
+          auto params = ::make_shared<raw::select_statement::parameters>(std::move(orderings), is_distinct, allow_filtering, is_json, bypass_cache, parallel_scan);
           $expr = ::make_shared<raw::select_statement>(std::move(cf), std::move(params),
             std::move(sclause), std::move(wclause), std::move(limit), std::move(per_partition_limit),
             std::move(gbcolumns));
@@ -1737,6 +1739,8 @@ basic_unreserved_keyword returns [sstring str]
         | K_JSON
         | K_CACHE
         | K_BYPASS
+        | K_PARALLEL
+        | K_SCAN
         | K_LIKE
         | K_PER
         | K_PARTITION
@@ -1885,6 +1889,8 @@ K_EMPTY:       E M P T Y;
 
 K_BYPASS:      B Y P A S S;
 K_CACHE:       C A C H E;
+K_PARALLEL:    P A R A L L E L;
+K_SCAN:        S C A N;
 
 K_PER:         P E R;
 K_PARTITION:   P A R T I T I O N;
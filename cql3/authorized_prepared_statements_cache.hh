@@ -78,6 +78,13 @@ class authorized_prepared_statements_cache {
         return _stats;
     }
 
+    /// Changes whenever an entry leaves the cache of this shard, whether it
+    /// expired, was refreshed, evicted or invalidated. Lets copies of the
+    /// entries kept elsewhere tell that they may have outlived them.
+    static uint64_t generation() noexcept {
+        return shard_stats().authorized_prepared_statements_cache_evictions;
+    }
+
     struct authorized_prepared_statements_cache_stats_updater {
         static void inc_hits() noexcept {}
         static void inc_misses() noexcept {}
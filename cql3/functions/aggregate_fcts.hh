@@ -42,6 +42,7 @@
 #pragma once
 
 #include "utils/big_decimal.hh"
+#include "types/tuple.hh"
 #include "aggregate_function.hh"
 #include "native_aggregate_function.hh"
 
@@ -54,7 +55,7 @@ namespace functions {
 namespace aggregate_fcts {
 
 class impl_count_function : public aggregate_function::aggregate {
-    int64_t _count;
+    int64_t _count = 0;
 public:
     virtual void reset() override {
         _count = 0;
@@ -65,6 +66,12 @@ class impl_count_function : public aggregate_function::aggregate {
     virtual void add_input(cql_serialization_format sf, const std::vector<opt_bytes>& values) override {
         ++_count;
     }
+    virtual opt_bytes get_state() override {
+        return long_type->decompose(_count);
+    }
+    virtual void merge_state(const opt_bytes& state) override {
+        _count += value_cast<int64_t>(long_type->deserialize(*state));
+    }
 };
 
 static const sstring COUNT_ROWS_FUNCTION_NAME = "countRows";
@@ -106,6 +113,12 @@ class impl_sum_function_for final : public aggregate_function::aggregate {
         }
         _sum += value_cast<Type>(data_type_for<Type>()->deserialize(*values[0]));
     }
+    virtual opt_bytes get_state() override {
+        return data_type_for<Type>()->decompose(_sum);
+    }
+    virtual void merge_state(const opt_bytes& state) override {
+        _sum += value_cast<Type>(data_type_for<Type>()->deserialize(*state));
+    }
 };
 
 template <typename Type>
@@ -186,10 +199,45 @@ struct accumulator_for<big_decimal> {
     using type = big_decimal;
 };
 
+// How the accumulator of an average is represented in its serialized state.
+template <typename Acc>
+struct accumulator_state_for {
+    static data_type type() {
+        return data_type_for<Acc>();
+    }
+    static data_value to_value(const Acc& acc) {
+        return data_value(acc);
+    }
+    static Acc from_value(const data_value& v) {
+        return value_cast<Acc>(v);
+    }
+};
+
+template <>
+struct accumulator_state_for<__int128> {
+    static data_type type() {
+        return varint_type;
+    }
+    static data_value to_value(const __int128& acc) {
+        return data_value(boost::multiprecision::cpp_int(acc));
+    }
+    static __int128 from_value(const data_value& v) {
+        return value_cast<boost::multiprecision::cpp_int>(v).convert_to<__int128>();
+    }
+};
+
 template <typename Type>
 class impl_avg_function_for final : public aggregate_function::aggregate {
-   typename accumulator_for<Type>::type _sum{};
+   using accumulator_type = typename accumulator_for<Type>::type;
+   using state = accumulator_state_for<accumulator_type>;
+   accumulator_type _sum{};
    int64_t _count = 0;
+
+   // The state is a (count, sum) tuple.
+   static data_type state_type() {
+       static thread_local data_type type = tuple_type_impl::get_instance({long_type, state::type()});
+       return type;
+   }
 public:
     virtual void reset() override {
         _sum = {};
@@ -209,6 +257,14 @@ class impl_avg_function_for final : public aggregate_function::aggregate {
         ++_count;
         _sum += value_cast<Type>(data_type_for<Type>()->deserialize(*values[0]));
     }
+    virtual opt_bytes get_state() override {
+        return state_type()->decompose(make_tuple_value(state_type(), {data_value(_count), state::to_value(_sum)}));
+    }
+    virtual void merge_state(const opt_bytes& s) override {
+        auto v = value_cast<tuple_type_impl::native_type>(state_type()->deserialize(*s));
+        _count += value_cast<int64_t>(v[0]);
+        _sum += state::from_value(v[1]);
+    }
 };
 
 template <typename Type>
@@ -266,6 +322,12 @@ class impl_max_function_for final : public aggregate_function::aggregate {
             _max = std::max(*_max, val);
         }
     }
+    virtual opt_bytes get_state() override {
+        return compute(cql_serialization_format::internal());
+    }
+    virtual void merge_state(const opt_bytes& state) override {
+        add_input(cql_serialization_format::internal(), {state});
+    }
 };
 
 template <typename Type>
@@ -313,6 +375,12 @@ class impl_min_function_for final : public aggregate_function::aggregate {
             _min = std::min(*_min, val);
         }
     }
+    virtual opt_bytes get_state() override {
+        return compute(cql_serialization_format::internal());
+    }
+    virtual void merge_state(const opt_bytes& state) override {
+        add_input(cql_serialization_format::internal(), {state});
+    }
 };
 
 template <typename Type>
@@ -354,6 +422,12 @@ class impl_count_function_for final : public aggregate_function::aggregate {
         }
         ++_count;
     }
+    virtual opt_bytes get_state() override {
+        return long_type->decompose(_count);
+    }
+    virtual void merge_state(const opt_bytes& state) override {
+        _count += value_cast<int64_t>(long_type->deserialize(*state));
+    }
 };
 
 template <typename Type>
@@ -87,6 +87,24 @@ class aggregate_function : public virtual function {
          */
         virtual opt_bytes compute(cql_serialization_format sf) = 0;
 
+        /**
+         * Returns the intermediate state of this aggregate, serialized so that
+         * it can be sent to another node and combined there with merge_state().
+         * Unlike compute(), the state is not finalized, e.g. an average keeps
+         * both the sum and the count of its inputs.
+         *
+         * @return the aggregate current state.
+         */
+        virtual opt_bytes get_state() = 0;
+
+        /**
+         * Combines the state of another aggregate of the same function, as
+         * returned by its get_state(), into this aggregate.
+         *
+         * @param state the state to merge.
+         */
+        virtual void merge_state(const opt_bytes& state) = 0;
+
         /**
          * Reset this aggregate.
          */
@@ -104,6 +104,14 @@ query_processor::query_processor(service::storage_proxy& proxy, database& db, qu
         "statements_prepared",
         _stats.prepare_invocations,
         sm::description("Counts a total number of parsed CQL requests.")));
+    qp_group.push_back(sm::make_derive(
+        "simple_statements_parsed",
+        _stats.simple_statements_parsed,
+        sm::description("Counts unprepared statements parsed without the full CQL parser.")));
+    qp_group.push_back(sm::make_derive(
+        "simple_statement_cache_hits",
+        _stats.simple_statement_cache_hits,
+        sm::description("Counts unprepared statements found in the cache of parsed statements.")));
     for (auto cl = size_t(clevel::MIN_VALUE); cl <= size_t(clevel::MAX_VALUE); ++cl) {
         qp_group.push_back(
             sm::make_derive(
@@ -257,6 +265,11 @@ query_processor::query_processor(service::storage_proxy& proxy, database& db, qu
                             _cql_stats.unpaged_select_queries,
                             sm::description("Counts number of unpaged CQL SELECT requests.")),
 
+                    sm::make_counter(
+                            "replica_aggregate_queries",
+                            _cql_stats.replica_aggregate_queries,
+                            sm::description("Counts number of CQL SELECT requests whose aggregates were computed by the replicas.")),
+
             });
 
     service::get_local_migration_manager().register_listener(_migration_subscriber.get());
@@ -408,7 +421,7 @@ prepared_cache_key_type query_processor::compute_thrift_id(
 
 std::unique_ptr<prepared_statement>
 query_processor::get_statement(const sstring_view& query, const service::client_state& client_state) {
-    ::shared_ptr<raw::parsed_statement> statement = parse_statement(query);
+    ::shared_ptr<raw::parsed_statement> statement = parse_statement_cached(query);
 
     // Set keyspace for statement that require login
     auto cf_stmt = dynamic_pointer_cast<raw::cf_statement>(statement);
@@ -419,8 +432,7 @@ query_processor::get_statement(const sstring_view& query, const service::client_
     return statement->prepare(_db, _cql_stats);
 }
 
-::shared_ptr<raw::parsed_statement>
-query_processor::parse_statement(const sstring_view& query) {
+static ::shared_ptr<raw::parsed_statement> parse_with_antlr(const sstring_view& query) {
     try {
         auto statement = util::do_with_parser(query,  std::mem_fn(&cql3_parser::CqlParser::query));
         if (!statement) {
@@ -437,6 +449,40 @@ query_processor::parse_statement(const sstring_view& query) {
     }
 }
 
+::shared_ptr<raw::parsed_statement>
+query_processor::parse_statement(const sstring_view& query) {
+    if (auto simple = parse_simple_statement(query)) {
+        return simple->make_raw();
+    }
+    return parse_with_antlr(query);
+}
+
+::shared_ptr<raw::parsed_statement>
+query_processor::parse_statement_cached(const sstring_view& query) {
+    if (query.size() > max_cached_simple_statement_size) {
+        return parse_statement(query);
+    }
+    sstring key(query);
+    auto it = _simple_statements.find(key);
+    if (it != _simple_statements.end()) {
+        ++_stats.simple_statement_cache_hits;
+        return it->second.make_raw();
+    }
+    auto simple = parse_simple_statement(query);
+    if (!simple) {
+        return parse_with_antlr(query);
+    }
+    ++_stats.simple_statements_parsed;
+    if (_simple_statements.size() >= max_cached_simple_statements) {
+        // Queries with inlined values rarely repeat, so an arbitrary entry is
+        // about as good a victim as the least recently used one.
+        _simple_statements.erase(_simple_statements.begin());
+    }
+    auto raw = simple->make_raw();
+    _simple_statements.emplace(std::move(key), std::move(*simple));
+    return raw;
+}
+
 query_options query_processor::make_internal_options(
         const statements::prepared_statement::checked_weak_ptr& p,
         const std::initializer_list<data_value>& values,
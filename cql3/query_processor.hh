@@ -51,6 +51,7 @@
 #include "cql3/prepared_statements_cache.hh"
 #include "cql3/authorized_prepared_statements_cache.hh"
 #include "cql3/query_options.hh"
+#include "cql3/simple_statement_parser.hh"
 #include "cql3/statements/prepared_statement.hh"
 #include "cql3/statements/raw/parsed_statement.hh"
 #include "cql3/statements/raw/cf_statement.hh"
@@ -112,6 +113,8 @@ class query_processor {
 
     struct stats {
         uint64_t prepare_invocations = 0;
+        uint64_t simple_statements_parsed = 0;
+        uint64_t simple_statement_cache_hits = 0;
         uint64_t queries_by_cl[size_t(db::consistency_level::MAX_VALUE) + 1] = {};
     } _stats;
 
@@ -129,6 +132,13 @@ class query_processor {
     // don't bother with expiration on those.
     std::unordered_map<sstring, std::unique_ptr<statements::prepared_statement>> _internal_statements;
 
+    // Statements recognized by parse_simple_statement(), by query text, so that
+    // repeated unprepared queries don't need to be parsed again.
+    std::unordered_map<sstring, simple_statement> _simple_statements;
+    static constexpr size_t max_cached_simple_statements = 1000;
+    // Longer queries typically carry large literals and are unlikely to repeat.
+    static constexpr size_t max_cached_simple_statement_size = 1024;
+
 public:
     static const sstring CQL_VERSION;
 
@@ -142,6 +152,10 @@ class query_processor {
 
     static ::shared_ptr<statements::raw::parsed_statement> parse_statement(const std::string_view& query);
 
+    /// Like parse_statement(), but simple statements are looked up in, and
+    /// added to, a cache of statements parsed on this shard.
+    ::shared_ptr<statements::raw::parsed_statement> parse_statement_cached(const std::string_view& query);
+
     query_processor(service::storage_proxy& proxy, database& db, memory_config mcfg);
 
     ~query_processor();
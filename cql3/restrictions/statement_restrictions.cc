@@ -517,6 +517,37 @@ bool statement_restrictions::need_filtering() const {
             || (_uses_secondary_indexing && number_of_filtering_restrictions > 1);
 }
 
+std::vector<query::column_predicate> statement_restrictions::get_column_predicates(const query_options& options) const {
+    using comparison = query::column_predicate::comparison;
+    std::vector<query::column_predicate> predicates;
+    auto add = [&] (const column_definition& cdef, comparison op, std::vector<bytes_opt> values) {
+        // Null values are left for the coordinator to deal with.
+        if (values.empty() || boost::algorithm::any_of(values, [] (const bytes_opt& v) { return !v; })) {
+            return;
+        }
+        predicates.push_back(query::column_predicate{cdef.name(), op,
+                boost::copy_range<std::vector<bytes>>(values | boost::adaptors::transformed([] (bytes_opt& v) { return std::move(*v); }))});
+    };
+    for (auto&& [cdef, r] : _nonprimary_key_restrictions->restrictions()) {
+        if (!cdef->is_regular() || !cdef->is_atomic() || cdef->is_counter()) {
+            continue;
+        }
+        if (r->is_EQ()) {
+            add(*cdef, comparison::eq, r->values(options));
+        } else if (r->is_IN()) {
+            add(*cdef, comparison::in, r->values(options));
+        } else if (r->is_slice()) {
+            if (r->has_bound(statements::bound::START)) {
+                add(*cdef, r->is_inclusive(statements::bound::START) ? comparison::gte : comparison::gt, r->bounds(statements::bound::START, options));
+            }
+            if (r->has_bound(statements::bound::END)) {
+                add(*cdef, r->is_inclusive(statements::bound::END) ? comparison::lte : comparison::lt, r->bounds(statements::bound::END, options));
+            }
+        }
+    }
+    return predicates;
+}
+
 void statement_restrictions::validate_secondary_index_selections(bool selects_only_static_columns) {
     if (key_is_in_relation()) {
         throw exceptions::invalid_request_exception(
@@ -381,6 +381,14 @@ class statement_restrictions {
      */
     bool need_filtering() const;
 
+    /**
+     * Returns the restrictions of regular columns which replicas can apply
+     * to the rows they read, i.e. EQ, IN and slice restrictions of atomic,
+     * non-counter columns. Only a part of the restrictions of the query may
+     * be returned, so the rows still need to be filtered.
+     */
+    std::vector<query::column_predicate> get_column_predicates(const query_options& options) const;
+
     void validate_secondary_index_selections(bool selects_only_static_columns);
 
     /**
@@ -36,13 +36,23 @@ class result_generator {
     template<typename Visitor>
     class query_result_visitor {
         const schema& _schema;
-        std::vector<bytes> _partition_key;
-        std::vector<bytes> _clustering_key;
+        // Views into the keys passed to accept_new_partition() and
+        // accept_new_row(). result_view::consume() keeps the partition key
+        // alive until accept_partition_end(), and the clustering key for the
+        // duration of accept_new_row(), so components need not be copied.
+        // The vectors are reused to avoid allocating for every row.
+        std::vector<bytes_view> _partition_key;
+        std::vector<bytes_view> _clustering_key;
         uint32_t _partition_row_count = 0;
         uint32_t _total_row_count = 0;
         Visitor& _visitor;
         const selection::selection& _selection;
     private:
+        template<typename Key>
+        void explode(const Key& key, std::vector<bytes_view>& components) {
+            components.clear();
+            std::copy(key.begin(_schema), key.end(_schema), std::back_inserter(components));
+        }
         void accept_cell_value(const column_definition& def, query::result_row_view::iterator_type& i) {
             if (def.is_multi_cell()) {
                 _visitor.accept_value(i.next_collection_cell());
@@ -56,7 +66,7 @@ class result_generator {
             : _schema(s), _visitor(visitor), _selection(select) { }
 
         void accept_new_partition(const partition_key& key, uint32_t row_count) {
-            _partition_key = key.explode(_schema);
+            explode(key, _partition_key);
             accept_new_partition(row_count);
         }
         void accept_new_partition(uint32_t row_count) {
@@ -66,7 +76,7 @@ class result_generator {
 
         void accept_new_row(const clustering_key& key, query::result_row_view static_row,
                             query::result_row_view row) {
-            _clustering_key = key.explode(_schema);
+            explode(key, _clustering_key);
             accept_new_row(static_row, row);
         }
         void accept_new_row(query::result_row_view static_row, query::result_row_view row) {
@@ -76,11 +86,11 @@ class result_generator {
             for (auto&& def : _selection.get_columns()) {
                 switch (def->kind) {
                 case column_kind::partition_key:
-                    _visitor.accept_value(query::result_bytes_view(bytes_view(_partition_key[def->component_index()])));
+                    _visitor.accept_value(query::result_bytes_view(_partition_key[def->component_index()]));
                     break;
                 case column_kind::clustering_key:
                     if (_clustering_key.size() > def->component_index()) {
-                        _visitor.accept_value(query::result_bytes_view(bytes_view(_clustering_key[def->component_index()])));
+                        _visitor.accept_value(query::result_bytes_view(_clustering_key[def->component_index()]));
                     } else {
                         _visitor.accept_value({});
                     }
@@ -103,7 +113,7 @@ class result_generator {
                 auto static_row_iterator = static_row.iterator();
                 for (auto&& def : _selection.get_columns()) {
                     if (def->is_partition_key()) {
-                        _visitor.accept_value(query::result_bytes_view(bytes_view(_partition_key[def->component_index()])));
+                        _visitor.accept_value(query::result_bytes_view(_partition_key[def->component_index()]));
                     } else if (def->is_static()) {
                         accept_cell_value(*def, static_row_iterator);
                     } else {
@@ -97,6 +97,23 @@ abstract_function_selector::new_factory(shared_ptr<functions::function> fun, sha
         virtual bool is_aggregate_selector_factory() override {
             return _fun->is_aggregate() || _factories->contains_only_aggregate_functions();
         }
+
+        virtual std::optional<query::aggregate_spec> get_aggregate_spec(const std::vector<const column_definition*>& columns) override {
+            if (!_fun->is_aggregate() || !_fun->is_native()) {
+                return std::nullopt;
+            }
+            query::aggregate_spec spec{_fun->name().name, std::nullopt};
+            if (_fun->arg_types().size() == 1) {
+                auto idx = (*_factories->begin())->selected_column_index();
+                if (!idx) {
+                    return std::nullopt;
+                }
+                spec.column_name = columns[*idx]->name();
+            } else if (!_fun->arg_types().empty()) {
+                return std::nullopt;
+            }
+            return spec;
+        }
     };
 
     return make_shared<fun_selector_factory>(std::move(fun), std::move(factories));
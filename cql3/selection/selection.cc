@@ -171,6 +171,18 @@ class selection_with_processing : public selection {
     virtual bool is_aggregate() const override {
         return _factories->does_aggregation();
     }
+
+    virtual std::optional<std::vector<query::aggregate_spec>> get_aggregate_specs() const override {
+        std::vector<query::aggregate_spec> specs;
+        for (auto&& f : *_factories) {
+            auto spec = f->get_aggregate_spec(get_columns());
+            if (!spec) {
+                return std::nullopt;
+            }
+            specs.push_back(std::move(*spec));
+        }
+        return specs;
+    }
 protected:
     class selectors_with_processing : public selectors {
     private:
@@ -209,6 +209,16 @@ class selection {
 
     virtual bool is_aggregate() const = 0;
 
+    /**
+     * Describes the aggregates of this selection, if the replicas can compute all of them.
+     *
+     * @return the aggregates, in the order of the selection, or <code>std::nullopt</code> if the
+     * selection isn't made of aggregates only or the replicas can't compute some of them.
+     */
+    virtual std::optional<std::vector<query::aggregate_spec>> get_aggregate_specs() const {
+        return std::nullopt;
+    }
+
     /**
      * Checks that selectors are either all aggregates or that none of them is.
      *
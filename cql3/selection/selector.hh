@@ -45,6 +45,7 @@
 #include "cql3/assignment_testable.hh"
 #include "types.hh"
 #include "schema.hh"
+#include "query-request.hh"
 
 namespace cql3 {
 
@@ -174,6 +175,27 @@ class selector::factory {
         return false;
     }
 
+    /**
+     * Returns the index of the column the selector instances created by this factory select as is.
+     *
+     * @return the index of the selected column in the selection, or <code>std::nullopt</code> if the
+     * selector instances created by this factory do anything else than selecting a column.
+     */
+    virtual std::optional<uint32_t> selected_column_index() {
+        return std::nullopt;
+    }
+
+    /**
+     * Describes the aggregate computed by the selector instances created by this factory, so that
+     * it can be computed by the replicas instead.
+     *
+     * @param columns the columns of the selection
+     * @return the aggregate, or <code>std::nullopt</code> if the replicas can't compute it.
+     */
+    virtual std::optional<query::aggregate_spec> get_aggregate_spec(const std::vector<const column_definition*>& columns) {
+        return std::nullopt;
+    }
+
     /**
      * Returns the name of the column corresponding to the output value of the selector instances created by
      * this factory.
@@ -0,0 +1,570 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <array>
+
+#include "cql3/simple_statement_parser.hh"
+#include "cql3/abstract_marker.hh"
+#include "cql3/attributes.hh"
+#include "cql3/cf_name.hh"
+#include "cql3/constants.hh"
+#include "cql3/operation_impl.hh"
+#include "cql3/single_column_relation.hh"
+#include "cql3/selection/raw_selector.hh"
+#include "cql3/statements/raw/insert_statement.hh"
+#include "cql3/statements/raw/select_statement.hh"
+#include "cql3/statements/raw/update_statement.hh"
+
+namespace cql3 {
+
+namespace {
+
+// All the keywords of Cql.g, in lower case and sorted. Unquoted identifiers
+// matching one of them are left to the full parser, which knows which
+// keywords are reserved.
+constexpr std::array<std::string_view, 137> keywords = {
+    "add", "aggregate", "all", "allow", "alter", "and", "apply", "as", "asc", "ascii", "authorize",
+    "batch", "begin", "bigint", "blob", "boolean", "by", "bypass", "cache", "cast", "clustering",
+    "columnfamily", "compact", "contains", "count", "counter", "create", "custom", "date",
+    "decimal", "default", "delete", "desc", "describe", "deterministic", "distinct", "double",
+    "drop", "duration", "empty", "entries", "exists", "filtering", "finalfunc", "float", "from",
+    "frozen", "full", "function", "grant", "group", "if", "in", "index", "inet", "infinity",
+    "initcond", "insert", "int", "into", "is", "json", "key", "keys", "keyspace", "keyspaces",
+    "language", "like", "limit", "list", "login", "map", "materialized", "modify", "nan",
+    "nologin", "non", "norecursive", "nosuperuser", "not", "null", "of", "on", "options", "or",
+    "order", "partition", "password", "per", "permission", "permissions", "primary", "rename",
+    "replace", "returns", "revoke", "role", "roles", "schema", "scylla_counter_shard_list",
+    "scylla_timeuuid_list_index", "select", "set", "sfunc", "smallint", "static", "storage",
+    "stype", "superuser", "table", "text", "time", "timestamp", "timeuuid", "tinyint", "to",
+    "token", "trigger", "truncate", "ttl", "tuple", "type", "unlogged", "unset", "update", "use",
+    "user", "users", "using", "uuid", "values", "varchar", "varint", "view", "where", "with",
+    "writetime"
+};
+
+bool is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_hex_digit(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Characters which, following a number, make it a different token than the
+// one we lexed (a UUID, a duration, a float...).
+bool continues_number(char c) {
+    return is_letter(c) || is_digit(c) || c == '_' || c == '-' || c == '.';
+}
+
+// Likewise for words, which can be the beginning of a UUID.
+bool continues_word(char c) {
+    return c == '-';
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [] (char x, char y) {
+        return ::tolower(x) == ::tolower(y);
+    });
+}
+
+sstring normalized(const simple_statement::identifier& id) {
+    if (id.quoted) {
+        return id.text;
+    }
+    sstring lower = id.text;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    return lower;
+}
+
+}
+
+// Recursive descent over the subset of the grammar described in the header.
+// Every parse_*() method returns false, or a disengaged optional, when the
+// input doesn't match, in which case the whole statement is given up on.
+class simple_statement_parser {
+    std::string_view _query;
+    size_t _pos = 0;
+    simple_statement _stmt;
+private:
+    bool at_end() const {
+        return _pos == _query.size();
+    }
+
+    char peek(size_t ahead = 0) const {
+        return _pos + ahead < _query.size() ? _query[_pos + ahead] : '\0';
+    }
+
+    void skip_whitespace() {
+        while (!at_end() && (peek() == ' ' || peek() == '\t' || peek() == '\n' || peek() == '\r')) {
+            ++_pos;
+        }
+    }
+
+    bool accept(char c) {
+        skip_whitespace();
+        return accept_immediately(c);
+    }
+
+    bool accept_immediately(char c) {
+        if (peek() == c) {
+            ++_pos;
+            return true;
+        }
+        return false;
+    }
+
+    // Returns the word at the current position, without consuming it.
+    std::string_view peek_word() {
+        skip_whitespace();
+        if (!is_letter(peek())) {
+            return {};
+        }
+        auto end = _pos + 1;
+        while (end < _query.size() && (is_letter(_query[end]) || is_digit(_query[end]) || _query[end] == '_')) {
+            ++end;
+        }
+        return _query.substr(_pos, end - _pos);
+    }
+
+    bool accept_keyword(std::string_view keyword) {
+        auto word = peek_word();
+        if (!iequals(word, keyword)) {
+            return false;
+        }
+        _pos += word.size();
+        return true;
+    }
+
+    std::optional<simple_statement::identifier> parse_identifier() {
+        skip_whitespace();
+        if (peek() == '"') {
+            sstring text;
+            size_t i = _pos + 1;
+            for (;;) {
+                if (i == _query.size()) {
+                    return std::nullopt;
+                }
+                if (_query[i] == '"') {
+                    if (i + 1 < _query.size() && _query[i + 1] == '"') {
+                        text += '"';
+                        i += 2;
+                        continue;
+                    }
+                    break;
+                }
+                text += _query[i++];
+            }
+            if (text.empty()) {
+                return std::nullopt;
+            }
+            _pos = i + 1;
+            return simple_statement::identifier{std::move(text), true};
+        }
+        auto word = peek_word();
+        if (word.empty() || continues_word(peek_char_after(word))) {
+            return std::nullopt;
+        }
+        // The lexer prefers ISO 8601 durations, like P1D or PT1H, over identifiers.
+        if (word[0] == 'P' && (word.size() == 1 || is_digit(word[1]) || word[1] == 'T')) {
+            return std::nullopt;
+        }
+        sstring lower(word.data(), word.size());
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower == "true" || lower == "false" || std::binary_search(keywords.begin(), keywords.end(), std::string_view(lower))) {
+            return std::nullopt;
+        }
+        _pos += word.size();
+        return simple_statement::identifier{sstring(word.data(), word.size()), false};
+    }
+
+    char peek_char_after(std::string_view word) const {
+        size_t end = word.data() + word.size() - _query.data();
+        return end < _query.size() ? _query[end] : '\0';
+    }
+
+    std::optional<simple_statement::term> parse_marker() {
+        if (accept('?')) {
+            _stmt._bind_variables.emplace_back();
+        } else if (accept(':')) {
+            auto name = parse_identifier();
+            if (!name) {
+                return std::nullopt;
+            }
+            _stmt._bind_variables.emplace_back(std::move(*name));
+        } else {
+            return std::nullopt;
+        }
+        return simple_statement::term{simple_statement::term_kind::marker, {}, _stmt._bind_variables.size() - 1};
+    }
+
+    std::optional<simple_statement::term> parse_integer() {
+        skip_whitespace();
+        auto start = _pos;
+        auto i = _pos + (peek() == '-');
+        if (i >= _query.size() || !is_digit(_query[i])) {
+            return std::nullopt;
+        }
+        while (i < _query.size() && is_digit(_query[i])) {
+            ++i;
+        }
+        if (i < _query.size() && continues_number(_query[i])) {
+            return std::nullopt;
+        }
+        _pos = i;
+        return simple_statement::term{simple_statement::term_kind::integer, sstring(_query.data() + start, i - start)};
+    }
+
+    // An INTEGER or a bind marker, as accepted by LIMIT and USING.
+    std::optional<simple_statement::term> parse_int_value() {
+        if (auto marker = parse_marker()) {
+            return marker;
+        }
+        return parse_integer();
+    }
+
+    std::optional<simple_statement::term> parse_term() {
+        using kind = simple_statement::term_kind;
+        if (auto marker = parse_marker()) {
+            return marker;
+        }
+        skip_whitespace();
+        auto c = peek();
+        if (c == '\'') {
+            sstring text;
+            size_t i = _pos + 1;
+            for (;;) {
+                if (i == _query.size()) {
+                    return std::nullopt;
+                }
+                if (_query[i] == '\'') {
+                    if (i + 1 < _query.size() && _query[i + 1] == '\'') {
+                        text += '\'';
+                        i += 2;
+                        continue;
+                    }
+                    break;
+                }
+                text += _query[i++];
+            }
+            _pos = i + 1;
+            return simple_statement::term{kind::string, std::move(text)};
+        }
+        if (c == '0' && (peek(1) == 'x' || peek(1) == 'X')) {
+            auto i = _pos + 2;
+            while (i < _query.size() && is_hex_digit(_query[i])) {
+                ++i;
+            }
+            if (i < _query.size() && continues_number(_query[i])) {
+                return std::nullopt;
+            }
+            auto text = sstring(_query.data() + _pos, i - _pos);
+            _pos = i;
+            return simple_statement::term{kind::hex, std::move(text)};
+        }
+        if (is_digit(c) || c == '-') {
+            return parse_integer();
+        }
+        auto word = peek_word();
+        if (word.empty() || continues_word(peek_char_after(word))) {
+            return std::nullopt;
+        }
+        if (iequals(word, "true") || iequals(word, "false")) {
+            _pos += word.size();
+            return simple_statement::term{kind::boolean, sstring(word.data(), word.size())};
+        }
+        if (iequals(word, "null")) {
+            _pos += word.size();
+            return simple_statement::term{kind::null};
+        }
+        return std::nullopt;
+    }
+
+    bool parse_table_name() {
+        auto name = parse_identifier();
+        if (!name) {
+            return false;
+        }
+        if (accept('.')) {
+            _stmt._keyspace = std::move(name);
+            name = parse_identifier();
+            if (!name) {
+                return false;
+            }
+        }
+        _stmt._table = std::move(*name);
+        return true;
+    }
+
+    bool parse_where_clause() {
+        do {
+            auto column = parse_identifier();
+            if (!column) {
+                return false;
+            }
+            const operator_type* op;
+            // '<=' and '>=' are single tokens, so no whitespace is allowed before the '='.
+            if (accept('=')) {
+                op = &operator_type::EQ;
+            } else if (accept('<')) {
+                op = accept_immediately('=') ? &operator_type::LTE : &operator_type::LT;
+            } else if (accept('>')) {
+                op = accept_immediately('=') ? &operator_type::GTE : &operator_type::GT;
+            } else {
+                return false;
+            }
+            auto value = parse_term();
+            if (!value) {
+                return false;
+            }
+            _stmt._where.push_back(simple_statement::relation{std::move(*column), op, std::move(*value)});
+        } while (accept_keyword("and"));
+        return true;
+    }
+
+    bool parse_using_clause() {
+        if (!accept_keyword("using")) {
+            return true;
+        }
+        do {
+            std::optional<simple_statement::term>* attr;
+            if (accept_keyword("ttl")) {
+                attr = &_stmt._ttl;
+            } else if (accept_keyword("timestamp")) {
+                attr = &_stmt._timestamp;
+            } else {
+                return false;
+            }
+            *attr = parse_int_value();
+            if (!*attr) {
+                return false;
+            }
+        } while (accept_keyword("and"));
+        return true;
+    }
+
+    bool parse_select() {
+        _stmt._kind = simple_statement::kind::select;
+        if (!accept('*')) {
+            do {
+                auto column = parse_identifier();
+                if (!column) {
+                    return false;
+                }
+                _stmt._columns.push_back(std::move(*column));
+            } while (accept(','));
+        }
+        if (!accept_keyword("from") || !parse_table_name()) {
+            return false;
+        }
+        if (accept_keyword("where") && !parse_where_clause()) {
+            return false;
+        }
+        if (accept_keyword("limit")) {
+            _stmt._limit = parse_int_value();
+            if (!_stmt._limit) {
+                return false;
+            }
+        }
+        if (accept_keyword("allow")) {
+            if (!accept_keyword("filtering")) {
+                return false;
+            }
+            _stmt._allow_filtering = true;
+        }
+        return true;
+    }
+
+    bool parse_insert() {
+        _stmt._kind = simple_statement::kind::insert;
+        if (!accept_keyword("into") || !parse_table_name() || !accept('(')) {
+            return false;
+        }
+        do {
+            auto column = parse_identifier();
+            if (!column) {
+                return false;
+            }
+            _stmt._columns.push_back(std::move(*column));
+        } while (accept(','));
+        if (!accept(')') || !accept_keyword("values") || !accept('(')) {
+            return false;
+        }
+        do {
+            auto value = parse_term();
+            if (!value) {
+                return false;
+            }
+            _stmt._values.push_back(std::move(*value));
+        } while (accept(','));
+        return accept(')') && parse_using_clause();
+    }
+
+    bool parse_update() {
+        _stmt._kind = simple_statement::kind::update;
+        if (!parse_table_name() || !parse_using_clause() || !accept_keyword("set")) {
+            return false;
+        }
+        do {
+            auto column = parse_identifier();
+            if (!column || !accept('=')) {
+                return false;
+            }
+            auto value = parse_term();
+            if (!value) {
+                return false;
+            }
+            // Setting a column twice is an error, let the full parser report it.
+            auto name = normalized(*column);
+            if (std::any_of(_stmt._columns.begin(), _stmt._columns.end(), [&] (auto& c) { return normalized(c) == name; })) {
+                return false;
+            }
+            _stmt._columns.push_back(std::move(*column));
+            _stmt._values.push_back(std::move(*value));
+        } while (accept(','));
+        return accept_keyword("where") && parse_where_clause();
+    }
+public:
+    explicit simple_statement_parser(std::string_view query)
+        : _query(query) {
+    }
+
+    std::optional<simple_statement> parse() && {
+        bool parsed;
+        if (accept_keyword("select")) {
+            parsed = parse_select();
+        } else if (accept_keyword("insert")) {
+            parsed = parse_insert();
+        } else if (accept_keyword("update")) {
+            parsed = parse_update();
+        } else {
+            return std::nullopt;
+        }
+        while (accept(';')) {
+        }
+        skip_whitespace();
+        if (!parsed || !at_end()) {
+            return std::nullopt;
+        }
+        return std::move(_stmt);
+    }
+};
+
+std::optional<simple_statement> parse_simple_statement(std::string_view query) {
+    return simple_statement_parser(query).parse();
+}
+
+static ::shared_ptr<column_identifier::raw> make_raw_identifier(const simple_statement::identifier& id) {
+    return ::make_shared<column_identifier::raw>(id.text, id.quoted);
+}
+
+static ::shared_ptr<term::raw> make_raw_term(const simple_statement::term& t) {
+    switch (t.kind) {
+    case simple_statement::term_kind::string:
+        return constants::literal::string(t.text);
+    case simple_statement::term_kind::integer:
+        return constants::literal::integer(t.text);
+    case simple_statement::term_kind::hex:
+        return constants::literal::hex(t.text);
+    case simple_statement::term_kind::boolean:
+        return constants::literal::bool_(t.text);
+    case simple_statement::term_kind::null:
+        return constants::NULL_LITERAL;
+    case simple_statement::term_kind::marker:
+        return ::make_shared<abstract_marker::raw>(t.bind_index);
+    }
+    abort();
+}
+
+static ::shared_ptr<term::raw> make_raw_term(const std::optional<simple_statement::term>& t) {
+    return t ? make_raw_term(*t) : nullptr;
+}
+
+::shared_ptr<statements::raw::parsed_statement> simple_statement::make_raw() const {
+    auto cf = ::make_shared<cf_name>();
+    if (_keyspace) {
+        cf->set_keyspace(_keyspace->text, _keyspace->quoted);
+    }
+    cf->set_column_family(_table.text, _table.quoted);
+
+    std::vector<relation_ptr> where_clause;
+    where_clause.reserve(_where.size());
+    for (auto& r : _where) {
+        where_clause.push_back(::make_shared<single_column_relation>(make_raw_identifier(r.column), *r.op, make_raw_term(r.value)));
+    }
+
+    auto attrs = ::make_shared<attributes::raw>();
+    attrs->time_to_live = make_raw_term(_ttl);
+    attrs->timestamp = make_raw_term(_timestamp);
+
+    ::shared_ptr<statements::raw::parsed_statement> stmt;
+    switch (_kind) {
+    case kind::select: {
+        std::vector<::shared_ptr<selection::raw_selector>> selectors;
+        selectors.reserve(_columns.size());
+        for (auto& c : _columns) {
+            selectors.push_back(::make_shared<selection::raw_selector>(make_raw_identifier(c), nullptr));
+        }
+        auto params = ::make_shared<statements::raw::select_statement::parameters>(
+                statements::raw::select_statement::parameters::orderings_type(), false, _allow_filtering, false, false, false);
+        stmt = ::make_shared<statements::raw::select_statement>(std::move(cf), std::move(params), std::move(selectors),
+                std::move(where_clause), make_raw_term(_limit), nullptr, std::vector<::shared_ptr<column_identifier::raw>>());
+        break;
+    }
+    case kind::insert: {
+        std::vector<::shared_ptr<column_identifier::raw>> columns;
+        std::vector<::shared_ptr<term::raw>> values;
+        columns.reserve(_columns.size());
+        values.reserve(_values.size());
+        for (auto& c : _columns) {
+            columns.push_back(make_raw_identifier(c));
+        }
+        for (auto& v : _values) {
+            values.push_back(make_raw_term(v));
+        }
+        stmt = ::make_shared<statements::raw::insert_statement>(std::move(cf), std::move(attrs), std::move(columns), std::move(values), false);
+        break;
+    }
+    case kind::update: {
+        std::vector<std::pair<::shared_ptr<column_identifier::raw>, ::shared_ptr<operation::raw_update>>> updates;
+        updates.reserve(_columns.size());
+        for (size_t i = 0; i < _columns.size(); ++i) {
+            updates.emplace_back(make_raw_identifier(_columns[i]), ::make_shared<operation::set_value>(make_raw_term(_values[i])));
+        }
+        stmt = ::make_shared<statements::raw::update_statement>(std::move(cf), std::move(attrs), std::move(updates),
+                std::move(where_clause), statements::raw::modification_statement::conditions_vector());
+        break;
+    }
+    }
+
+    std::vector<::shared_ptr<column_identifier>> bind_variables;
+    bind_variables.reserve(_bind_variables.size());
+    for (auto& name : _bind_variables) {
+        bind_variables.push_back(name ? ::make_shared<column_identifier>(name->text, name->quoted) : nullptr);
+    }
+    stmt->set_bound_variables(bind_variables);
+    return stmt;
+}
+
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <seastar/core/shared_ptr.hh>
+#include <seastar/core/sstring.hh>
+
+#include "cql3/operator.hh"
+#include "cql3/statements/raw/parsed_statement.hh"
+
+namespace cql3 {
+
+/// A statement recognized by parse_simple_statement().
+///
+/// Raw statements are consumed by prepare(), so they can't be kept around
+/// and reused. A simple_statement holds just what is needed to build the raw
+/// statement again, cheaply and without going through the parser, so it can
+/// be cached by query text.
+class simple_statement {
+public:
+    struct identifier {
+        sstring text;
+        bool quoted = false;
+    };
+    enum class term_kind : uint8_t { string, integer, hex, boolean, null, marker };
+    struct term {
+        term_kind kind;
+        // The literal as it appears in the query (unescaped for strings),
+        // unused for null and markers.
+        sstring text;
+        // The bind index of a marker.
+        size_t bind_index = 0;
+    };
+    struct relation {
+        identifier column;
+        const operator_type* op;
+        term value;
+    };
+    enum class kind : uint8_t { select, insert, update };
+private:
+    friend class simple_statement_parser;
+
+    kind _kind;
+    std::optional<identifier> _keyspace;
+    identifier _table;
+    // Selected columns (empty for '*'), inserted columns or updated columns.
+    std::vector<identifier> _columns;
+    // Inserted or assigned values, matching _columns.
+    std::vector<term> _values;
+    std::vector<relation> _where;
+    std::optional<term> _limit;
+    std::optional<term> _timestamp;
+    std::optional<term> _ttl;
+    bool _allow_filtering = false;
+    // Names of the bind variables, disengaged for anonymous ones.
+    std::vector<std::optional<identifier>> _bind_variables;
+public:
+    kind get_kind() const {
+        return _kind;
+    }
+
+    /// Builds the raw statement the CQL parser would have returned for the
+    /// query this statement was parsed from.
+    ::shared_ptr<statements::raw::parsed_statement> make_raw() const;
+};
+
+/// Recognizes the most common shapes of SELECT, INSERT and UPDATE statements
+/// by primary key, which make up most of the unprepared traffic, without
+/// running the ANTLR-generated parser:
+///
+///     SELECT * | c1, c2... FROM [ks.]t [WHERE c1 op v1 AND ...] [LIMIT n] [ALLOW FILTERING]
+///     INSERT INTO [ks.]t (c1, c2...) VALUES (v1, v2...) [USING TTL n [AND TIMESTAMP n]]
+///     UPDATE [ks.]t [USING ...] SET c1 = v1, c2 = v2... WHERE c1 op v1 AND ...
+///
+/// where values are literal strings, integers, blobs, booleans, NULL or bind
+/// markers. Returns a disengaged optional for anything else, including
+/// malformed statements, which should then go through the full parser so
+/// that errors are reported the usual way.
+std::optional<simple_statement> parse_simple_statement(std::string_view query);
+
+}
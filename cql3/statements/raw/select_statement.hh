@@ -77,6 +77,7 @@ class select_statement : public cf_statement
         const bool _allow_filtering;
         const bool _is_json;
         bool _bypass_cache = false;
+        bool _parallel_scan = false;
     public:
         parameters();
         parameters(orderings_type orderings,
@@ -86,11 +87,13 @@ class select_statement : public cf_statement
             bool is_distinct,
             bool allow_filtering,
             bool is_json,
-            bool bypass_cache);
+            bool bypass_cache,
+            bool parallel_scan);
         bool is_distinct() const;
         bool allow_filtering() const;
         bool is_json() const;
         bool bypass_cache() const;
+        bool parallel_scan() const;
         orderings_type const& orderings() const;
     };
     template<typename T>
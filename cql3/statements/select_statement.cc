@@ -58,7 +58,11 @@
 #include "db/timeout_clock.hh"
 #include "db/consistency_level_validations.hh"
 #include "database.hh"
+#include "aggregate_query.hh"
+#include "service/storage_service.hh"
 #include <boost/algorithm/cxx11/any_of.hpp>
+#include <boost/algorithm/cxx11/all_of.hpp>
+#include <boost/range/irange.hpp>
 
 namespace cql3 {
 
@@ -85,12 +89,14 @@ select_statement::parameters::parameters(orderings_type orderings,
                                          bool is_distinct,
                                          bool allow_filtering,
                                          bool is_json,
-                                         bool bypass_cache)
+                                         bool bypass_cache,
+                                         bool parallel_scan)
     : _orderings{std::move(orderings)}
     , _is_distinct{is_distinct}
     , _allow_filtering{allow_filtering}
     , _is_json{is_json}
     , _bypass_cache{bypass_cache}
+    , _parallel_scan{parallel_scan}
 { }
 
 bool select_statement::parameters::is_distinct() const {
@@ -109,6 +115,10 @@ bool select_statement::parameters::bypass_cache() const {
     return _bypass_cache;
 }
 
+bool select_statement::parameters::parallel_scan() const {
+    return _parallel_scan;
+}
+
 select_statement::parameters::orderings_type const& select_statement::parameters::orderings() const {
     return _orderings;
 }
@@ -310,6 +320,15 @@ select_statement::do_execute(service::storage_proxy& proxy,
     auto command = ::make_lw_shared<query::read_command>(_schema->id(), _schema->version(),
         make_partition_slice(options), limit, now, tracing::make_trace_info(state.get_trace_state()), query::max_partitions, utils::UUID(), options.get_timestamp(state));
 
+    // Let the replica drop rows which don't satisfy the restrictions before
+    // they make it into the result. The rows of different replicas are
+    // filtered independently, so a row which only matches once the replicas'
+    // versions of it are reconciled would be lost: restrict this to reads
+    // from a single replica.
+    if (restrictions_need_filtering && (cl == db::consistency_level::ONE || cl == db::consistency_level::LOCAL_ONE)) {
+        command->slice.set_filter(_restrictions->get_column_predicates(options));
+    }
+
     int32_t page_size = options.get_page_size();
 
     _stats.unpaged_select_queries += page_size <= 0;
@@ -326,6 +345,12 @@ select_statement::do_execute(service::storage_proxy& proxy,
 
     auto key_ranges = _restrictions->get_partition_key_ranges(options);
 
+    if (_selection->is_aggregate() && !has_group_by()) {
+        if (auto aggregates = get_replica_aggregates(proxy, options)) {
+            return execute_aggregates_on_replicas(proxy, command, std::move(key_ranges), std::move(*aggregates), state, options);
+        }
+    }
+
     if (!aggregate && !restrictions_need_filtering && (page_size <= 0
             || !service::pager::query_pagers::may_need_paging(*_schema, page_size,
                     *command, key_ranges))) {
@@ -334,8 +359,11 @@ select_statement::do_execute(service::storage_proxy& proxy,
 
     command->slice.options.set<query::partition_slice::option::allow_short_read>();
     auto timeout_duration = options.get_timeout_config().*get_timeout_config_selector();
+    // Groups must not be split by rows of other sub-ranges of a parallel scan.
+    const bool allow_parallel_scan = _parameters->parallel_scan() && !has_group_by();
     auto p = service::pager::query_pagers::pager(_schema, _selection,
-            state, options, command, std::move(key_ranges), _stats, restrictions_need_filtering ? _restrictions : nullptr);
+            state, options, command, std::move(key_ranges), _stats, restrictions_need_filtering ? _restrictions : nullptr,
+            allow_parallel_scan);
 
     if (aggregate || nonpaged_filtering) {
         return do_with(
@@ -366,7 +394,7 @@ select_statement::do_execute(service::storage_proxy& proxy,
     }
 
     auto timeout = db::timeout_clock::now() + timeout_duration;
-    if (_selection->is_trivial() && !restrictions_need_filtering && !_per_partition_limit) {
+    if (_selection->is_trivial() && !restrictions_need_filtering) {
         return p->fetch_page_generator(page_size, now, timeout, _stats).then([this, p] (result_generator generator) {
             auto meta = [&] () -> shared_ptr<const cql3::metadata> {
                 if (!p->is_exhausted()) {
@@ -400,6 +428,55 @@ select_statement::do_execute(service::storage_proxy& proxy,
             });
 }
 
+std::optional<std::vector<query::aggregate_spec>>
+select_statement::get_replica_aggregates(service::storage_proxy& proxy, const query_options& options) const {
+    // The replicas see neither the rows of other replicas nor the options
+    // which are applied on the coordinator, so they can only compute
+    // aggregates over all the rows they select, each read from one replica.
+    // In particular they can't tell when the LIMIT is reached.
+    auto cl = options.get_consistency();
+    if ((cl != db::consistency_level::ONE && cl != db::consistency_level::LOCAL_ONE)
+            || _limit
+            || _restrictions->need_filtering()
+            || _parameters->is_distinct()
+            || _is_reversed
+            || _per_partition_limit
+            || needs_post_query_ordering()
+            || !proxy.get_db().local().get_config().enable_aggregate_pushdown()
+            || !service::get_local_storage_service().cluster_supports_aggregate_pushdown()) {
+        return std::nullopt;
+    }
+    auto aggregates = _selection->get_aggregate_specs();
+    if (aggregates && !boost::algorithm::all_of(*aggregates, [this] (const query::aggregate_spec& spec) {
+                return bool(query::find_aggregate_function(*_schema, spec));
+            })) {
+        return std::nullopt;
+    }
+    return aggregates;
+}
+
+future<shared_ptr<cql_transport::messages::result_message>>
+select_statement::execute_aggregates_on_replicas(service::storage_proxy& proxy,
+                                                 lw_shared_ptr<query::read_command> cmd,
+                                                 dht::partition_range_vector&& partition_ranges,
+                                                 std::vector<query::aggregate_spec> aggregates,
+                                                 service::query_state& state,
+                                                 const query_options& options)
+{
+    ++_stats.replica_aggregate_queries;
+    auto timeout_duration = options.get_timeout_config().*get_timeout_config_selector();
+    return proxy.query_aggregates(_schema, std::move(cmd), std::move(partition_ranges), aggregates, options.get_consistency(),
+            timeout_duration, state.get_trace_state()).then([this, aggregates, &options] (query::aggregate_result partial) {
+        query::aggregates merged(*_schema, aggregates);
+        merged.merge(partial);
+        auto rs = std::make_unique<result_set>(_selection->get_result_metadata());
+        rs->add_row(merged.compute(options.get_cql_serialization_format()));
+        update_stats_rows_read(rs->size());
+        auto msg = ::make_shared<cql_transport::messages::result_message::rows>(result(std::move(rs)));
+        return make_ready_future<shared_ptr<cql_transport::messages::result_message>>(std::move(msg));
+    });
+}
+
 template<typename KeyType>
 GCC6_CONCEPT(
     requires (std::is_same_v<KeyType, partition_key> || std::is_same_v<KeyType, clustering_key_prefix>)
@@ -529,6 +606,9 @@ indexed_table_select_statement::do_execute_base_query(
         query::result_merger merger;
         std::vector<primary_key> primary_keys;
         std::vector<primary_key>::iterator current_primary_key;
+        size_t keys_per_round = 1;
+        uint64_t result_bytes = 0;
+        uint64_t result_rows = 0;
         base_query_state(uint32_t row_limit, std::vector<primary_key>&& keys)
                 : merger(row_limit, query::max_partitions)
                 , primary_keys(std::move(keys))
@@ -540,36 +620,83 @@ indexed_table_select_statement::do_execute_base_query(
 
     base_query_state query_state{cmd->row_limit, std::move(primary_keys)};
     return do_with(std::move(query_state), [this, &proxy, &state, &options, cmd, timeout] (auto&& query_state) {
-        auto &merger = query_state.merger;
-        auto &keys = query_state.primary_keys;
-        auto &key_it = query_state.current_primary_key;
-        return repeat([this, &keys, &key_it, &merger, &proxy, &state, &options, cmd, timeout]() {
-            // Starting with 1 key, we check if the result was a short read, and if not,
-            // we continue exponentially, asking for 2x more key than before
-            auto key_it_end = std::min(key_it + std::distance(keys.begin(), key_it) + 1, keys.end());
-            auto command = ::make_lw_shared<query::read_command>(*cmd);
+        return repeat([this, &query_state, &proxy, &state, &options, cmd, timeout]() {
+            auto& keys = query_state.primary_keys;
+            auto& key_it = query_state.current_primary_key;
+            // The keys returned by the index are grouped by partition, so all
+            // the rows needed from a partition are read with a single query.
+            // Consecutive partitions needing no specific rows share the same
+            // slice, so they are read with one multi-partition query. Results
+            // are merged in the order of the keys.
+            std::vector<lw_shared_ptr<query::read_command>> commands;
+            std::vector<dht::partition_range_vector> command_ranges;
+            dht::partition_range_vector whole_partitions;
+            auto flush_whole_partitions = [&] {
+                if (!whole_partitions.empty()) {
+                    auto command = ::make_lw_shared<query::read_command>(*cmd);
+                    command->slice._row_ranges.clear();
+                    commands.push_back(std::move(command));
+                    command_ranges.push_back(std::exchange(whole_partitions, {}));
+                }
+            };
+            clustering_key_prefix::less_compare ck_less(*_schema);
+            clustering_key_prefix::equality ck_eq(*_schema);
+            auto round_end = key_it;
+            while (round_end != keys.end() && size_t(std::distance(key_it, round_end)) < query_state.keys_per_round) {
+                auto partition_end = std::find_if(round_end, keys.end(), [this, &round_end] (const primary_key& key) {
+                    return !key.partition.equal(*_schema, round_end->partition);
+                });
+                std::vector<clustering_key_prefix> cks;
+                for (auto it = round_end; it != partition_end; ++it) {
+                    if (it->clustering) {
+                        cks.push_back(it->clustering);
+                    }
+                }
+                if (cks.empty()) {
+                    whole_partitions.push_back(dht::partition_range::make_singular(round_end->partition));
+                } else {
+                    flush_whole_partitions();
+                    std::sort(cks.begin(), cks.end(), ck_less);
+                    cks.erase(std::unique(cks.begin(), cks.end(), ck_eq), cks.end());
+                    auto command = ::make_lw_shared<query::read_command>(*cmd);
+                    command->slice._row_ranges.clear();
+                    for (auto& ck : cks) {
+                        command->slice._row_ranges.push_back(query::clustering_range::make_singular(std::move(ck)));
+                    }
+                    commands.push_back(std::move(command));
+                    command_ranges.push_back({dht::partition_range::make_singular(round_end->partition)});
+                }
+                round_end = partition_end;
+            }
+            flush_whole_partitions();
 
             query::result_merger oneshot_merger(cmd->row_limit, query::max_partitions);
-            return map_reduce(key_it, key_it_end, [this, &proxy, &state, &options, cmd, timeout] (auto& key) {
-                auto command = ::make_lw_shared<query::read_command>(*cmd);
-                // for each partition, read just one clustering row (TODO: can
-                // get all needed rows of one partition at once.)
-                command->slice._row_ranges.clear();
-                if (key.clustering) {
-                    command->slice._row_ranges.push_back(query::clustering_range::make_singular(key.clustering));
-                }
-                return proxy.query(_schema, command, {dht::partition_range::make_singular(key.partition)}, options.get_consistency(), {timeout, state.get_permit(), state.get_client_state(), state.get_trace_state()})
+            auto command_indexes = boost::irange<size_t>(0, commands.size());
+            return map_reduce(command_indexes.begin(), command_indexes.end(), [this, &proxy, &state, &options, timeout,
+                    commands = std::move(commands), command_ranges = std::move(command_ranges)] (size_t i) mutable {
+                return proxy.query(_schema, commands[i], std::move(command_ranges[i]), options.get_consistency(), {timeout, state.get_permit(), state.get_client_state(), state.get_trace_state()})
                 .then([] (service::storage_proxy::coordinator_query_result qr) {
                     return std::move(qr.query_result);
                 });
-            }, std::move(oneshot_merger)).then([&key_it, key_it_end = std::move(key_it_end), &keys, &merger] (foreign_ptr<lw_shared_ptr<query::result>> result) {
+            }, std::move(oneshot_merger)).then([&query_state, round_end] (foreign_ptr<lw_shared_ptr<query::result>> result) {
                 bool is_short_read = result->is_short_read();
-                merger(std::move(result));
-                key_it = key_it_end;
-                return stop_iteration(is_short_read || key_it == keys.end());
+                query_state.result_bytes += result->buf().size();
+                query_state.result_rows += result->row_count().value_or(0);
+                query_state.merger(std::move(result));
+                query_state.current_primary_key = round_end;
+                // Starting with 1 key, we check if the result was a short read, and if not,
+                // we continue exponentially, asking for 2x more keys than before, as long as
+                // the rows of a round are expected to fit in the maximum result size.
+                auto keys_per_round = query_state.keys_per_round * 2;
+                if (query_state.result_rows) {
+                    auto bytes_per_row = std::max<uint64_t>(query_state.result_bytes / query_state.result_rows, 1);
+                    keys_per_round = std::min<uint64_t>(keys_per_round, query::result_memory_limiter::maximum_result_size / bytes_per_row);
+                }
+                query_state.keys_per_round = std::max<size_t>(keys_per_round, 1);
+                return stop_iteration(is_short_read || query_state.current_primary_key == query_state.primary_keys.end());
             });
-        }).then([&merger] () {
-            return merger.get();
+        }).then([&query_state] () {
+            return query_state.merger.get();
         }).then([cmd] (foreign_ptr<lw_shared_ptr<query::result>> result) mutable {
             return make_ready_future<foreign_ptr<lw_shared_ptr<query::result>>, lw_shared_ptr<query::read_command>>(std::move(result), std::move(cmd));
         });
@@ -153,6 +153,14 @@ protected :
         return do_get_limit(options, _per_partition_limit);
     }
     bool needs_post_query_ordering() const;
+    /**
+     * Returns the aggregates of this statement if the replicas can compute them,
+     * <code>std::nullopt</code> otherwise.
+     */
+    std::optional<std::vector<query::aggregate_spec>> get_replica_aggregates(service::storage_proxy& proxy, const query_options& options) const;
+    future<::shared_ptr<cql_transport::messages::result_message>> execute_aggregates_on_replicas(service::storage_proxy& proxy,
+        lw_shared_ptr<query::read_command> cmd, dht::partition_range_vector&& partition_ranges, std::vector<query::aggregate_spec> aggregates,
+        service::query_state& state, const query_options& options);
     virtual void update_stats_rows_read(int64_t rows_read) {
         _stats.rows_read += rows_read;
     }
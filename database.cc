@@ -62,6 +62,8 @@
 #include "service/storage_service.hh"
 #include "message/messaging_service.hh"
 #include "mutation_query.hh"
+#include "aggregate_query.hh"
+#include "repair/repair.hh"
 #include <seastar/core/fstream.hh>
 #include <seastar/core/enum.hh>
 #include "utils/latency.hh"
@@ -368,6 +370,15 @@ database::setup_metrics() {
        sm::make_derive("view_building_paused", _cf_stats.view_building_paused,
                       sm::description("Counts the number of times view building process was paused (e.g. due to node unavailability). ")),
 
+        sm::make_derive("coalesced_view_update_reads", _cf_stats.coalesced_view_update_reads,
+                       sm::description("Counts the number of writes whose read of the existing base rows, needed to generate view updates, was shared with other writes to the same partition.")),
+
+        sm::make_derive("skipped_view_update_reads", _cf_stats.skipped_view_update_reads,
+                       sm::description("Counts the number of reads of existing base rows, needed to generate view updates, which were skipped because the base partition was known not to exist.")),
+
+        sm::make_derive("skipped_filtered_partitions", _cf_stats.skipped_filtered_partitions,
+                       sm::description("Counts the number of partitions read by filtering queries which were skipped because the value ranges of their sstables can't satisfy the filter.")),
+
         sm::make_derive("total_writes", _stats->total_writes,
                        sm::description("Counts the total number of successful write operations performed by this shard.")),
 
@@ -1179,6 +1190,37 @@ database::query_mutations(schema_ptr s, const query::read_command& cmd, const dh
     });
 }
 
+future<query::aggregate_result>
+database::query_aggregates(schema_ptr s, const query::read_command& cmd, const dht::partition_range_vector& ranges,
+                           const std::vector<query::aggregate_spec>& aggregates, tracing::trace_state_ptr trace_state,
+                           db::timeout_clock::time_point timeout) {
+    column_family& cf = find_column_family(cmd.cf_id);
+    return query::aggregate_query(std::move(s), cf.as_mutation_source(), ranges, cmd.slice, aggregates, cmd.timestamp,
+            std::move(trace_state), timeout).then_wrapped([s = _stats, op = cf.read_in_progress()] (future<query::aggregate_result> f) {
+        if (f.failed()) {
+            ++s->total_reads_failed;
+        } else {
+            ++s->total_reads;
+        }
+        return f;
+    });
+}
+
+future<partition_row_hashes>
+database::query_row_hashes(schema_ptr s, const query::read_command& cmd, const dht::partition_range& range,
+                           tracing::trace_state_ptr trace_state, db::timeout_clock::time_point timeout) {
+    column_family& cf = find_column_family(cmd.cf_id);
+    return query_partition_row_hashes(std::move(s), cf.as_mutation_source(), range, cmd.slice, cmd.row_limit, cmd.timestamp,
+            std::move(trace_state), timeout).then_wrapped([s = _stats, op = cf.read_in_progress()] (future<partition_row_hashes> f) {
+        if (f.failed()) {
+            ++s->total_reads_failed;
+        } else {
+            ++s->total_reads;
+        }
+        return f;
+    });
+}
+
 std::unordered_set<sstring> database::get_initial_tokens() {
     std::unordered_set<sstring> tokens;
     sstring tokens_string = get_config().initial_token();
@@ -1922,7 +1964,7 @@ template <typename T>
 using foreign_unique_ptr = foreign_ptr<std::unique_ptr<T>>;
 
 flat_mutation_reader make_multishard_streaming_reader(distributed<database>& db, dht::i_partitioner& partitioner, schema_ptr schema,
-        std::function<std::optional<dht::partition_range>()> range_generator) {
+        std::function<std::optional<dht::partition_range>()> range_generator, read_unrepaired_only unrepaired_only) {
     class streaming_reader_lifecycle_policy
             : public reader_lifecycle_policy
             , public enable_shared_from_this<streaming_reader_lifecycle_policy> {
@@ -1932,9 +1974,11 @@ flat_mutation_reader make_multishard_streaming_reader(distributed<database>& db,
             reader_concurrency_semaphore* semaphore;
         };
         distributed<database>& _db;
+        read_unrepaired_only _unrepaired_only;
         std::vector<reader_context> _contexts;
     public:
-        explicit streaming_reader_lifecycle_policy(distributed<database>& db) : _db(db), _contexts(smp::count) {
+        streaming_reader_lifecycle_policy(distributed<database>& db, read_unrepaired_only unrepaired_only)
+                : _db(db), _unrepaired_only(unrepaired_only), _contexts(smp::count) {
         }
         virtual flat_mutation_reader create_reader(
                 schema_ptr schema,
@@ -1950,7 +1994,7 @@ flat_mutation_reader make_multishard_streaming_reader(distributed<database>& db,
             _contexts[shard].read_operation = make_foreign(std::make_unique<utils::phased_barrier::operation>(cf.read_in_progress()));
             _contexts[shard].semaphore = &cf.streaming_read_concurrency_semaphore();
 
-            return cf.make_streaming_reader(std::move(schema), *_contexts[shard].range, slice, fwd_mr);
+            return cf.make_streaming_reader(std::move(schema), *_contexts[shard].range, slice, fwd_mr, _unrepaired_only);
         }
         virtual void destroy_reader(shard_id shard, future<stopped_reader> reader_fut) noexcept override {
             // Move to the background.
@@ -1966,14 +2010,14 @@ flat_mutation_reader make_multishard_streaming_reader(distributed<database>& db,
             return *_contexts[engine().cpu_id()].semaphore;
         }
     };
-    auto ms = mutation_source([&db, &partitioner] (schema_ptr s,
+    auto ms = mutation_source([&db, &partitioner, unrepaired_only] (schema_ptr s,
             const dht::partition_range& pr,
             const query::partition_slice& ps,
             const io_priority_class& pc,
             tracing::trace_state_ptr trace_state,
             streamed_mutation::forwarding,
             mutation_reader::forwarding fwd_mr) {
-        return make_multishard_combining_reader(make_shared<streaming_reader_lifecycle_policy>(db), partitioner, std::move(s), pr, ps, pc,
+        return make_multishard_combining_reader(make_shared<streaming_reader_lifecycle_policy>(db, unrepaired_only), partitioner, std::move(s), pr, ps, pc,
                 std::move(trace_state), fwd_mr);
     });
     return make_flat_multi_range_reader(std::move(schema), std::move(ms), std::move(range_generator), schema->full_slice(),
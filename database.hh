@@ -92,6 +92,7 @@
 #include <unordered_set>
 #include "disk-error-handler.hh"
 #include "utils/updateable_value.hh"
+#include <seastar/util/bool_class.hh>
 
 class cell_locker;
 class cell_locker_stats;
@@ -99,11 +100,16 @@ class locked_cell;
 
 class frozen_mutation;
 class reconcilable_result;
+struct partition_row_hashes;
 
 namespace service {
 class storage_proxy;
 }
 
+namespace query {
+class row_filter;
+}
+
 namespace netw {
 class messaging_service;
 }
@@ -303,6 +309,18 @@ struct cf_stats {
     // How many times view building was paused (e.g. due to node unavailability)
     int64_t view_building_paused = 0;
 
+    // How many writes had their view read-before-write coalesced with that of
+    // an earlier write to the same partition.
+    int64_t coalesced_view_update_reads = 0;
+
+    // How many view read-before-writes were skipped because the base
+    // partition was known not to exist.
+    int64_t skipped_view_update_reads = 0;
+
+    // How many partitions read by filtering queries were skipped because
+    // the value ranges of their sstables can't satisfy the filter.
+    int64_t skipped_filtered_partitions = 0;
+
     // How many view updates were processed for all tables
     uint64_t total_view_updates_pushed_local = 0;
     uint64_t total_view_updates_pushed_remote = 0;
@@ -313,6 +331,10 @@ struct cf_stats {
 class table;
 using column_family = table;
 
+// Whether a streaming reader skips the sstables marked as repaired, for
+// incremental repair.
+using read_unrepaired_only = bool_class<class read_unrepaired_only_tag>;
+
 class database_sstable_write_monitor;
 
 class table : public enable_lw_shared_from_this<table> {
@@ -363,6 +385,7 @@ class table : public enable_lw_shared_from_this<table> {
         utils::timed_rate_moving_average_and_histogram tombstone_scanned;
         utils::timed_rate_moving_average_and_histogram live_scanned;
         utils::estimated_histogram estimated_coordinator_read;
+        utils::estimated_histogram estimated_coordinator_range_read;
     };
 
     struct snapshot_details {
@@ -501,9 +524,14 @@ class table : public enable_lw_shared_from_this<table> {
     // have to get.  It will be closed by stop().
     seastar::gate _async_gate;
 
-    double _cached_percentile = -1;
-    lowres_clock::time_point _percentile_cache_timestamp;
-    std::chrono::milliseconds _percentile_cache_value;
+    struct latency_percentile_cache {
+        double percentile = -1;
+        lowres_clock::time_point timestamp;
+        std::chrono::milliseconds value;
+    };
+    latency_percentile_cache _read_percentile_cache;
+    latency_percentile_cache _range_read_percentile_cache;
+    static std::chrono::milliseconds get_latency_percentile(utils::estimated_histogram& histogram, latency_percentile_cache& cache, double percentile);
 
     // Phaser used to synchronize with in-progress writes. This is useful for code that,
     // after some modification, needs to ensure that news writes will see it before
@@ -658,8 +686,8 @@ class table : public enable_lw_shared_from_this<table> {
             tracing::trace_state_ptr trace_state = nullptr,
             streamed_mutation::forwarding fwd = streamed_mutation::forwarding::no,
             mutation_reader::forwarding fwd_mr = mutation_reader::forwarding::yes) const;
-    flat_mutation_reader make_reader_excluding_sstable(schema_ptr schema,
-            sstables::shared_sstable sst,
+    flat_mutation_reader make_reader_excluding_sstables(schema_ptr schema,
+            const std::vector<sstables::shared_sstable>& excluded_sstables,
             const dht::partition_range& range,
             const query::partition_slice& slice,
             const io_priority_class& pc = default_priority_class(),
@@ -680,22 +708,30 @@ class table : public enable_lw_shared_from_this<table> {
     flat_mutation_reader make_streaming_reader(schema_ptr schema,
             const dht::partition_range_vector& ranges) const;
 
+    // Doesn't read the excluded sstables, which are streamed by other means.
+    flat_mutation_reader make_streaming_reader(schema_ptr schema,
+            const dht::partition_range_vector& ranges,
+            std::unordered_set<sstables::shared_sstable> excluded_sstables) const;
+
     // Single range overload.
     flat_mutation_reader make_streaming_reader(schema_ptr schema, const dht::partition_range& range,
             const query::partition_slice& slice,
-            mutation_reader::forwarding fwd_mr = mutation_reader::forwarding::no) const;
+            mutation_reader::forwarding fwd_mr = mutation_reader::forwarding::no,
+            read_unrepaired_only unrepaired_only = read_unrepaired_only::no) const;
 
-    flat_mutation_reader make_streaming_reader(schema_ptr schema, const dht::partition_range& range) {
-        return make_streaming_reader(schema, range, schema->full_slice());
+    flat_mutation_reader make_streaming_reader(schema_ptr schema, const dht::partition_range& range,
+            read_unrepaired_only unrepaired_only = read_unrepaired_only::no) {
+        return make_streaming_reader(schema, range, schema->full_slice(), mutation_reader::forwarding::no, unrepaired_only);
     }
 
-    sstables::shared_sstable make_streaming_sstable_for_write(std::optional<sstring> subdir = {});
-    sstables::shared_sstable make_streaming_staging_sstable() {
-        return make_streaming_sstable_for_write("staging");
+    sstables::shared_sstable make_streaming_sstable_for_write(std::optional<sstring> subdir = {},
+            std::optional<sstables::sstable_version_types> version = {});
+    sstables::shared_sstable make_streaming_staging_sstable(std::optional<sstables::sstable_version_types> version = {}) {
+        return make_streaming_sstable_for_write("staging", version);
     }
 
     mutation_source as_mutation_source() const;
-    mutation_source as_mutation_source_excluding(sstables::shared_sstable sst) const;
+    mutation_source as_mutation_source_excluding(std::vector<sstables::shared_sstable> excluded_sstables) const;
 
     void set_virtual_reader(mutation_source virtual_reader) {
         _virtual_reader = std::move(virtual_reader);
@@ -880,6 +916,12 @@ class table : public enable_lw_shared_from_this<table> {
 
     future<> run_with_compaction_disabled(std::function<future<> ()> func);
 
+    // Marks the sstables with the given generations which are still part of
+    // the table and not repaired yet as repaired at `repaired_at`, which is in
+    // milliseconds since the epoch. Used by incremental repair. They are
+    // moved to level 0, as their level was computed among unrepaired sstables.
+    future<> mark_sstables_repaired(std::unordered_set<int64_t> generations, uint64_t repaired_at);
+
     utils::phased_barrier::operation write_in_progress() {
         return _pending_writes_phaser.start();
     }
@@ -910,9 +952,12 @@ class table : public enable_lw_shared_from_this<table> {
     const std::vector<view_ptr>& views() const;
     future<row_locker::lock_holder> push_view_replica_updates(const schema_ptr& s, const frozen_mutation& fm, db::timeout_clock::time_point timeout) const;
     future<row_locker::lock_holder> push_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout) const;
-    future<row_locker::lock_holder> stream_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout, sstables::shared_sstable excluded_sstable) const;
+    future<row_locker::lock_holder> stream_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout, std::vector<sstables::shared_sstable> excluded_sstables) const;
     void add_coordinator_read_latency(utils::estimated_histogram::duration latency);
     std::chrono::milliseconds get_coordinator_read_latency_percentile(double percentile);
+    // Latency of the sub-range reads token range scans are split into.
+    void add_coordinator_range_read_latency(utils::estimated_histogram::duration latency);
+    std::chrono::milliseconds get_coordinator_range_read_latency_percentile(double percentile);
 
     secondary_index::secondary_index_manager& get_index_manager() {
         return _index_manager;
@@ -937,7 +982,15 @@ class table : public enable_lw_shared_from_this<table> {
     }
 
 private:
-    future<row_locker::lock_holder> do_push_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout, mutation_source&& source, const io_priority_class& io_priority) const;
+    future<row_locker::lock_holder> do_push_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout, mutation_source&& source,
+            const io_priority_class& io_priority, bool coalesce_reads) const;
+    future<row_locker::lock_holder> read_and_push_view_replica_updates(const schema_ptr& base, std::vector<view_ptr>&& views, mutation&& m,
+            query::clustering_row_ranges&& cr_ranges, db::timeout_clock::time_point timeout, mutation_source&& source, const io_priority_class& io_priority) const;
+    bool partition_may_exist(const schema& s, const dht::decorated_key& key,
+            const std::function<bool(const sstables::sstable&)>& sstable_may_match = {}) const;
+    mutation_source as_mutation_source_skipping(lw_shared_ptr<const query::row_filter> filter) const;
+    future<row_locker::lock_holder> coalesce_and_push_view_replica_updates(const schema_ptr& base, std::vector<view_ptr>&& views, mutation&& m,
+            query::clustering_row_ranges&& cr_ranges, db::timeout_clock::time_point timeout) const;
     std::vector<view_ptr> affected_views(const schema_ptr& base, const mutation& update) const;
     future<> generate_and_propagate_view_updates(const schema_ptr& base,
             std::vector<view_ptr>&& views,
@@ -945,6 +998,31 @@ class table : public enable_lw_shared_from_this<table> {
             flat_mutation_reader_opt existings) const;
 
     mutable row_locker _row_locker;
+
+    // Writes to the same partition which need to read existing rows in order
+    // to generate view updates, and which arrive close together, are
+    // coalesced: the rows are read, and the view updates generated, once for
+    // the whole group. See coalesce_and_push_view_replica_updates().
+    struct view_update_read_batch {
+        struct write {
+            mutation update;
+            query::clustering_row_ranges ranges;
+            db::timeout_clock::time_point timeout;
+            // Resolved with the lock on the rows of the write, once its view
+            // updates are generated. The writes of a group share the lock
+            // until they are all applied.
+            promise<row_locker::lock_holder> lock;
+        };
+        std::vector<view_ptr> views;
+        std::vector<write> writes;
+
+        explicit view_update_read_batch(std::vector<view_ptr> views)
+            : views(std::move(views)) {
+        }
+    };
+    // Batches still accepting writes, by token.
+    mutable std::unordered_multimap<dht::token, lw_shared_ptr<view_update_read_batch>> _view_update_read_batches;
+
     future<row_locker::lock_holder> local_base_lock(
             const schema_ptr& s,
             const dht::decorated_key& pk,
@@ -1404,6 +1482,13 @@ class database {
     future<reconcilable_result, cache_temperature> query_mutations(schema_ptr, const query::read_command& cmd, const dht::partition_range& range,
                                                 query::result_memory_accounter&& accounter, tracing::trace_state_ptr trace_state,
                                                 db::timeout_clock::time_point timeout = db::no_timeout);
+    // Partial states of the aggregates over the rows this shard owns in ranges.
+    future<query::aggregate_result> query_aggregates(schema_ptr, const query::read_command& cmd, const dht::partition_range_vector& ranges,
+                                                const std::vector<query::aggregate_spec>& aggregates, tracing::trace_state_ptr trace_state,
+                                                db::timeout_clock::time_point timeout = db::no_timeout);
+    // Hashes of the rows of the single partition in range, see query_partition_row_hashes().
+    future<partition_row_hashes> query_row_hashes(schema_ptr, const query::read_command& cmd, const dht::partition_range& range,
+                                                tracing::trace_state_ptr trace_state, db::timeout_clock::time_point timeout = db::no_timeout);
     // Apply the mutation atomically.
     // Throws timed_out_error when timeout is reached.
     future<> apply(schema_ptr, const frozen_mutation&, db::timeout_clock::time_point timeout = db::no_timeout);
@@ -1531,7 +1616,8 @@ future<> stop_database(sharded<database>& db);
 // Shard readers are created via `table::make_streaming_reader()`.
 // Range generator must generate disjoint, monotonically increasing ranges.
 flat_mutation_reader make_multishard_streaming_reader(distributed<database>& db, dht::i_partitioner& partitioner, schema_ptr schema,
-        std::function<std::optional<dht::partition_range>()> range_generator);
+        std::function<std::optional<dht::partition_range>()> range_generator,
+        read_unrepaired_only unrepaired_only = read_unrepaired_only::no);
 
 future<utils::UUID> update_schema_version(distributed<service::storage_proxy>& proxy, db::schema_features);
 future<> announce_schema_version(utils::UUID schema_version);
@@ -493,6 +493,10 @@ db::config::config(std::shared_ptr<db::extensions> exts)
         "\tnone : No compression.")
     , inter_dc_tcp_nodelay(this, "inter_dc_tcp_nodelay", value_status::Used, false,
         "Enable or disable tcp_nodelay for inter-data center communication. When disabled larger, but fewer, network packets are sent. This reduces overhead from the TCP protocol itself. However, if cross data-center responses are blocked, it will increase latency.")
+    , internode_shard_aware_connections(this, "internode_shard_aware_connections", value_status::Used, false,
+        "When enabled, each shard connects to the shard of the remote node which owns the data a request is for, so that the request is served without an extra hop between shards on the replica. Results in up to one connection per pair of shards.")
+    , internode_streaming_connections(this, "internode_streaming_connections", value_status::Used, 1,
+        "Number of connections each shard opens to another node for streaming and repair traffic.")
     , streaming_socket_timeout_in_ms(this, "streaming_socket_timeout_in_ms", value_status::Unused, 0,
         "Enable or disable socket timeout for streaming operations. When a timeout occurs during streaming, streaming is retried from the start of the current file. Avoid setting this value too low, as it can result in a significant amount of data re-streaming.")
     /* Native transport (CQL Binary Protocol) */
@@ -506,6 +510,12 @@ db::config::config(std::shared_ptr<db::extensions> exts)
         "for native_transport_port. Setting native_transport_port_ssl to a different value"
         "from native_transport_port will use encryption for native_transport_port_ssl while"
         "keeping native_transport_port unencrypted")
+    , native_shard_aware_transport_port(this, "native_shard_aware_transport_port", value_status::Used, 19042,
+        "Like native_transport_port, but clients are forwarded to specific shards, based on the client-side port numbers. "
+        "Set to 0 to disable.")
+    , native_shard_aware_transport_port_ssl(this, "native_shard_aware_transport_port_ssl", value_status::Used, 19142,
+        "Like native_transport_port_ssl, but clients are forwarded to specific shards, based on the client-side port numbers. "
+        "Used only if native_transport_port_ssl is used. Set to 0 to disable.")
     , native_transport_max_threads(this, "native_transport_max_threads", value_status::Invalid, 128,
         "The maximum number of thread handling requests. The meaning is the same as rpc_max_threads.\n"
         "Default is different (128 versus unlimited).\n"
@@ -513,6 +523,8 @@ db::config::config(std::shared_ptr<db::extensions> exts)
         "Idle threads are stopped after 30 seconds.\n")
     , native_transport_max_frame_size_in_mb(this, "native_transport_max_frame_size_in_mb", value_status::Unused, 256,
         "The maximum size of allowed frame. Frame (requests) larger than this are rejected as invalid.")
+    , native_transport_compression_threshold(this, "native_transport_compression_threshold", value_status::Used, 512,
+        "Responses smaller than this many bytes are sent uncompressed, even if the client asked for compression. Compressing small frames costs more CPU than it saves on the wire.")
     /* RPC (remote procedure call) settings */
     /* Settings for configuring and tuning client connections. */
     , broadcast_rpc_address(this, "broadcast_rpc_address", value_status::Used, {/* unset */},
@@ -540,6 +552,14 @@ db::config::config(std::shared_ptr<db::extensions> exts)
         "\tYour own RPC server: You must provide a fully-qualified class name of an o.a.c.t.TServerFactory that can create a server instance.")
     , cache_hit_rate_read_balancing(this, "cache_hit_rate_read_balancing", value_status::Used, true,
         "This boolean controls whether the replicas for read query will be choosen based on cache hit ratio")
+    , adaptive_replica_selection(this, "adaptive_replica_selection", value_status::Used, false,
+        "When enabled, the replicas for a read query are ranked by the response latency, the number of in-flight requests and the queue length observed for each of them, so that reads are steered away from temporarily slow replicas. Replicas outside the local datacenter keep their snitch order. Overrides cache_hit_rate_read_balancing.")
+    , enable_aggregate_pushdown(this, "enable_aggregate_pushdown", value_status::Used, true,
+        "When enabled, COUNT, SUM, MIN, MAX and AVG over a table read at consistency level ONE or LOCAL_ONE are computed by the replicas, on all their shards in parallel, and the coordinator only merges their partial results instead of fetching every row.")
+    , parallel_scan_concurrency(this, "parallel_scan_concurrency", value_status::Used, 4,
+        "The number of sub-ranges of the token ring which a paged scan with the PARALLEL SCAN clause reads concurrently. 0 disables parallel scans, and such scans then read the ring in order.")
+    , parallel_scan_memory_budget_in_mb(this, "parallel_scan_memory_budget_in_mb", value_status::Used, 64,
+        "The memory a single parallel scan may use for the results of its concurrent reads. Limits parallel_scan_concurrency to this budget divided by the maximum size of a read result.")
     /* Advanced fault detection settings */
     /* Settings to handle poorly performing or failing nodes. */
     , dynamic_snitch_badness_threshold(this, "dynamic_snitch_badness_threshold", value_status::Unused, 0,
@@ -688,6 +708,7 @@ db::config::config(std::shared_ptr<db::extensions> exts)
         " Performance is affected to some extent as a result. Useful to help debugging problems that may arise at another layers.")
     , cpu_scheduler(this, "cpu_scheduler", value_status::Used, true, "Enable cpu scheduling")
     , view_building(this, "view_building", value_status::Used, true, "Enable view building; should only be set to false when the node is experience issues due to view building")
+    , view_building_concurrency(this, "view_building_concurrency", value_status::Used, 4, "The number of batches of view updates each shard may be sending to the view replicas at once while building views. With 1, each batch is propagated before reading the next one.")
     , enable_sstables_mc_format(this, "enable_sstables_mc_format", value_status::Used, true, "Enable SSTables 'mc' format to be used as the default file format")
     , enable_dangerous_direct_import_of_cassandra_counters(this, "enable_dangerous_direct_import_of_cassandra_counters", value_status::Used, false, "Only turn this option on if you want to import tables from Cassandra containing counters, and you are SURE that no counters in that table were created in a version earlier than Cassandra 2.1."
         " It is not enough to have ever since upgraded to newer versions of Cassandra. If you EVER used a version earlier than 2.1 in the cluster where these SSTables come from, DO NOT TURN ON THIS OPTION! You will corrupt your data. You have been warned.")
@@ -199,12 +199,17 @@ class config : public utils::config_file {
     named_value<uint32_t> internode_recv_buff_size_in_bytes;
     named_value<sstring> internode_compression;
     named_value<bool> inter_dc_tcp_nodelay;
+    named_value<bool> internode_shard_aware_connections;
+    named_value<uint32_t> internode_streaming_connections;
     named_value<uint32_t> streaming_socket_timeout_in_ms;
     named_value<bool> start_native_transport;
     named_value<uint16_t> native_transport_port;
     named_value<uint16_t> native_transport_port_ssl;
+    named_value<uint16_t> native_shard_aware_transport_port;
+    named_value<uint16_t> native_shard_aware_transport_port_ssl;
     named_value<uint32_t> native_transport_max_threads;
     named_value<uint32_t> native_transport_max_frame_size_in_mb;
+    named_value<uint32_t> native_transport_compression_threshold;
     named_value<sstring> broadcast_rpc_address;
     named_value<uint16_t> rpc_port;
     named_value<bool> start_rpc;
@@ -215,6 +220,10 @@ class config : public utils::config_file {
     named_value<uint32_t> rpc_send_buff_size_in_bytes;
     named_value<sstring> rpc_server_type;
     named_value<bool> cache_hit_rate_read_balancing;
+    named_value<bool> adaptive_replica_selection;
+    named_value<bool> enable_aggregate_pushdown;
+    named_value<uint32_t> parallel_scan_concurrency;
+    named_value<uint32_t> parallel_scan_memory_budget_in_mb;
     named_value<double> dynamic_snitch_badness_threshold;
     named_value<uint32_t> dynamic_snitch_reset_interval_in_ms;
     named_value<uint32_t> dynamic_snitch_update_interval_in_ms;
@@ -278,6 +287,7 @@ class config : public utils::config_file {
     named_value<bool> enable_sstable_key_validation;
     named_value<bool> cpu_scheduler;
     named_value<bool> view_building;
+    named_value<uint32_t> view_building_concurrency;
     named_value<bool> enable_sstables_mc_format;
     named_value<bool> enable_dangerous_direct_import_of_cassandra_counters;
     named_value<bool> enable_shard_aware_drivers;
@@ -22,6 +22,9 @@
 #include "row_locking.hh"
 #include "log.hh"
 
+#include <seastar/core/do_with.hh>
+#include <seastar/core/future-util.hh>
+
 static logging::logger mylog("row_locking");
 
 row_locker::row_locker(schema_ptr s)
@@ -54,14 +57,33 @@ row_locker::lock_holder::lock_holder(row_locker* locker, const dht::decorated_ke
     , _row_exclusive(true) {
 }
 
-row_locker::lock_holder::lock_holder(row_locker* locker, const dht::decorated_key* pk, const clustering_key_prefix* cpk, bool exclusive)
+row_locker::lock_holder::lock_holder(row_locker* locker, const dht::decorated_key* pk, const clustering_key_prefix* cpk, bool exclusive, bool holds_partition)
     : _locker(locker)
     , _partition(pk)
     , _partition_exclusive(false)
+    , _holds_partition(holds_partition)
     , _row(cpk)
     , _row_exclusive(exclusive) {
 }
 
+row_locker::lock_holder::lock_holder(std::shared_ptr<lock_holder> shared) noexcept
+    : _locker(nullptr)
+    , _partition(nullptr)
+    , _partition_exclusive(true)
+    , _row(nullptr)
+    , _row_exclusive(true)
+    , _shared(std::move(shared)) {
+}
+
+row_locker::lock_holder::lock_holder(std::vector<lock_holder> holders) noexcept
+    : _locker(nullptr)
+    , _partition(nullptr)
+    , _partition_exclusive(true)
+    , _row(nullptr)
+    , _row_exclusive(true)
+    , _holders(std::move(holders)) {
+}
+
 future<row_locker::lock_holder>
 row_locker::lock_pk(const dht::decorated_key& pk, bool exclusive, db::timeout_clock::time_point timeout, stats& stats) {
     mylog.debug("taking {} lock on entire partition {}", (exclusive ? "exclusive" : "shared"), pk);
@@ -133,12 +155,74 @@ row_locker::lock_ck(const dht::decorated_key& pk, const clustering_key_prefix& c
     });
 }
 
+future<row_locker::lock_holder>
+row_locker::lock_cks(const dht::decorated_key& pk, std::vector<clustering_key_prefix> ckps, bool exclusive, db::timeout_clock::time_point timeout, stats& stats) {
+    std::sort(ckps.begin(), ckps.end(), clustering_key_prefix::less_compare(*_schema));
+    ckps.erase(std::unique(ckps.begin(), ckps.end(), clustering_key_prefix::equality(*_schema)), ckps.end());
+    // The shared partition lock is taken only once. Taking it again for each
+    // row, as lock_ck() does, could deadlock: the rwlock is FIFO, so a
+    // request for an exclusive partition lock queued meanwhile would wait
+    // for the shared lock we hold, while our next shared lock waits for it.
+    auto f = lock_pk(pk, false, timeout, stats);
+    // The partition's entry stays in the hash table while its lock is held
+    // or waited for, so the reference to it remains valid.
+    auto& entry = *_two_level_locks.find(pk);
+    return do_with(std::move(ckps), std::vector<lock_holder>(), [this, f = std::move(f), &entry, exclusive, timeout, &stats] (auto& ckps, auto& holders) mutable {
+        holders.reserve(ckps.size() + 1);
+        return f.then([this, &entry, exclusive, timeout, &stats, &ckps, &holders] (lock_holder partition_holder) {
+            return do_for_each(ckps, [this, &entry, exclusive, timeout, &stats, &holders] (const clustering_key_prefix& ckp) {
+                return lock_row(entry, ckp, exclusive, timeout, stats).then([&holders] (lock_holder holder) {
+                    holders.push_back(std::move(holder));
+                });
+            }).then_wrapped([&holders, partition_holder = std::move(partition_holder)] (future<> f) mutable {
+                // The row locks must be released before the partition lock.
+                if (f.failed()) {
+                    holders.clear();
+                    return make_exception_future<lock_holder>(f.get_exception());
+                }
+                holders.push_back(std::move(partition_holder));
+                return make_ready_future<lock_holder>(lock_holder(std::move(holders)));
+            });
+        });
+    });
+}
+
+future<row_locker::lock_holder>
+row_locker::lock_row(two_level_locks_type::value_type& entry, const clustering_key_prefix& cpk, bool exclusive, db::timeout_clock::time_point timeout, stats& stats) {
+    mylog.debug("taking {} lock on row {} in partition {}, whose shared lock is held", (exclusive ? "exclusive" : "shared"), cpk, entry.first);
+    auto j = entry.second._row_locks.find(cpk);
+    if (j == entry.second._row_locks.end()) {
+        j = entry.second._row_locks.emplace(cpk, lock_type()).first;
+    }
+    single_lock_stats &single_lock_stats = exclusive ? stats.exclusive_row : stats.shared_row;
+    single_lock_stats.operations_currently_waiting_for_lock++;
+    utils::latency_counter waiting_latency;
+    waiting_latency.start();
+    auto f = exclusive ? j->second.write_lock(timeout) : j->second.read_lock(timeout);
+    return f.then_wrapped([this, &entry, j, exclusive, &single_lock_stats, waiting_latency = std::move(waiting_latency)] (future<> f) mutable {
+        single_lock_stats.operations_currently_waiting_for_lock--;
+        if (f.failed()) {
+            if (!j->second.locked()) {
+                entry.second._row_locks.erase(j);
+            }
+            return make_exception_future<lock_holder>(f.get_exception());
+        }
+        waiting_latency.stop();
+        single_lock_stats.estimated_waiting_for_lock.add(waiting_latency.latency(), single_lock_stats.operations_currently_waiting_for_lock);
+        single_lock_stats.lock_acquisitions++;
+        return make_ready_future<lock_holder>(lock_holder(this, &entry.first, &j->first, exclusive, false));
+    });
+}
+
 row_locker::lock_holder::lock_holder(row_locker::lock_holder&& old) noexcept
         : _locker(old._locker)
         , _partition(old._partition)
         , _partition_exclusive(old._partition_exclusive)
+        , _holds_partition(old._holds_partition)
         , _row(old._row)
         , _row_exclusive(old._row_exclusive)
+        , _shared(std::move(old._shared))
+        , _holders(std::move(old._holders))
 {
     // We also need to zero old's _partition and _row, so when destructed
     // the destructor will do nothing and further moves will not create
@@ -149,10 +233,16 @@ row_locker::lock_holder::lock_holder(row_locker::lock_holder&& old) noexcept
 
 row_locker::lock_holder& row_locker::lock_holder::operator=(row_locker::lock_holder&& old) noexcept {
     if (this != &old) {
-        this->~lock_holder();
+        if (_locker) {
+            _locker->unlock(_partition,  _partition_exclusive, _holds_partition, _row, _row_exclusive);
+        }
+        release_holders();
+        _shared = std::move(old._shared);
+        _holders = std::move(old._holders);
         _locker = old._locker;
         _partition = old._partition;
         _partition_exclusive = old._partition_exclusive;
+        _holds_partition = old._holds_partition;
         _row = old._row;
         _row_exclusive = old._row_exclusive;
         // As above, need to also zero other's data
@@ -163,7 +253,7 @@ row_locker::lock_holder& row_locker::lock_holder::operator=(row_locker::lock_hol
 }
 
 void
-row_locker::unlock(const dht::decorated_key* pk, bool partition_exclusive,
+row_locker::unlock(const dht::decorated_key* pk, bool partition_exclusive, bool holds_partition,
                     const clustering_key_prefix* cpk, bool row_exclusive) {
     // Look for the partition and/or row locks given keys, release the locks,
     // and if nobody is using one of lock objects any more, delete it:
@@ -194,6 +284,10 @@ row_locker::unlock(const dht::decorated_key* pk, bool partition_exclusive,
                 pli->second._row_locks.erase(rli);
             }
         }
+        if (!holds_partition) {
+            // The partition lock is held, and released, by another holder.
+            return;
+        }
         mylog.debug("releasing {} lock for entire partition {}", (partition_exclusive ? "exclusive" : "shared"), *pk);
         auto& lock = pli->second._partition_lock;
         if (partition_exclusive) {
@@ -209,7 +303,17 @@ row_locker::unlock(const dht::decorated_key* pk, bool partition_exclusive,
 }
 
 row_locker::lock_holder::~lock_holder() {
+    release_holders();
     if (_locker) {
-        _locker->unlock(_partition,  _partition_exclusive, _row, _row_exclusive);
+        _locker->unlock(_partition,  _partition_exclusive, _holds_partition, _row, _row_exclusive);
+    }
+}
+
+void row_locker::lock_holder::release_holders() noexcept {
+    // Release the locks in the order they were taken, so that the partition
+    // lock taken by lock_cks() is released after its row locks.
+    for (auto& holder : _holders) {
+        holder = lock_holder();
     }
+    _holders.clear();
 }
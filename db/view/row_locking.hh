@@ -34,6 +34,7 @@
 
 #include <unordered_map>
 #include <memory>
+#include <vector>
 
 #include <seastar/core/rwlock.hh>
 #include <seastar/core/future.hh>
@@ -71,12 +72,27 @@ class row_locker {
         // this partition or row are released).
         const dht::decorated_key* _partition;
         bool _partition_exclusive;
+        // False when the shared partition lock is held by another holder,
+        // see lock_cks().
+        bool _holds_partition = true;
         const clustering_key_prefix* _row;
         bool _row_exclusive;
+        // Set when this holder shares a lock taken by another holder, see below.
+        std::shared_ptr<lock_holder> _shared;
+        // Locks held together, see lock_cks(). The partition lock comes last.
+        std::vector<lock_holder> _holders;
+        void release_holders() noexcept;
     public:
         lock_holder();
         lock_holder(row_locker* locker, const dht::decorated_key* pk, bool exclusive);
-        lock_holder(row_locker* locker, const dht::decorated_key* pk, const clustering_key_prefix* cpk, bool exclusive);
+        lock_holder(row_locker* locker, const dht::decorated_key* pk, const clustering_key_prefix* cpk, bool exclusive, bool holds_partition = true);
+        // Several operations may need to hold the same lock until each of
+        // them is done, e.g. writes whose view updates were generated
+        // together. Each of them gets a holder sharing the lock, which is
+        // released when the last of them is destroyed.
+        explicit lock_holder(std::shared_ptr<lock_holder> shared) noexcept;
+        // Holds the locks of several rows, taken by lock_cks(), together.
+        explicit lock_holder(std::vector<lock_holder> holders) noexcept;
         ~lock_holder();
         // Allow move (noexcept) but disallow copy
         lock_holder(lock_holder&&) noexcept;
@@ -112,8 +128,11 @@ class row_locker {
             return k1.equal(*locker->_schema, k2);
         }
     };
-    std::unordered_map<dht::decorated_key, two_level_lock, decorated_key_hash, decorated_key_equals_comparator> _two_level_locks;
-    void unlock(const dht::decorated_key* pk, bool partition_exclusive, const clustering_key_prefix* cpk, bool row_exclusive);
+    using two_level_locks_type = std::unordered_map<dht::decorated_key, two_level_lock, decorated_key_hash, decorated_key_equals_comparator>;
+    two_level_locks_type _two_level_locks;
+    void unlock(const dht::decorated_key* pk, bool partition_exclusive, bool holds_partition, const clustering_key_prefix* cpk, bool row_exclusive);
+    // Locks a row of a partition whose shared lock is already held.
+    future<lock_holder> lock_row(two_level_locks_type::value_type& entry, const clustering_key_prefix& cpk, bool exclusive, db::timeout_clock::time_point timeout, stats& stats);
 public:
     // row_locker needs to know the column_family's schema because key
     // comparisons needs the schema.
@@ -139,5 +158,15 @@ class row_locker {
     // schema, call upgrade() before taking the lock.
     future<lock_holder> lock_ck(const dht::decorated_key& pk, const clustering_key_prefix& ckp, bool exclusive, db::timeout_clock::time_point timeout, stats& stats);
 
+    // Lock several clustering rows of a partition, like lock_ck() does for
+    // each of them, but taking the shared partition lock only once. The rows
+    // are locked one at a time, in clustering order, so that two callers
+    // locking overlapping sets of rows can't deadlock.
+    future<lock_holder> lock_cks(const dht::decorated_key& pk, std::vector<clustering_key_prefix> ckps, bool exclusive, db::timeout_clock::time_point timeout, stats& stats);
+
+    // Whether a lock on the partition, or on a row in it, is held or being
+    // waited for.
+    bool is_locked(const dht::decorated_key& pk) const { return _two_level_locks.count(pk); }
+
     bool empty() const { return _two_level_locks.empty(); }
 };
@@ -1133,7 +1133,9 @@ future<> mutate_MV(
 view_builder::view_builder(database& db, db::system_distributed_keyspace& sys_dist_ks, service::migration_manager& mm)
         : _db(db)
         , _sys_dist_ks(sys_dist_ks)
-        , _mm(mm) {
+        , _mm(mm)
+        , _view_updates_concurrency(std::max(db.get_config().view_building_concurrency(), 1u))
+        , _view_updates_sem(_view_updates_concurrency) {
 }
 
 future<> view_builder::start() {
@@ -1510,7 +1512,9 @@ void view_builder::on_drop_view(const sstring& ks_name, const sstring& view_name
 }
 
 future<> view_builder::do_build_step() {
-    return seastar::async([this] {
+    seastar::thread_attributes attr;
+    attr.sched_group = _db.get_streaming_scheduling_group();
+    return seastar::async(std::move(attr), [this] {
         exponential_backoff_retry r(1s, 1min);
         while (!_base_to_build_step.empty() && !_as.abort_requested()) {
             auto units = get_units(_sem, 1).get0();
@@ -1664,10 +1668,16 @@ class view_builder::consumer {
         _builder._as.check();
         if (!_fragments.empty()) {
             _fragments.push_front(partition_start(_step.current_key, tombstone()));
-            _step.base->populate_views(
+            auto units = get_units(_builder._view_updates_sem, 1).get0();
+            // Waited for by view_builder::wait_for_view_updates().
+            (void)_step.base->populate_views(
                     _views_to_build,
                     _step.current_token(),
-                    make_flat_mutation_reader_from_fragments(_step.base->schema(), std::move(_fragments))).get();
+                    make_flat_mutation_reader_from_fragments(_step.base->schema(), std::move(_fragments))).handle_exception([&builder = _builder] (std::exception_ptr ep) {
+                if (!builder._view_updates_error) {
+                    builder._view_updates_error = std::move(ep);
+                }
+            }).finally([base = _step.base, units = std::move(units)] { });
             _fragments.clear();
             _fragments_memory_usage = 0;
         }
@@ -1709,7 +1719,17 @@ void view_builder::execute(build_step& step, exponential_backoff_retry r) {
             query::max_partitions,
             view_builder::consumer{*this, step});
     consumer.consume_new_partition(step.current_key); // Initialize the state in case we're resuming a partition
-    auto built = step.reader.consume_in_thread(std::move(consumer), db::no_timeout);
+    auto built = [&] {
+        try {
+            return step.reader.consume_in_thread(std::move(consumer), db::no_timeout);
+        } catch (...) {
+            wait_for_view_updates();
+            throw;
+        }
+    }();
+    // The progress made by the step can only be recorded once its view
+    // updates have been propagated.
+    wait_for_view_updates();
 
     _as.check();
 
@@ -1731,6 +1751,14 @@ void view_builder::execute(build_step& step, exponential_backoff_retry r) {
     }).get();
 }
 
+// Called in the context of a seastar::thread.
+void view_builder::wait_for_view_updates() {
+    get_units(_view_updates_sem, _view_updates_concurrency).get();
+    if (auto ep = std::exchange(_view_updates_error, nullptr)) {
+        std::rethrow_exception(std::move(ep));
+    }
+}
+
 future<> view_builder::maybe_mark_view_as_built(view_ptr view, dht::token next_token) {
     _built_views.emplace(view->id());
     vlogger.debug("Shard finished building view {}.{}", view->ks_name(), view->cf_name());
@@ -66,6 +66,12 @@ namespace db::view {
  * from one reader. We also strive for fairness, in that each build step inserts entries for
  * the views of a different base. Each build step reads and generates updates for batch_size rows.
  *
+ * Sending view updates to the view replicas takes much longer than reading the base rows, so a
+ * build step doesn't wait for the updates of a batch to be propagated before reading the next one.
+ * Up to view_building_concurrency batches may be in flight on a shard; they are all waited for
+ * before the progress of the step is recorded, so a restart never skips unpropagated updates.
+ * Building runs in the streaming scheduling group, like other maintenance operations.
+ *
  * We lack a controller, which could potentially allow us to go faster (to execute multiple steps at
  * the same time, or consume more rows per batch), and also which would apply backpressure, so we
  * could, for example, delay executing a build step.
@@ -154,6 +160,11 @@ class view_builder final : public service::migration_listener::only_view_notific
     // a build step we don't consider newly added or removed views. This simplifies
     // the algorithms. Also synchronizes an operation wrt. a call to stop().
     seastar::semaphore _sem{1};
+    // Limits the batches of view updates being propagated at once. The
+    // first error of a batch is kept until the build step waits for them.
+    size_t _view_updates_concurrency;
+    seastar::semaphore _view_updates_sem;
+    std::exception_ptr _view_updates_error;
     seastar::abort_source _as;
     future<> _started = make_ready_future<>();
     // Used to coordinate between shards the conclusion of the build process for a particular view.
@@ -205,6 +216,7 @@ class view_builder final : public service::migration_listener::only_view_notific
     future<> add_new_view(view_ptr, build_step&);
     future<> do_build_step();
     void execute(build_step&, exponential_backoff_retry);
+    void wait_for_view_updates();
     future<> maybe_mark_view_as_built(view_ptr, dht::token);
 
     struct consumer;
@@ -20,37 +20,34 @@
  */
 
 #include "view_update_generator.hh"
+#include "mutation_reader.hh"
+#include "service/priority_manager.hh"
+#include "log.hh"
+#include "utils/exponential_backoff_retry.hh"
+
+#include <seastar/core/metrics.hh>
+#include <seastar/core/sleep.hh>
+
+#include <boost/range/irange.hpp>
 
 namespace db::view {
 
+static logging::logger vug_logger("view_update_generator");
+
 future<> view_update_generator::start() {
-    thread_attributes attr;
-    attr.sched_group = _db.get_streaming_scheduling_group();
-    _started = seastar::async(std::move(attr), [this]() mutable {
-        while (!_as.abort_requested()) {
-            if (_sstables_with_tables.empty()) {
-                _pending_sstables.wait().get();
-            }
-            while (!_sstables_with_tables.empty()) {
-                auto& entry = _sstables_with_tables.front();
-                schema_ptr s = entry.t->schema();
-                flat_mutation_reader staging_sstable_reader = entry.sst->read_rows_flat(s);
-                auto result = staging_sstable_reader.consume_in_thread(view_updating_consumer(s, _proxy, entry.sst, _as), db::no_timeout);
-                if (result == stop_iteration::yes) {
-                    break;
-                }
-                entry.t->move_sstable_from_staging_in_thread(entry.sst);
-                _registration_sem.signal();
-                _sstables_with_tables.pop_front();
-            }
-        }
+    _started = parallel_for_each(boost::irange<size_t>(0, max_workers), [this] (size_t id) {
+        thread_attributes attr;
+        attr.sched_group = _db.get_streaming_scheduling_group();
+        return seastar::async(std::move(attr), [this, id] {
+            run_worker(id);
+        });
     });
     return make_ready_future<>();
 }
 
 future<> view_update_generator::stop() {
     _as.request_abort();
-    _pending_sstables.signal();
+    _pending_sstables.broadcast();
     return std::move(_started).then([this] {
         _registration_sem.broken();
     });
@@ -60,10 +57,136 @@ bool view_update_generator::should_throttle() const {
     return !_started.available();
 }
 
+void view_update_generator::setup_metrics() {
+    namespace sm = seastar::metrics;
+
+    _metrics.add_group("view_update_generator", {
+        sm::make_gauge("queued_sstables", [this] { return _sstables_with_tables.size(); },
+                sm::description("Number of staging sstables waiting for their view updates to be generated.")),
+        sm::make_gauge("sstables_in_progress", [this] { return _sstables_in_progress; },
+                sm::description("Number of staging sstables whose view updates are being generated.")),
+        sm::make_gauge("pending_bytes", [this] { return _pending_bytes; },
+                sm::description("Size on disk of the staging sstables queued or in progress.")),
+    });
+}
+
+// The number of workers allowed to take new staging sstables, which goes
+// down to a single one as the view update backlog of the node fills up.
+size_t view_update_generator::allowed_workers() const {
+    auto backlog = std::min(_proxy.get_view_update_backlog().relative_size(), 1.0f);
+    return std::max(size_t(1), size_t(max_workers * (1.0f - backlog)));
+}
+
+// Called in the context of a seastar::thread.
+void view_update_generator::run_worker(size_t id) {
+    static constexpr auto backlog_check_interval = std::chrono::milliseconds(100);
+    exponential_backoff_retry backoff(std::chrono::seconds(1), std::chrono::minutes(1));
+    while (!_as.abort_requested()) {
+        if (_sstables_with_tables.empty()) {
+            _pending_sstables.wait().get();
+            continue;
+        }
+        if (id >= allowed_workers()) {
+            // We may have consumed the wakeup meant for the sstables which
+            // are queued; pass it on to a worker which is allowed to run.
+            _pending_sstables.signal();
+            try {
+                sleep_abortable(backlog_check_interval, _as).get();
+            } catch (sleep_aborted&) {
+            }
+            continue;
+        }
+        auto batch = take_batch();
+        try {
+            process_batch(batch);
+            backoff.reset();
+        } catch (...) {
+            vug_logger.warn("Failed to generate view updates for {} staging sstables of {}.{}: {}. Retrying in {} ms", batch.size(),
+                    batch.front().t->schema()->ks_name(), batch.front().t->schema()->cf_name(), std::current_exception(),
+                    backoff.sleep_time().count());
+            try {
+                backoff.retry(_as).get();
+            } catch (sleep_aborted&) {
+            }
+            if (!_as.abort_requested()) {
+                requeue_batch(batch);
+                continue;
+            }
+        }
+        release_batch(batch);
+    }
+}
+
+// Takes the oldest queued staging sstable along with the other queued
+// staging sstables of the same table.
+std::vector<view_update_generator::sstable_with_table> view_update_generator::take_batch() {
+    auto t = _sstables_with_tables.front().t;
+    std::vector<sstable_with_table> batch;
+    for (auto it = _sstables_with_tables.begin(); it != _sstables_with_tables.end() && batch.size() < max_sstables_per_batch;) {
+        if (it->t == t) {
+            batch.push_back(std::move(*it));
+            it = _sstables_with_tables.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    _sstables_in_progress += batch.size();
+    if (!_sstables_with_tables.empty()) {
+        // Wake up another worker for the remaining sstables.
+        _pending_sstables.signal();
+    }
+    return batch;
+}
+
+// Puts the sstables of a failed batch back at the end of the queue, so that
+// they are retried without holding up the sstables of other tables.
+void view_update_generator::requeue_batch(std::vector<sstable_with_table>& batch) {
+    _sstables_in_progress -= batch.size();
+    for (auto& entry : batch) {
+        _sstables_with_tables.push_back(std::move(entry));
+    }
+    _pending_sstables.signal();
+}
+
+// Releases what a batch holds once it is done with, or aborted by stop().
+void view_update_generator::release_batch(std::vector<sstable_with_table>& batch) {
+    for (auto& entry : batch) {
+        _pending_bytes -= entry.sst->bytes_on_disk();
+        --_sstables_in_progress;
+        _registration_sem.signal();
+    }
+}
+
+// Called in the context of a seastar::thread.
+void view_update_generator::process_batch(std::vector<sstable_with_table>& batch) {
+    auto& t = batch.front().t;
+    schema_ptr s = t->schema();
+    std::vector<sstables::shared_sstable> ssts;
+    std::vector<flat_mutation_reader> readers;
+    ssts.reserve(batch.size());
+    readers.reserve(batch.size());
+    for (auto& entry : batch) {
+        ssts.push_back(entry.sst);
+        readers.push_back(entry.sst->read_rows_flat(s, service::get_local_streaming_read_priority()));
+    }
+    vug_logger.debug("Generating view updates for {} staging sstables of {}.{}", batch.size(), s->ks_name(), s->cf_name());
+    auto staging_sstables_reader = make_combined_reader(s, std::move(readers));
+    auto result = staging_sstables_reader.consume_in_thread(view_updating_consumer(s, _proxy, std::move(ssts), _as), db::no_timeout);
+    if (result == stop_iteration::yes) {
+        // Aborted by stop(). The sstables stay in staging and are
+        // registered again on restart.
+        return;
+    }
+    for (auto& entry : batch) {
+        entry.t->move_sstable_from_staging_in_thread(entry.sst);
+    }
+}
+
 future<> view_update_generator::register_staging_sstable(sstables::shared_sstable sst, lw_shared_ptr<table> table) {
     if (_as.abort_requested()) {
         return make_ready_future<>();
     }
+    _pending_bytes += sst->bytes_on_disk();
     _sstables_with_tables.emplace_back(std::move(sst), std::move(table));
     _pending_sstables.signal();
     if (should_throttle()) {
@@ -28,11 +28,26 @@
 #include <seastar/core/abort_source.hh>
 #include <seastar/core/condition-variable.hh>
 #include <seastar/core/semaphore.hh>
+#include <seastar/core/metrics_registration.hh>
 
 namespace db::view {
 
+/*
+ * Generates the view updates of the staging sstables written by streaming,
+ * repair or a bulk load, before moving them to the table's directory.
+ *
+ * Staging sstables are processed by a pool of workers. A worker takes all the
+ * sstables of a table which are waiting to be processed, up to a limit, and
+ * reads them through a single combined reader, so that a partition present in
+ * several of them results in a single read-before-write. Fewer workers run as
+ * the view update backlog of the node grows, so that generating view updates
+ * for staging sstables yields to the view updates of regular writes. The
+ * sstables of a batch which fails are queued again after a backoff.
+ */
 class view_update_generator {
     static constexpr size_t registration_queue_size = 5;
+    static constexpr size_t max_workers = 4;
+    static constexpr size_t max_sstables_per_batch = 16;
     database& _db;
     service::storage_proxy& _proxy;
     seastar::abort_source _as;
@@ -45,14 +60,36 @@ class view_update_generator {
         sstable_with_table(sstables::shared_sstable sst, lw_shared_ptr<table> t) : sst(sst), t(t) { }
     };
     std::deque<sstable_with_table> _sstables_with_tables;
+    // Sstables taken by the workers and not yet moved out of staging.
+    size_t _sstables_in_progress = 0;
+    // Size on disk of the sstables queued or in progress.
+    uint64_t _pending_bytes = 0;
+    seastar::metrics::metric_groups _metrics;
 public:
-    view_update_generator(database& db, service::storage_proxy& proxy) : _db(db), _proxy(proxy) { }
+    view_update_generator(database& db, service::storage_proxy& proxy) : _db(db), _proxy(proxy) {
+        setup_metrics();
+    }
 
     future<> start();
     future<> stop();
     future<> register_staging_sstable(sstables::shared_sstable sst, lw_shared_ptr<table> table);
+
+    size_t queued_sstables() const {
+        return _sstables_with_tables.size();
+    }
+
+    uint64_t pending_bytes() const {
+        return _pending_bytes;
+    }
 private:
     bool should_throttle() const;
+    void setup_metrics();
+    size_t allowed_workers() const;
+    void run_worker(size_t id);
+    std::vector<sstable_with_table> take_batch();
+    void requeue_batch(std::vector<sstable_with_table>& batch);
+    void release_batch(std::vector<sstable_with_table>& batch);
+    void process_batch(std::vector<sstable_with_table>& batch);
 };
 
 }
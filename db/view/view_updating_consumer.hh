@@ -32,19 +32,20 @@ namespace db::view {
 
 /*
  * A consumer that pushes materialized view updates for each consumed mutation.
+ * The sstables being consumed are excluded from the read-before-write.
  * It is expected to be run in seastar::async threaded context through consume_in_thread()
  */
 class view_updating_consumer {
     schema_ptr _schema;
     lw_shared_ptr<table> _table;
-    sstables::shared_sstable _excluded_sstable;
+    std::vector<sstables::shared_sstable> _excluded_sstables;
     const seastar::abort_source& _as;
     std::optional<mutation> _m;
 public:
-    view_updating_consumer(schema_ptr schema, service::storage_proxy& proxy, sstables::shared_sstable excluded_sstable, const seastar::abort_source& as)
+    view_updating_consumer(schema_ptr schema, service::storage_proxy& proxy, std::vector<sstables::shared_sstable> excluded_sstables, const seastar::abort_source& as)
             : _schema(std::move(schema))
             , _table(proxy.get_db().local().find_column_family(_schema->id()).shared_from_this())
-            , _excluded_sstable(excluded_sstable)
+            , _excluded_sstables(std::move(excluded_sstables))
             , _as(as)
             , _m()
     { }
@@ -249,6 +249,14 @@ class versioned_value {
         versioned_value cql_ready(bool value) {
             return versioned_value(to_sstring(int(value)));
         }
+
+        versioned_value shard_count(unsigned value) {
+            return versioned_value(to_sstring(value));
+        }
+
+        versioned_value ignore_msb_bits(unsigned value) {
+            return versioned_value(to_sstring(value));
+        }
     };
 }; // class versioned_value
 
@@ -8,6 +8,11 @@ enum class read_repair_decision : uint8_t {
 
 namespace service {
 namespace pager {
+struct parallel_scan_range {
+    nonwrapping_range<dht::ring_position> range;
+    std::optional<clustering_key> last_clustering_key;
+};
+
 class paging_state {
     partition_key get_partition_key();
     std::optional<clustering_key> get_clustering_key();
@@ -16,6 +21,9 @@ class paging_state {
     std::unordered_map<dht::token_range, std::vector<utils::UUID>> get_last_replicas() [[version 2.2]] = std::unordered_map<dht::token_range, std::vector<utils::UUID>>();
     std::optional<db::read_repair_decision> get_query_read_repair_decision() [[version 2.3]] = std::nullopt;
     uint32_t get_rows_fetched_for_last_partition() [[version 3.1]] = 0;
+    std::vector<service::pager::parallel_scan_range> get_parallel_scan_ranges() [[version 3.3]] = std::vector<service::pager::parallel_scan_range>();
+    std::optional<range_bound<dht::ring_position>> get_unscanned_from() [[version 3.3]] = std::nullopt;
+    std::optional<float> get_estimated_result_rows_per_range() [[version 3.3]] = std::nullopt;
 };
 }
 }
@@ -22,6 +22,7 @@
 enum class repair_checksum : uint8_t {
     legacy = 0,
     streamed = 1,
+    xxh3 = 2,
 };
 
 class partition_checksum {
@@ -32,6 +33,16 @@ class repair_hash {
     uint64_t hash;
 };
 
+struct clustering_row_hash {
+    clustering_key key;
+    repair_hash hash;
+};
+
+struct partition_row_hashes {
+    repair_hash partition_hash;
+    std::vector<clustering_row_hash> rows;
+};
+
 enum class bound_weight : int8_t {
     before_all_prefixed = -1,
     equal = 0,
@@ -77,6 +88,17 @@ struct get_combined_row_hash_response {
 enum class row_level_diff_detect_algorithm : uint8_t {
     send_full_set,
     send_full_set_rpc_stream,
+    send_ibf_rpc_stream,
+};
+
+struct repair_hash_ibf_cell {
+    int32_t count;
+    uint64_t key_sum;
+    uint64_t check_sum;
+};
+
+class repair_hash_ibf {
+    std::vector<repair_hash_ibf_cell> cells();
 };
 
 enum class repair_stream_cmd : uint8_t {
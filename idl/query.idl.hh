@@ -29,6 +29,15 @@ class query_result stub [[writable]] {
     std::vector<qr_partition> partitions; // in ring order
 };
 
+struct aggregate_spec {
+    sstring function_name;
+    std::optional<bytes> column_name;
+};
+
+struct aggregate_result {
+    std::vector<std::optional<bytes>> states;
+};
+
 enum class digest_algorithm : uint8_t {
     none = 0,  // digest not required
     MD5 = 1,
@@ -30,6 +30,20 @@ class specific_ranges {
     std::vector<nonwrapping_range<clustering_key_prefix>> ranges();
 };
 
+struct column_predicate {
+    enum class comparison : uint8_t {
+        eq,
+        lt,
+        lte,
+        gt,
+        gte,
+        in,
+    };
+    bytes column_name;
+    query::column_predicate::comparison op;
+    std::vector<bytes> values;
+};
+
 class partition_slice {
     std::vector<nonwrapping_range<clustering_key_prefix>> default_row_ranges();
     utils::small_vector<uint32_t, 8> static_columns;
@@ -38,6 +52,7 @@ class partition_slice {
     std::unique_ptr<query::specific_ranges> get_specific_ranges();
     cql_serialization_format cql_format();
     uint32_t partition_row_limit() [[version 1.3]] = std::numeric_limits<uint32_t>::max();
+    std::vector<query::column_predicate> filter() [[version 3.3]] = std::vector<query::column_predicate>();
 };
 
 class read_command {
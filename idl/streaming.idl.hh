@@ -57,4 +57,21 @@ enum class stream_mutation_fragments_cmd : uint8_t {
     end_of_stream,
 };
 
+enum class stream_sstable_files_cmd : uint8_t {
+    error,
+    sstable_start,
+    component_start,
+    component_data,
+    component_end,
+    sstable_end,
+    end_of_stream,
+};
+
+struct stream_sstable_files_chunk {
+    streaming::stream_sstable_files_cmd cmd;
+    sstring name;
+    bytes data;
+    uint32_t checksum;
+};
+
 }
@@ -130,7 +130,10 @@ void init_ms_fd_gossiper(sharded<gms::gossiper>& gossiper
     scfg.statement = scheduling_config.statement;
     scfg.streaming = scheduling_config.streaming;
     scfg.gossip = scheduling_config.gossip;
-    netw::get_messaging_service().start(listen, storage_port, ew, cw, tndw, ssl_storage_port, creds, mcfg, scfg, sltba, listen_now).get();
+    netw::messaging_service::connection_config ccfg;
+    ccfg.shard_aware = cfg.internode_shard_aware_connections();
+    ccfg.streaming_connections = std::max(cfg.internode_streaming_connections(), 1u);
+    netw::get_messaging_service().start(listen, storage_port, ew, cw, tndw, ssl_storage_port, creds, mcfg, scfg, ccfg, sltba, listen_now).get();
 
     // #293 - do not stop anything
     //engine().at_exit([] { return netw::get_messaging_service().stop(); });
@@ -764,6 +764,12 @@ size_t memtable::partition_count() const {
     return partitions.size();
 }
 
+bool memtable::contains_partition(const dht::decorated_key& key) const {
+    return with_linearized_managed_bytes([&] {
+        return partitions.find(key, memtable_entry::compare(_schema)) != partitions.end();
+    });
+}
+
 memtable_entry::memtable_entry(memtable_entry&& o) noexcept
     : _link()
     , _schema(std::move(o._schema))
@@ -233,6 +233,9 @@ class memtable final : public enable_lw_shared_from_this<memtable>, private loga
     size_t partition_count() const;
     logalloc::occupancy_stats occupancy() const;
 
+    // Returns true if the memtable has an entry for the partition.
+    bool contains_partition(const dht::decorated_key& key) const;
+
     // Creates a reader of data in this memtable for given partition range.
     //
     // Live readers share ownership of the memtable instance, so caller
@@ -40,6 +40,7 @@
 #include "range.hh"
 #include "frozen_schema.hh"
 #include "repair/repair.hh"
+#include "repair/hash_set_serializer.hh"
 #include "digest_algorithm.hh"
 #include "idl/consistency_level.dist.hh"
 #include "idl/tracing.dist.hh"
@@ -93,6 +94,7 @@
 #include "flat_mutation_reader.hh"
 #include "streaming/stream_manager.hh"
 #include "streaming/stream_mutation_fragments_cmd.hh"
+#include "streaming/stream_sstable_files_cmd.hh"
 
 namespace netw {
 
@@ -218,7 +220,7 @@ rpc::stats messaging_service::shard_info::get_stats() const {
 void messaging_service::foreach_client(std::function<void(const msg_addr& id, const shard_info& info)> f) const {
     for (unsigned idx = 0; idx < _clients.size(); idx ++) {
         for (auto i = _clients[idx].cbegin(); i != _clients[idx].cend(); i++) {
-            f(i->first, i->second);
+            f(i->first.addr, i->second);
         }
     }
 }
@@ -272,7 +274,7 @@ void register_handler(messaging_service* ms, messaging_verb verb, Func&& func) {
 
 messaging_service::messaging_service(gms::inet_address ip, uint16_t port, bool listen_now)
     : messaging_service(std::move(ip), port, encrypt_what::none, compress_what::none, tcp_nodelay_what::all, 0, nullptr, memory_config{1'000'000},
-            scheduling_config{}, false, listen_now)
+            scheduling_config{}, connection_config{}, false, listen_now)
 {}
 
 static
@@ -349,6 +351,7 @@ messaging_service::messaging_service(gms::inet_address ip
         , std::shared_ptr<seastar::tls::credentials_builder> credentials
         , messaging_service::memory_config mcfg
         , scheduling_config scfg
+        , connection_config ccfg
         , bool sltba
         , bool listen_now)
     : _listen_address(ip)
@@ -362,6 +365,7 @@ messaging_service::messaging_service(gms::inet_address ip
     , _credentials(credentials ? credentials->build_server_credentials() : nullptr)
     , _mcfg(mcfg)
     , _scheduling_config(scfg)
+    , _connection_config(ccfg)
 {
     _rpc->set_logger([] (const sstring& log) {
             rpc_logger.info("{}", log);
@@ -411,7 +415,7 @@ future<> messaging_service::stop_nontls_server() {
 
 future<> messaging_service::stop_client() {
     return parallel_for_each(_clients, [] (auto& m) {
-        return parallel_for_each(m, [] (std::pair<const msg_addr, shard_info>& c) {
+        return parallel_for_each(m, [] (std::pair<const client_key, shard_info>& c) {
             return c.second.rpc_client->stop();
         });
     });
@@ -434,6 +438,8 @@ static constexpr unsigned do_get_rpc_client_idx(messaging_verb verb) {
     case messaging_verb::READ_DATA:
     case messaging_verb::READ_MUTATION_DATA:
     case messaging_verb::READ_DIGEST:
+    case messaging_verb::READ_ROW_HASHES:
+    case messaging_verb::AGGREGATE_QUERY:
     case messaging_verb::GOSSIP_DIGEST_ACK:
     case messaging_verb::DEFINITIONS_UPDATE:
     case messaging_verb::TRUNCATE:
@@ -472,6 +478,9 @@ static constexpr unsigned do_get_rpc_client_idx(messaging_verb verb) {
     case messaging_verb::REPAIR_GET_ROW_DIFF_WITH_RPC_STREAM:
     case messaging_verb::REPAIR_PUT_ROW_DIFF_WITH_RPC_STREAM:
     case messaging_verb::REPAIR_GET_FULL_ROW_HASHES_WITH_RPC_STREAM:
+    case messaging_verb::REPAIR_GET_ROW_HASH_IBF:
+    case messaging_verb::STREAM_SSTABLE_FILES:
+    case messaging_verb::REPAIR_MARK_SSTABLES_REPAIRED:
         return 2;
     case messaging_verb::MUTATION_DONE:
     case messaging_verb::MUTATION_FAILED:
@@ -549,10 +558,75 @@ void messaging_service::cache_preferred_ip(gms::inet_address ep, gms::inet_addre
     _preferred_ip_cache[ep] = ip;
 }
 
+void messaging_service::set_sharding_info(gms::inet_address ep, unsigned shard_count, unsigned sharding_ignore_msb) {
+    auto& p = _remote_sharding[ep];
+    if (p && p->shard_count() == shard_count && p->sharding_ignore_msb() == sharding_ignore_msb) {
+        return;
+    }
+    // Shard-aware connections opened for the previous sharding may now lead
+    // to the wrong shards.
+    if (p && _connection_config.shard_aware) {
+        remove_rpc_client(msg_addr(ep));
+    }
+    p = dht::make_partitioner(dht::global_partitioner().name(), shard_count, sharding_ignore_msb);
+}
+
+void messaging_service::remove_sharding_info(gms::inet_address ep) {
+    _remote_sharding.erase(ep);
+}
+
+msg_addr messaging_service::addr_for_token(gms::inet_address ep, const dht::token& t) const {
+    if (!_connection_config.shard_aware) {
+        return msg_addr(ep);
+    }
+    auto it = _remote_sharding.find(ep);
+    if (it == _remote_sharding.end()) {
+        return msg_addr(ep);
+    }
+    return msg_addr::for_shard(ep, it->second->shard_of(t));
+}
+
+unsigned messaging_service::shard_slot(msg_addr id, unsigned remote_shard_count) {
+    if (!id.shard_resolved || !remote_shard_count) {
+        return 0;
+    }
+    // Slot 0 stays the connection to an arbitrary shard.
+    return id.cpu_id % remote_shard_count + 1;
+}
+
+unsigned messaging_service::get_client_slot(unsigned idx, msg_addr id) {
+    if (idx == 2) {
+        // Streaming and repair requests are independent of each other, so
+        // spreading them over several connections is safe.
+        auto n = std::max(_connection_config.streaming_connections, 1u);
+        return n > 1 ? _next_streaming_slot++ % n : 0;
+    }
+    if (_connection_config.shard_aware && (idx == 0 || idx == 3)) {
+        auto it = _remote_sharding.find(id.addr);
+        if (it != _remote_sharding.end()) {
+            return shard_slot(id, it->second->shard_count());
+        }
+    }
+    return 0;
+}
+
+uint16_t messaging_service::source_port_for_shard(unsigned shard, unsigned shard_count, unsigned local_shard, unsigned local_shard_count, unsigned attempt) {
+    // The default Linux ephemeral port range
+    constexpr unsigned low = 32768;
+    constexpr unsigned high = 60999;
+    // The ports leading to the remote shard, of which the local shards take
+    // every local_shard_count-th in turn.
+    auto first = low + (shard + shard_count - low % shard_count) % shard_count;
+    auto ports = (high - first) / shard_count + 1;
+    auto i = (local_shard + uint64_t(local_shard_count) * attempt) % ports;
+    return first + i * shard_count;
+}
+
 shared_ptr<messaging_service::rpc_protocol_client_wrapper> messaging_service::get_rpc_client(messaging_verb verb, msg_addr id) {
     assert(!_stopping);
     auto idx = get_rpc_client_idx(verb);
-    auto it = _clients[idx].find(id);
+    auto key = client_key{id, get_client_slot(idx, id)};
+    auto it = _clients[idx].find(key);
 
     if (it != _clients[idx].end()) {
         auto c = it->second.rpc_client;
@@ -607,6 +681,18 @@ shared_ptr<messaging_service::rpc_protocol_client_wrapper> messaging_service::ge
     }();
 
     auto remote_addr = socket_address(get_preferred_ip(id.addr), must_encrypt ? _ssl_port : _port);
+    auto local_addr = socket_address();
+    if (key.slot && idx != 2) {
+        // The server side uses port based load balancing, which hands a
+        // connection to shard (source port % shard count). Binding the source
+        // port is thus enough to have the connection handled by the chosen
+        // remote shard. The connection is made with SO_REUSEADDR, so the port
+        // may be shared with connections to other nodes. Should it be taken
+        // after all, the connection fails, and the next one to the shard,
+        // made by the next request, tries the next port.
+        auto shard_count = _remote_sharding.at(id.addr)->shard_count();
+        local_addr = socket_address(_listen_address, source_port_for_shard(key.slot - 1, shard_count, engine().cpu_id(), smp::count, _next_source_port_attempt++));
+    }
 
     rpc::client_options opts;
     // send keepalive messages each minute if connection is idle, drop connection after 10 failures
@@ -619,12 +705,13 @@ shared_ptr<messaging_service::rpc_protocol_client_wrapper> messaging_service::ge
 
     auto client = must_encrypt ?
                     ::make_shared<rpc_protocol_client_wrapper>(*_rpc, std::move(opts),
-                                    remote_addr, socket_address(), _credentials) :
+                                    remote_addr, local_addr, _credentials) :
                     ::make_shared<rpc_protocol_client_wrapper>(*_rpc, std::move(opts),
-                                    remote_addr);
+                                    remote_addr, local_addr);
 
-    auto res = _clients[idx].emplace(id, shard_info(std::move(client)));
+    auto res = _clients[idx].emplace(key, shard_info(std::move(client)));
     assert(res.second);
+    _max_client_slot = std::max(_max_client_slot, key.slot);
     it = res.first;
     uint32_t src_cpu_id = engine().cpu_id();
     // No reply is received, nothing to wait for.
@@ -644,8 +731,12 @@ bool messaging_service::remove_rpc_client_one(clients_map& clients, msg_addr id,
     }
 
     bool found = false;
-    auto it = clients.find(id);
-    if (it != clients.end() && (!dead_only || it->second.rpc_client->error())) {
+    // There may be a connection to the node in each slot, see client_key.
+    for (unsigned slot = 0; slot <= _max_client_slot; ++slot) {
+        auto it = clients.find(client_key{id, slot});
+        if (it == clients.end() || (dead_only && !it->second.rpc_client->error())) {
+            continue;
+        }
         auto client = std::move(it->second.rpc_client);
         clients.erase(it);
         //
@@ -704,6 +795,30 @@ void messaging_service::register_stream_mutation_fragments(std::function<future<
     register_handler(this, messaging_verb::STREAM_MUTATION_FRAGMENTS, std::move(func));
 }
 
+rpc::sink<int32_t> messaging_service::make_sink_for_stream_sstable_files(rpc::source<streaming::stream_sstable_files_chunk>& source) {
+    return source.make_sink<netw::serializer, int32_t>();
+}
+
+future<rpc::sink<streaming::stream_sstable_files_chunk>, rpc::source<int32_t>>
+messaging_service::make_sink_and_source_for_stream_sstable_files(utils::UUID schema_id, utils::UUID plan_id, utils::UUID cf_id, streaming::stream_reason reason, msg_addr id) {
+    if (is_stopping()) {
+        return make_exception_future<rpc::sink<streaming::stream_sstable_files_chunk>, rpc::source<int32_t>>(rpc::closed_error());
+    }
+    auto rpc_client = get_rpc_client(messaging_verb::STREAM_SSTABLE_FILES, id);
+    return rpc_client->make_stream_sink<netw::serializer, streaming::stream_sstable_files_chunk>().then([this, plan_id, schema_id, cf_id, reason, rpc_client] (rpc::sink<streaming::stream_sstable_files_chunk> sink) mutable {
+        auto rpc_handler = rpc()->make_client<rpc::source<int32_t> (utils::UUID, utils::UUID, utils::UUID, streaming::stream_reason, rpc::sink<streaming::stream_sstable_files_chunk>)>(messaging_verb::STREAM_SSTABLE_FILES);
+        return rpc_handler(*rpc_client , plan_id, schema_id, cf_id, reason, sink).then_wrapped([sink, rpc_client] (future<rpc::source<int32_t>> source) mutable {
+            return (source.failed() ? sink.close() : make_ready_future<>()).then([sink = std::move(sink), source = std::move(source)] () mutable {
+                return make_ready_future<rpc::sink<streaming::stream_sstable_files_chunk>, rpc::source<int32_t>>(std::move(sink), std::move(source.get0()));
+            });
+        });
+    });
+}
+
+void messaging_service::register_stream_sstable_files(std::function<future<rpc::sink<int32_t>> (const rpc::client_info& cinfo, UUID plan_id, UUID schema_id, UUID cf_id, streaming::stream_reason reason, rpc::source<streaming::stream_sstable_files_chunk> source)>&& func) {
+    register_handler(this, messaging_verb::STREAM_SSTABLE_FILES, std::move(func));
+}
+
 template<class SinkType, class SourceType>
 future<rpc::sink<SinkType>, rpc::source<SourceType>>
 do_make_sink_source(messaging_verb verb, uint32_t repair_meta_id, shared_ptr<messaging_service::rpc_protocol_client_wrapper> rpc_client, std::unique_ptr<messaging_service::rpc_protocol_wrapper>& rpc) {
@@ -1019,14 +1134,14 @@ future<> messaging_service::send_mutation_failed(msg_addr id, unsigned shard, re
     return send_message_oneway(this, messaging_verb::MUTATION_FAILED, std::move(id), std::move(shard), std::move(response_id), num_failed, std::move(backlog));
 }
 
-void messaging_service::register_read_data(std::function<future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>> (const rpc::client_info&, rpc::opt_time_point t, query::read_command cmd, ::compat::wrapping_partition_range pr, rpc::optional<query::digest_algorithm> oda)>&& func) {
+void messaging_service::register_read_data(std::function<future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature, uint32_t>> (const rpc::client_info&, rpc::opt_time_point t, query::read_command cmd, ::compat::wrapping_partition_range pr, rpc::optional<query::digest_algorithm> oda)>&& func) {
     register_handler(this, netw::messaging_verb::READ_DATA, std::move(func));
 }
 void messaging_service::unregister_read_data() {
     _rpc->unregister_handler(netw::messaging_verb::READ_DATA);
 }
-future<rpc::tuple<query::result, rpc::optional<cache_temperature>>> messaging_service::send_read_data(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr, query::digest_algorithm da) {
-    return send_message_timeout<future<rpc::tuple<query::result, rpc::optional<cache_temperature>>>>(this, messaging_verb::READ_DATA, std::move(id), timeout, cmd, pr, da);
+future<rpc::tuple<query::result, rpc::optional<cache_temperature>, rpc::optional<uint32_t>>> messaging_service::send_read_data(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr, query::digest_algorithm da) {
+    return send_message_timeout<future<rpc::tuple<query::result, rpc::optional<cache_temperature>, rpc::optional<uint32_t>>>>(this, messaging_verb::READ_DATA, std::move(id), timeout, cmd, pr, da);
 }
 
 void messaging_service::register_get_schema_version(std::function<future<frozen_schema>(unsigned, table_schema_version)>&& func) {
@@ -1059,14 +1174,34 @@ future<rpc::tuple<reconcilable_result, rpc::optional<cache_temperature>>> messag
     return send_message_timeout<future<rpc::tuple<reconcilable_result, rpc::optional<cache_temperature>>>>(this, messaging_verb::READ_MUTATION_DATA, std::move(id), timeout, cmd, pr);
 }
 
-void messaging_service::register_read_digest(std::function<future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature>> (const rpc::client_info&, rpc::opt_time_point timeout, query::read_command cmd, ::compat::wrapping_partition_range pr, rpc::optional<query::digest_algorithm> oda)>&& func) {
+void messaging_service::register_read_row_hashes(std::function<future<partition_row_hashes> (const rpc::client_info&, rpc::opt_time_point t, query::read_command cmd, ::compat::wrapping_partition_range pr)>&& func) {
+    register_handler(this, netw::messaging_verb::READ_ROW_HASHES, std::move(func));
+}
+void messaging_service::unregister_read_row_hashes() {
+    _rpc->unregister_handler(netw::messaging_verb::READ_ROW_HASHES);
+}
+future<partition_row_hashes> messaging_service::send_read_row_hashes(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr) {
+    return send_message_timeout<future<partition_row_hashes>>(this, messaging_verb::READ_ROW_HASHES, std::move(id), timeout, cmd, pr);
+}
+
+void messaging_service::register_aggregate_query(std::function<future<query::aggregate_result> (const rpc::client_info&, rpc::opt_time_point t, query::read_command cmd, dht::partition_range_vector pr, std::vector<query::aggregate_spec> aggregates)>&& func) {
+    register_handler(this, netw::messaging_verb::AGGREGATE_QUERY, std::move(func));
+}
+void messaging_service::unregister_aggregate_query() {
+    _rpc->unregister_handler(netw::messaging_verb::AGGREGATE_QUERY);
+}
+future<query::aggregate_result> messaging_service::send_aggregate_query(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range_vector& pr, const std::vector<query::aggregate_spec>& aggregates) {
+    return send_message_timeout<future<query::aggregate_result>>(this, messaging_verb::AGGREGATE_QUERY, std::move(id), timeout, cmd, pr, aggregates);
+}
+
+void messaging_service::register_read_digest(std::function<future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature, uint32_t>> (const rpc::client_info&, rpc::opt_time_point timeout, query::read_command cmd, ::compat::wrapping_partition_range pr, rpc::optional<query::digest_algorithm> oda)>&& func) {
     register_handler(this, netw::messaging_verb::READ_DIGEST, std::move(func));
 }
 void messaging_service::unregister_read_digest() {
     _rpc->unregister_handler(netw::messaging_verb::READ_DIGEST);
 }
-future<rpc::tuple<query::result_digest, rpc::optional<api::timestamp_type>, rpc::optional<cache_temperature>>> messaging_service::send_read_digest(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr, query::digest_algorithm da) {
-    return send_message_timeout<future<rpc::tuple<query::result_digest, rpc::optional<api::timestamp_type>, rpc::optional<cache_temperature>>>>(this, netw::messaging_verb::READ_DIGEST, std::move(id), timeout, cmd, pr, da);
+future<rpc::tuple<query::result_digest, rpc::optional<api::timestamp_type>, rpc::optional<cache_temperature>, rpc::optional<uint32_t>>> messaging_service::send_read_digest(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr, query::digest_algorithm da) {
+    return send_message_timeout<future<rpc::tuple<query::result_digest, rpc::optional<api::timestamp_type>, rpc::optional<cache_temperature>, rpc::optional<uint32_t>>>>(this, netw::messaging_verb::READ_DIGEST, std::move(id), timeout, cmd, pr, da);
 }
 
 // Wrapper for TRUNCATE
@@ -1112,14 +1247,25 @@ future<partition_checksum> messaging_service::send_repair_checksum_range(
 }
 
 // Wrapper for REPAIR_GET_FULL_ROW_HASHES
-void messaging_service::register_repair_get_full_row_hashes(std::function<future<std::unordered_set<repair_hash>> (const rpc::client_info& cinfo, uint32_t repair_meta_id)>&& func) {
+void messaging_service::register_repair_get_full_row_hashes(std::function<future<repair_hash_set> (const rpc::client_info& cinfo, uint32_t repair_meta_id)>&& func) {
     register_handler(this, messaging_verb::REPAIR_GET_FULL_ROW_HASHES, std::move(func));
 }
 void messaging_service::unregister_repair_get_full_row_hashes() {
     _rpc->unregister_handler(messaging_verb::REPAIR_GET_FULL_ROW_HASHES);
 }
-future<std::unordered_set<repair_hash>> messaging_service::send_repair_get_full_row_hashes(msg_addr id, uint32_t repair_meta_id) {
-    return send_message<future<std::unordered_set<repair_hash>>>(this, messaging_verb::REPAIR_GET_FULL_ROW_HASHES, std::move(id), repair_meta_id);
+future<repair_hash_set> messaging_service::send_repair_get_full_row_hashes(msg_addr id, uint32_t repair_meta_id) {
+    return send_message<future<repair_hash_set>>(this, messaging_verb::REPAIR_GET_FULL_ROW_HASHES, std::move(id), repair_meta_id);
+}
+
+// Wrapper for REPAIR_GET_ROW_HASH_IBF
+void messaging_service::register_repair_get_row_hash_ibf(std::function<future<repair_hash_ibf> (const rpc::client_info& cinfo, uint32_t repair_meta_id, uint32_t nr_cells)>&& func) {
+    register_handler(this, messaging_verb::REPAIR_GET_ROW_HASH_IBF, std::move(func));
+}
+void messaging_service::unregister_repair_get_row_hash_ibf() {
+    _rpc->unregister_handler(messaging_verb::REPAIR_GET_ROW_HASH_IBF);
+}
+future<repair_hash_ibf> messaging_service::send_repair_get_row_hash_ibf(msg_addr id, uint32_t repair_meta_id, uint32_t nr_cells) {
+    return send_message<future<repair_hash_ibf>>(this, messaging_verb::REPAIR_GET_ROW_HASH_IBF, std::move(id), repair_meta_id, nr_cells);
 }
 
 // Wrapper for REPAIR_GET_COMBINED_ROW_HASH
@@ -1144,13 +1290,13 @@ future<get_sync_boundary_response> messaging_service::send_repair_get_sync_bound
 }
 
 // Wrapper for REPAIR_GET_ROW_DIFF
-void messaging_service::register_repair_get_row_diff(std::function<future<repair_rows_on_wire> (const rpc::client_info& cinfo, uint32_t repair_meta_id, std::unordered_set<repair_hash> set_diff, bool needs_all_rows)>&& func) {
+void messaging_service::register_repair_get_row_diff(std::function<future<repair_rows_on_wire> (const rpc::client_info& cinfo, uint32_t repair_meta_id, repair_hash_set set_diff, bool needs_all_rows)>&& func) {
     register_handler(this, messaging_verb::REPAIR_GET_ROW_DIFF, std::move(func));
 }
 void messaging_service::unregister_repair_get_row_diff() {
     _rpc->unregister_handler(messaging_verb::REPAIR_GET_ROW_DIFF);
 }
-future<repair_rows_on_wire> messaging_service::send_repair_get_row_diff(msg_addr id, uint32_t repair_meta_id, std::unordered_set<repair_hash> set_diff, bool needs_all_rows) {
+future<repair_rows_on_wire> messaging_service::send_repair_get_row_diff(msg_addr id, uint32_t repair_meta_id, repair_hash_set set_diff, bool needs_all_rows) {
     return send_message<future<repair_rows_on_wire>>(this, messaging_verb::REPAIR_GET_ROW_DIFF, std::move(id), repair_meta_id, std::move(set_diff), needs_all_rows);
 }
 
@@ -1166,14 +1312,14 @@ future<> messaging_service::send_repair_put_row_diff(msg_addr id, uint32_t repai
 }
 
 // Wrapper for REPAIR_ROW_LEVEL_START
-void messaging_service::register_repair_row_level_start(std::function<future<> (const rpc::client_info& cinfo, uint32_t repair_meta_id, sstring keyspace_name, sstring cf_name, dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size, uint64_t seed, unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version)>&& func) {
+void messaging_service::register_repair_row_level_start(std::function<future<> (const rpc::client_info& cinfo, uint32_t repair_meta_id, sstring keyspace_name, sstring cf_name, dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size, uint64_t seed, unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version, rpc::optional<bool> incremental, rpc::optional<repair_checksum> hash_version, rpc::optional<uint64_t> repaired_at)>&& func) {
     register_handler(this, messaging_verb::REPAIR_ROW_LEVEL_START, std::move(func));
 }
 void messaging_service::unregister_repair_row_level_start() {
     _rpc->unregister_handler(messaging_verb::REPAIR_ROW_LEVEL_START);
 }
-future<> messaging_service::send_repair_row_level_start(msg_addr id, uint32_t repair_meta_id, sstring keyspace_name, sstring cf_name, dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size, uint64_t seed, unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version) {
-    return send_message<void>(this, messaging_verb::REPAIR_ROW_LEVEL_START, std::move(id), repair_meta_id, std::move(keyspace_name), std::move(cf_name), std::move(range), algo, max_row_buf_size, seed, remote_shard, remote_shard_count, remote_ignore_msb, std::move(remote_partitioner_name), std::move(schema_version));
+future<> messaging_service::send_repair_row_level_start(msg_addr id, uint32_t repair_meta_id, sstring keyspace_name, sstring cf_name, dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size, uint64_t seed, unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version, bool incremental, repair_checksum hash_version, uint64_t repaired_at) {
+    return send_message<void>(this, messaging_verb::REPAIR_ROW_LEVEL_START, std::move(id), repair_meta_id, std::move(keyspace_name), std::move(cf_name), std::move(range), algo, max_row_buf_size, seed, remote_shard, remote_shard_count, remote_ignore_msb, std::move(remote_partitioner_name), std::move(schema_version), incremental, hash_version, repaired_at);
 }
 
 // Wrapper for REPAIR_ROW_LEVEL_STOP
@@ -1220,4 +1366,15 @@ future<std::vector<row_level_diff_detect_algorithm>> messaging_service::send_rep
     return send_message<future<std::vector<row_level_diff_detect_algorithm>>>(this, messaging_verb::REPAIR_GET_DIFF_ALGORITHMS, std::move(id));
 }
 
+// Wrapper for REPAIR_MARK_SSTABLES_REPAIRED
+void messaging_service::register_repair_mark_sstables_repaired(std::function<future<> (const rpc::client_info& cinfo, sstring keyspace_name, std::vector<UUID> table_ids, dht::token_range_vector ranges, uint64_t repaired_at)>&& func) {
+    register_handler(this, messaging_verb::REPAIR_MARK_SSTABLES_REPAIRED, std::move(func));
+}
+void messaging_service::unregister_repair_mark_sstables_repaired() {
+    _rpc->unregister_handler(messaging_verb::REPAIR_MARK_SSTABLES_REPAIRED);
+}
+future<> messaging_service::send_repair_mark_sstables_repaired(msg_addr id, sstring keyspace_name, std::vector<UUID> table_ids, dht::token_range_vector ranges, uint64_t repaired_at) {
+    return send_message<void>(this, messaging_verb::REPAIR_MARK_SSTABLES_REPAIRED, std::move(id), std::move(keyspace_name), std::move(table_ids), std::move(ranges), repaired_at);
+}
+
 } // namespace net
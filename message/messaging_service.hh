@@ -33,10 +33,13 @@
 #include "mutation_query.hh"
 #include "range.hh"
 #include "repair/repair.hh"
+#include "repair/hash_ibf.hh"
+#include "repair/hash_set.hh"
 #include "tracing/tracing.hh"
 #include "digest_algorithm.hh"
 #include "streaming/stream_reason.hh"
 #include "streaming/stream_mutation_fragments_cmd.hh"
+#include "streaming/stream_sstable_files_cmd.hh"
 #include "cache_temperature.hh"
 
 #include <list>
@@ -70,9 +73,11 @@ class update_backlog;
 class frozen_mutation;
 class frozen_schema;
 class partition_checksum;
+struct partition_row_hashes;
 
 namespace dht {
     class token;
+    class i_partitioner;
 }
 
 namespace query {
@@ -134,7 +139,12 @@ enum class messaging_verb : int32_t {
     REPAIR_GET_ROW_DIFF_WITH_RPC_STREAM = 36,
     REPAIR_PUT_ROW_DIFF_WITH_RPC_STREAM = 37,
     REPAIR_GET_FULL_ROW_HASHES_WITH_RPC_STREAM = 38,
-    LAST = 39,
+    READ_ROW_HASHES = 39,
+    AGGREGATE_QUERY = 40,
+    REPAIR_GET_ROW_HASH_IBF = 41,
+    STREAM_SSTABLE_FILES = 42,
+    REPAIR_MARK_SSTABLES_REPAIRED = 43,
+    LAST = 44,
 };
 
 } // namespace netw
@@ -167,7 +177,22 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     using msg_addr = netw::msg_addr;
     using inet_address = gms::inet_address;
     using UUID = utils::UUID;
-    using clients_map = std::unordered_map<msg_addr, shard_info, msg_addr::hash>;
+    // A node may be reached over several connections for the same kind of
+    // verbs, told apart by the slot: one connection per remote shard when
+    // shard-aware connections are enabled, or several streaming connections.
+    struct client_key {
+        msg_addr addr;
+        unsigned slot;
+        friend bool operator==(const client_key& x, const client_key& y) {
+            return x.addr == y.addr && x.slot == y.slot;
+        }
+        struct hash {
+            size_t operator()(const client_key& k) const {
+                return msg_addr::hash()(k.addr) ^ k.slot;
+            }
+        };
+    };
+    using clients_map = std::unordered_map<client_key, shard_info, client_key::hash>;
 
     // This should change only if serialization format changes
     static constexpr int32_t current_version = 0;
@@ -218,6 +243,14 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
         scheduling_group gossip;
     };
 
+    struct connection_config {
+        // Connect statement verbs directly to the remote shard a request is
+        // routed to, instead of to an arbitrary one.
+        bool shard_aware = false;
+        // Number of connections to a node used for streaming and repair.
+        unsigned streaming_connections = 1;
+    };
+
 private:
     gms::inet_address _listen_address;
     uint16_t _port;
@@ -238,6 +271,13 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     std::list<std::function<void(gms::inet_address ep)>> _connection_drop_notifiers;
     memory_config _mcfg;
     scheduling_config _scheduling_config;
+    connection_config _connection_config;
+    unsigned _next_streaming_slot = 0;
+    // Highest slot of a connection made so far, see client_key.
+    unsigned _max_client_slot = 0;
+    unsigned _next_source_port_attempt = 0;
+    // Sharding of remote nodes, as advertised through gossip
+    std::unordered_map<gms::inet_address, std::unique_ptr<dht::i_partitioner>> _remote_sharding;
 public:
     using clock_type = lowres_clock;
 public:
@@ -245,7 +285,7 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
             uint16_t port = 7000, bool listen_now = true);
     messaging_service(gms::inet_address ip, uint16_t port, encrypt_what, compress_what, tcp_nodelay_what,
             uint16_t ssl_port, std::shared_ptr<seastar::tls::credentials_builder>,
-            memory_config mcfg, scheduling_config scfg, bool sltba = false, bool listen_now = true);
+            memory_config mcfg, scheduling_config scfg, connection_config ccfg, bool sltba = false, bool listen_now = true);
     ~messaging_service();
 public:
     void start_listen();
@@ -282,6 +322,12 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     rpc::sink<int32_t> make_sink_for_stream_mutation_fragments(rpc::source<frozen_mutation_fragment, rpc::optional<streaming::stream_mutation_fragments_cmd>>& source);
     future<rpc::sink<frozen_mutation_fragment, streaming::stream_mutation_fragments_cmd>, rpc::source<int32_t>> make_sink_and_source_for_stream_mutation_fragments(utils::UUID schema_id, utils::UUID plan_id, utils::UUID cf_id, uint64_t estimated_partitions, streaming::stream_reason reason, msg_addr id);
 
+    // Wrapper for STREAM_SSTABLE_FILES
+    // The receiver of STREAM_SSTABLE_FILES sends status code to the sender in the same way as for STREAM_MUTATION_FRAGMENTS.
+    void register_stream_sstable_files(std::function<future<rpc::sink<int32_t>> (const rpc::client_info& cinfo, UUID plan_id, UUID schema_id, UUID cf_id, streaming::stream_reason reason, rpc::source<streaming::stream_sstable_files_chunk> source)>&& func);
+    rpc::sink<int32_t> make_sink_for_stream_sstable_files(rpc::source<streaming::stream_sstable_files_chunk>& source);
+    future<rpc::sink<streaming::stream_sstable_files_chunk>, rpc::source<int32_t>> make_sink_and_source_for_stream_sstable_files(utils::UUID schema_id, utils::UUID plan_id, utils::UUID cf_id, streaming::stream_reason reason, msg_addr id);
+
     // Wrapper for REPAIR_GET_ROW_DIFF_WITH_RPC_STREAM
     future<rpc::sink<repair_hash_with_cmd>, rpc::source<repair_row_on_wire_with_cmd>> make_sink_and_source_for_repair_get_row_diff_with_rpc_stream(uint32_t repair_meta_id, msg_addr id);
     rpc::sink<repair_row_on_wire_with_cmd> make_sink_for_repair_get_row_diff_with_rpc_stream(rpc::source<repair_hash_with_cmd>& source);
@@ -309,9 +355,14 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     future<partition_checksum> send_repair_checksum_range(msg_addr id, sstring keyspace, sstring cf, dht::token_range range, repair_checksum hash_version);
 
     // Wrapper for REPAIR_GET_FULL_ROW_HASHES
-    void register_repair_get_full_row_hashes(std::function<future<std::unordered_set<repair_hash>> (const rpc::client_info& cinfo, uint32_t repair_meta_id)>&& func);
+    void register_repair_get_full_row_hashes(std::function<future<repair_hash_set> (const rpc::client_info& cinfo, uint32_t repair_meta_id)>&& func);
     void unregister_repair_get_full_row_hashes();
-    future<std::unordered_set<repair_hash>> send_repair_get_full_row_hashes(msg_addr id, uint32_t repair_meta_id);
+    future<repair_hash_set> send_repair_get_full_row_hashes(msg_addr id, uint32_t repair_meta_id);
+
+    // Wrapper for REPAIR_GET_ROW_HASH_IBF
+    void register_repair_get_row_hash_ibf(std::function<future<repair_hash_ibf> (const rpc::client_info& cinfo, uint32_t repair_meta_id, uint32_t nr_cells)>&& func);
+    void unregister_repair_get_row_hash_ibf();
+    future<repair_hash_ibf> send_repair_get_row_hash_ibf(msg_addr id, uint32_t repair_meta_id, uint32_t nr_cells);
 
     // Wrapper for REPAIR_GET_COMBINED_ROW_HASH
     void register_repair_get_combined_row_hash(std::function<future<get_combined_row_hash_response> (const rpc::client_info& cinfo, uint32_t repair_meta_id, std::optional<repair_sync_boundary> common_sync_boundary)>&& func);
@@ -324,9 +375,9 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     future<get_sync_boundary_response> send_repair_get_sync_boundary(msg_addr id, uint32_t repair_meta_id, std::optional<repair_sync_boundary> skipped_sync_boundary);
 
     // Wrapper for REPAIR_GET_ROW_DIFF
-    void register_repair_get_row_diff(std::function<future<repair_rows_on_wire> (const rpc::client_info& cinfo, uint32_t repair_meta_id, std::unordered_set<repair_hash> set_diff, bool needs_all_rows)>&& func);
+    void register_repair_get_row_diff(std::function<future<repair_rows_on_wire> (const rpc::client_info& cinfo, uint32_t repair_meta_id, repair_hash_set set_diff, bool needs_all_rows)>&& func);
     void unregister_repair_get_row_diff();
-    future<repair_rows_on_wire> send_repair_get_row_diff(msg_addr id, uint32_t repair_meta_id, std::unordered_set<repair_hash> set_diff, bool needs_all_rows);
+    future<repair_rows_on_wire> send_repair_get_row_diff(msg_addr id, uint32_t repair_meta_id, repair_hash_set set_diff, bool needs_all_rows);
 
     // Wrapper for REPAIR_PUT_ROW_DIFF
     void register_repair_put_row_diff(std::function<future<> (const rpc::client_info& cinfo, uint32_t repair_meta_id, repair_rows_on_wire row_diff)>&& func);
@@ -334,9 +385,9 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     future<> send_repair_put_row_diff(msg_addr id, uint32_t repair_meta_id, repair_rows_on_wire row_diff);
 
     // Wrapper for REPAIR_ROW_LEVEL_START
-    void register_repair_row_level_start(std::function<future<> (const rpc::client_info& cinfo, uint32_t repair_meta_id, sstring keyspace_name, sstring cf_name, dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size, uint64_t seed, unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version)>&& func);
+    void register_repair_row_level_start(std::function<future<> (const rpc::client_info& cinfo, uint32_t repair_meta_id, sstring keyspace_name, sstring cf_name, dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size, uint64_t seed, unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version, rpc::optional<bool> incremental, rpc::optional<repair_checksum> hash_version, rpc::optional<uint64_t> repaired_at)>&& func);
     void unregister_repair_row_level_start();
-    future<> send_repair_row_level_start(msg_addr id, uint32_t repair_meta_id, sstring keyspace_name, sstring cf_name, dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size, uint64_t seed, unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version);
+    future<> send_repair_row_level_start(msg_addr id, uint32_t repair_meta_id, sstring keyspace_name, sstring cf_name, dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size, uint64_t seed, unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version, bool incremental, repair_checksum hash_version, uint64_t repaired_at);
 
     // Wrapper for REPAIR_ROW_LEVEL_STOP
     void register_repair_row_level_stop(std::function<future<> (const rpc::client_info& cinfo, uint32_t repair_meta_id, sstring keyspace_name, sstring cf_name, dht::token_range range)>&& func);
@@ -358,6 +409,11 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     void unregister_repair_get_diff_algorithms();
     future<std::vector<row_level_diff_detect_algorithm>> send_repair_get_diff_algorithms(msg_addr id);
 
+    // Wrapper for REPAIR_MARK_SSTABLES_REPAIRED
+    void register_repair_mark_sstables_repaired(std::function<future<> (const rpc::client_info& cinfo, sstring keyspace_name, std::vector<UUID> table_ids, dht::token_range_vector ranges, uint64_t repaired_at)>&& func);
+    void unregister_repair_mark_sstables_repaired();
+    future<> send_repair_mark_sstables_repaired(msg_addr id, sstring keyspace_name, std::vector<UUID> table_ids, dht::token_range_vector ranges, uint64_t repaired_at);
+
     // Wrapper for GOSSIP_ECHO verb
     void register_gossip_echo(std::function<future<> ()>&& func);
     void unregister_gossip_echo();
@@ -422,9 +478,11 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
 
     // Wrapper for READ_DATA
     // Note: WTH is future<foreign_ptr<lw_shared_ptr<query::result>>
-    void register_read_data(std::function<future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>> (const rpc::client_info&, rpc::opt_time_point timeout, query::read_command cmd, ::compat::wrapping_partition_range pr, rpc::optional<query::digest_algorithm> digest)>&& func);
+    // The trailing uint32_t of READ_DATA and READ_DIGEST responses is the
+    // replica's read queue length, used for adaptive replica selection.
+    void register_read_data(std::function<future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature, uint32_t>> (const rpc::client_info&, rpc::opt_time_point timeout, query::read_command cmd, ::compat::wrapping_partition_range pr, rpc::optional<query::digest_algorithm> digest)>&& func);
     void unregister_read_data();
-    future<rpc::tuple<query::result, rpc::optional<cache_temperature>>> send_read_data(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr, query::digest_algorithm da);
+    future<rpc::tuple<query::result, rpc::optional<cache_temperature>, rpc::optional<uint32_t>>> send_read_data(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr, query::digest_algorithm da);
 
     // Wrapper for GET_SCHEMA_VERSION
     void register_get_schema_version(std::function<future<frozen_schema>(unsigned, table_schema_version)>&& func);
@@ -441,10 +499,20 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     void unregister_read_mutation_data();
     future<rpc::tuple<reconcilable_result, rpc::optional<cache_temperature>>> send_read_mutation_data(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr);
 
+    // Wrapper for READ_ROW_HASHES
+    void register_read_row_hashes(std::function<future<partition_row_hashes> (const rpc::client_info&, rpc::opt_time_point timeout, query::read_command cmd, ::compat::wrapping_partition_range pr)>&& func);
+    void unregister_read_row_hashes();
+    future<partition_row_hashes> send_read_row_hashes(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr);
+
+    // Wrapper for AGGREGATE_QUERY
+    void register_aggregate_query(std::function<future<query::aggregate_result> (const rpc::client_info&, rpc::opt_time_point timeout, query::read_command cmd, dht::partition_range_vector pr, std::vector<query::aggregate_spec> aggregates)>&& func);
+    void unregister_aggregate_query();
+    future<query::aggregate_result> send_aggregate_query(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range_vector& pr, const std::vector<query::aggregate_spec>& aggregates);
+
     // Wrapper for READ_DIGEST
-    void register_read_digest(std::function<future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature>> (const rpc::client_info&, rpc::opt_time_point timeout, query::read_command cmd, ::compat::wrapping_partition_range pr, rpc::optional<query::digest_algorithm> digest)>&& func);
+    void register_read_digest(std::function<future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature, uint32_t>> (const rpc::client_info&, rpc::opt_time_point timeout, query::read_command cmd, ::compat::wrapping_partition_range pr, rpc::optional<query::digest_algorithm> digest)>&& func);
     void unregister_read_digest();
-    future<rpc::tuple<query::result_digest, rpc::optional<api::timestamp_type>, rpc::optional<cache_temperature>>> send_read_digest(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr, query::digest_algorithm da);
+    future<rpc::tuple<query::result_digest, rpc::optional<api::timestamp_type>, rpc::optional<cache_temperature>, rpc::optional<uint32_t>>> send_read_digest(msg_addr id, clock_type::time_point timeout, const query::read_command& cmd, const dht::partition_range& pr, query::digest_algorithm da);
 
     // Wrapper for TRUNCATE
     void register_truncate(std::function<future<>(sstring, sstring)>&& func);
@@ -458,7 +526,25 @@ class messaging_service : public seastar::async_sharded_service<messaging_servic
     void foreach_server_connection_stats(std::function<void(const rpc::client_info&, const rpc::stats&)>&& f) const;
 private:
     bool remove_rpc_client_one(clients_map& clients, msg_addr id, bool dead_only);
+    unsigned get_client_slot(unsigned idx, msg_addr id);
 public:
+    // Remembers how ep shards its data, so that requests for a token can be
+    // routed to the shard owning it.
+    void set_sharding_info(gms::inet_address ep, unsigned shard_count, unsigned sharding_ignore_msb);
+    void remove_sharding_info(gms::inet_address ep);
+    bool shard_aware_connections() const {
+        return _connection_config.shard_aware;
+    }
+    // Address of the shard of ep which owns t. Any shard unless shard-aware
+    // connections are enabled and ep's sharding is known.
+    msg_addr addr_for_token(gms::inet_address ep, const dht::token& t) const;
+    // Slot of the connection to the shard of a node with remote_shard_count
+    // shards which id resolves to. Slot 0, the connection to an arbitrary
+    // shard, if id does not resolve to a shard.
+    static unsigned shard_slot(msg_addr id, unsigned remote_shard_count);
+    // Source port of a connection to the given remote shard, out of those
+    // reserved for local_shard, for the given attempt at connecting to it.
+    static uint16_t source_port_for_shard(unsigned shard, unsigned shard_count, unsigned local_shard, unsigned local_shard_count, unsigned attempt);
     // Return rpc::protocol::client for a shard which is a ip + cpuid pair.
     shared_ptr<rpc_protocol_client_wrapper> get_rpc_client(messaging_verb verb, msg_addr id);
     void remove_error_rpc_client(messaging_verb verb, msg_addr id);
@@ -29,6 +29,11 @@ namespace netw {
 struct msg_addr {
     gms::inet_address addr;
     uint32_t cpu_id;
+    // Set when cpu_id is the remote shard the message should be handled on,
+    // so that it may be sent over a connection to that shard. Otherwise the
+    // message may be handled on any remote shard. Ignored by comparisons,
+    // like cpu_id.
+    bool shard_resolved = false;
     friend bool operator==(const msg_addr& x, const msg_addr& y);
     friend bool operator<(const msg_addr& x, const msg_addr& y);
     friend std::ostream& operator<<(std::ostream& os, const msg_addr& x);
@@ -37,6 +42,12 @@ struct msg_addr {
     };
     explicit msg_addr(gms::inet_address ip) : addr(ip), cpu_id(0) { }
     msg_addr(gms::inet_address ip, uint32_t cpu) : addr(ip), cpu_id(cpu) { }
+    // Address of the given remote shard of ip, see shard_resolved.
+    static msg_addr for_shard(gms::inet_address ip, uint32_t cpu) {
+        msg_addr a(ip, cpu);
+        a.shard_resolved = true;
+        return a;
+    }
 };
 
 }
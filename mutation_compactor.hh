@@ -23,6 +23,7 @@
 
 #include "compaction_garbage_collector.hh"
 #include "mutation_fragment.hh"
+#include "query_row_filter.hh"
 
 static inline bool has_ck_selector(const query::clustering_row_ranges& ranges) {
     // Like PK range, an empty row range, should be considered an "exclude all" restriction
@@ -155,6 +156,14 @@ class compact_mutation_state {
 
     std::optional<static_row> _last_static_row;
 
+    // Applied to the live clustering rows, when only those are emitted.
+    query::row_filter _filter;
+    // With a filter, the static row is held back until a clustering row of
+    // the partition satisfies it.
+    std::optional<static_row> _filtered_static_row;
+    // Rows rejected by the filter in the current page.
+    uint32_t _filtered_out_rows = 0;
+
     std::unique_ptr<mutation_compactor_garbage_collector> _collector;
 private:
     static constexpr bool only_live() {
@@ -164,6 +173,10 @@ class compact_mutation_state {
         return SSTableCompaction == compact_for_sstables::yes;
     }
 
+    bool short_reads_allowed() const {
+        return _slice.options.contains(query::partition_slice::option::allow_short_read);
+    }
+
     template <typename GCConsumer>
     void partition_is_not_empty_for_gc_consumer(GCConsumer& gc_consumer) {
         if (_empty_partition_in_gc_consumer) {
@@ -229,6 +242,7 @@ class compact_mutation_state {
         , _partition_row_limit(_slice.options.contains(query::partition_slice::option::distinct) ? 1 : slice.partition_row_limit())
         , _range_tombstones(s, _slice.options.contains(query::partition_slice::option::reversed))
         , _last_dk({dht::token(), partition_key::make_empty()})
+        , _filter(only_live() ? query::row_filter(s, slice.filter()) : query::row_filter())
     {
         static_assert(!sstable_compaction(), "This constructor cannot be used for sstable compaction.");
     }
@@ -261,6 +275,7 @@ class compact_mutation_state {
         _current_partition_limit = std::min(_row_limit, _partition_row_limit);
         _max_purgeable = api::missing_timestamp;
         _last_static_row.reset();
+        _filtered_static_row.reset();
     }
 
     template <typename Consumer, typename GCConsumer>
@@ -298,6 +313,10 @@ class compact_mutation_state {
             });
         }
         _static_row_live = is_live;
+        if (only_live() && is_live && _filter) {
+            _filtered_static_row = std::move(sr);
+            return stop_iteration::no;
+        }
         if (is_live || (!only_live() && !sr.empty())) {
             partition_is_not_empty(consumer);
             return consumer.consume(std::move(sr), current_tombstone, is_live);
@@ -343,7 +362,24 @@ class compact_mutation_state {
         }
 
         if (only_live() && is_live) {
+            // Rows rejected by the filter are dropped before being copied
+            // into the result, and don't count against the limits.
+            if (_filter && !_filter.matches(cr.cells())) {
+                if (++_filtered_out_rows < query::max_filtered_out_rows_per_page || !short_reads_allowed()) {
+                    return stop_iteration::no;
+                }
+                // End the page with this row, so that the next page continues
+                // after it instead of skipping the same rows again. The
+                // coordinator applies the restrictions too, and drops it.
+                partition_is_not_empty(consumer);
+                consumer.consume(std::move(cr), t, true);
+                ++_rows_in_current_partition;
+                return stop_iteration::yes;
+            }
             partition_is_not_empty(consumer);
+            if (_filtered_static_row) {
+                consumer.consume(*std::exchange(_filtered_static_row, {}), _range_tombstones.get_partition_tombstone(), true);
+            }
             auto stop = consumer.consume(std::move(cr), t, true);
             if (++_rows_in_current_partition == _current_partition_limit) {
                 return stop_iteration::yes;
@@ -393,7 +429,8 @@ class compact_mutation_state {
         if (!_empty_partition) {
             // #589 - Do not add extra row for statics unless we did a CK range-less query.
             // See comment in query
-            if (_rows_in_current_partition == 0 && _static_row_live && !_has_ck_selector) {
+            // Such a row has no regular cells, so it can't satisfy a filter.
+            if (_rows_in_current_partition == 0 && _static_row_live && !_has_ck_selector && !_filter) {
                 ++_rows_in_current_partition;
             }
 
@@ -401,7 +438,7 @@ class compact_mutation_state {
             _partition_limit -= _rows_in_current_partition > 0;
             auto stop = consumer.consume_end_of_partition();
             if (!sstable_compaction()) {
-                return _row_limit && _partition_limit && stop != stop_iteration::yes
+                return _row_limit && _partition_limit && stop != stop_iteration::yes && !is_filtered_out_rows_limit_reached()
                        ? stop_iteration::no : stop_iteration::yes;
             }
         }
@@ -445,6 +482,8 @@ class compact_mutation_state {
             Consumer& consumer) {
         _empty_partition = true;
         _static_row_live = false;
+        _filtered_static_row.reset();
+        _filtered_out_rows = 0;
         _row_limit = row_limit;
         _partition_limit = partition_limit;
         _rows_in_current_partition = 0;
@@ -464,6 +503,12 @@ class compact_mutation_state {
         return _row_limit == 0 || _partition_limit == 0;
     }
 
+    /// Whether the page was ended because the filter rejected too many rows,
+    /// see query::max_filtered_out_rows_per_page. The page is then a short read.
+    bool is_filtered_out_rows_limit_reached() const {
+        return _filtered_out_rows >= query::max_filtered_out_rows_per_page && short_reads_allowed();
+    }
+
     /// Detach the internal state of the compactor
     ///
     /// The state is represented by the last seen partition header, static row
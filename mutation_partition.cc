@@ -2129,6 +2129,9 @@ future<> data_query(
         auto qrb = query_result_builder(*s, builder);
         return q.consume_page(std::move(qrb), row_limit, partition_limit, query_time, timeout).then(
                 [=, &builder, &q, trace_ptr = std::move(trace_ptr), cache_ctx = std::move(cache_ctx)] () mutable {
+            if (q.is_filtered_out_rows_limit_reached()) {
+                builder.mark_as_short_read();
+            }
             if (q.are_limits_reached() || builder.is_short_read()) {
                 cache_ctx.insert(std::move(q), std::move(trace_ptr));
             }
@@ -168,6 +168,10 @@ class querier {
         return  _compaction_state->are_limits_reached();
     }
 
+    bool is_filtered_out_rows_limit_reached() const {
+        return _compaction_state->is_filtered_out_rows_limit_reached();
+    }
+
     template <typename Consumer>
     GCC6_CONCEPT(
         requires CompactedFragmentsConsumer<Consumer>
@@ -118,6 +118,19 @@ class specific_ranges {
 
 constexpr auto max_rows = std::numeric_limits<uint32_t>::max();
 
+// A restriction of a regular column of a filtering query, which replicas
+// can apply to the rows they read before adding them to the result. The
+// coordinator still applies all the restrictions of the query.
+struct column_predicate {
+    enum class comparison : uint8_t { eq, lt, lte, gt, gte, in };
+    bytes column_name;
+    comparison op;
+    // A single value, except for `in`.
+    std::vector<bytes> values;
+};
+
+std::ostream& operator<<(std::ostream& out, const column_predicate& p);
+
 // Specifies subset of rows, columns and cell attributes to be returned in a query.
 // Can be accessed across cores.
 // Schema-dependent.
@@ -146,12 +159,14 @@ class partition_slice {
     std::unique_ptr<specific_ranges> _specific_ranges;
     cql_serialization_format _cql_format;
     uint32_t _partition_row_limit;
+    std::vector<column_predicate> _filter;
 public:
     partition_slice(clustering_row_ranges row_ranges, column_id_vector static_columns,
         column_id_vector regular_columns, option_set options,
         std::unique_ptr<specific_ranges> specific_ranges = nullptr,
         cql_serialization_format = cql_serialization_format::internal(),
-        uint32_t partition_row_limit = max_rows);
+        uint32_t partition_row_limit = max_rows,
+        std::vector<column_predicate> filter = {});
     partition_slice(const partition_slice&);
     partition_slice(partition_slice&&);
     ~partition_slice();
@@ -182,6 +197,14 @@ class partition_slice {
     void set_partition_row_limit(uint32_t limit) {
         _partition_row_limit = limit;
     }
+    // Predicates which all clustering rows returned by data queries satisfy.
+    // Mutation queries, which are used to reconcile replicas, ignore them.
+    const std::vector<column_predicate>& filter() const {
+        return _filter;
+    }
+    void set_filter(std::vector<column_predicate> filter) {
+        _filter = std::move(filter);
+    }
 
     friend std::ostream& operator<<(std::ostream& out, const partition_slice& ps);
     friend std::ostream& operator<<(std::ostream& out, const specific_ranges& ps);
@@ -241,4 +264,18 @@ class read_command {
     friend std::ostream& operator<<(std::ostream& out, const read_command& r);
 };
 
+// An aggregate computed by the replicas on behalf of the coordinator.
+// Identifies a native aggregate function and the column it is applied
+// to, which is disengaged for COUNT(*).
+struct aggregate_spec {
+    sstring function_name;
+    std::optional<bytes> column_name;
+};
+
+// Partial states of the aggregates of a query, one for each aggregate_spec,
+// as returned by cql3::functions::aggregate_function::aggregate::get_state().
+struct aggregate_result {
+    std::vector<bytes_opt> states;
+};
+
 }
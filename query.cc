@@ -54,9 +54,17 @@ std::ostream& operator<<(std::ostream& out, const partition_slice& ps) {
     out << ", options=" << format("{:x}", ps.options.mask()); // FIXME: pretty print options
     out << ", cql_format=" << ps.cql_format();
     out << ", partition_row_limit=" << ps._partition_row_limit;
+    if (!ps._filter.empty()) {
+        out << ", filter=[" << join(", ", ps._filter) << "]";
+    }
     return out << "}";
 }
 
+std::ostream& operator<<(std::ostream& out, const column_predicate& p) {
+    static const char* const ops[] = { "=", "<", "<=", ">", ">=", "IN" };
+    return out << "{" << p.column_name << " " << ops[static_cast<uint8_t>(p.op)] << " [" << join(", ", p.values) << "]}";
+}
+
 std::ostream& operator<<(std::ostream& out, const read_command& r) {
     return out << "read_command{"
         << "cf_id=" << r.cf_id
@@ -115,7 +123,8 @@ partition_slice::partition_slice(clustering_row_ranges row_ranges,
     option_set options,
     std::unique_ptr<specific_ranges> specific_ranges,
     cql_serialization_format cql_format,
-    uint32_t partition_row_limit)
+    uint32_t partition_row_limit,
+    std::vector<column_predicate> filter)
     : _row_ranges(std::move(row_ranges))
     , static_columns(std::move(static_columns))
     , regular_columns(std::move(regular_columns))
@@ -123,6 +132,7 @@ partition_slice::partition_slice(clustering_row_ranges row_ranges,
     , _specific_ranges(std::move(specific_ranges))
     , _cql_format(std::move(cql_format))
     , _partition_row_limit(partition_row_limit)
+    , _filter(std::move(filter))
 {}
 
 partition_slice::partition_slice(partition_slice&&) = default;
@@ -139,6 +149,7 @@ partition_slice::partition_slice(const partition_slice& s)
     , _specific_ranges(s._specific_ranges ? std::make_unique<specific_ranges>(*s._specific_ranges) : nullptr)
     , _cql_format(s._cql_format)
     , _partition_row_limit(s._partition_row_limit)
+    , _filter(s._filter)
 {}
 
 partition_slice::~partition_slice()
@@ -275,7 +286,9 @@ foreign_ptr<lw_shared_ptr<query::result>> result_merger::get() {
         });
         if (r->is_short_read()) {
             is_short_read = short_read::yes;
-            break;
+            if (!_merge_after_short_read) {
+                break;
+            }
         }
         if (row_count >= _max_rows || partition_count >= _max_partitions) {
             break;
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <seastar/core/distributed.hh>
+#include <seastar/util/bool_class.hh>
 #include "query-result.hh"
 
 namespace query {
@@ -29,13 +30,21 @@ namespace query {
 // Merges non-overlapping results into one
 // Implements @Reducer concept from distributed.hh
 class result_merger {
+public:
+    // Results following a short read are normally dropped, as the rows they
+    // contain come after the ones the short read is missing. Results of
+    // ranges whose progress is tracked separately can be merged regardless.
+    using merge_after_short_read = bool_class<class merge_after_short_read_tag>;
+private:
     std::vector<foreign_ptr<lw_shared_ptr<query::result>>> _partial;
     const uint32_t _max_rows;
     const uint32_t _max_partitions;
+    const merge_after_short_read _merge_after_short_read;
 public:
-    explicit result_merger(uint32_t max_rows, uint32_t max_partitions)
+    explicit result_merger(uint32_t max_rows, uint32_t max_partitions, merge_after_short_read masr = merge_after_short_read::no)
             : _max_rows(max_rows)
             , _max_partitions(max_partitions)
+            , _merge_after_short_read(masr)
     { }
 
     void reserve(size_t size) {
@@ -43,7 +52,7 @@ class result_merger {
     }
 
     void operator()(foreign_ptr<lw_shared_ptr<query::result>> r) {
-        if (!_partial.empty() && _partial.back()->is_short_read()) {
+        if (!_merge_after_short_read && !_partial.empty() && _partial.back()->is_short_read()) {
             return;
         }
         _partial.emplace_back(std::move(r));
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "query_row_filter.hh"
+#include "mutation_partition.hh"
+
+namespace query {
+
+row_filter::row_filter(const schema& s, const std::vector<column_predicate>& predicates) {
+    for (auto& p : predicates) {
+        auto cdef = s.get_column_definition(p.column_name);
+        if (!cdef || !cdef->is_regular() || !cdef->is_atomic() || cdef->is_counter() || p.values.empty()) {
+            continue;
+        }
+        _predicates.push_back(predicate{cdef, p.op, p.values});
+    }
+}
+
+static bool satisfies(const abstract_type& type, column_predicate::comparison op, const std::vector<bytes>& values, bytes_view v) {
+    using comparison = column_predicate::comparison;
+    switch (op) {
+    case comparison::eq:
+        return type.compare(values.front(), v) == 0;
+    case comparison::lt:
+        return type.compare(v, values.front()) < 0;
+    case comparison::lte:
+        return type.compare(v, values.front()) <= 0;
+    case comparison::gt:
+        return type.compare(v, values.front()) > 0;
+    case comparison::gte:
+        return type.compare(v, values.front()) >= 0;
+    case comparison::in:
+        return std::any_of(values.begin(), values.end(), [&] (const bytes& value) {
+            return type.compare(value, v) == 0;
+        });
+    }
+    return false;
+}
+
+static bool may_satisfy(const abstract_type& type, column_predicate::comparison op, const std::vector<bytes>& values, const row_filter::value_range& range) {
+    using comparison = column_predicate::comparison;
+    auto in_range = [&] (const bytes& value) {
+        return type.compare(range.min, value) <= 0 && type.compare(value, range.max) <= 0;
+    };
+    switch (op) {
+    case comparison::eq:
+        return in_range(values.front());
+    case comparison::lt:
+        return type.compare(range.min, values.front()) < 0;
+    case comparison::lte:
+        return type.compare(range.min, values.front()) <= 0;
+    case comparison::gt:
+        return type.compare(range.max, values.front()) > 0;
+    case comparison::gte:
+        return type.compare(range.max, values.front()) >= 0;
+    case comparison::in:
+        return std::any_of(values.begin(), values.end(), in_range);
+    }
+    return true;
+}
+
+bool row_filter::may_match(const std::function<std::optional<value_range>(const column_definition&)>& get_range) const {
+    return std::all_of(_predicates.begin(), _predicates.end(), [&get_range] (const predicate& p) {
+        auto range = get_range(*p.column);
+        return !range || may_satisfy(*p.column->type, p.op, p.values, *range);
+    });
+}
+
+bool row_filter::matches(const row& cells) const {
+    return std::all_of(_predicates.begin(), _predicates.end(), [&cells] (const predicate& p) {
+        auto cell = cells.find_cell(p.column->id);
+        if (!cell) {
+            return false;
+        }
+        auto c = cell->as_atomic_cell(*p.column);
+        if (!c.is_live()) {
+            return false;
+        }
+        return c.value().with_linearized([&] (bytes_view v) {
+            return satisfies(*p.column->type, p.op, p.values, v);
+        });
+    });
+}
+
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <optional>
+
+#include "query-request.hh"
+#include "schema.hh"
+
+class row;
+
+namespace query {
+
+/// The number of rows the filter of a query may reject in a page before the
+/// page is ended as a short read. Rejected rows count against no other limit,
+/// so a selective filter could otherwise scan any amount of data per page.
+constexpr uint32_t max_filtered_out_rows_per_page = 10000;
+
+/// The column predicates of a partition_slice, resolved against a schema so
+/// that they can be checked against the cells of every row read.
+class row_filter {
+    struct predicate {
+        const column_definition* column;
+        column_predicate::comparison op;
+        std::vector<bytes> values;
+    };
+    std::vector<predicate> _predicates;
+public:
+    row_filter() = default;
+    /// Predicates on columns which are not regular, atomic and non-counter
+    /// columns of `s`, e.g. because the column was dropped, are ignored.
+    row_filter(const schema& s, const std::vector<column_predicate>& predicates);
+
+    explicit operator bool() const {
+        return !_predicates.empty();
+    }
+
+    /// Whether the cells of a compacted clustering row satisfy all the
+    /// predicates. A missing cell doesn't satisfy any.
+    bool matches(const row& cells) const;
+
+    /// The smallest and the largest live value of a column in some set of
+    /// rows, e.g. those of an sstable.
+    struct value_range {
+        bytes_view min;
+        bytes_view max;
+    };
+
+    /// Whether a row of a set of rows could satisfy all the predicates,
+    /// given the range of the live values of the columns in that set.
+    /// `get_range` returns a disengaged optional for columns whose range is
+    /// unknown.
+    bool may_match(const std::function<std::optional<value_range>(const column_definition&)>& get_range) const;
+};
+
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repair/hash_ibf.hh"
+
+#include <seastar/core/print.hh>
+
+// The finalizer of splitmix64.
+static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t check_hash(uint64_t key) {
+    return mix(key ^ 0x6a09e667f3bcc908ULL);
+}
+
+size_t repair_hash_ibf::cells_for_differences(size_t expected_differences) {
+    // Decoding with 3 hash functions succeeds with high probability once
+    // there are more than about 1.23 cells per difference; small tables need
+    // some more room.
+    return expected_differences * 3 / 2 + 33;
+}
+
+repair_hash_ibf::repair_hash_ibf(size_t nr_cells)
+    : _cells(std::max<size_t>((nr_cells + nr_hash_functions - 1) / nr_hash_functions, 1) * nr_hash_functions) {
+}
+
+repair_hash_ibf::repair_hash_ibf(std::vector<repair_hash_ibf_cell> cells)
+    : _cells(std::move(cells)) {
+    if (_cells.empty() || _cells.size() % nr_hash_functions) {
+        throw std::runtime_error(format("Invalid number of cells in a row hash IBF: {}", _cells.size()));
+    }
+}
+
+size_t repair_hash_ibf::cell_index(uint64_t key, unsigned i) const {
+    auto slice = slice_size();
+    return i * slice + mix(key + i * 0x9e3779b97f4a7c15ULL) % slice;
+}
+
+void repair_hash_ibf::update(uint64_t key, int32_t count) {
+    auto check = check_hash(key);
+    for (unsigned i = 0; i < nr_hash_functions; ++i) {
+        auto& c = _cells[cell_index(key, i)];
+        c.count += count;
+        c.key_sum ^= key;
+        c.check_sum ^= check;
+    }
+}
+
+bool repair_hash_ibf::is_pure(const repair_hash_ibf_cell& c) const {
+    return (c.count == 1 || c.count == -1) && c.check_sum == check_hash(c.key_sum);
+}
+
+void repair_hash_ibf::subtract(const repair_hash_ibf& o) {
+    if (o._cells.size() != _cells.size()) {
+        throw std::runtime_error(format("Can not subtract a row hash IBF of {} cells from one of {} cells", o._cells.size(), _cells.size()));
+    }
+    for (size_t i = 0; i < _cells.size(); ++i) {
+        _cells[i].count -= o._cells[i].count;
+        _cells[i].key_sum ^= o._cells[i].key_sum;
+        _cells[i].check_sum ^= o._cells[i].check_sum;
+    }
+}
+
+std::optional<repair_hash_ibf::set_difference> repair_hash_ibf::decode() {
+    set_difference diff;
+    std::vector<size_t> pure;
+    for (size_t i = 0; i < _cells.size(); ++i) {
+        if (is_pure(_cells[i])) {
+            pure.push_back(i);
+        }
+    }
+    while (!pure.empty()) {
+        auto& c = _cells[pure.back()];
+        pure.pop_back();
+        // The cell may have been peeled already through another one.
+        if (!is_pure(c)) {
+            continue;
+        }
+        auto key = c.key_sum;
+        auto count = c.count;
+        auto& set = count > 0 ? diff.only_local : diff.only_remote;
+        if (!set.emplace(key)) {
+            // A hash can only be listed once, the table is inconsistent.
+            return std::nullopt;
+        }
+        update(key, -count);
+        for (unsigned i = 0; i < nr_hash_functions; ++i) {
+            auto idx = cell_index(key, i);
+            if (is_pure(_cells[idx])) {
+                pure.push_back(idx);
+            }
+        }
+    }
+    for (auto& c : _cells) {
+        if (c.count || c.key_sum || c.check_sum) {
+            return std::nullopt;
+        }
+    }
+    return diff;
+}
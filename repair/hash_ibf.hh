@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "repair/hash_set.hh"
+
+struct repair_hash_ibf_cell {
+    int32_t count = 0;
+    uint64_t key_sum = 0;
+    uint64_t check_sum = 0;
+};
+
+// An invertible Bloom lookup table of row hashes.
+//
+// Each hash is added to one cell in each of `nr_hash_functions` disjoint
+// slices of the table. Subtracting the table of one set from the table of
+// another leaves only the hashes present in one of the sets, which can be
+// listed as long as there are not many more of them than about 2/3 of the
+// number of cells. This allows two nodes to find the difference between
+// their row hash sets by exchanging data proportional to the size of the
+// difference rather than to the size of the sets.
+//
+// The row hashes are already seeded with a per repair random seed, so they
+// are used to pick the cells directly.
+class repair_hash_ibf {
+public:
+    static constexpr unsigned nr_hash_functions = 3;
+
+    struct set_difference {
+        // Hashes present only in the table subtract() was called on.
+        repair_hash_set only_local;
+        // Hashes present only in the subtracted table.
+        repair_hash_set only_remote;
+    };
+private:
+    std::vector<repair_hash_ibf_cell> _cells;
+private:
+    size_t slice_size() const {
+        return _cells.size() / nr_hash_functions;
+    }
+    size_t cell_index(uint64_t key, unsigned hash_function) const;
+    void update(uint64_t key, int32_t count);
+    bool is_pure(const repair_hash_ibf_cell& c) const;
+public:
+    // The number of cells a table needs to decode about `expected_differences`
+    // differences.
+    static size_t cells_for_differences(size_t expected_differences);
+
+    // Creates an empty table with at least `nr_cells` cells.
+    explicit repair_hash_ibf(size_t nr_cells);
+
+    explicit repair_hash_ibf(std::vector<repair_hash_ibf_cell> cells);
+
+    const std::vector<repair_hash_ibf_cell>& cells() const {
+        return _cells;
+    }
+
+    size_t size() const {
+        return _cells.size();
+    }
+
+    // The hashes must be distinct.
+    void add(repair_hash h) {
+        update(h.hash, 1);
+    }
+
+    void remove(repair_hash h) {
+        update(h.hash, -1);
+    }
+
+    // Throws if the tables have different sizes.
+    void subtract(const repair_hash_ibf& o);
+
+    // Lists the hashes left in a table after subtract(). Returns a disengaged
+    // optional if the difference is too large to be decoded with this table.
+    // Destroys the contents of the table.
+    std::optional<set_difference> decode();
+};
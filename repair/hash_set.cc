@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repair/hash_set.hh"
+
+#include <algorithm>
+#include <array>
+
+#include <seastar/core/bitops.hh>
+
+size_t repair_hash_set::capacity_for(size_t size) {
+    size_t nr_slots = min_capacity;
+    while (nr_slots / 4 * 3 < size) {
+        nr_slots *= 2;
+    }
+    return nr_slots;
+}
+
+void repair_hash_set::rehash(size_t nr_slots) {
+    std::vector<repair_hash> old_slots(nr_slots);
+    std::swap(_slots, old_slots);
+    _shift = 64 - log2ceil(nr_slots);
+    for (auto& h : old_slots) {
+        if (h.hash) {
+            _slots[find_slot(h.hash, home_slot(h.hash))] = h;
+        }
+    }
+}
+
+void repair_hash_set::clear() {
+    std::fill(_slots.begin(), _slots.end(), repair_hash());
+    _size = 0;
+    _has_zero = false;
+}
+
+size_t repair_hash_set::erase(repair_hash h) {
+    if (!h.hash) {
+        auto erased = _has_zero;
+        _has_zero = false;
+        _size -= erased;
+        return erased;
+    }
+    if (_slots.empty()) {
+        return 0;
+    }
+    auto i = find_slot(h.hash, home_slot(h.hash));
+    if (!_slots[i].hash) {
+        return 0;
+    }
+    // Move back the following hashes of the probe sequence which would not
+    // be found past the hole, so that no tombstones are needed.
+    for (auto j = next_slot(i); _slots[j].hash; j = next_slot(j)) {
+        auto k = home_slot(_slots[j].hash);
+        bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+        if (!stays) {
+            _slots[i] = _slots[j];
+            i = j;
+        }
+    }
+    _slots[i] = repair_hash();
+    --_size;
+    return 1;
+}
+
+void repair_hash_set::difference(const repair_hash_set& o, size_t start, size_t end, repair_hash_set& out) const {
+    if (start == 0 && _has_zero && !o._has_zero) {
+        out.insert(repair_hash());
+    }
+    if (o._slots.empty()) {
+        for (auto i = start; i < end; ++i) {
+            if (_slots[i].hash) {
+                out.insert(_slots[i]);
+            }
+        }
+        return;
+    }
+    constexpr size_t batch_size = 16;
+    std::array<size_t, batch_size> homes;
+    for (auto i = start; i < end; i += batch_size) {
+        auto n = std::min(batch_size, end - i);
+        auto hashes = &_slots[i];
+        for (size_t j = 0; j < n; ++j) {
+            homes[j] = o.home_slot(hashes[j].hash);
+        }
+        for (size_t j = 0; j < n; ++j) {
+            if (hashes[j].hash) {
+                __builtin_prefetch(&o._slots[homes[j]]);
+            }
+        }
+        for (size_t j = 0; j < n; ++j) {
+            auto h = hashes[j].hash;
+            if (h && !o._slots[o.find_slot(h, homes[j])].hash) {
+                out.insert(hashes[j]);
+            }
+        }
+    }
+}
+
+bool repair_hash_set::operator==(const repair_hash_set& o) const {
+    return _size == o._size && std::all_of(begin(), end(), [&o] (const repair_hash& h) {
+        return o.contains(h);
+    });
+}
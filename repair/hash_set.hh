@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "repair/repair.hh"
+
+// A set of row hashes kept in a single open addressing table with linear
+// probing.
+//
+// Row level repair keeps the hashes of all the rows in the working row
+// buffer, for itself and for each of the peers, which can be millions of
+// them. Unlike std::unordered_set, which allocates a node per hash and
+// follows at least one pointer per lookup, this set stores the hashes
+// themselves in the table, so filling it takes a few allocations and a
+// lookup usually touches a single cache line.
+//
+// Since a zero hash marks an empty slot, a zero row hash, should it ever
+// occur, is tracked on the side.
+class repair_hash_set {
+public:
+    class const_iterator {
+        const repair_hash* _pos = nullptr;
+        const repair_hash* _end = nullptr;
+        bool _at_zero = false;
+    private:
+        friend class repair_hash_set;
+        const_iterator(const repair_hash* pos, const repair_hash* end, bool at_zero)
+            : _pos(pos), _end(end), _at_zero(at_zero) {
+            if (!_at_zero) {
+                skip_empty();
+            }
+        }
+        void skip_empty() {
+            while (_pos != _end && !_pos->hash) {
+                ++_pos;
+            }
+        }
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = repair_hash;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const repair_hash*;
+        using reference = const repair_hash&;
+
+        const_iterator() = default;
+
+        reference operator*() const {
+            return _at_zero ? zero_hash : *_pos;
+        }
+        pointer operator->() const {
+            return &**this;
+        }
+        const_iterator& operator++() {
+            if (_at_zero) {
+                _at_zero = false;
+            } else {
+                ++_pos;
+            }
+            skip_empty();
+            return *this;
+        }
+        const_iterator operator++(int) {
+            auto it = *this;
+            ++*this;
+            return it;
+        }
+        bool operator==(const const_iterator& o) const {
+            return _pos == o._pos && _at_zero == o._at_zero;
+        }
+        bool operator!=(const const_iterator& o) const {
+            return !(*this == o);
+        }
+    };
+    using iterator = const_iterator;
+    using value_type = repair_hash;
+private:
+    static inline const repair_hash zero_hash{};
+    static constexpr size_t min_capacity = 16;
+
+    // Either empty or a power of two in size.
+    std::vector<repair_hash> _slots;
+    // 64 - log2(_slots.size())
+    unsigned _shift = 64;
+    // Includes the zero hash.
+    size_t _size = 0;
+    bool _has_zero = false;
+private:
+    // The table is kept at most 3/4 full.
+    static size_t capacity_for(size_t size);
+    size_t home_slot(uint64_t h) const {
+        // Fibonacci hashing, so that hashes which differ only in their
+        // high bits do not collide.
+        return (h * 0x9e3779b97f4a7c15ULL) >> _shift;
+    }
+    size_t next_slot(size_t i) const {
+        return (i + 1) & (_slots.size() - 1);
+    }
+    // Returns the slot holding h, or the empty slot where it would go.
+    // The table must not be empty.
+    size_t find_slot(uint64_t h, size_t i) const {
+        while (_slots[i].hash && _slots[i].hash != h) {
+            i = next_slot(i);
+        }
+        return i;
+    }
+    void rehash(size_t nr_slots);
+public:
+    repair_hash_set() = default;
+
+    explicit repair_hash_set(size_t expected_size) {
+        reserve(expected_size);
+    }
+
+    template <typename InputIterator>
+    repair_hash_set(InputIterator first, InputIterator last) {
+        insert(first, last);
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return !_size;
+    }
+
+    // Makes room for `size` hashes without further allocations.
+    void reserve(size_t size) {
+        auto nr_slots = capacity_for(size);
+        if (nr_slots > _slots.size()) {
+            rehash(nr_slots);
+        }
+    }
+
+    // Removes all the hashes but keeps the memory.
+    void clear();
+
+    // Returns false if the set already contains h.
+    bool insert(repair_hash h) {
+        if (!h.hash) {
+            auto inserted = !_has_zero;
+            _has_zero = true;
+            _size += inserted;
+            return inserted;
+        }
+        reserve(_size + 1);
+        auto i = find_slot(h.hash, home_slot(h.hash));
+        if (_slots[i].hash) {
+            return false;
+        }
+        _slots[i] = h;
+        ++_size;
+        return true;
+    }
+
+    template <typename... Args>
+    bool emplace(Args&&... args) {
+        return insert(repair_hash(std::forward<Args>(args)...));
+    }
+
+    template <typename InputIterator>
+    void insert(InputIterator first, InputIterator last) {
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIterator>::iterator_category>) {
+            reserve(_size + std::distance(first, last));
+        }
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    size_t erase(repair_hash h);
+
+    bool contains(repair_hash h) const {
+        if (!h.hash) {
+            return _has_zero;
+        }
+        return !_slots.empty() && _slots[find_slot(h.hash, home_slot(h.hash))].hash;
+    }
+
+    size_t count(repair_hash h) const {
+        return contains(h);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(_slots.data(), _slots.data() + _slots.size(), _has_zero);
+    }
+
+    const_iterator end() const {
+        auto end = _slots.data() + _slots.size();
+        return const_iterator(end, end, false);
+    }
+
+    // The number of slots of the table, see difference().
+    size_t slot_count() const {
+        return _slots.size();
+    }
+
+    // Inserts into `out` the hashes held in the slots [start, end) of this
+    // set which `o` does not contain, and the zero hash if start is 0.
+    // Looking at a range of slots at a time allows a large difference to be
+    // computed in pieces, with preemption points in between.
+    //
+    // The lookups into `o` are made in batches whose slots are prefetched
+    // first, so that the cache misses of a batch overlap.
+    void difference(const repair_hash_set& o, size_t start, size_t end, repair_hash_set& out) const;
+
+    // Returns the hashes of this set which `o` does not contain.
+    repair_hash_set difference(const repair_hash_set& o) const {
+        repair_hash_set out;
+        difference(o, 0, slot_count(), out);
+        return out;
+    }
+
+    bool operator==(const repair_hash_set& o) const;
+
+    bool operator!=(const repair_hash_set& o) const {
+        return !(*this == o);
+    }
+};
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "repair/hash_set.hh"
+#include "serializer.hh"
+
+namespace ser {
+
+// repair_hash_set replaced std::unordered_set<repair_hash> in the repair
+// verbs, so it is serialized the same way.
+template<>
+struct serializer<repair_hash_set> {
+    template<typename Input>
+    static repair_hash_set read(Input& in) {
+        auto sz = deserialize(in, boost::type<uint32_t>());
+        repair_hash_set v(sz);
+        while (sz--) {
+            v.insert(deserialize(in, boost::type<repair_hash>()));
+        }
+        return v;
+    }
+    template<typename Output>
+    static void write(Output& out, const repair_hash_set& v) {
+        safe_serialize_as_uint32(out, v.size());
+        for (auto& h : v) {
+            serialize(out, h);
+        }
+    }
+    template<typename Input>
+    static void skip(Input& in) {
+        auto sz = deserialize(in, boost::type<uint32_t>());
+        while (sz--) {
+            ser::skip(in, boost::type<repair_hash>());
+        }
+    }
+};
+
+}
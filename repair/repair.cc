@@ -71,6 +71,8 @@ std::ostream& operator<<(std::ostream& out, row_level_diff_detect_algorithm algo
         return out << "send_full_set";
     case row_level_diff_detect_algorithm::send_full_set_rpc_stream:
         return out << "send_full_set_rpc_stream";
+    case row_level_diff_detect_algorithm::send_ibf_rpc_stream:
+        return out << "send_ibf_rpc_stream";
     };
     return out << "unknown";
 }
@@ -631,7 +633,10 @@ repair_info::repair_info(seastar::sharded<database>& db_,
     const std::vector<sstring>& cfs_,
     int id_,
     const std::vector<sstring>& data_centers_,
-    const std::vector<sstring>& hosts_)
+    const std::vector<sstring>& hosts_,
+    bool incremental_,
+    bool mark_repaired_,
+    uint64_t repaired_at_)
     : db(db_)
     , keyspace(keyspace_)
     , ranges(ranges_)
@@ -640,7 +645,35 @@ repair_info::repair_info(seastar::sharded<database>& db_,
     , shard(engine().cpu_id())
     , data_centers(data_centers_)
     , hosts(hosts_)
-    , _row_level_repair(service::get_local_storage_service().cluster_supports_row_level_repair()) {
+    , _row_level_repair(service::get_local_storage_service().cluster_supports_row_level_repair())
+    , incremental(incremental_)
+    , mark_repaired(mark_repaired_)
+    , repaired_at(repaired_at_) {
+    if (mark_repaired) {
+        for (auto& cf : cfs) {
+            auto& t = db.local().find_column_family(keyspace, cf);
+            auto& generations = unrepaired_generations[t.schema()->id()];
+            for (auto& sst : *t.get_sstables()) {
+                if (!sst->is_repaired() && !sst->is_shared()) {
+                    generations.insert(sst->generation());
+                }
+            }
+        }
+    }
+}
+
+future<> repair_info::mark_sstables_repaired() {
+    return parallel_for_each(unrepaired_generations, [this] (auto& x) {
+        auto& generations = x.second;
+        try {
+            auto& t = db.local().find_column_family(x.first);
+            rlogger.info("repair id {} on shard {}: marking {} sstables of {}.{} as repaired", id, shard, generations.size(), keyspace, t.schema()->cf_name());
+            return t.mark_sstables_repaired(std::move(generations), repaired_at);
+        } catch (no_such_column_family&) {
+            // The table was dropped during the repair.
+            return make_ready_future<>();
+        }
+    });
 }
 
 future<> repair_info::do_streaming() {
@@ -1100,6 +1133,9 @@ struct repair_options {
     // The node starting the repair must be in the data center; Issuing a
     // repair to a data center other than the named one returns an error.
     std::vector<sstring> data_centers;
+    // If incremental is true, only the data which was not repaired yet is
+    // read and compared, see repair_info::incremental.
+    bool incremental = false;
 
     repair_options(std::unordered_map<sstring, sstring> options) {
         bool_opt(primary_range, options, PRIMARY_RANGE_KEY);
@@ -1107,14 +1143,7 @@ struct repair_options {
         list_opt(column_families, options, COLUMNFAMILIES_KEY);
         list_opt(hosts, options, HOSTS_KEY);
         list_opt(data_centers, options, DATACENTERS_KEY);
-        // We currently do not support incremental repair. We could probably
-        // ignore this option as it is just an optimization, but for now,
-        // let's make it an error.
-        bool incremental = false;
         bool_opt(incremental, options, INCREMENTAL_KEY);
-        if (incremental) {
-            throw std::runtime_error("unsupported incremental repair");
-        }
         // We do not currently support the distinction between "parallel" and
         // "sequential" repair, and operate the same for both.
         // We don't currently support "dc parallel" parallelism.
@@ -1297,8 +1326,8 @@ static future<> repair_ranges(lw_shared_ptr<repair_info> ri) {
     repair_tracker().add_repair_info(ri->id, ri);
     return do_repair_ranges(ri).then([ri] {
         ri->check_failed_ranges();
+    }).then([ri] {
         repair_tracker().remove_repair_info(ri->id);
-        return make_ready_future<>();
     }).handle_exception([ri] (std::exception_ptr eptr) {
         rlogger.info("repair id {} failed - {}", ri->id, eptr);
         repair_tracker().remove_repair_info(ri->id);
@@ -1306,6 +1335,151 @@ static future<> repair_ranges(lw_shared_ptr<repair_info> ri) {
     });
 }
 
+// Merges the ranges which overlap or are adjacent, so that an sstable
+// spanning several of them is seen to be covered.
+static dht::token_range_vector merge_ranges(dht::token_range_vector ranges) {
+    dht::token_range_vector merged;
+    for (auto& r : dht::token_range::deoverlap(std::move(ranges), dht::token_comparator())) {
+        if (!merged.empty() && merged.back().end() && r.start() && merged.back().end()->value() == r.start()->value()
+                && (merged.back().end()->is_inclusive() || r.start()->is_inclusive())) {
+            merged.back() = dht::token_range(merged.back().start(), r.end());
+        } else {
+            merged.push_back(std::move(r));
+        }
+    }
+    return merged;
+}
+
+// The generations of the unrepaired sstables recorded on this shard for the
+// incremental repairs run by other nodes, by repair master and start time of
+// the repair on the master, then by table id.
+using recorded_generations = std::unordered_map<utils::UUID, std::unordered_set<int64_t>>;
+static thread_local std::map<std::pair<gms::inet_address, uint64_t>, recorded_generations> follower_unrepaired_generations;
+
+future<> repair_record_unrepaired_sstables(seastar::sharded<database>& db, gms::inet_address master,
+        sstring keyspace, sstring cf, uint64_t repaired_at) {
+    return db.invoke_on_all([master, keyspace = std::move(keyspace), cf = std::move(cf), repaired_at] (database& localdb) {
+        utils::UUID table_id;
+        try {
+            table_id = localdb.find_column_family(keyspace, cf).schema()->id();
+        } catch (no_such_column_family&) {
+            // Reported by the repair itself.
+            return;
+        }
+        auto& recorded = follower_unrepaired_generations[{master, repaired_at}];
+        if (recorded.count(table_id)) {
+            return;
+        }
+        // An earlier repair of the table by the same master either failed or
+        // hasn't marked anything yet. Its sstables are read again by this
+        // one, which marks them instead.
+        for (auto it = follower_unrepaired_generations.begin(); it != follower_unrepaired_generations.end();) {
+            if (it->first.first == master && it->first.second < repaired_at) {
+                it->second.erase(table_id);
+            }
+            if (it->second.empty() && it->first.second != repaired_at) {
+                it = follower_unrepaired_generations.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto& generations = recorded[table_id];
+        for (auto& sst : *localdb.find_column_family(table_id).get_sstables()) {
+            if (!sst->is_repaired() && !sst->is_shared()) {
+                generations.insert(sst->generation());
+            }
+        }
+    });
+}
+
+void repair_forget_unrepaired_sstables(gms::inet_address master) {
+    for (auto it = follower_unrepaired_generations.begin(); it != follower_unrepaired_generations.end();) {
+        if (it->first.first == master) {
+            it = follower_unrepaired_generations.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+future<> repair_mark_sstables_repaired(seastar::sharded<database>& db, gms::inet_address master,
+        std::vector<utils::UUID> table_ids, dht::token_range_vector ranges, uint64_t repaired_at) {
+    return db.invoke_on_all([master, table_ids, ranges = merge_ranges(std::move(ranges)), repaired_at] (database& localdb) {
+        auto it = follower_unrepaired_generations.find({master, repaired_at});
+        if (it == follower_unrepaired_generations.end()) {
+            // This node restarted or saw the master restart since the repair
+            // started, so what it read is unknown.
+            return make_ready_future<>();
+        }
+        auto recorded = std::move(it->second);
+        follower_unrepaired_generations.erase(it);
+        return do_with(table_ids, ranges, std::move(recorded), [&localdb, repaired_at]
+                (const std::vector<utils::UUID>& table_ids, const dht::token_range_vector& ranges, recorded_generations& recorded) {
+          return parallel_for_each(table_ids, [&localdb, &ranges, &recorded, repaired_at] (const utils::UUID& table_id) {
+            try {
+                auto& t = localdb.find_column_family(table_id);
+                auto& seen = recorded[table_id];
+                std::unordered_set<int64_t> generations;
+                for (auto& sst : *t.get_sstables()) {
+                    if (sst->is_repaired() || !seen.count(sst->generation())) {
+                        continue;
+                    }
+                    auto covered = dht::token_range::make({sst->get_first_decorated_key().token(), true}, {sst->get_last_decorated_key().token(), true});
+                    if (boost::algorithm::any_of(ranges, [&covered] (const dht::token_range& r) { return r.contains(covered, dht::token_comparator()); })) {
+                        generations.insert(sst->generation());
+                    }
+                }
+                rlogger.info("marking {} sstables of {}.{} as repaired", generations.size(), t.schema()->ks_name(), t.schema()->cf_name());
+                return t.mark_sstables_repaired(std::move(generations), repaired_at);
+            } catch (no_such_column_family&) {
+                // The table was dropped during the repair.
+                return make_ready_future<>();
+            }
+          });
+        });
+    });
+}
+
+// Marks the data repaired by an incremental repair as repaired, once all the
+// ranges of all the shards are repaired, on this node and on the other
+// replicas of the ranges. Failing to mark the sstables of another replica
+// doesn't fail the repair, they are just read again by the next one.
+static future<> mark_sstables_repaired(seastar::sharded<database>& db, int id, sstring keyspace, const std::vector<sstring>& cfs,
+        const dht::token_range_vector& ranges, uint64_t repaired_at, std::vector<foreign_ptr<lw_shared_ptr<repair_info>>> ris) {
+    std::unordered_map<gms::inet_address, dht::token_range_vector> peer_ranges;
+    for (auto& range : ranges) {
+        for (auto& peer : get_neighbors(db.local(), keyspace, range, {}, {})) {
+            peer_ranges[peer].push_back(range);
+        }
+    }
+    std::vector<utils::UUID> table_ids;
+    for (auto& cf : cfs) {
+        try {
+            table_ids.push_back(db.local().find_column_family(keyspace, cf).schema()->id());
+        } catch (no_such_column_family&) {
+            // The table was dropped during the repair.
+        }
+    }
+    return do_with(std::move(ris), [] (std::vector<foreign_ptr<lw_shared_ptr<repair_info>>>& ris) {
+        return parallel_for_each(ris, [] (foreign_ptr<lw_shared_ptr<repair_info>>& ri) {
+            return smp::submit_to(ri.get_owner_shard(), [ri = ri.get()] {
+                return ri->mark_sstables_repaired();
+            });
+        });
+    }).then([id, keyspace = std::move(keyspace), table_ids = std::move(table_ids), peer_ranges = std::move(peer_ranges), repaired_at] () mutable {
+        return do_with(std::move(keyspace), std::move(table_ids), std::move(peer_ranges),
+                [id, repaired_at] (const sstring& keyspace, const std::vector<utils::UUID>& table_ids, auto& peer_ranges) {
+            return parallel_for_each(peer_ranges, [id, repaired_at, &keyspace, &table_ids] (auto& x) {
+                auto peer = x.first;
+                return netw::get_local_messaging_service().send_repair_mark_sstables_repaired(netw::msg_addr(peer),
+                        keyspace, table_ids, std::move(x.second), repaired_at).handle_exception([id, peer] (std::exception_ptr ep) {
+                    rlogger.warn("repair id {}: failed to mark the repaired sstables of {} as repaired: {}", id, peer, ep);
+                });
+            });
+        });
+    });
+}
+
 // repair_start() can run on any cpu; It runs on cpu0 the function
 // do_repair_start(). The benefit of always running that function on the same
 // CPU is that it allows us to keep some state (like a list of ongoing
@@ -1399,33 +1573,57 @@ static int do_repair_start(seastar::sharded<database>& db, sstring keyspace,
     }
 
 
-    std::vector<future<>> repair_results;
+    std::vector<future<foreign_ptr<lw_shared_ptr<repair_info>>>> repair_results;
     repair_results.reserve(smp::count);
 
+    // The data of this node is repaired only if all of its ranges are
+    // repaired with all their replicas.
+    bool mark_repaired = options.incremental && !options.primary_range && options.ranges.empty()
+            && options.start_token.empty() && options.end_token.empty()
+            && options.data_centers.empty() && options.hosts.empty();
+    if (options.incremental && !mark_repaired) {
+        rlogger.warn("repair id {}: incremental repair of a subset of the ranges or replicas of this node does not mark any data as repaired", id);
+    }
+    auto repaired_at = std::chrono::duration_cast<std::chrono::milliseconds>(db_clock::now().time_since_epoch()).count();
+
     for (auto shard : boost::irange(unsigned(0), smp::count)) {
         auto f = db.invoke_on(shard, [keyspace, cfs, id, ranges,
-                data_centers = options.data_centers, hosts = options.hosts] (database& localdb) mutable {
+                data_centers = options.data_centers, hosts = options.hosts,
+                incremental = options.incremental, mark_repaired, repaired_at] (database& localdb) mutable {
             auto ri = make_lw_shared<repair_info>(service::get_local_storage_service().db(),
                     std::move(keyspace), std::move(ranges), std::move(cfs),
-                    id, std::move(data_centers), std::move(hosts));
-            return repair_ranges(ri);
+                    id, std::move(data_centers), std::move(hosts), incremental, mark_repaired, repaired_at);
+            return repair_ranges(ri).then([ri] () mutable {
+                return make_foreign(std::move(ri));
+            });
         });
         repair_results.push_back(std::move(f));
     }
 
     // Do it in the background.
-    (void)when_all(repair_results.begin(), repair_results.end()).then([id, fail = std::move(fail)] (std::vector<future<>> results) mutable {
+    (void)when_all(repair_results.begin(), repair_results.end()).then([&db, id, fail = std::move(fail), keyspace = std::move(keyspace),
+            cfs = std::move(cfs), ranges = std::move(ranges), mark_repaired, repaired_at]
+            (std::vector<future<foreign_ptr<lw_shared_ptr<repair_info>>>> results) mutable {
         if (std::any_of(results.begin(), results.end(), [] (auto&& f) { return f.failed(); })) {
             rlogger.info("repair {} failed", id);
-        } else {
-            fail.cancel();
-            repair_tracker().done(id, true);
-            rlogger.info("repair {} completed successfully", id);
+            for (auto& f : results) {
+                f.ignore_ready_future();
+            }
+            return make_ready_future<>();
         }
+        std::vector<foreign_ptr<lw_shared_ptr<repair_info>>> ris;
+        ris.reserve(results.size());
         for (auto& f : results) {
-            f.ignore_ready_future();
+            ris.push_back(f.get0());
         }
-        return make_ready_future<>();
+        auto f = mark_repaired
+                ? mark_sstables_repaired(db, id, std::move(keyspace), cfs, ranges, repaired_at, std::move(ris))
+                : make_ready_future<>();
+        return f.then([id, fail = std::move(fail)] () mutable {
+            fail.cancel();
+            repair_tracker().done(id, true);
+            rlogger.info("repair {} completed successfully", id);
+        });
     }).handle_exception([id] (std::exception_ptr eptr) {
          rlogger.info("repair {} failed: {}", id, eptr);
     });
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 #include <exception>
 
 #include <seastar/core/sstring.hh>
@@ -30,6 +31,10 @@
 
 #include "database_fwd.hh"
 #include "flat_mutation_reader.hh"
+#include "mutation_reader.hh"
+#include "query-request.hh"
+#include "tracing/trace_state.hh"
+#include "db/timeout_clock.hh"
 #include "utils/UUID.hh"
 #include "streaming/stream_plan.hh"
 
@@ -79,9 +84,31 @@ void check_in_shutdown();
 // Abort all the repairs
 future<> repair_abort_all(seastar::sharded<database>& db);
 
+// Records the unrepaired sstables of a table on all shards, when `master`
+// starts repairing it incrementally and is going to mark the data it
+// repaired as repaired at `repaired_at`, see REPAIR_ROW_LEVEL_START. Only
+// the sstables recorded when the repair of a table first reaches this node
+// are known to be read by it. Does nothing if they are already recorded.
+future<> repair_record_unrepaired_sstables(seastar::sharded<database>& db, gms::inet_address master,
+        sstring keyspace, sstring cf, uint64_t repaired_at);
+
+// Marks as repaired at `repaired_at` the sstables of the given tables which
+// were recorded for the repair `master` started at `repaired_at` and only
+// hold data of `ranges`, on all shards. Called on the other replicas by the
+// node which repaired the ranges incrementally, see
+// REPAIR_MARK_SSTABLES_REPAIRED.
+future<> repair_mark_sstables_repaired(seastar::sharded<database>& db, gms::inet_address master,
+        std::vector<utils::UUID> table_ids, dht::token_range_vector ranges, uint64_t repaired_at);
+
+// Drops the sstables recorded on this shard for the repairs of `master`,
+// when it goes down or restarts and will not mark them.
+void repair_forget_unrepaired_sstables(gms::inet_address master);
+
 enum class repair_checksum {
     legacy = 0,
     streamed = 1,
+    // Row level repair only: hash rows with XXH3 instead of XXH64.
+    xxh3 = 2,
 };
 
 // The class partition_checksum calculates a 256-bit cryptographically-secure
@@ -181,6 +208,20 @@ class repair_info {
     repair_stats _stats;
     bool _row_level_repair;
     uint64_t _sub_ranges_nr = 0;
+    // Incremental repair reads only the sstables which are not repaired yet.
+    bool incremental;
+    // If set, the sstables which were not repaired when the repair started
+    // are marked as repaired at repaired_at once all the ranges of all the
+    // shards are repaired. Only done when the repair covers all the ranges
+    // of this node with all their replicas, as otherwise the sstables hold
+    // data not repaired by it.
+    bool mark_repaired;
+    uint64_t repaired_at;
+    // Generations of the unrepaired sstables of each table when the repair
+    // started, indexed by table id. Shared sstables are left out, as the
+    // repair of the other shards they belong to may fail, and marking them
+    // from several shards would rewrite their statistics concurrently.
+    std::unordered_map<utils::UUID, std::unordered_set<int64_t>> unrepaired_generations;
 public:
     repair_info(seastar::sharded<database>& db_,
             const sstring& keyspace_,
@@ -188,7 +229,12 @@ class repair_info {
             const std::vector<sstring>& cfs_,
             int id_,
             const std::vector<sstring>& data_centers_,
-            const std::vector<sstring>& hosts_);
+            const std::vector<sstring>& hosts_,
+            bool incremental_ = false,
+            bool mark_repaired_ = false,
+            uint64_t repaired_at_ = 0);
+    // Marks the sstables listed in unrepaired_generations as repaired.
+    future<> mark_sstables_repaired();
     future<> do_streaming();
     void check_failed_ranges();
     future<> request_transfer_ranges(const sstring& cf,
@@ -307,6 +353,42 @@ class repair_hash {
     }
 };
 
+// Hash of a single clustering row, see hash_partition_rows()
+struct clustering_row_hash {
+    clustering_key key;
+    repair_hash hash;
+};
+
+// Return value of the READ_ROW_HASHES RPC verb
+struct partition_row_hashes {
+    // Covers the partition key and tombstone, the static row and the range tombstones
+    repair_hash partition_hash;
+    // In clustering order
+    std::vector<clustering_row_hash> rows;
+};
+
+// Hashes the partition and each of its clustering rows using the same
+// hashing repair uses for rows, so that replicas holding the same data
+// produce the same hashes.
+partition_row_hashes hash_partition_rows(const schema& s, const mutation& m);
+
+// Given the hashes of the same partition from several replicas, returns the
+// rows which are missing from some of them or differ between them, or
+// std::nullopt if the replicas disagree on partition-level data.
+std::optional<query::clustering_row_ranges> diverging_rows(const schema& s, const std::vector<partition_row_hashes>& hashes);
+
+// Returns the same hashes as hash_partition_rows() would for the partition
+// selected by range and slice, but hashes the rows as they are read from the
+// source instead of materializing the partition first.
+future<partition_row_hashes> query_partition_row_hashes(schema_ptr s,
+        const mutation_source& source,
+        const dht::partition_range& range,
+        const query::partition_slice& slice,
+        uint32_t row_limit,
+        gc_clock::time_point query_time,
+        tracing::trace_state_ptr trace_state,
+        db::timeout_clock::time_point timeout);
+
 // Return value of the REPAIR_GET_SYNC_BOUNDARY RPC verb
 struct get_sync_boundary_response {
     std::optional<repair_sync_boundary> boundary;
@@ -380,6 +462,9 @@ struct repair_row_on_wire_with_cmd {
 enum class row_level_diff_detect_algorithm : uint8_t {
     send_full_set,
     send_full_set_rpc_stream,
+    // Like send_full_set_rpc_stream, but the row hash sets are reconciled
+    // with invertible Bloom lookup tables first, see repair_hash_ibf.
+    send_ibf_rpc_stream,
 };
 
 std::ostream& operator<<(std::ostream& out, row_level_diff_detect_algorithm algo);
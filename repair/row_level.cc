@@ -20,6 +20,8 @@
  */
 
 #include "repair/repair.hh"
+#include "repair/hash_ibf.hh"
+#include "repair/hash_set.hh"
 #include "message/messaging_service.hh"
 #include "sstables/sstables.hh"
 #include "mutation_fragment.hh"
@@ -37,6 +39,7 @@
 #include <seastar/util/bool_class.hh>
 #include <seastar/core/metrics_registration.hh>
 #include <list>
+#include <map>
 #include <vector>
 #include <algorithm>
 #include <random>
@@ -47,6 +50,7 @@
 #include "gms/gossiper.hh"
 #include "repair/row_level.hh"
 #include "mutation_source_metadata.hh"
+#include "mutation_compactor.hh"
 
 extern logging::logger rlogger;
 
@@ -169,6 +173,7 @@ static const std::vector<row_level_diff_detect_algorithm>& suportted_diff_detect
     static std::vector<row_level_diff_detect_algorithm> _algorithms = {
         row_level_diff_detect_algorithm::send_full_set,
         row_level_diff_detect_algorithm::send_full_set_rpc_stream,
+        row_level_diff_detect_algorithm::send_ibf_rpc_stream,
     };
     return _algorithms;
 };
@@ -212,21 +217,37 @@ static uint64_t get_random_seed() {
     return random_dist(random_engine);
 }
 
+// Feeds a hasher seeded with seed to func and returns the resulting row
+// hash. Row level repair hashes rows with XXH3 if hash_version is
+// repair_checksum::xxh3, and with XXH64 otherwise.
+template <typename Func>
+static repair_hash do_hash(repair_checksum hash_version, uint64_t seed, Func&& func) {
+    if (hash_version == repair_checksum::xxh3) {
+        xxh3_hasher h(seed);
+        func(h);
+        return repair_hash(h.finalize_uint64());
+    }
+    xx_hasher h(seed);
+    func(h);
+    return repair_hash(h.finalize_uint64());
+}
+
 class decorated_key_with_hash {
 public:
     dht::decorated_key dk;
     repair_hash hash;
-    decorated_key_with_hash(const schema& s, dht::decorated_key key, uint64_t seed)
+    decorated_key_with_hash(const schema& s, dht::decorated_key key, uint64_t seed, repair_checksum hash_version)
         : dk(key) {
-        xx_hasher h(seed);
-        feed_hash(h, dk.key(), s);
-        hash = repair_hash(h.finalize_uint64());
+        hash = do_hash(hash_version, seed, [&] (auto& h) {
+            feed_hash(h, dk.key(), s);
+        });
     }
 };
 
+template <typename Hasher>
 class fragment_hasher {
     const schema& _schema;
-    xx_hasher& _hasher;
+    Hasher& _hasher;
 private:
     void consume_cell(const column_definition& col, const atomic_cell_or_collection& cell) {
         feed_hash(_hasher, col.kind);
@@ -234,7 +255,7 @@ class fragment_hasher {
         feed_hash(_hasher, cell, col);
     }
 public:
-    explicit fragment_hasher(const schema&s, xx_hasher& h)
+    explicit fragment_hasher(const schema&s, Hasher& h)
         : _schema(s), _hasher(h) { }
 
     void hash(const mutation_fragment& mf) {
@@ -264,17 +285,30 @@ class fragment_hasher {
     }
 
     void consume(const static_row& sr) {
-        sr.cells().for_each_cell([&] (column_id id, const atomic_cell_or_collection& cell) {
+        hash_static_row(sr.cells());
+    }
+
+    void consume(const clustering_row& cr) {
+        hash_row(cr.key(), cr.tomb(), cr.marker(), cr.cells());
+    }
+
+public:
+    // The methods below hash the pieces of a mutation_partition in the same
+    // way the corresponding fragments are hashed, so that a row read by a
+    // query and a row read by repair hash to the same value.
+
+    void hash_static_row(const row& cells) {
+        cells.for_each_cell([&] (column_id id, const atomic_cell_or_collection& cell) {
             auto&& col = _schema.static_column_at(id);
             consume_cell(col, cell);
         });
     }
 
-    void consume(const clustering_row& cr) {
-        feed_hash(_hasher, cr.key(), _schema);
-        feed_hash(_hasher, cr.tomb());
-        feed_hash(_hasher, cr.marker());
-        cr.cells().for_each_cell([&] (column_id id, const atomic_cell_or_collection& cell) {
+    void hash_row(const clustering_key& key, row_tombstone tomb, const row_marker& marker, const row& cells) {
+        feed_hash(_hasher, key, _schema);
+        feed_hash(_hasher, tomb);
+        feed_hash(_hasher, marker);
+        cells.for_each_cell([&] (column_id id, const atomic_cell_or_collection& cell) {
             auto&& col = _schema.regular_column_at(id);
             consume_cell(col, cell);
         });
@@ -289,13 +323,139 @@ class fragment_hasher {
     }
 
     void consume(const partition_start& ps) {
-        feed_hash(_hasher, ps.key().key(), _schema);
-        if (ps.partition_tombstone()) {
-            consume(ps.partition_tombstone());
+        hash_partition_header(ps.key().key(), ps.partition_tombstone());
+    }
+
+    void hash_partition_header(const partition_key& key, tombstone t) {
+        feed_hash(_hasher, key, _schema);
+        if (t) {
+            consume(t);
         }
     }
 };
 
+partition_row_hashes hash_partition_rows(const schema& s, const mutation& m) {
+    partition_row_hashes ret;
+    auto& p = m.partition();
+    {
+        xx_hasher h;
+        fragment_hasher fh(s, h);
+        fh.hash_partition_header(m.key(), p.partition_tombstone());
+        fh.hash_static_row(p.static_row());
+        for (auto&& rt : p.row_tombstones()) {
+            fh.consume(rt);
+        }
+        ret.partition_hash = repair_hash(h.finalize_uint64());
+    }
+    ret.rows.reserve(p.clustered_rows().calculate_size());
+    for (const rows_entry& e : p.clustered_rows()) {
+        xx_hasher h;
+        fragment_hasher fh(s, h);
+        auto& r = e.row();
+        fh.hash_row(e.key(), r.deleted_at(), r.marker(), r.cells());
+        ret.rows.push_back(clustering_row_hash{e.key(), repair_hash(h.finalize_uint64())});
+    }
+    return ret;
+}
+
+std::optional<query::clustering_row_ranges> diverging_rows(const schema& s, const std::vector<partition_row_hashes>& hashes) {
+    for (auto& h : hashes) {
+        if (h.partition_hash != hashes.front().partition_hash) {
+            return std::nullopt;
+        }
+    }
+    struct row_agreement {
+        repair_hash hash;
+        size_t replicas = 0;
+        bool mismatch = false;
+    };
+    std::map<clustering_key, row_agreement, clustering_key::less_compare> rows(clustering_key::less_compare(s));
+    for (auto& h : hashes) {
+        for (auto& r : h.rows) {
+            auto& agreement = rows.try_emplace(r.key, row_agreement{r.hash}).first->second;
+            agreement.replicas++;
+            agreement.mismatch |= agreement.hash != r.hash;
+        }
+    }
+    query::clustering_row_ranges ranges;
+    for (auto& [key, agreement] : rows) {
+        if (agreement.mismatch || agreement.replicas != hashes.size()) {
+            ranges.push_back(query::clustering_range::make_singular(key));
+        }
+    }
+    return ranges;
+}
+
+// Hashes the compacted fragments of the partitions read by a query the same
+// way hash_partition_rows() hashes a mutation, so that the rows don't have to
+// be materialized first. Range tombstones are de-overlapped, as they are in a
+// mutation_partition, before being hashed with the partition header.
+class partition_row_hashes_builder {
+    const schema& _schema;
+    partition_row_hashes _hashes;
+    xx_hasher _partition_hasher;
+    std::optional<range_tombstone_list> _range_tombstones;
+public:
+    explicit partition_row_hashes_builder(const schema& s) : _schema(s) { }
+
+    void consume_new_partition(const dht::decorated_key& dk) {
+        _partition_hasher = xx_hasher();
+        _range_tombstones.emplace(_schema);
+        feed_hash(_partition_hasher, dk.key(), _schema);
+    }
+
+    void consume(tombstone t) {
+        feed_hash(_partition_hasher, t);
+    }
+
+    stop_iteration consume(static_row&& sr, tombstone, bool) {
+        fragment_hasher<xx_hasher>(_schema, _partition_hasher).hash_static_row(sr.cells());
+        return stop_iteration::no;
+    }
+
+    stop_iteration consume(clustering_row&& cr, row_tombstone, bool) {
+        xx_hasher h;
+        fragment_hasher<xx_hasher>(_schema, h).hash_row(cr.key(), cr.tomb(), cr.marker(), cr.cells());
+        _hashes.rows.push_back(clustering_row_hash{std::move(cr.key()), repair_hash(h.finalize_uint64())});
+        return stop_iteration::no;
+    }
+
+    stop_iteration consume(range_tombstone&& rt) {
+        _range_tombstones->apply(_schema, std::move(rt));
+        return stop_iteration::no;
+    }
+
+    stop_iteration consume_end_of_partition() {
+        fragment_hasher<xx_hasher> fh(_schema, _partition_hasher);
+        for (auto&& rt : *_range_tombstones) {
+            fh.consume(rt);
+        }
+        _hashes.partition_hash = repair_hash(_partition_hasher.finalize_uint64());
+        return stop_iteration::no;
+    }
+
+    partition_row_hashes consume_end_of_stream() {
+        return std::move(_hashes);
+    }
+};
+
+future<partition_row_hashes> query_partition_row_hashes(schema_ptr s,
+        const mutation_source& source,
+        const dht::partition_range& range,
+        const query::partition_slice& slice,
+        uint32_t row_limit,
+        gc_clock::time_point query_time,
+        tracing::trace_state_ptr trace_state,
+        db::timeout_clock::time_point timeout) {
+    auto reader = source.make_reader(s, range, slice, service::get_local_sstable_query_read_priority(), std::move(trace_state),
+            streamed_mutation::forwarding::no, mutation_reader::forwarding::no);
+    return do_with(std::move(reader), [s, &slice, row_limit, query_time, timeout] (flat_mutation_reader& reader) {
+        auto consumer = make_stable_flattened_mutations_consumer<compact_for_query<emit_only_live_rows::no, partition_row_hashes_builder>>(
+                *s, query_time, slice, row_limit, 1, partition_row_hashes_builder(*s));
+        return reader.consume(std::move(consumer), timeout);
+    });
+}
+
 class repair_row {
     std::optional<frozen_mutation_fragment> _fm;
     lw_shared_ptr<const decorated_key_with_hash> _dk_with_hash;
@@ -367,6 +527,7 @@ using is_local_reader = bool_class<class is_local_reader_tag>;
     dht::selective_token_range_sharder _sharder;
     // Seed for the repair row hashing
     uint64_t _seed;
+    repair_checksum _hash_version;
     // Pin the table while the reader is alive.
     // Only needed for local readers, the multishard reader takes care
     // of pinning tables on used shards.
@@ -386,13 +547,16 @@ using is_local_reader = bool_class<class is_local_reader_tag>;
             dht::i_partitioner& remote_partitioner,
             unsigned remote_shard,
             uint64_t seed,
-            is_local_reader local_reader)
+            repair_checksum hash_version,
+            is_local_reader local_reader,
+            read_unrepaired_only unrepaired_only)
             : _schema(s)
             , _range(dht::to_partition_range(range))
             , _sharder(remote_partitioner, range, remote_shard)
             , _seed(seed)
+            , _hash_version(hash_version)
             , _local_read_op(local_reader ? std::optional(cf.read_in_progress()) : std::nullopt)
-            , _reader(make_reader(db, cf, local_partitioner, local_reader)) {
+            , _reader(make_reader(db, cf, local_partitioner, local_reader, unrepaired_only)) {
     }
 
 private:
@@ -400,9 +564,10 @@ using is_local_reader = bool_class<class is_local_reader_tag>;
     make_reader(seastar::sharded<database>& db,
             column_family& cf,
             dht::i_partitioner& local_partitioner,
-            is_local_reader local_reader) {
+            is_local_reader local_reader,
+            read_unrepaired_only unrepaired_only) {
         if (local_reader) {
-            return cf.make_streaming_reader(_schema, _range);
+            return cf.make_streaming_reader(_schema, _range, unrepaired_only);
         }
         return make_multishard_streaming_reader(db, local_partitioner, _schema, [this] {
             auto shard_range = _sharder.next();
@@ -410,7 +575,7 @@ using is_local_reader = bool_class<class is_local_reader_tag>;
                 return std::optional<dht::partition_range>(dht::to_partition_range(*shard_range));
             }
             return std::optional<dht::partition_range>();
-        });
+        }, unrepaired_only);
     }
 
 public:
@@ -424,7 +589,7 @@ using is_local_reader = bool_class<class is_local_reader_tag>;
     }
 
     void set_current_dk(const dht::decorated_key& key) {
-        _current_dk = make_lw_shared<const decorated_key_with_hash>(*_schema, key, _seed);
+        _current_dk = make_lw_shared<const decorated_key_with_hash>(*_schema, key, _seed, _hash_version);
     }
 
     void clear_current_dk() {
@@ -571,11 +736,15 @@ class repair_meta {
     // Max rows size can be stored in _row_buf
     size_t _max_row_buf_size;
     uint64_t _seed = 0;
+    // The row hash function, see do_hash()
+    repair_checksum _hash_version;
     repair_master _repair_master;
     gms::inet_address _myip;
     uint32_t _repair_meta_id;
     // Repair master's sharding configuration
     shard_config _master_node_shard_config;
+    // Incremental repair reads only the sstables which are not repaired yet
+    read_unrepaired_only _unrepaired_only;
     // Partitioner of repair master
     std::unique_ptr<dht::i_partitioner> _remote_partitioner;
     bool _same_sharding_config = false;
@@ -597,7 +766,7 @@ class repair_meta {
     // Tracks current sync boundary
     std::optional<repair_sync_boundary> _current_sync_boundary;
     // Contains the hashes of rows in the _working_row_buffor for all peer nodes
-    std::vector<std::unordered_set<repair_hash>> _peer_row_hash_sets;
+    std::vector<repair_hash_set> _peer_row_hash_sets;
     // Gate used to make sure pending operation of meta data is done
     seastar::gate _gate;
     sink_source_for_get_full_row_hashes _sink_source_for_get_full_row_hashes;
@@ -625,6 +794,9 @@ class repair_meta {
     bool use_rpc_stream() const {
         return is_rpc_stream_supported(_algo);
     }
+    bool use_ibf() const {
+        return _algo == row_level_diff_detect_algorithm::send_ibf_rpc_stream;
+    }
 
 public:
     repair_meta(
@@ -635,9 +807,11 @@ class repair_meta {
             row_level_diff_detect_algorithm algo,
             size_t max_row_buf_size,
             uint64_t seed,
+            repair_checksum hash_version,
             repair_master master,
             uint32_t repair_meta_id,
             shard_config master_node_shard_config,
+            read_unrepaired_only unrepaired_only,
             size_t nr_peer_nodes = 1)
             : _db(db)
             , _cf(cf)
@@ -647,10 +821,12 @@ class repair_meta {
             , _algo(algo)
             , _max_row_buf_size(max_row_buf_size)
             , _seed(seed)
+            , _hash_version(hash_version)
             , _repair_master(master)
             , _myip(utils::fb_utilities::get_broadcast_address())
             , _repair_meta_id(repair_meta_id)
             , _master_node_shard_config(std::move(master_node_shard_config))
+            , _unrepaired_only(unrepaired_only)
             , _remote_partitioner(make_remote_partitioner())
             , _same_sharding_config(is_same_sharding_config())
             , _nr_peer_nodes(nr_peer_nodes)
@@ -663,7 +839,9 @@ class repair_meta {
                     *_remote_partitioner,
                     _master_node_shard_config.shard,
                     _seed,
-                    repair_reader::is_local_reader(_repair_master || _same_sharding_config)
+                    _hash_version,
+                    repair_reader::is_local_reader(_repair_master || _same_sharding_config),
+                    _unrepaired_only
               )
             , _repair_writer(_schema, _estimated_partitions, _nr_peer_nodes)
             , _sink_source_for_get_full_row_hashes(_repair_meta_id, _nr_peer_nodes,
@@ -714,16 +892,20 @@ class repair_meta {
             row_level_diff_detect_algorithm algo,
             uint64_t max_row_buf_size,
             uint64_t seed,
+            repair_checksum hash_version,
             shard_config master_node_shard_config,
-            table_schema_version schema_version) {
+            table_schema_version schema_version,
+            read_unrepaired_only unrepaired_only) {
         return service::get_schema_for_write(schema_version, {from, src_cpu_id}).then([from,
                 repair_meta_id,
                 range,
                 algo,
                 max_row_buf_size,
                 seed,
+                hash_version,
                 master_node_shard_config,
-                schema_version] (schema_ptr s) {
+                schema_version,
+                unrepaired_only] (schema_ptr s) {
             auto& db = service::get_local_storage_proxy().get_db();
             auto& cf = db.local().find_column_family(s->id());
             node_repair_meta_id id{from, repair_meta_id};
@@ -734,9 +916,11 @@ class repair_meta {
                     algo,
                     max_row_buf_size,
                     seed,
+                    hash_version,
                     repair_meta::repair_master::no,
                     repair_meta_id,
-                    std::move(master_node_shard_config));
+                    std::move(master_node_shard_config),
+                    unrepaired_only);
             bool insertion = repair_meta_map().emplace(id, rm).second;
             if (!insertion) {
                 rlogger.warn("insert_repair_meta: repair_meta_id {} for node {} already exists, replace existing one", id.repair_meta_id, id.ip);
@@ -813,12 +997,18 @@ class repair_meta {
     }
 
     // Must run inside a seastar thread
-    static std::unordered_set<repair_hash>
-    get_set_diff(const std::unordered_set<repair_hash>& x, const std::unordered_set<repair_hash>& y) {
-        std::unordered_set<repair_hash> set_diff;
-        // Note std::set_difference needs x and y are sorted.
-        std::copy_if(x.begin(), x.end(), std::inserter(set_diff, set_diff.end()),
-                [&y] (auto& item) { thread::maybe_yield(); return y.find(item) == y.end(); });
+    static repair_hash_set
+    get_set_diff(const repair_hash_set& x, const repair_hash_set& y) {
+        // The number of slots of x to look at between preemption checks
+        constexpr size_t slots_per_step = 1024;
+        repair_hash_set set_diff;
+        size_t start = 0;
+        do {
+            auto end = std::min(start + slots_per_step, x.slot_count());
+            x.difference(y, start, end, set_diff);
+            start = end;
+            thread::maybe_yield();
+        } while (start < x.slot_count());
         return set_diff;
     }
 
@@ -833,14 +1023,14 @@ class repair_meta {
 
     }
 
-    std::unordered_set<repair_hash>& peer_row_hash_sets(unsigned node_idx) {
+    repair_hash_set& peer_row_hash_sets(unsigned node_idx) {
         return _peer_row_hash_sets[node_idx];
     }
 
     // Get a list of row hashes in _working_row_buf
-    future<std::unordered_set<repair_hash>>
+    future<repair_hash_set>
     working_row_hashes() {
-        return do_with(std::unordered_set<repair_hash>(), [this] (std::unordered_set<repair_hash>& hashes) {
+        return do_with(repair_hash_set(_working_row_buf.size()), [this] (repair_hash_set& hashes) {
             return do_for_each(_working_row_buf, [&hashes] (repair_row& r) {
                 hashes.emplace(r.hash());
             }).then([&hashes] {
@@ -849,6 +1039,66 @@ class repair_meta {
         });
     }
 
+    static future<repair_hash_ibf>
+    make_row_hash_ibf(const repair_hash_set& hashes, size_t nr_cells) {
+        return do_with(repair_hash_ibf(nr_cells), [&hashes] (repair_hash_ibf& ibf) {
+            return do_for_each(hashes, [&ibf] (const repair_hash& h) {
+                ibf.add(h);
+            }).then([&ibf] {
+                return std::move(ibf);
+            });
+        });
+    }
+
+    // An IBF of more cells than this would not be smaller than the full set
+    // of the hashes of rows_nr rows.
+    static size_t max_row_hash_ibf_cells(uint64_t rows_nr) {
+        return rows_nr * sizeof(repair_hash) / sizeof(repair_hash_ibf_cell);
+    }
+
+    // Must run inside a seastar thread
+    // Finds the difference between the rows in _working_row_buf and those of
+    // the peer by exchanging IBFs of their hashes, starting with one sized for
+    // the difference in the number of rows and growing it until the difference
+    // can be decoded. On success, sets peer_row_hash_sets(node_idx) and returns
+    // the hashes of the rows only the peer has. Returns a disengaged optional
+    // once an IBF would not be smaller than the full set of the peer hashes.
+    std::optional<repair_hash_set>
+    get_set_diff_with_ibf(gms::inet_address remote_node, unsigned node_idx, uint64_t remote_rows_nr) {
+        auto local_hashes = working_row_hashes().get0();
+        uint64_t local_rows_nr = local_hashes.size();
+        auto expected_differences = std::max(local_rows_nr, remote_rows_nr) - std::min(local_rows_nr, remote_rows_nr);
+        auto max_cells = max_row_hash_ibf_cells(remote_rows_nr);
+        for (auto nr_cells = repair_hash_ibf::cells_for_differences(expected_differences); nr_cells < max_cells; nr_cells *= 4) {
+            auto ibf = make_row_hash_ibf(local_hashes, nr_cells).get0();
+            ibf.subtract(get_row_hash_ibf(remote_node, ibf.size()).get0());
+            auto diff = ibf.decode();
+            if (!diff) {
+                rlogger.debug("Failed to decode row hash IBF of peer={}, nr_cells={}", remote_node, ibf.size());
+                continue;
+            }
+            bool consistent = std::all_of(diff->only_local.begin(), diff->only_local.end(), [&] (const repair_hash& h) {
+                return local_hashes.count(h);
+            }) && std::none_of(diff->only_remote.begin(), diff->only_remote.end(), [&] (const repair_hash& h) {
+                return local_hashes.count(h);
+            });
+            if (!consistent) {
+                rlogger.debug("Decoded inconsistent row hash IBF of peer={}, nr_cells={}", remote_node, ibf.size());
+                continue;
+            }
+            rlogger.debug("Decoded row hash IBF of peer={}, nr_cells={}, only_local={}, only_remote={}",
+                    remote_node, ibf.size(), diff->only_local.size(), diff->only_remote.size());
+            auto& peer_hashes = _peer_row_hash_sets[node_idx];
+            peer_hashes = std::move(local_hashes);
+            for (auto& h : diff->only_local) {
+                peer_hashes.erase(h);
+            }
+            peer_hashes.insert(diff->only_remote.begin(), diff->only_remote.end());
+            return std::move(diff->only_remote);
+        }
+        return std::nullopt;
+    }
+
     std::pair<std::optional<repair_sync_boundary>, bool>
     get_common_sync_boundary(bool zero_rows,
             std::vector<repair_sync_boundary>& sync_boundaries,
@@ -959,11 +1209,11 @@ class repair_meta {
     }
 
     repair_hash do_hash_for_mf(const decorated_key_with_hash& dk_with_hash, const mutation_fragment& mf) {
-        xx_hasher h(_seed);
-        fragment_hasher fh(*_schema, h);
-        fh.hash(mf);
-        feed_hash(h, dk_with_hash.hash.hash);
-        return repair_hash(h.finalize_uint64());
+        return do_hash(_hash_version, _seed, [&] (auto& h) {
+            fragment_hasher fh(*_schema, h);
+            fh.hash(mf);
+            feed_hash(h, dk_with_hash.hash.hash);
+        });
     }
 
     stop_iteration handle_mutation_fragment(mutation_fragment_opt mfopt, size_t& cur_size, size_t& new_rows_size, std::list<repair_row>& cur_rows) {
@@ -1122,9 +1372,9 @@ class repair_meta {
     }
 
     future<std::list<repair_row>>
-    copy_rows_from_working_row_buf_within_set_diff(std::unordered_set<repair_hash> set_diff) {
+    copy_rows_from_working_row_buf_within_set_diff(repair_hash_set set_diff) {
         return do_with(std::list<repair_row>(), std::move(set_diff),
-                [this] (std::list<repair_row>& rows, std::unordered_set<repair_hash>& set_diff) {
+                [this] (std::list<repair_row>& rows, repair_hash_set& set_diff) {
             return do_for_each(_working_row_buf, [this, &set_diff, &rows] (const repair_row& r) {
                 if (set_diff.count(r.hash()) > 0) {
                     rows.push_back(r);
@@ -1139,7 +1389,7 @@ class repair_meta {
     // Give a set of row hashes, return the corresponding rows
     // If needs_all_rows is set, return all the rows in _working_row_buf, ignore the set_diff
     future<std::list<repair_row>>
-    get_row_diff(std::unordered_set<repair_hash> set_diff, needs_all_rows_t needs_all_rows = needs_all_rows_t::no) {
+    get_row_diff(repair_hash_set set_diff, needs_all_rows_t needs_all_rows = needs_all_rows_t::no) {
         if (needs_all_rows) {
             if (!_repair_master || _nr_peer_nodes == 1) {
                 return make_ready_future<std::list<repair_row>>(std::move(_working_row_buf));
@@ -1172,7 +1422,7 @@ class repair_meta {
                 [this] (const repair_row& x, const repair_row& y) { thread::maybe_yield(); return _cmp(x.boundary(), y.boundary()) < 0; });
         }
         if (update_hash_set) {
-            _peer_row_hash_sets[node_idx] = boost::copy_range<std::unordered_set<repair_hash>>(row_diff |
+            _peer_row_hash_sets[node_idx] = boost::copy_range<repair_hash_set>(row_diff |
                     boost::adaptors::transformed([] (repair_row& r) { thread::maybe_yield(); return r.hash(); }));
         }
         _repair_writer.create_writer(node_idx);
@@ -1241,7 +1491,7 @@ class repair_meta {
             return do_for_each(rows, [this, &dk_ptr, &row_list, &last_mf, &cmp] (partition_key_and_mutation_fragments& x) mutable {
                 dht::decorated_key dk = dht::global_partitioner().decorate_key(*_schema, x.get_key());
                 if (!(dk_ptr && dk_ptr->dk.equal(*_schema, dk))) {
-                    dk_ptr = make_lw_shared<const decorated_key_with_hash>(*_schema, dk, _seed);
+                    dk_ptr = make_lw_shared<const decorated_key_with_hash>(*_schema, dk, _seed, _hash_version);
                 }
                 if (_repair_master) {
                     return do_for_each(x.get_mutation_fragments(), [this, &dk_ptr, &row_list] (frozen_mutation_fragment& fmf) mutable {
@@ -1285,13 +1535,13 @@ class repair_meta {
 public:
     // RPC API
     // Return the hashes of the rows in _working_row_buf
-    future<std::unordered_set<repair_hash>>
+    future<repair_hash_set>
     get_full_row_hashes(gms::inet_address remote_node) {
         if (remote_node == _myip) {
             return get_full_row_hashes_handler();
         }
         return netw::get_local_messaging_service().send_repair_get_full_row_hashes(msg_addr(remote_node),
-                _repair_meta_id).then([this, remote_node] (std::unordered_set<repair_hash> hashes) {
+                _repair_meta_id).then([this, remote_node] (repair_hash_set hashes) {
             rlogger.debug("Got full hashes from peer={}, nr_hashes={}", remote_node, hashes.size());
             _metrics.rx_hashes_nr += hashes.size();
             stats().rx_hashes_nr += hashes.size();
@@ -1302,7 +1552,7 @@ class repair_meta {
 
 private:
     future<> get_full_row_hashes_source_op(
-            lw_shared_ptr<std::unordered_set<repair_hash>> current_hashes,
+            lw_shared_ptr<repair_hash_set> current_hashes,
             gms::inet_address remote_node,
             unsigned node_idx,
             rpc::source<repair_hash_with_cmd>& source) {
@@ -1340,12 +1590,12 @@ class repair_meta {
     }
 
 public:
-    future<std::unordered_set<repair_hash>>
+    future<repair_hash_set>
     get_full_row_hashes_with_rpc_stream(gms::inet_address remote_node, unsigned node_idx) {
         if (remote_node == _myip) {
             return get_full_row_hashes_handler();
         }
-        auto current_hashes = make_lw_shared<std::unordered_set<repair_hash>>();
+        auto current_hashes = make_lw_shared<repair_hash_set>();
         return _sink_source_for_get_full_row_hashes.get_sink_source(remote_node, node_idx).then(
                 [this, current_hashes, remote_node, node_idx]
                 (rpc::sink<repair_stream_cmd>& sink, rpc::source<repair_hash_with_cmd>& source) mutable {
@@ -1358,13 +1608,43 @@ class repair_meta {
     }
 
     // RPC handler
-    future<std::unordered_set<repair_hash>>
+    future<repair_hash_set>
     get_full_row_hashes_handler() {
         return with_gate(_gate, [this] {
             return working_row_hashes();
         });
     }
 
+    // RPC API
+    // Return an IBF of nr_cells cells of the hashes of the rows in _working_row_buf
+    future<repair_hash_ibf>
+    get_row_hash_ibf(gms::inet_address remote_node, uint32_t nr_cells) {
+        if (remote_node == _myip) {
+            return get_row_hash_ibf_handler(nr_cells);
+        }
+        return netw::get_local_messaging_service().send_repair_get_row_hash_ibf(msg_addr(remote_node),
+                _repair_meta_id, nr_cells).then([this, remote_node] (repair_hash_ibf ibf) {
+            rlogger.debug("Got row hash IBF from peer={}, nr_cells={}", remote_node, ibf.size());
+            stats().rpc_call_nr++;
+            return ibf;
+        });
+    }
+
+    // RPC handler
+    future<repair_hash_ibf>
+    get_row_hash_ibf_handler(uint32_t nr_cells) {
+        return with_gate(_gate, [this, nr_cells] {
+            return working_row_hashes().then([nr_cells] (repair_hash_set hashes) {
+                // The master never asks for more, so a larger request is not
+                // worth the memory.
+                size_t cells = std::min<size_t>(nr_cells, max_row_hash_ibf_cells(hashes.size()));
+                return do_with(std::move(hashes), [cells] (const repair_hash_set& hashes) {
+                    return make_row_hash_ibf(hashes, cells);
+                });
+            });
+        });
+    }
+
     // RPC API
     // Return the combined hashes of the current working row buf
     future<get_combined_row_hash_response>
@@ -1394,28 +1674,31 @@ class repair_meta {
 
     // RPC API
     future<>
-    repair_row_level_start(gms::inet_address remote_node, sstring ks_name, sstring cf_name, dht::token_range range, table_schema_version schema_version) {
+    repair_row_level_start(gms::inet_address remote_node, sstring ks_name, sstring cf_name, dht::token_range range, table_schema_version schema_version,
+            uint64_t repaired_at) {
         if (remote_node == _myip) {
             return make_ready_future<>();
         }
         stats().rpc_call_nr++;
         return netw::get_local_messaging_service().send_repair_row_level_start(msg_addr(remote_node),
                 _repair_meta_id, std::move(ks_name), std::move(cf_name), std::move(range), _algo, _max_row_buf_size, _seed,
-                _master_node_shard_config.shard, _master_node_shard_config.shard_count, _master_node_shard_config.ignore_msb, _master_node_shard_config.partitioner_name, std::move(schema_version));
+                _master_node_shard_config.shard, _master_node_shard_config.shard_count, _master_node_shard_config.ignore_msb, _master_node_shard_config.partitioner_name, std::move(schema_version),
+                bool(_unrepaired_only), _hash_version, repaired_at);
     }
 
     // RPC handler
     static future<>
     repair_row_level_start_handler(gms::inet_address from, uint32_t src_cpu_id, uint32_t repair_meta_id, sstring ks_name, sstring cf_name,
             dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size,
-            uint64_t seed, shard_config master_node_shard_config, table_schema_version schema_version) {
+            uint64_t seed, repair_checksum hash_version, shard_config master_node_shard_config, table_schema_version schema_version, read_unrepaired_only unrepaired_only) {
         if (!_sys_dist_ks->local_is_initialized() || !_view_update_generator->local_is_initialized()) {
             return make_exception_future<>(std::runtime_error(format("Node {} is not fully initialized for repair, try again later",
                     utils::fb_utilities::get_broadcast_address())));
         }
-        rlogger.debug(">>> Started Row Level Repair (Follower): local={}, peers={}, repair_meta_id={}, keyspace={}, cf={}, schema_version={}, range={}, seed={}, max_row_buf_siz={}",
-            utils::fb_utilities::get_broadcast_address(), from, repair_meta_id, ks_name, cf_name, schema_version, range, seed, max_row_buf_size);
-        return insert_repair_meta(from, src_cpu_id, repair_meta_id, std::move(range), algo, max_row_buf_size, seed, std::move(master_node_shard_config), std::move(schema_version));
+        rlogger.debug(">>> Started Row Level Repair (Follower): local={}, peers={}, repair_meta_id={}, keyspace={}, cf={}, schema_version={}, range={}, seed={}, hash_version={:d}, max_row_buf_siz={}, unrepaired_only={}",
+            utils::fb_utilities::get_broadcast_address(), from, repair_meta_id, ks_name, cf_name, schema_version, range, seed, static_cast<int>(hash_version), max_row_buf_size, unrepaired_only);
+        return insert_repair_meta(from, src_cpu_id, repair_meta_id, std::move(range), algo, max_row_buf_size, seed, hash_version, std::move(master_node_shard_config), std::move(schema_version),
+                unrepaired_only);
     }
 
     // RPC API
@@ -1491,7 +1774,7 @@ class repair_meta {
     // RPC API
     // Return rows in the _working_row_buf with hash within the given sef_diff
     // Must run inside a seastar thread
-    void get_row_diff(std::unordered_set<repair_hash> set_diff, needs_all_rows_t needs_all_rows, gms::inet_address remote_node, unsigned node_idx) {
+    void get_row_diff(repair_hash_set set_diff, needs_all_rows_t needs_all_rows, gms::inet_address remote_node, unsigned node_idx) {
         if (needs_all_rows || !set_diff.empty()) {
             if (remote_node == _myip) {
                 return;
@@ -1560,11 +1843,11 @@ class repair_meta {
     }
 
     future<> get_row_diff_sink_op(
-            std::unordered_set<repair_hash> set_diff,
+            repair_hash_set set_diff,
             needs_all_rows_t needs_all_rows,
             rpc::sink<repair_hash_with_cmd>& sink,
             gms::inet_address remote_node) {
-        return do_with(std::move(set_diff), [needs_all_rows, remote_node, &sink] (std::unordered_set<repair_hash>& set_diff) mutable {
+        return do_with(std::move(set_diff), [needs_all_rows, remote_node, &sink] (repair_hash_set& set_diff) mutable {
             if (inject_rpc_stream_error) {
                 return make_exception_future<>(std::runtime_error("get_row_diff: Inject sender error in sink loop"));
             }
@@ -1591,7 +1874,7 @@ class repair_meta {
 public:
     // Must run inside a seastar thread
     void get_row_diff_with_rpc_stream(
-            std::unordered_set<repair_hash> set_diff,
+            repair_hash_set set_diff,
             needs_all_rows_t needs_all_rows,
             update_peer_row_hash_sets update_hash_set,
             gms::inet_address remote_node,
@@ -1617,7 +1900,7 @@ class repair_meta {
     }
 
     // RPC handler
-    future<repair_rows_on_wire> get_row_diff_handler(std::unordered_set<repair_hash> set_diff, needs_all_rows_t needs_all_rows) {
+    future<repair_rows_on_wire> get_row_diff_handler(repair_hash_set set_diff, needs_all_rows_t needs_all_rows) {
         return with_gate(_gate, [this, set_diff = std::move(set_diff), needs_all_rows] () mutable {
             return get_row_diff(std::move(set_diff), needs_all_rows).then([this] (std::list<repair_row> row_diff) {
                 return to_repair_rows_on_wire(std::move(row_diff));
@@ -1627,7 +1910,7 @@ class repair_meta {
 
     // RPC API
     // Send rows in the _working_row_buf with hash within the given sef_diff
-    future<> put_row_diff(std::unordered_set<repair_hash> set_diff, needs_all_rows_t needs_all_rows, gms::inet_address remote_node) {
+    future<> put_row_diff(repair_hash_set set_diff, needs_all_rows_t needs_all_rows, gms::inet_address remote_node) {
         if (!set_diff.empty()) {
             if (remote_node == _myip) {
                 return make_ready_future<>();
@@ -1702,7 +1985,7 @@ class repair_meta {
 
 public:
     future<> put_row_diff_with_rpc_stream(
-            std::unordered_set<repair_hash> set_diff,
+            repair_hash_set set_diff,
             needs_all_rows_t needs_all_rows,
             gms::inet_address remote_node, unsigned node_idx) {
         if (!set_diff.empty()) {
@@ -1751,7 +2034,7 @@ static future<stop_iteration> repair_get_row_diff_with_rpc_stream_process_op(
         rpc::sink<repair_row_on_wire_with_cmd> sink,
         rpc::source<repair_hash_with_cmd> source,
         bool &error,
-        std::unordered_set<repair_hash>& current_set_diff,
+        repair_hash_set& current_set_diff,
         std::optional<std::tuple<repair_hash_with_cmd>> hash_cmd_opt) {
     repair_hash_with_cmd hash_cmd = std::get<0>(hash_cmd_opt.value());
     rlogger.trace("Got repair_hash_with_cmd from peer={}, hash={}, cmd={}", from, hash_cmd.hash, int(hash_cmd.cmd));
@@ -1763,7 +2046,7 @@ static future<stop_iteration> repair_get_row_diff_with_rpc_stream_process_op(
             return make_exception_future<stop_iteration>(std::runtime_error("get_row_diff_with_rpc_stream: Inject error in handler loop"));
         }
         bool needs_all_rows = hash_cmd.cmd == repair_stream_cmd::needs_all_rows;
-        auto fp = make_foreign(std::make_unique<std::unordered_set<repair_hash>>(std::move(current_set_diff)));
+        auto fp = make_foreign(std::make_unique<repair_hash_set>(std::move(current_set_diff)));
         return smp::submit_to(src_cpu_id % smp::count, [from, repair_meta_id, needs_all_rows, fp = std::move(fp)] {
             auto rm = repair_meta::get_repair_meta(from, repair_meta_id);
             if (fp.get_owner_shard() == engine().cpu_id()) {
@@ -1841,12 +2124,12 @@ static future<stop_iteration> repair_get_full_row_hashes_with_rpc_stream_process
     if (status == repair_stream_cmd::get_full_row_hashes) {
         return smp::submit_to(src_cpu_id % smp::count, [from, repair_meta_id] {
             auto rm = repair_meta::get_repair_meta(from, repair_meta_id);
-            return rm->get_full_row_hashes_handler().then([] (std::unordered_set<repair_hash> hashes) {
+            return rm->get_full_row_hashes_handler().then([] (repair_hash_set hashes) {
                 _metrics.tx_hashes_nr += hashes.size();
                 return hashes;
             });
-        }).then([sink] (std::unordered_set<repair_hash> hashes) mutable {
-            return do_with(std::move(hashes), [sink] (std::unordered_set<repair_hash>& hashes) mutable {
+        }).then([sink] (repair_hash_set hashes) mutable {
+            return do_with(std::move(hashes), [sink] (repair_hash_set& hashes) mutable {
                 return do_for_each(hashes, [sink] (const repair_hash& hash) mutable {
                     return sink(repair_hash_with_cmd{repair_stream_cmd::hash_data, hash});
                 }).then([sink] () mutable {
@@ -1869,7 +2152,7 @@ static future<> repair_get_row_diff_with_rpc_stream_handler(
         uint32_t repair_meta_id,
         rpc::sink<repair_row_on_wire_with_cmd> sink,
         rpc::source<repair_hash_with_cmd> source) {
-    return do_with(false, std::unordered_set<repair_hash>(), [from, src_cpu_id, repair_meta_id, sink, source] (bool& error, std::unordered_set<repair_hash>& current_set_diff) mutable {
+    return do_with(false, repair_hash_set(), [from, src_cpu_id, repair_meta_id, sink, source] (bool& error, repair_hash_set& current_set_diff) mutable {
         return repeat([from, src_cpu_id, repair_meta_id, sink, source, &error, &current_set_diff] () mutable {
             return source().then([from, src_cpu_id, repair_meta_id, sink, source, &error, &current_set_diff] (std::optional<std::tuple<repair_hash_with_cmd>> hash_cmd_opt) mutable {
                 if (hash_cmd_opt) {
@@ -2036,12 +2319,20 @@ future<> repair_init_messaging_service_handler(repair_service& rs, distributed<d
             auto from = cinfo.retrieve_auxiliary<gms::inet_address>("baddr");
             return smp::submit_to(src_cpu_id % smp::count, [from, repair_meta_id] {
                 auto rm = repair_meta::get_repair_meta(from, repair_meta_id);
-                return rm->get_full_row_hashes_handler().then([] (std::unordered_set<repair_hash> hashes) {
+                return rm->get_full_row_hashes_handler().then([] (repair_hash_set hashes) {
                     _metrics.tx_hashes_nr += hashes.size();
                     return hashes;
                 });
             }) ;
         });
+        ms.register_repair_get_row_hash_ibf([] (const rpc::client_info& cinfo, uint32_t repair_meta_id, uint32_t nr_cells) {
+            auto src_cpu_id = cinfo.retrieve_auxiliary<uint32_t>("src_cpu_id");
+            auto from = cinfo.retrieve_auxiliary<gms::inet_address>("baddr");
+            return smp::submit_to(src_cpu_id % smp::count, [from, repair_meta_id, nr_cells] {
+                auto rm = repair_meta::get_repair_meta(from, repair_meta_id);
+                return rm->get_row_hash_ibf_handler(nr_cells);
+            });
+        });
         ms.register_repair_get_combined_row_hash([] (const rpc::client_info& cinfo, uint32_t repair_meta_id,
                 std::optional<repair_sync_boundary> common_sync_boundary) {
             auto src_cpu_id = cinfo.retrieve_auxiliary<uint32_t>("src_cpu_id");
@@ -2064,10 +2355,10 @@ future<> repair_init_messaging_service_handler(repair_service& rs, distributed<d
             });
         });
         ms.register_repair_get_row_diff([] (const rpc::client_info& cinfo, uint32_t repair_meta_id,
-                std::unordered_set<repair_hash> set_diff, bool needs_all_rows) {
+                repair_hash_set set_diff, bool needs_all_rows) {
             auto src_cpu_id = cinfo.retrieve_auxiliary<uint32_t>("src_cpu_id");
             auto from = cinfo.retrieve_auxiliary<gms::inet_address>("baddr");
-            auto fp = make_foreign(std::make_unique<std::unordered_set<repair_hash>>(std::move(set_diff)));
+            auto fp = make_foreign(std::make_unique<repair_hash_set>(std::move(set_diff)));
             return smp::submit_to(src_cpu_id % smp::count, [from, repair_meta_id, fp = std::move(fp), needs_all_rows] () mutable {
                 auto rm = repair_meta::get_repair_meta(from, repair_meta_id);
                 if (fp.get_owner_shard() == engine().cpu_id()) {
@@ -2093,15 +2384,25 @@ future<> repair_init_messaging_service_handler(repair_service& rs, distributed<d
         });
         ms.register_repair_row_level_start([] (const rpc::client_info& cinfo, uint32_t repair_meta_id, sstring ks_name,
                 sstring cf_name, dht::token_range range, row_level_diff_detect_algorithm algo, uint64_t max_row_buf_size, uint64_t seed,
-                unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version) {
+                unsigned remote_shard, unsigned remote_shard_count, unsigned remote_ignore_msb, sstring remote_partitioner_name, table_schema_version schema_version,
+                rpc::optional<bool> incremental, rpc::optional<repair_checksum> hash_version, rpc::optional<uint64_t> repaired_at) {
             auto src_cpu_id = cinfo.retrieve_auxiliary<uint32_t>("src_cpu_id");
             auto from = cinfo.retrieve_auxiliary<gms::inet_address>("baddr");
-            return smp::submit_to(src_cpu_id % smp::count, [from, src_cpu_id, repair_meta_id, ks_name, cf_name,
-                    range, algo, max_row_buf_size, seed, remote_shard, remote_shard_count, remote_ignore_msb, remote_partitioner_name, schema_version] () mutable {
+            auto unrepaired_only = read_unrepaired_only(incremental.value_or(false));
+            auto hv = hash_version.value_or(repair_checksum::legacy);
+            // A repaired_at of 0 means the master doesn't mark anything.
+            auto f = unrepaired_only && repaired_at.value_or(0)
+                    ? repair_record_unrepaired_sstables(service::get_local_storage_service().db(), from, ks_name, cf_name, *repaired_at)
+                    : make_ready_future<>();
+            return f.then([from, src_cpu_id, repair_meta_id, ks_name, cf_name, range, algo, max_row_buf_size, seed, hv,
+                    remote_shard, remote_shard_count, remote_ignore_msb, remote_partitioner_name, schema_version, unrepaired_only] () mutable {
+              return smp::submit_to(src_cpu_id % smp::count, [from, src_cpu_id, repair_meta_id, ks_name, cf_name,
+                    range, algo, max_row_buf_size, seed, hv, remote_shard, remote_shard_count, remote_ignore_msb, remote_partitioner_name, schema_version, unrepaired_only] () mutable {
                 return repair_meta::repair_row_level_start_handler(from, src_cpu_id, repair_meta_id, std::move(ks_name),
-                        std::move(cf_name), std::move(range), algo, max_row_buf_size, seed,
+                        std::move(cf_name), std::move(range), algo, max_row_buf_size, seed, hv,
                         shard_config{remote_shard, remote_shard_count, remote_ignore_msb, std::move(remote_partitioner_name)},
-                        schema_version);
+                        schema_version, unrepaired_only);
+              });
             });
         });
         ms.register_repair_row_level_stop([] (const rpc::client_info& cinfo, uint32_t repair_meta_id,
@@ -2131,6 +2432,12 @@ future<> repair_init_messaging_service_handler(repair_service& rs, distributed<d
         ms.register_repair_get_diff_algorithms([] (const rpc::client_info& cinfo) {
             return make_ready_future<std::vector<row_level_diff_detect_algorithm>>(suportted_diff_detect_algorithms());
         });
+        ms.register_repair_mark_sstables_repaired([] (const rpc::client_info& cinfo, sstring ks_name, std::vector<utils::UUID> table_ids,
+                dht::token_range_vector ranges, uint64_t repaired_at) {
+            auto from = cinfo.retrieve_auxiliary<gms::inet_address>("baddr");
+            rlogger.info("Got repair_mark_sstables_repaired from peer={}, keyspace={}, repaired_at={}", from, ks_name, repaired_at);
+            return repair_mark_sstables_repaired(service::get_local_storage_service().db(), from, std::move(table_ids), std::move(ranges), repaired_at);
+        });
     });
 }
 
@@ -2183,6 +2490,9 @@ class row_level_repair {
     // the next repair.
     uint64_t _seed;
 
+    // The row hash function, XXH3 once all nodes support it.
+    repair_checksum _hash_version;
+
 public:
     row_level_repair(repair_info& ri,
             sstring cf_name,
@@ -2194,7 +2504,9 @@ class row_level_repair {
         , _all_live_peer_nodes(std::move(all_live_peer_nodes))
         , _cf(_ri.db.local().find_column_family(_ri.keyspace, _cf_name))
         , _all_nodes(_all_live_peer_nodes)
-        , _seed(get_random_seed()) {
+        , _seed(get_random_seed())
+        , _hash_version(service::get_local_storage_service().cluster_supports_row_level_repair_xxh3()
+                ? repair_checksum::xxh3 : repair_checksum::legacy) {
     }
 
 private:
@@ -2279,6 +2591,7 @@ class row_level_repair {
         // moved from the `_row_buf` to `_working_row_buf`.
         std::vector<repair_hash> combined_hashes;
         combined_hashes.resize(_all_nodes.size());
+        std::vector<uint64_t> rows_nr(_all_nodes.size());
         parallel_for_each(boost::irange(size_t(0), _all_nodes.size()), [&, this] (size_t idx) {
             // Request combined hashes from all nodes between (_last_sync_boundary, _current_sync_boundary]
             // Each node will
@@ -2294,6 +2607,7 @@ class row_level_repair {
             return master.get_combined_row_hash(_common_sync_boundary, _all_nodes[idx]).then([&, this, idx] (get_combined_row_hash_response resp) {
                 rlogger.debug("Calling master.get_combined_row_hash for node {}, got combined_hash={}, rows_nr={}", _all_nodes[idx], resp.working_row_buf_combined_csum, resp.working_row_buf_nr);
                 combined_hashes[idx]= std::move(resp.working_row_buf_combined_csum);
+                rows_nr[idx] = resp.working_row_buf_nr;
             });
         }).get();
 
@@ -2345,25 +2659,37 @@ class row_level_repair {
                 continue;
             }
 
-            rlogger.debug("Before master.get_full_row_hashes for node {}, hash_sets={}",
-                node, master.peer_row_hash_sets(node_idx).size());
-            // Ask the peer to send the full list hashes in the working row buf.
-            if (master.use_rpc_stream()) {
-                master.peer_row_hash_sets(node_idx) = master.get_full_row_hashes_with_rpc_stream(node, node_idx).get0();
+            // If the replicas are mostly in sync, the difference between
+            // the row hashes can be found by exchanging an IBF much smaller
+            // than the full list of hashes.
+            std::optional<repair_hash_set> ibf_set_diff;
+            if (master.use_ibf()) {
+                ibf_set_diff = master.get_set_diff_with_ibf(node, node_idx, rows_nr[node_idx + 1]);
+            }
+            repair_hash_set set_diff;
+            if (ibf_set_diff) {
+                set_diff = std::move(*ibf_set_diff);
             } else {
-                master.peer_row_hash_sets(node_idx) = master.get_full_row_hashes(node).get0();
+                rlogger.debug("Before master.get_full_row_hashes for node {}, hash_sets={}",
+                    node, master.peer_row_hash_sets(node_idx).size());
+                // Ask the peer to send the full list hashes in the working row buf.
+                if (master.use_rpc_stream()) {
+                    master.peer_row_hash_sets(node_idx) = master.get_full_row_hashes_with_rpc_stream(node, node_idx).get0();
+                } else {
+                    master.peer_row_hash_sets(node_idx) = master.get_full_row_hashes(node).get0();
+                }
+                rlogger.debug("After master.get_full_row_hashes for node {}, hash_sets={}",
+                    node, master.peer_row_hash_sets(node_idx).size());
+
+                // With hashes of rows from peer node, we can figure out
+                // what rows repair master is missing. Note we get missing
+                // data from repair follower 1, apply the rows, then get
+                // missing data from repair follower 2 and so on. We do it
+                // sequentially because the rows from repair follower 1 to
+                // repair master might reduce the amount of missing data
+                // between repair master and repair follower 2.
+                set_diff = repair_meta::get_set_diff(master.peer_row_hash_sets(node_idx), master.working_row_hashes().get0());
             }
-            rlogger.debug("After master.get_full_row_hashes for node {}, hash_sets={}",
-                node, master.peer_row_hash_sets(node_idx).size());
-
-            // With hashes of rows from peer node, we can figure out
-            // what rows repair master is missing. Note we get missing
-            // data from repair follower 1, apply the rows, then get
-            // missing data from repair follower 2 and so on. We do it
-            // sequentially because the rows from repair follower 1 to
-            // repair master might reduce the amount of missing data
-            // between repair master and repair follower 2.
-            std::unordered_set<repair_hash> set_diff = repair_meta::get_set_diff(master.peer_row_hash_sets(node_idx), master.working_row_hashes().get0());
             // Request missing sets from peer node
             rlogger.debug("Before get_row_diff to node {}, local={}, peer={}, set_diff={}",
                     node, master.working_row_hashes().get0().size(), master.peer_row_hash_sets(node_idx).size(), set_diff.size());
@@ -2386,9 +2712,9 @@ class row_level_repair {
         // So we can figure out which rows peer node are missing and send the missing rows to them
         check_in_shutdown();
         _ri.check_in_abort();
-        std::unordered_set<repair_hash> local_row_hash_sets = master.working_row_hashes().get0();
+        repair_hash_set local_row_hash_sets = master.working_row_hashes().get0();
         auto sz = _all_live_peer_nodes.size();
-        std::vector<std::unordered_set<repair_hash>> set_diffs(sz);
+        std::vector<repair_hash_set> set_diffs(sz);
         for (size_t idx : boost::irange(size_t(0), sz)) {
             set_diffs[idx] = repair_meta::get_set_diff(local_row_hash_sets, master.peer_row_hash_sets(idx));
         }
@@ -2429,9 +2755,11 @@ class row_level_repair {
                     algorithm,
                     max_row_buf_size,
                     _seed,
+                    _hash_version,
                     repair_meta::repair_master::yes,
                     repair_meta_id,
                     std::move(master_node_shard_config),
+                    read_unrepaired_only(_ri.incremental),
                     _all_live_peer_nodes.size());
 
             // All nodes including the node itself.
@@ -2443,7 +2771,10 @@ class row_level_repair {
 
             try {
                 parallel_for_each(_all_nodes, [&, this] (const gms::inet_address& node) {
-                    return master.repair_row_level_start(node, _ri.keyspace, _cf_name, _range, schema_version).then([&] () {
+                    // The followers record the sstables they are going to
+                    // read, which are marked once the repair is done.
+                    auto repaired_at = _ri.mark_repaired ? _ri.repaired_at : 0;
+                    return master.repair_row_level_start(node, _ri.keyspace, _cf_name, _range, schema_version, repaired_at).then([&] () {
                         return master.repair_get_estimated_partitions(node).then([this, node] (uint64_t partitions) {
                             rlogger.trace("Get repair_get_estimated_partitions for node={}, estimated_partitions={}", node, partitions);
                             _estimated_partitions += partitions;
@@ -2508,6 +2839,7 @@ class row_level_repair_gossip_helper : public gms::i_endpoint_state_change_subsc
     void remove_row_level_repair(gms::inet_address node) {
         rlogger.debug("Started to remove row level repair on all shards for node {}", node);
         smp::invoke_on_all([node] {
+            repair_forget_unrepaired_sstables(node);
             return repair_meta::remove_repair_meta(node);
         }).then([node] {
             rlogger.debug("Finished to remove row level repair on all shards for node {}", node);
@@ -27,6 +27,7 @@
 #include <seastar/core/sstring.hh>
 #include <unordered_map>
 #include <optional>
+#include <cstring>
 #include "enum_set.hh"
 #include "utils/managed_bytes.hh"
 #include "bytes_ostream.hh"
@@ -223,6 +224,26 @@ template<> struct serializer<int32_t> : public integral_serializer<int32_t> {};
 template<> struct serializer<uint32_t> : public integral_serializer<uint32_t> {};
 template<> struct serializer<int64_t> : public integral_serializer<int64_t> {};
 template<> struct serializer<uint64_t> : public integral_serializer<uint64_t> {};
+template<> struct serializer<float> {
+    template <typename Input>
+    static float read(Input& i) {
+        auto bits = deserialize_integral<uint32_t>(i);
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+    template <typename Output>
+    static void write(Output& out, float v) {
+        static_assert(sizeof(float) == sizeof(uint32_t), "float should be 32 bits wide");
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        serialize_integral(out, bits);
+    }
+    template <typename Input>
+    static void skip(Input& i) {
+        read(i);
+    }
+};
 
 template<typename Output>
 void safe_serialize_as_uint32(Output& output, uint64_t data);
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+#include <seastar/core/lowres_clock.hh>
+
+#include "gms/inet_address.hh"
+#include "seastarx.hh"
+#include "utils/latency.hh"
+
+namespace service {
+
+/// Per-endpoint load as observed by a coordinator.
+///
+/// Used for adaptive replica selection: replicas are ranked by a score
+/// derived from the C3 algorithm (Suresh et al., "C3: Cutting Tail Latency
+/// in Cloud Data Stores via Adaptive Replica Selection"), combining the
+/// smoothed response time with the number of requests this coordinator has
+/// outstanding to the replica and the queue length the replica reported in
+/// its last response.
+///
+/// The tracker is shard-local and is not thread safe.
+class endpoint_load_tracker {
+public:
+    // Dates the statistics, which are only compared with a staleness
+    // threshold of the order of a second.
+    using clock_type = lowres_clock;
+    using latency_clock = utils::latency_counter::clock;
+private:
+    struct endpoint_load {
+        // Exponentially weighted moving average of response latency, in microseconds.
+        double latency_ewma = 0;
+        // Exponentially weighted moving average of the queue length reported by the replica.
+        double queue_ewma = 0;
+        // Requests sent by this shard which haven't completed yet.
+        uint32_t outstanding = 0;
+        clock_type::time_point last_updated;
+        bool has_latency = false;
+    };
+
+    std::unordered_map<gms::inet_address, endpoint_load> _endpoints;
+    // Weight of a new sample in the moving averages.
+    double _alpha;
+    // Statistics which were not refreshed for this long are ignored when
+    // ranking, so that a replica which was avoided gets probed again.
+    clock_type::duration _stale_after;
+    // A failed or timed out request is accounted as a response which took
+    // at least this long, so that a replica which fails requests is avoided.
+    latency_clock::duration _failure_latency;
+
+    void add_latency_sample(endpoint_load& e, latency_clock::duration latency, clock_type::time_point now) {
+        auto us = std::chrono::duration<double, std::micro>(latency).count();
+        e.latency_ewma = e.has_latency ? _alpha * us + (1 - _alpha) * e.latency_ewma : us;
+        e.has_latency = true;
+        e.last_updated = now;
+    }
+public:
+    explicit endpoint_load_tracker(double alpha = 0.75, clock_type::duration stale_after = std::chrono::seconds(1),
+            latency_clock::duration failure_latency = std::chrono::seconds(1))
+        : _alpha(alpha)
+        , _stale_after(stale_after)
+        , _failure_latency(failure_latency) {
+    }
+
+    /// Called before a request is sent to `ep`.
+    void request_sent(gms::inet_address ep) {
+        ++_endpoints[ep].outstanding;
+    }
+
+    /// Called when a request to `ep` completed after `latency`.
+    ///
+    /// \param queue_length queue length piggybacked on the response, if the
+    ///     replica provided one.
+    void request_completed(gms::inet_address ep, latency_clock::duration latency, std::optional<uint32_t> queue_length,
+            clock_type::time_point now = clock_type::now()) {
+        auto& e = _endpoints[ep];
+        if (e.outstanding) {
+            --e.outstanding;
+        }
+        add_latency_sample(e, latency, now);
+        if (queue_length) {
+            e.queue_ewma = _alpha * *queue_length + (1 - _alpha) * e.queue_ewma;
+        }
+    }
+
+    /// Called when a request to `ep` failed or timed out after `latency`.
+    /// It counts as a response which took at least the failure latency.
+    void request_failed(gms::inet_address ep, latency_clock::duration latency, clock_type::time_point now = clock_type::now()) {
+        auto& e = _endpoints[ep];
+        if (e.outstanding) {
+            --e.outstanding;
+        }
+        add_latency_sample(e, std::max(latency, _failure_latency), now);
+    }
+
+    /// Tracks a single request to an endpoint.
+    ///
+    /// The request is accounted as failed when destroyed before complete()
+    /// is called, so it can simply be captured by the continuation handling
+    /// the response.
+    class request {
+        endpoint_load_tracker* _tracker;
+        gms::inet_address _ep;
+        utils::latency_counter _latency;
+    public:
+        request(endpoint_load_tracker& tracker, gms::inet_address ep)
+            : _tracker(&tracker)
+            , _ep(ep) {
+            _latency.start();
+            _tracker->request_sent(_ep);
+        }
+        request(request&& o) noexcept
+            : _tracker(std::exchange(o._tracker, nullptr))
+            , _ep(o._ep)
+            , _latency(o._latency) {
+        }
+        request& operator=(request&&) = delete;
+        ~request() {
+            if (_tracker) {
+                _tracker->request_failed(_ep, _latency.stop().latency());
+            }
+        }
+        void complete(std::optional<uint32_t> queue_length = {}) {
+            if (_tracker) {
+                std::exchange(_tracker, nullptr)->request_completed(_ep, _latency.stop().latency(), queue_length);
+            }
+        }
+    };
+
+    request start_request(gms::inet_address ep) {
+        return request(*this, ep);
+    }
+
+    void remove_endpoint(gms::inet_address ep) {
+        _endpoints.erase(ep);
+    }
+
+    /// Score of `ep`, lower is better.
+    ///
+    /// Endpoints we know nothing about score 0, so that they are preferred
+    /// and their statistics get refreshed. So do endpoints whose statistics
+    /// went stale, unless requests to them are still outstanding.
+    double score(gms::inet_address ep, clock_type::time_point now = clock_type::now()) const {
+        auto it = _endpoints.find(ep);
+        if (it == _endpoints.end()) {
+            return 0;
+        }
+        auto& e = it->second;
+        if (!e.has_latency || now - e.last_updated > _stale_after) {
+            // The queue length the replica reported is out of date, but the
+            // requests still outstanding to it are not: a replica which
+            // stopped responding must not look idle.
+            auto prior = e.has_latency ? e.latency_ewma : std::chrono::duration<double, std::micro>(_failure_latency).count();
+            auto q = 1.0 + e.outstanding;
+            return prior * (q * q * q - 1);
+        }
+        // C3's cubic queue-size estimate penalizes long queues much more
+        // than a slightly higher latency, which is what cuts the tail.
+        auto q = 1 + e.outstanding + e.queue_ewma;
+        return e.latency_ewma * q * q * q;
+    }
+
+    /// Stable-sorts [begin, end) by ascending score.
+    template <typename Iterator>
+    void sort_by_score(Iterator begin, Iterator end, clock_type::time_point now = clock_type::now()) const {
+        std::stable_sort(begin, end, [this, now] (const gms::inet_address& a, const gms::inet_address& b) {
+            return score(a, now) < score(b, now);
+        });
+    }
+};
+
+}
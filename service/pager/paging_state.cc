@@ -48,12 +48,14 @@
 #include "idl/paging_state.dist.hh"
 #include "idl/token.dist.hh"
 #include "idl/range.dist.hh"
+#include "idl/ring_position.dist.hh"
 #include "serializer_impl.hh"
 #include "idl/keys.dist.impl.hh"
 #include "idl/uuid.dist.impl.hh"
 #include "idl/paging_state.dist.impl.hh"
 #include "idl/token.dist.impl.hh"
 #include "idl/range.dist.impl.hh"
+#include "idl/ring_position.dist.impl.hh"
 #include "message/messaging_service.hh"
 
 service::pager::paging_state::paging_state(partition_key pk,
@@ -62,29 +64,39 @@ service::pager::paging_state::paging_state(partition_key pk,
         utils::UUID query_uuid,
         replicas_per_token_range last_replicas,
         std::optional<db::read_repair_decision> query_read_repair_decision,
-        uint32_t rows_fetched_for_last_partition)
+        uint32_t rows_fetched_for_last_partition,
+        std::vector<parallel_scan_range> parallel_scan_ranges,
+        std::optional<dht::partition_range::bound> unscanned_from,
+        std::optional<float> estimated_result_rows_per_range)
     : _partition_key(std::move(pk))
     , _clustering_key(std::move(ck))
     , _remaining(rem)
     , _query_uuid(query_uuid)
     , _last_replicas(std::move(last_replicas))
     , _query_read_repair_decision(query_read_repair_decision)
-    , _rows_fetched_for_last_partition(rows_fetched_for_last_partition) {
+    , _rows_fetched_for_last_partition(rows_fetched_for_last_partition)
+    , _parallel_scan_ranges(std::move(parallel_scan_ranges))
+    , _unscanned_from(std::move(unscanned_from))
+    , _estimated_result_rows_per_range(estimated_result_rows_per_range) {
 }
 
 ::shared_ptr<service::pager::paging_state> service::pager::paging_state::deserialize(
-        bytes_opt data) {
+        std::optional<bytes_view> data) {
     if (!data) {
         return nullptr;
     }
 
-    if (data.value().size() < sizeof(uint32_t) || le_to_cpu(*unaligned_cast<int32_t*>(data.value().begin())) != netw::messaging_service::current_version) {
+    int32_t version = 0;
+    if (data->size() >= sizeof(version)) {
+        std::copy_n(data->begin(), sizeof(version), reinterpret_cast<int8_t*>(&version));
+    }
+    if (data->size() < sizeof(version) || le_to_cpu(version) != netw::messaging_service::current_version) {
         throw exceptions::protocol_exception("Invalid value for the paging state");
     }
 
 
     // skip 4 bytes that contain format id
-    seastar::simple_input_stream in(reinterpret_cast<char*>(data.value().begin() + sizeof(uint32_t)), data.value().size() - sizeof(uint32_t));
+    seastar::simple_input_stream in(reinterpret_cast<const char*>(data->begin() + sizeof(uint32_t)), data->size() - sizeof(uint32_t));
 
     try {
         return ::make_shared<paging_state>(ser::deserialize(in, boost::type<paging_state>()));
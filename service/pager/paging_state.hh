@@ -42,6 +42,7 @@
 #pragma once
 
 #include <optional>
+#include <cmath>
 
 #include "bytes.hh"
 #include "keys.hh"
@@ -53,6 +54,18 @@ namespace service {
 
 namespace pager {
 
+/**
+ * A sub-range of the queried ranges which a parallel scan is reading.
+ *
+ * The range starts after the last row returned from it. When that row was in
+ * the middle of a partition, the range starts with that partition, and
+ * last_clustering_key is the key of the last row returned from it.
+ */
+struct parallel_scan_range {
+    dht::partition_range range;
+    std::optional<clustering_key> last_clustering_key;
+};
+
 class paging_state final {
 public:
     using replicas_per_token_range = std::unordered_map<dht::token_range, std::vector<utils::UUID>>;
@@ -65,6 +78,9 @@ class paging_state final {
     replicas_per_token_range _last_replicas;
     std::optional<db::read_repair_decision> _query_read_repair_decision;
     uint32_t _rows_fetched_for_last_partition;
+    std::vector<parallel_scan_range> _parallel_scan_ranges;
+    std::optional<dht::partition_range::bound> _unscanned_from;
+    std::optional<float> _estimated_result_rows_per_range;
 
 public:
     paging_state(partition_key pk,
@@ -73,7 +89,10 @@ class paging_state final {
             utils::UUID reader_recall_uuid,
             replicas_per_token_range last_replicas,
             std::optional<db::read_repair_decision> query_read_repair_decision,
-            uint32_t rows_fetched_for_last_partition);
+            uint32_t rows_fetched_for_last_partition,
+            std::vector<parallel_scan_range> parallel_scan_ranges = {},
+            std::optional<dht::partition_range::bound> unscanned_from = {},
+            std::optional<float> estimated_result_rows_per_range = {});
 
     void set_partition_key(partition_key pk) {
         _partition_key = std::move(pk);
@@ -156,7 +175,47 @@ class paging_state final {
         return _query_read_repair_decision;
     }
 
-    static ::shared_ptr<paging_state> deserialize(bytes_opt bytes);
+    /**
+     * The sub-ranges a parallel scan is in the middle of.
+     *
+     * A parallel scan reads several sub-ranges of the queried ranges at the
+     * same time and fills each page from all of them, so a single position
+     * is not enough to tell where it is. The partition and clustering keys
+     * are not used by such scans.
+     */
+    const std::vector<parallel_scan_range>& get_parallel_scan_ranges() const {
+        return _parallel_scan_ranges;
+    }
+
+    /**
+     * Where the part of the queried ranges that a parallel scan has not
+     * started reading yet begins. Disengaged if there is no such part.
+     */
+    const std::optional<dht::partition_range::bound>& get_unscanned_from() const {
+        return _unscanned_from;
+    }
+
+    /**
+     * The number of result rows per vnode range a range scan expects, as
+     * estimated by the coordinator of the first page.
+     *
+     * The estimate is based on the sstables of the table and is costly to
+     * compute, so it is done once per query and reused by the following pages.
+     * The paging state comes from the client, so an estimate which can't be
+     * valid is dropped, and computed again.
+     */
+    std::optional<float> get_estimated_result_rows_per_range() const {
+        if (_estimated_result_rows_per_range && (!std::isfinite(*_estimated_result_rows_per_range) || *_estimated_result_rows_per_range < 0)) {
+            return std::nullopt;
+        }
+        return _estimated_result_rows_per_range;
+    }
+
+    bool is_parallel_scan() const {
+        return !_parallel_scan_ranges.empty() || _unscanned_from;
+    }
+
+    static ::shared_ptr<paging_state> deserialize(std::optional<bytes_view> bytes);
     bytes_opt serialize() const;
 };
 
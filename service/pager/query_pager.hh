@@ -89,6 +89,7 @@ class query_pager {
     paging_state::replicas_per_token_range _last_replicas;
     std::optional<db::read_repair_decision> _query_read_repair_decision;
     uint32_t _rows_fetched_for_last_partition = 0;
+    std::optional<float> _estimated_result_rows_per_range;
 public:
     query_pager(schema_ptr s, shared_ptr<const cql3::selection::selection> selection,
                 service::query_state& state,
@@ -110,7 +111,7 @@ class query_pager {
      */
     virtual future<> fetch_page(cql3::selection::result_set_builder&, uint32_t page_size, gc_clock::time_point, db::timeout_clock::time_point timeout);
 
-    future<cql3::result_generator> fetch_page_generator(uint32_t page_size, gc_clock::time_point now, db::timeout_clock::time_point timeout, cql3::cql_stats& stats);
+    virtual future<cql3::result_generator> fetch_page_generator(uint32_t page_size, gc_clock::time_point now, db::timeout_clock::time_point timeout, cql3::cql_stats& stats);
 
     /**
      * Whether or not this pager is exhausted, i.e. whether or not a call to
@@ -139,7 +140,7 @@ class query_pager {
      * @return the current paging state. If the pager is exhausted, the result is a valid pointer
      * to a paging_state instance which will return 0 on calling get_remaining() on it.
      */
-    ::shared_ptr<const paging_state> state() const;
+    virtual ::shared_ptr<const paging_state> state() const;
 
 protected:
     template<typename Base>
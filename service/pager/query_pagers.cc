@@ -44,8 +44,11 @@
 #include "cql3/selection/selection.hh"
 #include "log.hh"
 #include "service/storage_proxy.hh"
+#include "service/storage_service.hh"
 #include "to_string.hh"
 
+#include <boost/range/irange.hpp>
+
 static logging::logger qlogger("paging");
 
 namespace service::pager {
@@ -58,6 +61,10 @@ struct noop_visitor {
     uint32_t accept_partition_end(const query::result_row_view& static_row) { return 0; }
 };
 
+// Like noop_visitor, but makes handle_result() walk the rows so that the
+// rows fetched for the last partition are accounted for.
+struct row_counting_visitor : public noop_visitor { };
+
 static bool has_clustering_keys(const schema& s, const query::read_command& cmd) {
     return s.clustering_key_size() > 0
             && !cmd.slice.options.contains<query::partition_slice::option::distinct>();
@@ -91,6 +98,7 @@ static bool has_clustering_keys(const schema& s, const query::read_command& cmd)
             _last_replicas = state->get_last_replicas();
             _query_read_repair_decision = state->get_query_read_repair_decision();
             _rows_fetched_for_last_partition = state->get_rows_fetched_for_last_partition();
+            _estimated_result_rows_per_range = state->get_estimated_result_rows_per_range();
         } else {
             _cmd->query_uuid = utils::make_random_uuid();
             _cmd->is_first_page = true;
@@ -189,13 +197,15 @@ static bool has_clustering_keys(const schema& s, const query::read_command& cmd)
                 std::move(command),
                 std::move(ranges),
                 _options.get_consistency(),
-                {timeout, _state.get_permit(), _state.get_client_state(), _state.get_trace_state(), std::move(_last_replicas), _query_read_repair_decision});
+                {timeout, _state.get_permit(), _state.get_client_state(), _state.get_trace_state(), std::move(_last_replicas), _query_read_repair_decision,
+                        _estimated_result_rows_per_range});
     }
 
     future<> query_pager::fetch_page(cql3::selection::result_set_builder& builder, uint32_t page_size, gc_clock::time_point now, db::timeout_clock::time_point timeout) {
         return do_fetch_page(page_size, now, timeout).then([this, &builder, page_size, now] (service::storage_proxy::coordinator_query_result qr) {
             _last_replicas = std::move(qr.last_replicas);
             _query_read_repair_decision = qr.read_repair_decision;
+            _estimated_result_rows_per_range = qr.estimated_result_rows_per_range;
             handle_result(cql3::selection::result_set_builder::visitor(builder, *_schema, *_selection),
                           std::move(qr.query_result), page_size, now);
         });
@@ -217,7 +227,12 @@ future<cql3::result_generator> query_pager::fetch_page_generator(uint32_t page_s
     return do_fetch_page(page_size, now, timeout).then([this, page_size, now, &stats] (service::storage_proxy::coordinator_query_result qr) {
         _last_replicas = std::move(qr.last_replicas);
         _query_read_repair_decision = qr.read_repair_decision;
-        handle_result(noop_visitor(), qr.query_result, page_size, now);
+        _estimated_result_rows_per_range = qr.estimated_result_rows_per_range;
+        if (_cmd->slice.partition_row_limit() < query::max_rows) {
+            handle_result(row_counting_visitor(), qr.query_result, page_size, now);
+        } else {
+            handle_result(noop_visitor(), qr.query_result, page_size, now);
+        }
         return cql3::result_generator(_schema, std::move(qr.query_result), _cmd, _selection, stats);
     });
 }
@@ -243,6 +258,7 @@ class filtering_query_pager : public query_pager {
         return do_fetch_page(page_size, now, timeout).then([this, &builder, page_size, now] (service::storage_proxy::coordinator_query_result qr) {
             _last_replicas = std::move(qr.last_replicas);
             _query_read_repair_decision = qr.read_repair_decision;
+            _estimated_result_rows_per_range = qr.estimated_result_rows_per_range;
             qr.query_result->ensure_counts();
             _stats.filtered_rows_read_total += *qr.query_result->row_count();
             handle_result(cql3::selection::result_set_builder::visitor(builder, *_schema, *_selection,
@@ -366,9 +382,240 @@ class query_pager::query_result_visitor : public Base {
     }
 
     ::shared_ptr<const paging_state> query_pager::state() const {
-        return ::make_shared<paging_state>(_last_pkey.value_or(partition_key::make_empty()), _last_ckey, _exhausted ? 0 : _max, _cmd->query_uuid, _last_replicas, _query_read_repair_decision, _rows_fetched_for_last_partition);
+        return ::make_shared<paging_state>(_last_pkey.value_or(partition_key::make_empty()), _last_ckey, _exhausted ? 0 : _max, _cmd->query_uuid, _last_replicas, _query_read_repair_decision, _rows_fetched_for_last_partition,
+                std::vector<parallel_scan_range>(), std::nullopt, _estimated_result_rows_per_range);
+    }
+
+// Pages a range scan by reading several sub-ranges of the queried ranges
+// concurrently, each with its own share of the page.
+//
+// The sub-ranges are vnode ranges, so the reads of a page are spread over
+// all the replicas, and the replicas read them on all their shards. The
+// paging state tracks every sub-range which is being read, and the rows are
+// returned in token order only within a sub-range.
+class parallel_scan_query_pager : public query_pager {
+    ::shared_ptr<cql3::restrictions::statement_restrictions> _filtering_restrictions;
+    cql3::cql_stats& _stats;
+    // The sub-ranges being read, in token order. _ranges hold the part of
+    // the queried ranges which no sub-range was split off from yet.
+    std::vector<parallel_scan_range> _scan_ranges;
+    bool _state_restored = false;
+public:
+    parallel_scan_query_pager(schema_ptr s, shared_ptr<const cql3::selection::selection> selection,
+                service::query_state& state,
+                const cql3::query_options& options,
+                lw_shared_ptr<query::read_command> cmd,
+                dht::partition_range_vector ranges,
+                ::shared_ptr<cql3::restrictions::statement_restrictions> filtering_restrictions,
+                cql3::cql_stats& stats)
+        : query_pager(s, selection, state, options, std::move(cmd), std::move(ranges))
+        , _filtering_restrictions(std::move(filtering_restrictions))
+        , _stats(stats)
+        {}
+    virtual ~parallel_scan_query_pager() {}
+
+    virtual future<> fetch_page(cql3::selection::result_set_builder& builder, uint32_t page_size, gc_clock::time_point now, db::timeout_clock::time_point timeout) override {
+        return read_sub_ranges(page_size, timeout).then([this, &builder] (foreign_ptr<lw_shared_ptr<query::result>> result) {
+            if (_filtering_restrictions) {
+                result->ensure_counts();
+                _stats.filtered_rows_read_total += *result->row_count();
+                consume_result(cql3::selection::result_set_builder::visitor(builder, *_schema, *_selection,
+                        cql3::selection::result_set_builder::restrictions_filter(_filtering_restrictions, _options, _max, _schema, query::max_rows)),
+                        *result);
+            } else {
+                consume_result(cql3::selection::result_set_builder::visitor(builder, *_schema, *_selection), *result);
+            }
+        });
+    }
+
+    virtual future<cql3::result_generator> fetch_page_generator(uint32_t page_size, gc_clock::time_point now, db::timeout_clock::time_point timeout, cql3::cql_stats& stats) override {
+        return read_sub_ranges(page_size, timeout).then([this, &stats] (foreign_ptr<lw_shared_ptr<query::result>> result) {
+            result->ensure_counts();
+            _max -= std::min(_max, *result->row_count());
+            update_exhausted();
+            return cql3::result_generator(_schema, std::move(result), _cmd, _selection, stats);
+        });
     }
 
+    virtual ::shared_ptr<const paging_state> state() const override {
+        std::optional<dht::partition_range::bound> unscanned_from;
+        if (!_ranges.empty()) {
+            unscanned_from = _ranges.front().start().value_or(dht::partition_range::bound(dht::ring_position::min()));
+        }
+        return ::make_shared<paging_state>(partition_key::make_empty(), std::nullopt, _exhausted ? 0 : _max, utils::UUID(),
+                _last_replicas, std::nullopt, 0, _scan_ranges, std::move(unscanned_from), _estimated_result_rows_per_range);
+    }
+
+private:
+    void restore_state() {
+        // The sub-ranges always continue from where they stopped, including
+        // when the scan is resumed from a paging state.
+        _cmd->slice.options.set<query::partition_slice::option::send_partition_key>();
+        if (_has_clustering_keys) {
+            _cmd->slice.options.set<query::partition_slice::option::send_clustering_key>();
+        }
+
+        auto state = _options.get_paging_state();
+        if (!state) {
+            return;
+        }
+        _max = state->get_remaining();
+        _last_replicas = state->get_last_replicas();
+        _estimated_result_rows_per_range = state->get_estimated_result_rows_per_range();
+        _scan_ranges = state->get_parallel_scan_ranges();
+        dht::partition_range_vector unscanned;
+        if (auto& from = state->get_unscanned_from()) {
+            dht::ring_position_comparator cmp(*_schema);
+            for (auto& r : _ranges) {
+                if (auto trimmed = r.trim_front(std::optional<dht::partition_range::bound>(*from), cmp)) {
+                    unscanned.push_back(std::move(*trimmed));
+                }
+            }
+        }
+        _ranges = std::move(unscanned);
+    }
+
+    // Splits the first `n` vnode ranges off the unscanned ranges.
+    void add_sub_ranges(size_t n) {
+        auto& ks = get_local_storage_proxy().get_db().local().find_keyspace(_schema->ks_name());
+        query_ranges_to_vnodes_generator ranges_to_vnodes(_schema, _ranges,
+                ks.get_replication_strategy().get_type() == locator::replication_strategy_type::local);
+        auto vnodes = ranges_to_vnodes(n);
+        if (vnodes.empty()) {
+            _ranges.clear();
+            return;
+        }
+
+        dht::partition_range_vector unscanned;
+        if (auto& end = vnodes.back().end()) {
+            dht::ring_position_comparator cmp(*_schema);
+            auto from = dht::partition_range::bound(end->value(), !end->is_inclusive());
+            for (auto& r : _ranges) {
+                if (auto trimmed = r.trim_front(std::optional<dht::partition_range::bound>(from), cmp)) {
+                    unscanned.push_back(std::move(*trimmed));
+                }
+            }
+        }
+        _ranges = std::move(unscanned);
+
+        for (auto& vnode : vnodes) {
+            _scan_ranges.push_back(parallel_scan_range{std::move(vnode), std::nullopt});
+        }
+    }
+
+    lw_shared_ptr<query::read_command> make_command(const parallel_scan_range& sr, uint32_t row_limit) const {
+        auto cmd = ::make_lw_shared<query::read_command>(*_cmd);
+        cmd->row_limit = row_limit;
+        // The sub-ranges are read concurrently, possibly from the same
+        // replicas, so their readers can't be saved under the query's id.
+        cmd->query_uuid = utils::UUID();
+        cmd->is_first_page = true;
+        if (sr.last_clustering_key && sr.range.start() && sr.range.start()->value().has_key()) {
+            auto& pk = *sr.range.start()->value().key();
+            query::clustering_row_ranges row_ranges = cmd->slice.default_row_ranges();
+            clustering_key_prefix ckp = clustering_key_prefix::from_exploded(*_schema, sr.last_clustering_key->explode(*_schema));
+            query::trim_clustering_row_ranges_to(*_schema, row_ranges, ckp, false);
+            cmd->slice.set_range(*_schema, pk, row_ranges);
+        }
+        return cmd;
+    }
+
+    // Moves the start of a sub-range past the rows in `result`. Returns false
+    // if the sub-range has no rows left.
+    bool advance(parallel_scan_range& sr, const query::result& result, uint32_t row_limit) const {
+        auto view = query::result_view(result);
+        auto row_count = result.row_count() ? *result.row_count() : std::get<1>(view.count_partitions_and_rows());
+        if (row_count < row_limit && !result.is_short_read()) {
+            return false;
+        }
+        if (!row_count) {
+            return true;
+        }
+        auto [last_pkey, last_ckey] = view.get_last_partition_and_clustering_key();
+        const bool has_ck = _has_clustering_keys && last_ckey;
+        auto dk = dht::global_partitioner().decorate_key(*_schema, last_pkey);
+        auto trimmed = sr.range.trim_front(dht::partition_range::bound(dht::ring_position(std::move(dk)), has_ck), dht::ring_position_comparator(*_schema));
+        if (!trimmed) {
+            return false;
+        }
+        sr.range = std::move(*trimmed);
+        sr.last_clustering_key = has_ck ? std::move(last_ckey) : std::nullopt;
+        return true;
+    }
+
+    future<foreign_ptr<lw_shared_ptr<query::result>>> read_sub_ranges(uint32_t page_size, db::timeout_clock::time_point timeout) {
+        if (!_state_restored) {
+            restore_state();
+            _state_restored = true;
+        }
+
+        // Filtering drops rows on the coordinator, so the page is filled
+        // with as many rows as it can hold, as in filtering_query_pager.
+        const uint32_t max_rows = std::max(1u, _filtering_restrictions ? page_size : max_rows_to_fetch(page_size));
+        // Give each sub-range a share of at least one row.
+        const size_t concurrency = std::min(size_t(std::max(1, get_local_storage_proxy().parallel_scan_concurrency())), size_t(max_rows));
+        if (_scan_ranges.size() < concurrency && !_ranges.empty()) {
+            add_sub_ranges(concurrency - _scan_ranges.size());
+        }
+        const size_t n = std::min(concurrency, _scan_ranges.size());
+        const uint32_t row_limit = max_rows / std::max(size_t(1), n);
+
+        qlogger.debug("Fetching {} from {} sub-ranges, page size={}, rows per sub-range={}", _cmd->cf_id, n, page_size, row_limit);
+
+        using results_type = std::vector<foreign_ptr<lw_shared_ptr<query::result>>>;
+        return do_with(results_type(n), paging_state::replicas_per_token_range(),
+                [this, n, row_limit, timeout] (results_type& results, paging_state::replicas_per_token_range& used_replicas) {
+            return parallel_for_each(boost::irange(size_t(0), n), [this, n, row_limit, timeout, &results, &used_replicas] (size_t i) {
+                auto& sr = _scan_ranges[i];
+                return get_local_storage_proxy().query(_schema,
+                        make_command(sr, row_limit),
+                        dht::partition_range_vector{sr.range},
+                        _options.get_consistency(),
+                        {timeout, _state.get_permit(), _state.get_client_state(), _state.get_trace_state(), _last_replicas, std::nullopt,
+                                _estimated_result_rows_per_range}).then(
+                                [this, &results, &used_replicas, i] (service::storage_proxy::coordinator_query_result qr) {
+                    results[i] = std::move(qr.query_result);
+                    _estimated_result_rows_per_range = qr.estimated_result_rows_per_range;
+                    for (auto& e : qr.last_replicas) {
+                        used_replicas.insert_or_assign(e.first, std::move(e.second));
+                    }
+                });
+            }).then([this, n, row_limit, &results, &used_replicas] {
+                _last_replicas = std::move(used_replicas);
+
+                query::result_merger merger(query::max_rows, query::max_partitions, query::result_merger::merge_after_short_read::yes);
+                merger.reserve(n);
+                std::vector<parallel_scan_range> scan_ranges;
+                scan_ranges.reserve(_scan_ranges.size());
+                for (size_t i = 0; i < n; ++i) {
+                    if (advance(_scan_ranges[i], *results[i], row_limit)) {
+                        scan_ranges.push_back(std::move(_scan_ranges[i]));
+                    }
+                    merger(std::move(results[i]));
+                }
+                std::move(_scan_ranges.begin() + n, _scan_ranges.end(), std::back_inserter(scan_ranges));
+                _scan_ranges = std::move(scan_ranges);
+                return merger.get();
+            });
+        });
+    }
+
+    template<typename Visitor>
+    GCC6_CONCEPT(requires query::ResultVisitor<Visitor>)
+    void consume_result(Visitor&& visitor, const query::result& result) {
+        query_result_visitor<Visitor> v(std::forward<Visitor>(visitor));
+        auto view = query::result_view(result);
+        view.consume(_cmd->slice, v);
+        _max -= std::min(_max, v.total_rows - v.dropped_rows);
+        update_exhausted();
+        qlogger.debug("Fetched {} rows, max_remain={} {}", v.total_rows - v.dropped_rows, _max, _exhausted ? "(exh)" : "");
+    }
+
+    void update_exhausted() {
+        _exhausted = (_scan_ranges.empty() && _ranges.empty()) || _max == 0;
+    }
+};
+
 }
 
 bool service::pager::query_pagers::may_need_paging(const schema& s, uint32_t page_size,
@@ -401,13 +648,40 @@ bool service::pager::query_pagers::may_need_paging(const schema& s, uint32_t pag
     return need_paging;
 }
 
+bool service::pager::query_pagers::may_scan_in_parallel(const query::read_command& cmd,
+        const dht::partition_range_vector& ranges,
+        const cql3::query_options& options) {
+    // The limits are shared by the sub-ranges and can only be applied to
+    // rows once they are back on the coordinator. A LIMIT must also select
+    // the first rows in token order, not whichever sub-range returns first.
+    if (ranges.empty() || query::is_single_partition(ranges.front())
+            || cmd.row_limit != query::max_rows
+            || cmd.partition_limit != query::max_partitions
+            || cmd.slice.partition_row_limit() != query::max_rows
+            || cmd.slice.options.contains<query::partition_slice::option::reversed>()) {
+        return false;
+    }
+    // A scan continues the way it was started, so that a page served by a
+    // coordinator with a different configuration picks up where it ended.
+    if (auto state = options.get_paging_state()) {
+        return state->is_parallel_scan();
+    }
+    return get_local_storage_proxy().parallel_scan_concurrency() > 0
+            && get_local_storage_service().cluster_supports_parallel_scan_paging();
+}
+
 ::shared_ptr<service::pager::query_pager> service::pager::query_pagers::pager(
         schema_ptr s, shared_ptr<const cql3::selection::selection> selection,
         service::query_state& state, const cql3::query_options& options,
         lw_shared_ptr<query::read_command> cmd,
         dht::partition_range_vector ranges,
         cql3::cql_stats& stats,
-        ::shared_ptr<cql3::restrictions::statement_restrictions> filtering_restrictions) {
+        ::shared_ptr<cql3::restrictions::statement_restrictions> filtering_restrictions,
+        bool allow_parallel_scan) {
+    if (allow_parallel_scan && may_scan_in_parallel(*cmd, ranges, options)) {
+        return ::make_shared<parallel_scan_query_pager>(std::move(s), std::move(selection), state,
+                    options, std::move(cmd), std::move(ranges), std::move(filtering_restrictions), stats);
+    }
     // If partition row limit is applied to paging, we still need to fall back
     // to filtering the results to avoid extraneous rows on page breaks.
     if (!filtering_restrictions && cmd->slice.partition_row_limit() < query::max_rows) {
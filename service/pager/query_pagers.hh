@@ -67,7 +67,14 @@ class query_pagers {
             lw_shared_ptr<query::read_command>,
             dht::partition_range_vector,
             cql3::cql_stats& stats,
-            ::shared_ptr<cql3::restrictions::statement_restrictions> filtering_restrictions = nullptr);
+            ::shared_ptr<cql3::restrictions::statement_restrictions> filtering_restrictions = nullptr,
+            bool allow_parallel_scan = false);
+private:
+    // Whether a range scan can read sub-ranges of `ranges` concurrently,
+    // returning the rows of each page out of token order.
+    static bool may_scan_in_parallel(const query::read_command&,
+            const dht::partition_range_vector&,
+            const cql3::query_options&);
 };
 
 }
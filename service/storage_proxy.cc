@@ -86,6 +86,9 @@
 #include "db/timeout_clock.hh"
 #include "multishard_mutation_query.hh"
 #include "database.hh"
+#include "sstables/sstables.hh"
+#include "repair/repair.hh"
+#include "aggregate_query.hh"
 
 namespace bi = boost::intrusive;
 
@@ -851,6 +854,7 @@ storage_proxy::storage_proxy(distributed<database>& db, storage_proxy::config cf
     , _hints_resource_manager(cfg.available_memory / 10)
     , _hints_for_views_manager(_db.local().get_config().view_hints_directory(), {}, _db.local().get_config().max_hint_window_in_ms(), _hints_resource_manager, _db)
     , _background_write_throttle_threahsold(cfg.available_memory / 10)
+    , _max_concurrent_range_requests(std::max(size_t(1), cfg.available_memory / 50 / query::result_memory_limiter::maximum_result_size))
     , _mutate_stage{"storage_proxy_mutate", &storage_proxy::do_mutate}
     , _max_view_update_backlog(max_view_update_backlog)
     , _view_update_handlers_list(std::make_unique<view_update_handlers_list>()) {
@@ -906,6 +910,9 @@ storage_proxy::storage_proxy(distributed<database>& db, storage_proxy::config cf
         sm::make_total_operations("background_read_repairs", _stats.read_repair_repaired_background,
                        sm::description("number of background read repairs")),
 
+        sm::make_total_operations("background_read_repairs_narrowed", _stats.read_repair_narrowed_background,
+                       sm::description("number of background read repairs which only reconciled the rows found to differ by comparing row hashes")),
+
         sm::make_total_operations("write_timeouts", _stats.write_timeouts._count,
                        sm::description("number of write request failed due to a timeout")),
 
@@ -930,6 +937,12 @@ storage_proxy::storage_proxy(distributed<database>& db, storage_proxy::config cf
         sm::make_total_operations("speculative_data_reads", _stats.speculative_data_reads,
                        sm::description("number of speculative data read requests that were sent")),
 
+        sm::make_total_operations("speculative_range_digest_reads", _stats.speculative_range_digest_reads,
+                       sm::description("number of speculative digest range read requests that were sent")),
+
+        sm::make_total_operations("speculative_range_data_reads", _stats.speculative_range_data_reads,
+                       sm::description("number of speculative data range read requests that were sent")),
+
         sm::make_total_operations("background_writes_failed", _stats.background_writes_failed,
                        sm::description("number of write requests that failed after CL was reached")),
     });
@@ -1646,7 +1659,10 @@ void storage_proxy::send_to_live_endpoints(storage_proxy::response_id_type respo
         auto& tr_state = handler_ptr->get_trace_state();
         tracing::trace(tr_state, "Sending a mutation to /{}", coordinator);
 
-        return ms.send_mutation(netw::messaging_service::msg_addr{coordinator, 0}, timeout, m,
+        auto addr = ms.shard_aware_connections()
+                ? ms.addr_for_token(coordinator, m.decorated_key(*handler_ptr->get_schema()).token())
+                : netw::messaging_service::msg_addr{coordinator, 0};
+        return ms.send_mutation(addr, timeout, m,
                 std::move(forward), my_address, engine().cpu_id(), response_id, tracing::make_trace_info(tr_state)).finally([this, p = shared_from_this(), h = std::move(handler_ptr), msize, &stats] {
             stats.queued_write_bytes -= msize;
             unthrottle();
@@ -2414,16 +2430,29 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
     }
 
 protected:
+    netw::messaging_service::msg_addr replica_addr(gms::inet_address ep) const {
+        // Single partition reads go straight to the replica shard owning the partition.
+        if (_partition_range.is_singular()) {
+            return netw::get_local_messaging_service().addr_for_token(ep, _partition_range.start()->value().token());
+        }
+        return netw::messaging_service::msg_addr{ep, 0};
+    }
     future<rpc::tuple<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature>> make_mutation_data_request(lw_shared_ptr<query::read_command> cmd, gms::inet_address ep, clock_type::time_point timeout) {
         ++_proxy->_stats.mutation_data_read_attempts.get_ep_stat(ep);
+        auto load_req = _proxy->_endpoint_load.start_request(ep);
         if (fbu::is_me(ep)) {
             tracing::trace(_trace_state, "read_mutation_data: querying locally");
-            return _proxy->query_mutations_locally(_schema, cmd, _partition_range, timeout, _trace_state);
+            return _proxy->query_mutations_locally(_schema, cmd, _partition_range, timeout, _trace_state).then([load_req = std::move(load_req)] (
+                    rpc::tuple<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature> result_and_hit_rate) mutable {
+                load_req.complete();
+                return std::move(result_and_hit_rate);
+            });
         } else {
             auto& ms = netw::get_local_messaging_service();
             tracing::trace(_trace_state, "read_mutation_data: sending a message to /{}", ep);
-            return ms.send_read_mutation_data(netw::messaging_service::msg_addr{ep, 0}, timeout, *cmd, _partition_range).then([this, ep](rpc::tuple<reconcilable_result, rpc::optional<cache_temperature>> result_and_hit_rate) {
+            return ms.send_read_mutation_data(replica_addr(ep), timeout, *cmd, _partition_range).then([this, ep, load_req = std::move(load_req)](rpc::tuple<reconcilable_result, rpc::optional<cache_temperature>> result_and_hit_rate) mutable {
                 auto&& [result, hit_rate] = result_and_hit_rate;
+                load_req.complete();
                 tracing::trace(_trace_state, "read_mutation_data: got response from /{}", ep);
                 return make_ready_future<rpc::tuple<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature>>(rpc::tuple(make_foreign(::make_lw_shared<reconcilable_result>(std::move(result))), hit_rate.value_or(cache_temperature::invalid())));
             });
@@ -2434,14 +2463,22 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
         auto opts = want_digest
                   ? query::result_options{query::result_request::result_and_digest, digest_algorithm()}
                   : query::result_options{query::result_request::only_result, query::digest_algorithm::none};
+        auto load_req = _proxy->_endpoint_load.start_request(ep);
         if (fbu::is_me(ep)) {
             tracing::trace(_trace_state, "read_data: querying locally");
-            return _proxy->query_result_local(_schema, _cmd, _partition_range, opts, _trace_state, timeout);
+            return _proxy->query_result_local(_schema, _cmd, _partition_range, opts, _trace_state, timeout).then([load_req = std::move(load_req)] (
+                    rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature, uint32_t> result_hit_rate_queue) mutable {
+                auto&& [result, hit_rate, queue_length] = result_hit_rate_queue;
+                load_req.complete(queue_length);
+                return make_ready_future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>>(rpc::tuple(std::move(result), hit_rate));
+            });
         } else {
             auto& ms = netw::get_local_messaging_service();
             tracing::trace(_trace_state, "read_data: sending a message to /{}", ep);
-            return ms.send_read_data(netw::messaging_service::msg_addr{ep, 0}, timeout, *_cmd, _partition_range, opts.digest_algo).then([this, ep](rpc::tuple<query::result, rpc::optional<cache_temperature>> result_hit_rate) {
-                auto&& [result, hit_rate] = result_hit_rate;
+            return ms.send_read_data(replica_addr(ep), timeout, *_cmd, _partition_range, opts.digest_algo).then([this, ep, load_req = std::move(load_req)](
+                    rpc::tuple<query::result, rpc::optional<cache_temperature>, rpc::optional<uint32_t>> result_hit_rate_queue) mutable {
+                auto&& [result, hit_rate, queue_length] = result_hit_rate_queue;
+                load_req.complete(queue_length);
                 tracing::trace(_trace_state, "read_data: got response from /{}", ep);
                 return make_ready_future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>>(rpc::tuple(make_foreign(::make_lw_shared<query::result>(std::move(result))), hit_rate.value_or(cache_temperature::invalid())));
             });
@@ -2449,15 +2486,22 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
     }
     future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature>> make_digest_request(gms::inet_address ep, clock_type::time_point timeout) {
         ++_proxy->_stats.digest_read_attempts.get_ep_stat(ep);
+        auto load_req = _proxy->_endpoint_load.start_request(ep);
         if (fbu::is_me(ep)) {
             tracing::trace(_trace_state, "read_digest: querying locally");
-            return _proxy->query_result_local_digest(_schema, _cmd, _partition_range, _trace_state, timeout, digest_algorithm());
+            return _proxy->query_result_local_digest(_schema, _cmd, _partition_range, _trace_state, timeout, digest_algorithm()).then([load_req = std::move(load_req)] (
+                    rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature, uint32_t> digest_timestamp_hit_rate_queue) mutable {
+                auto&& [d, t, hit_rate, queue_length] = digest_timestamp_hit_rate_queue;
+                load_req.complete(queue_length);
+                return make_ready_future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature>>(rpc::tuple(d, t, hit_rate));
+            });
         } else {
             auto& ms = netw::get_local_messaging_service();
             tracing::trace(_trace_state, "read_digest: sending a message to /{}", ep);
-            return ms.send_read_digest(netw::messaging_service::msg_addr{ep, 0}, timeout, *_cmd, _partition_range, digest_algorithm()).then([this, ep] (
-                    rpc::tuple<query::result_digest, rpc::optional<api::timestamp_type>, rpc::optional<cache_temperature>> digest_timestamp_hit_rate) {
-                auto&& [d, t, hit_rate] = digest_timestamp_hit_rate;
+            return ms.send_read_digest(replica_addr(ep), timeout, *_cmd, _partition_range, digest_algorithm()).then([this, ep, load_req = std::move(load_req)] (
+                    rpc::tuple<query::result_digest, rpc::optional<api::timestamp_type>, rpc::optional<cache_temperature>, rpc::optional<uint32_t>> digest_timestamp_hit_rate_queue) mutable {
+                auto&& [d, t, hit_rate, queue_length] = digest_timestamp_hit_rate_queue;
+                load_req.complete(queue_length);
                 tracing::trace(_trace_state, "read_digest: got response from /{}", ep);
                 return make_ready_future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature>>(rpc::tuple(d, t ? t.value() : api::missing_timestamp, hit_rate.value_or(cache_temperature::invalid())));
             });
@@ -2611,6 +2655,66 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
     void reconcile(db::consistency_level cl, storage_proxy::clock_type::time_point timeout) {
         reconcile(cl, timeout, _cmd);
     }
+    future<partition_row_hashes> make_row_hashes_request(gms::inet_address ep, clock_type::time_point timeout) {
+        if (fbu::is_me(ep)) {
+            tracing::trace(_trace_state, "read_row_hashes: querying locally");
+            return _proxy->query_row_hashes_locally(_schema, _cmd, _partition_range, timeout, _trace_state);
+        } else {
+            auto& ms = netw::get_local_messaging_service();
+            tracing::trace(_trace_state, "read_row_hashes: sending a message to /{}", ep);
+            return ms.send_read_row_hashes(replica_addr(ep), timeout, *_cmd, _partition_range).then([this, ep] (partition_row_hashes hashes) {
+                tracing::trace(_trace_state, "read_row_hashes: got response from /{}", ep);
+                return hashes;
+            });
+        }
+    }
+    // Returns the command reconciling only the rows the replicas disagree
+    // on, the original command if they disagree on partition-level data, or
+    // a null pointer if they turned out to agree after all.
+    lw_shared_ptr<query::read_command> make_row_repair_command(const std::vector<partition_row_hashes>& hashes) {
+        auto ranges = diverging_rows(*_schema, hashes);
+        if (!ranges) {
+            return _cmd;
+        }
+        if (ranges->empty()) {
+            return nullptr;
+        }
+        auto cmd = make_lw_shared<query::read_command>(*_cmd);
+        auto dk = _partition_range.start()->value().as_decorated_key();
+        cmd->slice.options.remove<query::partition_slice::option::reversed>();
+        cmd->slice.set_range(*_schema, dk.key(), std::move(*ranges));
+        cmd->slice.set_partition_row_limit(query::max_rows);
+        cmd->row_limit = query::max_rows;
+        return cmd;
+    }
+    // Repairs a digest mismatch detected after the read was already
+    // answered. For a single partition the replicas first exchange per-row
+    // hashes, so that only the rows they disagree on are read and written
+    // back instead of the whole partition.
+    future<> reconcile_in_background(clock_type::time_point timeout) {
+        _result_promise = promise<foreign_ptr<lw_shared_ptr<query::result>>>();
+        if (!_partition_range.is_singular() || !_partition_range.start()->value().has_key()
+                || !service::get_local_storage_service().cluster_supports_row_hash_read_repair()) {
+            reconcile(_cl, timeout);
+            return _result_promise.get_future().discard_result();
+        }
+        auto hashes = make_lw_shared<std::vector<partition_row_hashes>>(_targets.size());
+        return parallel_for_each(boost::irange<size_t>(0, _targets.size()), [this, hashes, timeout] (size_t i) {
+            return make_row_hashes_request(_targets[i], timeout).then([hashes, i] (partition_row_hashes h) {
+                (*hashes)[i] = std::move(h);
+            });
+        }).then([this, exec = shared_from_this(), hashes, timeout] {
+            auto cmd = make_row_repair_command(*hashes);
+            if (!cmd) {
+                return make_ready_future<>();
+            }
+            if (cmd != _cmd) {
+                _proxy->_stats.read_repair_narrowed_background++;
+            }
+            reconcile(_cl, timeout, std::move(cmd));
+            return _result_promise.get_future().discard_result();
+        });
+    }
 
 public:
     virtual future<foreign_ptr<lw_shared_ptr<query::result>>> execute(storage_proxy::clock_type::time_point timeout) {
@@ -2660,9 +2764,7 @@ class abstract_read_executor : public enable_shared_from_this<abstract_read_exec
             (void)digest_resolver->done().then([exec, digest_resolver, timeout, background_repair_check] () mutable {
                 if (background_repair_check && !digest_resolver->digests_match()) {
                     exec->_proxy->_stats.read_repair_repaired_background++;
-                    exec->_result_promise = promise<foreign_ptr<lw_shared_ptr<query::result>>>();
-                    exec->reconcile(exec->_cl, timeout);
-                    return exec->_result_promise.get_future().discard_result();
+                    return exec->reconcile_in_background(timeout).finally([exec] {});
                 } else {
                     return make_ready_future<>();
                 }
@@ -2704,6 +2806,17 @@ class always_speculating_read_executor : public abstract_read_executor {
 // this executor sends request to an additional replica after some time below timeout
 class speculating_read_executor : public abstract_read_executor {
     timer<storage_proxy::clock_type> _speculate_timer;
+protected:
+    virtual std::chrono::milliseconds latency_percentile(double percentile) {
+        return std::min(_cf->get_coordinator_read_latency_percentile(percentile), std::chrono::milliseconds(_proxy->get_db().local().get_config().read_request_timeout_in_ms()/2));
+    }
+    virtual void on_speculative_read(bool digest) {
+        if (digest) {
+            _proxy->_stats.speculative_digest_reads++;
+        } else {
+            _proxy->_stats.speculative_data_reads++;
+        }
+    }
 public:
     using abstract_read_executor::abstract_read_executor;
     virtual future<> make_requests(digest_resolver_ptr resolver, storage_proxy::clock_type::time_point timeout) {
@@ -2712,11 +2825,10 @@ class speculating_read_executor : public abstract_read_executor {
                 resolver->add_wait_targets(1); // we send one more request so wait for it too
                 // FIXME: consider disabling for CL=*ONE
                 auto send_request = [&] (bool has_data) {
+                    on_speculative_read(has_data);
                     if (has_data) {
-                        _proxy->_stats.speculative_digest_reads++;
                         return make_digest_requests(resolver, _targets.end() - 1, _targets.end(), timeout);
                     } else {
-                        _proxy->_stats.speculative_data_reads++;
                         return make_data_requests(resolver, _targets.end() - 1, _targets.end(), timeout, true);
                     }
                 };
@@ -2726,7 +2838,7 @@ class speculating_read_executor : public abstract_read_executor {
         });
         auto& sr = _schema->speculative_retry();
         auto t = (sr.get_type() == speculative_retry::type::PERCENTILE) ?
-            std::min(_cf->get_coordinator_read_latency_percentile(sr.get_value()), std::chrono::milliseconds(_proxy->get_db().local().get_config().read_request_timeout_in_ms()/2)) :
+            latency_percentile(sr.get_value()) :
             std::chrono::milliseconds(unsigned(sr.get_value()));
         _speculate_timer.arm(t);
 
@@ -2765,6 +2877,27 @@ class range_slice_read_executor : public never_speculating_read_executor {
     }
 };
 
+// Hedges a token range read: when the table's range read latency percentile
+// (or the configured delay) is exceeded, the sub-range read is sent to the
+// extra replica last in _targets and the first replies satisfying the CL win.
+// Requires digest multipartition reads, as the reconciliation fallback of
+// range_slice_read_executor would wait for every target.
+class speculating_range_slice_read_executor : public speculating_read_executor {
+protected:
+    virtual std::chrono::milliseconds latency_percentile(double percentile) override {
+        return std::min(_cf->get_coordinator_range_read_latency_percentile(percentile), std::chrono::milliseconds(_proxy->get_db().local().get_config().range_request_timeout_in_ms()/2));
+    }
+    virtual void on_speculative_read(bool digest) override {
+        if (digest) {
+            _proxy->_stats.speculative_range_digest_reads++;
+        } else {
+            _proxy->_stats.speculative_range_data_reads++;
+        }
+    }
+public:
+    using speculating_read_executor::speculating_read_executor;
+};
+
 db::read_repair_decision storage_proxy::new_read_repair_decision(const schema& s) {
     double chance = _read_repair_chance(_urandom);
     if (s.read_repair_chance() > chance) {
@@ -2794,15 +2927,19 @@ ::shared_ptr<abstract_read_executor> storage_proxy::get_read_executor(lw_shared_
 
     std::vector<gms::inet_address> all_replicas = get_live_sorted_endpoints(ks, token);
     // Check for a non-local read before heat-weighted load balancing
-    // reordering of endpoints happens. The local endpoint, if
-    // present, is always first in the list, as get_live_sorted_endpoints()
-    // orders the list by proximity to the local endpoint.
-    is_read_non_local |= all_replicas.front() != utils::fb_utilities::get_broadcast_address();
+    // reordering of endpoints happens. With adaptive replica selection
+    // the local endpoint is not necessarily first in the list, so look
+    // for it instead of checking the front.
+    is_read_non_local |= boost::range::find(all_replicas, utils::fb_utilities::get_broadcast_address()) == all_replicas.end();
 
     auto cf = _db.local().find_column_family(schema).shared_from_this();
+    // Adaptive replica selection already ordered the replicas by load,
+    // heat-weighted balancing would undo that.
+    const auto& cfg = _db.local().get_config();
+    const bool hit_rate_balancing = cfg.cache_hit_rate_read_balancing() && !cfg.adaptive_replica_selection();
     std::vector<gms::inet_address> target_replicas = db::filter_for_query(cl, ks, all_replicas, preferred_endpoints, repair_decision,
             retry_type == speculative_retry::type::NONE ? nullptr : &extra_replica,
-            _db.local().get_config().cache_hit_rate_read_balancing() ? &*cf : nullptr);
+            hit_rate_balancing ? &*cf : nullptr);
 
     slogger.trace("creating read executor for token {} with all: {} targets: {} rp decision: {}", token, all_replicas, target_replicas, repair_decision);
     tracing::trace(trace_state, "Creating read executor for token {} with all: {} targets: {} repair decision: {}", token, all_replicas, target_replicas, repair_decision);
@@ -2853,15 +2990,15 @@ ::shared_ptr<abstract_read_executor> storage_proxy::get_read_executor(lw_shared_
     }
 }
 
-future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature>>
+future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature, uint32_t>>
 storage_proxy::query_result_local_digest(schema_ptr s, lw_shared_ptr<query::read_command> cmd, const dht::partition_range& pr, tracing::trace_state_ptr trace_state, storage_proxy::clock_type::time_point timeout, query::digest_algorithm da, uint64_t max_size) {
-    return query_result_local(std::move(s), std::move(cmd), pr, query::result_options::only_digest(da), std::move(trace_state), timeout, max_size).then([] (rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature> result_and_hit_rate) {
-        auto&& [result, hit_rate] = result_and_hit_rate;
-        return make_ready_future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature>>(rpc::tuple(*result->digest(), result->last_modified(), hit_rate));
+    return query_result_local(std::move(s), std::move(cmd), pr, query::result_options::only_digest(da), std::move(trace_state), timeout, max_size).then([] (rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature, uint32_t> result_hit_rate_queue) {
+        auto&& [result, hit_rate, queue_length] = result_hit_rate_queue;
+        return make_ready_future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature, uint32_t>>(rpc::tuple(*result->digest(), result->last_modified(), hit_rate, queue_length));
     });
 }
 
-future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>>
+future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature, uint32_t>>
 storage_proxy::query_result_local(schema_ptr s, lw_shared_ptr<query::read_command> cmd, const dht::partition_range& pr, query::result_options opts,
                                   tracing::trace_state_ptr trace_state, storage_proxy::clock_type::time_point timeout, uint64_t max_size) {
     cmd->slice.options.set_if<query::partition_slice::option::with_digest>(opts.request != query::result_request::only_result);
@@ -2870,18 +3007,23 @@ storage_proxy::query_result_local(schema_ptr s, lw_shared_ptr<query::read_comman
         _stats.replica_cross_shard_ops += shard != engine().cpu_id();
         return _db.invoke_on(shard, _read_smp_service_group, [max_size, gs = global_schema_ptr(s), prv = dht::partition_range_vector({pr}) /* FIXME: pr is copied */, cmd, opts, timeout, gt = tracing::global_trace_state_ptr(std::move(trace_state))] (database& db) mutable {
             auto trace_state = gt.get();
+            // Sampled on the shard which executes the read, before the read
+            // queues for admission itself.
+            auto queue_length = get_read_queue_length(db, *gs.get());
             tracing::trace(trace_state, "Start querying the token range that starts with {}", seastar::value_of([&prv] { return prv.begin()->start()->value().token(); }));
-            return db.query(gs, *cmd, opts, prv, trace_state, max_size, timeout).then([trace_state](auto&& f, cache_temperature ht) {
+            return db.query(gs, *cmd, opts, prv, trace_state, max_size, timeout).then([trace_state, queue_length](auto&& f, cache_temperature ht) {
                 tracing::trace(trace_state, "Querying is done");
-                return make_ready_future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>>(rpc::tuple(make_foreign(std::move(f)), ht));
+                return make_ready_future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature, uint32_t>>(rpc::tuple(make_foreign(std::move(f)), ht, queue_length));
             });
         });
     } else {
+        // The read spans all shards; the queue of this one stands for theirs.
+        auto queue_length = get_read_queue_length(_db.local(), *s);
         // FIXME: adjust multishard_mutation_query to accept an smp_service_group and propagate it there
-        return query_nonsingular_mutations_locally(s, cmd, {pr}, std::move(trace_state), max_size, timeout).then([s, cmd, opts] (rpc::tuple<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature>&& r_ht) {
+        return query_nonsingular_mutations_locally(s, cmd, {pr}, std::move(trace_state), max_size, timeout).then([s, cmd, opts, queue_length] (rpc::tuple<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature>&& r_ht) {
             auto&& [r, ht] = r_ht;
-            return make_ready_future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>>(
-                    rpc::tuple(::make_foreign(::make_lw_shared(to_data_query_result(*r, s, cmd->slice,  cmd->row_limit, cmd->partition_limit, opts))), ht));
+            return make_ready_future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature, uint32_t>>(
+                    rpc::tuple(::make_foreign(::make_lw_shared(to_data_query_result(*r, s, cmd->slice,  cmd->row_limit, cmd->partition_limit, opts))), ht, queue_length));
         });
     }
 }
@@ -2991,7 +3133,10 @@ storage_proxy::query_partition_key_range_concurrent(storage_proxy::clock_type::t
     std::vector<::shared_ptr<abstract_read_executor>> exec;
     auto p = shared_from_this();
     auto& cf= _db.local().find_column_family(schema);
-    auto pcf = _db.local().get_config().cache_hit_rate_read_balancing() ? &cf : nullptr;
+    const auto& cfg = _db.local().get_config();
+    auto pcf = cfg.cache_hit_rate_read_balancing() && !cfg.adaptive_replica_selection() ? &cf : nullptr;
+    const bool speculate = schema->speculative_retry().get_type() != speculative_retry::type::NONE
+            && service::get_local_storage_service().cluster_supports_digest_multipartition_reads();
     std::unordered_map<abstract_read_executor*, std::vector<dht::token_range>> ranges_per_exec;
 
     const auto preferred_replicas_for_range = [&preferred_replicas] (const dht::partition_range& r) {
@@ -3089,7 +3234,17 @@ storage_proxy::query_partition_key_range_concurrent(storage_proxy::clock_type::t
             throw;
         }
 
-        exec.push_back(::make_shared<range_slice_read_executor>(schema, cf.shared_from_this(), p, cmd, std::move(range), cl, std::move(filtered_endpoints), trace_state, permit));
+        auto extra_replica = speculate ? boost::range::find_if(live_endpoints, [&] (gms::inet_address ep) {
+            return boost::range::find(filtered_endpoints, ep) == filtered_endpoints.end() && (!is_datacenter_local(cl) || db::is_local(ep));
+        }) : live_endpoints.end();
+        if (extra_replica != live_endpoints.end()) {
+            slogger.trace("creating range read executor with extra target {}", *extra_replica);
+            auto block_for = filtered_endpoints.size();
+            filtered_endpoints.push_back(*extra_replica);
+            exec.push_back(::make_shared<speculating_range_slice_read_executor>(schema, cf.shared_from_this(), p, cmd, std::move(range), cl, block_for, std::move(filtered_endpoints), trace_state, permit));
+        } else {
+            exec.push_back(::make_shared<range_slice_read_executor>(schema, cf.shared_from_this(), p, cmd, std::move(range), cl, std::move(filtered_endpoints), trace_state, permit));
+        }
         ranges_per_exec.emplace(exec.back().get(), std::move(merged_ranges));
     }
 
@@ -3097,7 +3252,16 @@ storage_proxy::query_partition_key_range_concurrent(storage_proxy::clock_type::t
     merger.reserve(exec.size());
 
     auto f = ::map_reduce(exec.begin(), exec.end(), [timeout] (::shared_ptr<abstract_read_executor>& rex) {
-        return rex->execute(timeout);
+        utils::latency_counter lc;
+        lc.start();
+        return rex->execute(timeout).then_wrapped([lc, rex] (future<foreign_ptr<lw_shared_ptr<query::result>>> f) mutable {
+            // Failed and timed out reads would push the speculation
+            // threshold towards the timeout.
+            if (!f.failed() && lc.is_start()) {
+                rex->get_cf()->add_coordinator_range_read_latency(lc.stop().latency());
+            }
+            return std::move(f);
+        });
     }, std::move(merger));
 
     return f.then([p,
@@ -3115,6 +3279,9 @@ storage_proxy::query_partition_key_range_concurrent(storage_proxy::clock_type::t
             ranges_per_exec = std::move(ranges_per_exec),
             permit = std::move(permit)] (foreign_ptr<lw_shared_ptr<query::result>>&& result) mutable {
         result->ensure_counts();
+        // Rows per vnode range observed in this round, which reflects
+        // filtering and tombstones better than the up-front estimate.
+        const float result_rows_per_range = float(result->row_count().value()) / concurrency_factor;
         remaining_row_count -= result->row_count().value();
         remaining_partition_count -= result->partition_count().value();
         results.emplace_back(std::move(result));
@@ -3135,8 +3302,11 @@ storage_proxy::query_partition_key_range_concurrent(storage_proxy::clock_type::t
         } else {
             cmd->row_limit = remaining_row_count;
             cmd->partition_limit = remaining_partition_count;
+            const auto next_concurrency_factor = std::max(concurrency_factor, p->range_concurrency_for(result_rows_per_range, remaining_row_count, concurrency_factor));
+            slogger.trace("Observed result rows per range: {}; remaining rows: {}, next concurrent range requests: {}",
+                    result_rows_per_range, remaining_row_count, next_concurrency_factor);
             return p->query_partition_key_range_concurrent(timeout, std::move(results), cmd, cl, std::move(ranges_to_vnodes),
-                    concurrency_factor * 2, std::move(trace_state), remaining_row_count, remaining_partition_count, std::move(preferred_replicas), std::move(permit));
+                    next_concurrency_factor, std::move(trace_state), remaining_row_count, remaining_partition_count, std::move(preferred_replicas), std::move(permit));
         }
     }).handle_exception([p] (std::exception_ptr eptr) {
         p->handle_read_error(eptr, true);
@@ -3144,6 +3314,54 @@ storage_proxy::query_partition_key_range_concurrent(storage_proxy::clock_type::t
     });
 }
 
+float storage_proxy::estimate_result_rows_per_range(lw_shared_ptr<query::read_command> cmd, keyspace& ks) {
+    // Same crude estimate as the one size_estimates_virtual_reader exposes:
+    // based on the sstables only, ignoring memtables and overlaps between sstables.
+    auto& cf = _db.local().find_column_family(cmd->cf_id);
+    uint64_t rows = 0;
+    for (auto& sst : *cf.get_sstables()) {
+        auto& stats = sst->get_stats_metadata();
+        // Only the mc format records the number of rows.
+        if (sst->get_version() == sstables::sstable_version_types::mc && stats.rows_count > 0) {
+            rows += stats.rows_count;
+        } else {
+            rows += sst->get_estimated_key_count();
+        }
+    }
+    // Shards hold similar shares of the node's data.
+    rows *= smp::count;
+
+    // This node holds the data of num_tokens * RF vnode ranges.
+    auto& tm = get_local_storage_service().get_token_metadata();
+    auto local_ranges = tm.get_tokens(utils::fb_utilities::get_broadcast_address()).size() * ks.get_replication_strategy().get_replication_factor();
+    if (!local_ranges) {
+        return 0;
+    }
+    return float(rows) / local_ranges;
+}
+
+int storage_proxy::range_concurrency_for(float result_rows_per_range, uint32_t remaining_row_count, int current_concurrency) const {
+    // Capped by memory: an estimate may be far off, e.g. for an unpaged scan
+    // or one with a large limit, and each range may return a full result.
+    const double max_concurrency = _max_concurrent_range_requests;
+    if (result_rows_per_range <= 0) {
+        // Nothing to go by, fall back to exponential growth.
+        return std::max(1, int(std::min(double(current_concurrency) * 2, max_concurrency)));
+    }
+    auto wanted = std::ceil(double(remaining_row_count) / result_rows_per_range);
+    return std::max(1, int(std::min(wanted, max_concurrency)));
+}
+
+int storage_proxy::parallel_scan_concurrency() const {
+    const auto& cfg = _db.local().get_config();
+    if (!cfg.parallel_scan_concurrency()) {
+        return 0;
+    }
+    // Each of the concurrent reads may return up to a full result.
+    auto budget = size_t(cfg.parallel_scan_memory_budget_in_mb()) * 1024 * 1024 / query::result_memory_limiter::maximum_result_size;
+    return std::min({int(cfg.parallel_scan_concurrency()), int(std::max(size_t(1), budget)), _max_concurrent_range_requests});
+}
+
 future<storage_proxy::coordinator_query_result>
 storage_proxy::query_partition_key_range(lw_shared_ptr<query::read_command> cmd,
         dht::partition_range_vector partition_ranges,
@@ -3156,8 +3374,12 @@ storage_proxy::query_partition_key_range(lw_shared_ptr<query::read_command> cmd,
     // expensive in clusters with vnodes)
     query_ranges_to_vnodes_generator ranges_to_vnodes(schema, std::move(partition_ranges), ks.get_replication_strategy().get_type() == locator::replication_strategy_type::local);
 
-    int result_rows_per_range = 0;
-    int concurrency_factor = 1;
+    // The estimate walks all sstables of the table, so it is made once per
+    // query and the following pages reuse it.
+    float result_rows_per_range = query_options.estimated_result_rows_per_range
+            ? *query_options.estimated_result_rows_per_range
+            : estimate_result_rows_per_range(cmd, ks);
+    int concurrency_factor = result_rows_per_range > 0 ? range_concurrency_for(result_rows_per_range, cmd->row_limit, 1) : 1;
 
     std::vector<foreign_ptr<lw_shared_ptr<query::result>>> results;
 
@@ -3187,7 +3409,7 @@ storage_proxy::query_partition_key_range(lw_shared_ptr<query::read_command> cmd,
             cmd->row_limit,
             cmd->partition_limit,
             std::move(query_options.preferred_replicas),
-            std::move(query_options.permit)).then([row_limit, partition_limit] (
+            std::move(query_options.permit)).then([row_limit, partition_limit, result_rows_per_range] (
                     query_partition_key_range_concurrent_result result) {
         std::vector<foreign_ptr<lw_shared_ptr<query::result>>>& results = result.result;
         replicas_per_token_range& used_replicas = result.replicas;
@@ -3199,7 +3421,9 @@ storage_proxy::query_partition_key_range(lw_shared_ptr<query::read_command> cmd,
             merger(std::move(r));
         }
 
-        return make_ready_future<coordinator_query_result>(coordinator_query_result(merger.get(), std::move(used_replicas)));
+        coordinator_query_result qr(merger.get(), std::move(used_replicas));
+        qr.estimated_result_rows_per_range = result_rows_per_range;
+        return make_ready_future<coordinator_query_result>(std::move(qr));
     });
 }
 
@@ -3279,6 +3503,92 @@ storage_proxy::do_query(schema_ptr s,
     });
 }
 
+future<query::aggregate_result>
+storage_proxy::query_aggregates(schema_ptr s,
+    lw_shared_ptr<query::read_command> cmd,
+    dht::partition_range_vector&& partition_ranges,
+    std::vector<query::aggregate_spec> aggregates,
+    db::consistency_level cl,
+    clock_type::duration timeout_duration,
+    tracing::trace_state_ptr trace_state)
+{
+    // The partial states of different replicas can't be reconciled, so each
+    // range must be read from exactly one of them.
+    if (cl != db::consistency_level::ONE && cl != db::consistency_level::LOCAL_ONE) {
+        throw std::runtime_error(format("Aggregates can't be computed by the replicas at consistency level {}", cl));
+    }
+    // Limits the amount of data a single request reads, and thus the memory
+    // a replica holds for it.
+    static constexpr size_t ranges_per_request = 32;
+    // All the requests share the deadline of the query, although those to an
+    // endpoint are sent one after another.
+    auto timeout = clock_type::now() + timeout_duration;
+
+    keyspace& ks = _db.local().find_keyspace(s->ks_name());
+    query_ranges_to_vnodes_generator ranges_to_vnodes(s, std::move(partition_ranges),
+            ks.get_replication_strategy().get_type() == locator::replication_strategy_type::local);
+    std::unordered_map<gms::inet_address, dht::partition_range_vector> ranges_per_endpoint;
+    auto assigned_ranges = [&ranges_per_endpoint] (gms::inet_address ep) {
+        auto it = ranges_per_endpoint.find(ep);
+        return it == ranges_per_endpoint.end() ? size_t(0) : it->second.size();
+    };
+    auto& snitch_ptr = locator::i_endpoint_snitch::get_local_snitch_ptr();
+    while (!ranges_to_vnodes.empty()) {
+        for (auto&& range : ranges_to_vnodes(1024)) {
+            std::vector<gms::inet_address> live_endpoints = get_live_sorted_endpoints(ks, end_token(range));
+            std::vector<gms::inet_address> targets = filter_for_query(cl, ks, live_endpoints, {}, nullptr);
+            if (targets.empty()) {
+                throw exceptions::unavailable_exception(cl, 1, 0);
+            }
+            // Any replica in the datacenter of the closest one may serve the
+            // range, so spread the ranges over them instead of sending all
+            // ranges to the closest replica. Ties go to the closest replica.
+            auto dc = snitch_ptr->get_datacenter(targets.front());
+            auto candidates = live_endpoints | boost::adaptors::filtered([&] (gms::inet_address ep) {
+                return snitch_ptr->get_datacenter(ep) == dc;
+            });
+            auto target = *boost::min_element(candidates, [&] (gms::inet_address a, gms::inet_address b) {
+                return assigned_ranges(a) < assigned_ranges(b);
+            });
+            ranges_per_endpoint[target].push_back(std::move(range));
+        }
+    }
+
+    utils::latency_counter lc;
+    lc.start();
+    auto merged = make_lw_shared<query::aggregates>(*s, aggregates);
+    return do_with(std::move(ranges_per_endpoint), std::move(aggregates), [this, s, cmd, merged, timeout,
+            trace_state = std::move(trace_state)] (std::unordered_map<gms::inet_address, dht::partition_range_vector>& ranges_per_endpoint,
+                    const std::vector<query::aggregate_spec>& aggregates) {
+        return parallel_for_each(ranges_per_endpoint, [this, s, cmd, merged, timeout, trace_state, &aggregates] (auto& ep_and_ranges) {
+            auto ep = ep_and_ranges.first;
+            auto& ranges = ep_and_ranges.second;
+            return do_for_each(boost::irange<size_t>(0, ranges.size(), ranges_per_request), [this, s, cmd, merged, timeout, trace_state, &aggregates, ep, &ranges] (size_t i) {
+                auto end = ranges.begin() + std::min(i + ranges_per_request, ranges.size());
+                return do_with(dht::partition_range_vector(ranges.begin() + i, end), [this, s, cmd, timeout, trace_state, &aggregates, ep] (
+                        const dht::partition_range_vector& batch) {
+                    if (fbu::is_me(ep)) {
+                        tracing::trace(trace_state, "aggregate_query: querying locally");
+                        return query_aggregates_locally(s, cmd, batch, aggregates, timeout, trace_state);
+                    }
+                    auto& ms = netw::get_local_messaging_service();
+                    tracing::trace(trace_state, "aggregate_query: sending a message to /{}", ep);
+                    return ms.send_aggregate_query(netw::messaging_service::msg_addr{ep, 0}, timeout, *cmd, batch, aggregates).then([trace_state, ep] (query::aggregate_result r) {
+                        tracing::trace(trace_state, "aggregate_query: got response from /{}", ep);
+                        return r;
+                    });
+                }).then([merged] (query::aggregate_result r) {
+                    merged->merge(r);
+                });
+            });
+        });
+    }).then([merged] {
+        return merged->get_result();
+    }).finally([lc, p = shared_from_this()] () mutable {
+        p->_stats.range.mark(lc.stop().latency());
+    });
+}
+
 std::vector<gms::inet_address> storage_proxy::get_live_endpoints(keyspace& ks, const dht::token& token) {
     auto& rs = ks.get_replication_strategy();
     std::vector<gms::inet_address> eps = rs.get_natural_endpoints(token);
@@ -3290,6 +3600,13 @@ std::vector<gms::inet_address> storage_proxy::get_live_endpoints(keyspace& ks, c
 std::vector<gms::inet_address> storage_proxy::get_live_sorted_endpoints(keyspace& ks, const dht::token& token) {
     auto eps = get_live_endpoints(ks, token);
     locator::i_endpoint_snitch::get_local_snitch_ptr()->sort_by_proximity(utils::fb_utilities::get_broadcast_address(), eps);
+    if (_db.local().get_config().adaptive_replica_selection()) {
+        // Rank local datacenter replicas, which sort_by_proximity() put
+        // first, by their observed load. Remote replicas keep the snitch order.
+        auto local_end = std::find_if_not(eps.begin(), eps.end(), db::is_local);
+        _endpoint_load.sort_by_score(eps.begin(), local_end);
+        return eps;
+    }
     // FIXME: before dynamic snitch is implement put local address (if present) at the beginning
     auto it = boost::range::find(eps, utils::fb_utilities::get_broadcast_address());
     if (it != eps.end() && it != eps.begin()) {
@@ -3298,6 +3615,10 @@ std::vector<gms::inet_address> storage_proxy::get_live_sorted_endpoints(keyspace
     return eps;
 }
 
+uint32_t storage_proxy::get_read_queue_length(database& db, const schema& s) {
+    return db.find_column_family(s).read_concurrency_semaphore().waiters();
+}
+
 std::vector<gms::inet_address> storage_proxy::intersection(const std::vector<gms::inet_address>& l1, const std::vector<gms::inet_address>& l2) {
     std::vector<gms::inet_address> inter;
     inter.reserve(l1.size());
@@ -3511,7 +3832,7 @@ void storage_proxy::init_messaging_service() {
                     // send buffer.
                     tracing::trace(trace_state_ptr, "Sending mutation_done to /{}", reply_to);
                     return ms.send_mutation_done(
-                            netw::messaging_service::msg_addr{reply_to, shard},
+                            netw::messaging_service::msg_addr::for_shard(reply_to, shard),
                             shard,
                             response_id,
                             p->get_view_update_backlog()).then_wrapped([] (future<> f) {
@@ -3550,7 +3871,7 @@ void storage_proxy::init_messaging_service() {
                         tracing::trace(trace_state_ptr, "Sending mutation_failure with {} failures to /{}", errors, reply_to);
                         auto& ms = netw::get_local_messaging_service();
                         fut = ms.send_mutation_failed(
-                                netw::messaging_service::msg_addr{reply_to, shard},
+                                netw::messaging_service::msg_addr::for_shard(reply_to, shard),
                                 shard,
                                 response_id,
                                 errors,
@@ -3640,6 +3961,49 @@ void storage_proxy::init_messaging_service() {
             });
         });
     });
+    ms.register_read_row_hashes([] (const rpc::client_info& cinfo, rpc::opt_time_point t, query::read_command cmd, ::compat::wrapping_partition_range pr) {
+        tracing::trace_state_ptr trace_state_ptr;
+        auto src_addr = netw::messaging_service::get_source(cinfo);
+        if (cmd.trace_info) {
+            trace_state_ptr = tracing::tracing::get_local_tracing_instance().create_session(*cmd.trace_info);
+            tracing::begin(trace_state_ptr);
+            tracing::trace(trace_state_ptr, "read_row_hashes: message received from /{}", src_addr.addr);
+        }
+        return do_with(std::move(pr), get_local_shared_storage_proxy(), std::move(trace_state_ptr), [cmd = make_lw_shared<query::read_command>(std::move(cmd)), src_addr = std::move(src_addr), t] (::compat::wrapping_partition_range& pr, shared_ptr<storage_proxy>& p, tracing::trace_state_ptr& trace_state_ptr) mutable {
+            auto src_ip = src_addr.addr;
+            return get_schema_for_read(cmd->schema_version, std::move(src_addr)).then([cmd, &pr, &p, &trace_state_ptr, t] (schema_ptr s) {
+                auto pr2 = ::compat::unwrap(std::move(pr), *s);
+                if (pr2.second || !pr2.first.is_singular()) {
+                    throw std::runtime_error("READ_ROW_HASHES called with a non-singular range");
+                }
+                auto timeout = t ? *t : db::no_timeout;
+                return do_with(std::move(pr2.first), [&p, s = std::move(s), cmd, &trace_state_ptr, timeout] (const dht::partition_range& pr) mutable {
+                    return p->query_row_hashes_locally(std::move(s), cmd, pr, timeout, trace_state_ptr);
+                });
+            }).finally([&trace_state_ptr, src_ip] () mutable {
+                tracing::trace(trace_state_ptr, "read_row_hashes handling is done, sending a response to /{}", src_ip);
+            });
+        });
+    });
+    ms.register_aggregate_query([] (const rpc::client_info& cinfo, rpc::opt_time_point t, query::read_command cmd, dht::partition_range_vector pr, std::vector<query::aggregate_spec> aggregates) {
+        tracing::trace_state_ptr trace_state_ptr;
+        auto src_addr = netw::messaging_service::get_source(cinfo);
+        if (cmd.trace_info) {
+            trace_state_ptr = tracing::tracing::get_local_tracing_instance().create_session(*cmd.trace_info);
+            tracing::begin(trace_state_ptr);
+            tracing::trace(trace_state_ptr, "aggregate_query: message received from /{}", src_addr.addr);
+        }
+        return do_with(std::move(pr), std::move(aggregates), get_local_shared_storage_proxy(), std::move(trace_state_ptr), [cmd = make_lw_shared<query::read_command>(std::move(cmd)), src_addr = std::move(src_addr), t] (
+                const dht::partition_range_vector& pr, const std::vector<query::aggregate_spec>& aggregates, shared_ptr<storage_proxy>& p, tracing::trace_state_ptr& trace_state_ptr) mutable {
+            auto src_ip = src_addr.addr;
+            return get_schema_for_read(cmd->schema_version, std::move(src_addr)).then([cmd, &pr, &aggregates, &p, &trace_state_ptr, t] (schema_ptr s) {
+                auto timeout = t ? *t : db::no_timeout;
+                return p->query_aggregates_locally(std::move(s), cmd, pr, aggregates, timeout, trace_state_ptr);
+            }).finally([&trace_state_ptr, src_ip] () mutable {
+                tracing::trace(trace_state_ptr, "aggregate_query handling is done, sending a response to /{}", src_ip);
+            });
+        });
+    });
     ms.register_read_digest([] (const rpc::client_info& cinfo, rpc::opt_time_point t, query::read_command cmd, ::compat::wrapping_partition_range pr, rpc::optional<query::digest_algorithm> oda) {
         tracing::trace_state_ptr trace_state_ptr;
         auto src_addr = netw::messaging_service::get_source(cinfo);
@@ -3693,6 +4057,8 @@ void storage_proxy::uninit_messaging_service() {
     ms.unregister_read_data();
     ms.unregister_read_mutation_data();
     ms.unregister_read_digest();
+    ms.unregister_read_row_hashes();
+    ms.unregister_aggregate_query();
     ms.unregister_truncate();
 }
 
@@ -3715,6 +4081,34 @@ storage_proxy::query_mutations_locally(schema_ptr s, lw_shared_ptr<query::read_c
     }
 }
 
+future<partition_row_hashes>
+storage_proxy::query_row_hashes_locally(schema_ptr s, lw_shared_ptr<query::read_command> cmd, const dht::partition_range& pr,
+                                        storage_proxy::clock_type::time_point timeout,
+                                        tracing::trace_state_ptr trace_state) {
+    unsigned shard = _db.local().shard_of(pr.start()->value().token());
+    _stats.replica_cross_shard_ops += shard != engine().cpu_id();
+    return _db.invoke_on(shard, _read_smp_service_group, [cmd, &pr, gs = global_schema_ptr(s), timeout, gt = tracing::global_trace_state_ptr(std::move(trace_state))] (database& db) {
+        return db.query_row_hashes(gs, *cmd, pr, gt, timeout);
+    });
+}
+
+future<query::aggregate_result>
+storage_proxy::query_aggregates_locally(schema_ptr s, lw_shared_ptr<query::read_command> cmd, const dht::partition_range_vector& pr,
+                                        const std::vector<query::aggregate_spec>& aggregates,
+                                        storage_proxy::clock_type::time_point timeout,
+                                        tracing::trace_state_ptr trace_state) {
+    // Readers only return the partitions owned by their shard, so every shard
+    // can be given all the ranges.
+    return _db.map_reduce0([cmd, &pr, &aggregates, gs = global_schema_ptr(s), timeout, gt = tracing::global_trace_state_ptr(std::move(trace_state))] (database& db) {
+        return db.query_aggregates(gs, *cmd, pr, aggregates, gt, timeout);
+    }, query::aggregates(*s, aggregates), [] (query::aggregates merged, query::aggregate_result r) {
+        merged.merge(r);
+        return merged;
+    }).then([] (query::aggregates merged) {
+        return merged.get_result();
+    });
+}
+
 future<rpc::tuple<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature>>
 storage_proxy::query_mutations_locally(schema_ptr s, lw_shared_ptr<query::read_command> cmd, const ::compat::one_or_two_partition_ranges& pr,
                                        storage_proxy::clock_type::time_point timeout,
@@ -3751,7 +4145,9 @@ void storage_proxy::allow_replaying_hints() noexcept {
 
 void storage_proxy::on_join_cluster(const gms::inet_address& endpoint) {};
 
-void storage_proxy::on_leave_cluster(const gms::inet_address& endpoint) {};
+void storage_proxy::on_leave_cluster(const gms::inet_address& endpoint) {
+    _endpoint_load.remove_endpoint(endpoint);
+};
 
 void storage_proxy::on_up(const gms::inet_address& endpoint) {};
 
@@ -63,6 +63,7 @@
 #include "mutation_query.hh"
 #include "service_permit.hh"
 #include "service/client_state.hh"
+#include "service/endpoint_load_tracker.hh"
 
 
 namespace seastar::rpc {
@@ -84,6 +85,8 @@ class one_or_two_partition_ranges;
 
 }
 
+struct partition_row_hashes;
+
 namespace service {
 
 class abstract_write_response_handler;
@@ -171,19 +174,23 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy>, publ
         tracing::trace_state_ptr trace_state = nullptr;
         replicas_per_token_range preferred_replicas;
         std::optional<db::read_repair_decision> read_repair_decision;
+        // Estimate of the result rows per vnode range made for an earlier page of the query.
+        std::optional<float> estimated_result_rows_per_range;
 
         coordinator_query_options(clock_type::time_point timeout,
                 service_permit permit_,
                 client_state& client_state_,
                 tracing::trace_state_ptr trace_state = nullptr,
                 replicas_per_token_range preferred_replicas = { },
-                std::optional<db::read_repair_decision> read_repair_decision = { })
+                std::optional<db::read_repair_decision> read_repair_decision = { },
+                std::optional<float> estimated_result_rows_per_range = { })
             : _timeout(timeout)
             , permit(std::move(permit_))
             , cstate(client_state_)
             , trace_state(std::move(trace_state))
             , preferred_replicas(std::move(preferred_replicas))
-            , read_repair_decision(read_repair_decision) {
+            , read_repair_decision(read_repair_decision)
+            , estimated_result_rows_per_range(estimated_result_rows_per_range) {
         }
 
         clock_type::time_point timeout(storage_proxy& sp) const {
@@ -195,6 +202,9 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy>, publ
         foreign_ptr<lw_shared_ptr<query::result>> query_result;
         replicas_per_token_range last_replicas;
         db::read_repair_decision read_repair_decision;
+        // Estimate of the result rows per vnode range used by a range scan,
+        // to be passed back with the following pages.
+        std::optional<float> estimated_result_rows_per_range;
 
         coordinator_query_result(foreign_ptr<lw_shared_ptr<query::result>> query_result,
                 replicas_per_token_range last_replicas = {},
@@ -229,6 +239,10 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy>, publ
     std::uniform_real_distribution<> _read_repair_chance = std::uniform_real_distribution<>(0,1);
     seastar::metrics::metric_groups _metrics;
     uint64_t _background_write_throttle_threahsold;
+    // Upper bound on the number of ranges a range scan, or the sub-ranges a
+    // parallel scan, reads concurrently, so that the results of a single
+    // round fit in a fraction of the memory.
+    int _max_concurrent_range_requests;
     inheriting_concrete_execution_stage<
             future<>,
             storage_proxy*,
@@ -240,6 +254,8 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy>, publ
             bool> _mutate_stage;
     db::view::node_update_backlog& _max_view_update_backlog;
     std::unordered_map<gms::inet_address, view_update_backlog_timestamped> _view_update_backlogs;
+    // Load of the replicas as observed by this shard, for adaptive replica selection.
+    endpoint_load_tracker _endpoint_load;
 
     //NOTICE(sarna): This opaque pointer is here just to avoid moving write handler class definitions from .cc to .hh. It's slow path.
     class view_update_handlers_list;
@@ -272,6 +288,9 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy>, publ
     db::hints::manager& hints_manager_for(db::write_type type);
     std::vector<gms::inet_address> get_live_endpoints(keyspace& ks, const dht::token& token);
     std::vector<gms::inet_address> get_live_sorted_endpoints(keyspace& ks, const dht::token& token);
+    // Number of reads of the table waiting for admission on the shard of db,
+    // reported to coordinators for adaptive replica selection.
+    static uint32_t get_read_queue_length(database& db, const schema& s);
     db::read_repair_decision new_read_repair_decision(const schema& s);
     ::shared_ptr<abstract_read_executor> get_read_executor(lw_shared_ptr<query::read_command> cmd,
             schema_ptr schema,
@@ -282,12 +301,14 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy>, publ
             const std::vector<gms::inet_address>& preferred_endpoints,
             bool& is_bounced_read,
             service_permit permit);
-    future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature>> query_result_local(schema_ptr, lw_shared_ptr<query::read_command> cmd, const dht::partition_range& pr,
+    // Also return the read queue length of the shard which executed the read,
+    // see get_read_queue_length().
+    future<rpc::tuple<foreign_ptr<lw_shared_ptr<query::result>>, cache_temperature, uint32_t>> query_result_local(schema_ptr, lw_shared_ptr<query::read_command> cmd, const dht::partition_range& pr,
                                                                            query::result_options opts,
                                                                            tracing::trace_state_ptr trace_state,
                                                                            clock_type::time_point timeout,
                                                                            uint64_t max_size = query::result_memory_limiter::maximum_result_size);
-    future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature>> query_result_local_digest(schema_ptr, lw_shared_ptr<query::read_command> cmd, const dht::partition_range& pr,
+    future<rpc::tuple<query::result_digest, api::timestamp_type, cache_temperature, uint32_t>> query_result_local_digest(schema_ptr, lw_shared_ptr<query::read_command> cmd, const dht::partition_range& pr,
                                                                                                    tracing::trace_state_ptr trace_state,
                                                                                                    clock_type::time_point timeout,
                                                                                                    query::digest_algorithm da,
@@ -456,6 +477,38 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy>, publ
         db::consistency_level cl,
         coordinator_query_options optional_params);
 
+    /*
+     * Computes aggregates on the whole cluster.
+     *
+     * Every token range is read from a single replica, which evaluates the
+     * aggregates on all of its shards in parallel and returns their partial
+     * states, so only consistency levels requiring a single replica are
+     * supported. Returns the partial states of all replicas merged together.
+     */
+    future<query::aggregate_result> query_aggregates(schema_ptr,
+        lw_shared_ptr<query::read_command> cmd,
+        dht::partition_range_vector&& partition_ranges,
+        std::vector<query::aggregate_spec> aggregates,
+        db::consistency_level cl,
+        clock_type::duration timeout_duration,
+        tracing::trace_state_ptr trace_state = nullptr);
+
+    /*
+     * The number of sub-ranges a parallel scan may read concurrently:
+     * parallel_scan_concurrency, bounded by the scan's memory budget and by
+     * the coordinator's own limit on concurrent range reads. 0 if parallel
+     * scans are disabled, even for queries asking for them.
+     */
+    int parallel_scan_concurrency() const;
+
+    // Number of vnode ranges to query concurrently to fetch remaining_row_count
+    // rows in one round, at most max_concurrent_range_requests().
+    int range_concurrency_for(float result_rows_per_range, uint32_t remaining_row_count, int current_concurrency) const;
+
+    int max_concurrent_range_requests() const {
+        return _max_concurrent_range_requests;
+    }
+
     future<rpc::tuple<foreign_ptr<lw_shared_ptr<reconcilable_result>>, cache_temperature>> query_mutations_locally(
         schema_ptr, lw_shared_ptr<query::read_command> cmd, const dht::partition_range&,
         clock_type::time_point timeout,
@@ -475,6 +528,20 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy>, publ
             tracing::trace_state_ptr trace_state = nullptr,
             uint64_t max_size = query::result_memory_limiter::maximum_result_size);
 
+    // Hashes of the rows of the single partition selected by pr, used to
+    // narrow down background read repair to the rows which differ.
+    future<partition_row_hashes> query_row_hashes_locally(
+            schema_ptr s, lw_shared_ptr<query::read_command> cmd, const dht::partition_range& pr,
+            clock_type::time_point timeout,
+            tracing::trace_state_ptr trace_state = nullptr);
+
+    // Partial states of the aggregates over the rows of pr, computed on all shards.
+    future<query::aggregate_result> query_aggregates_locally(
+            schema_ptr s, lw_shared_ptr<query::read_command> cmd, const dht::partition_range_vector& pr,
+            const std::vector<query::aggregate_spec>& aggregates,
+            clock_type::time_point timeout,
+            tracing::trace_state_ptr trace_state = nullptr);
+
 
     future<> stop();
     future<> start_hints_manager(shared_ptr<gms::gossiper> gossiper_ptr, shared_ptr<service::storage_service> ss_ptr);
@@ -493,6 +560,7 @@ class storage_proxy : public seastar::async_sharded_service<storage_proxy>, publ
     friend class abstract_read_executor;
     friend class abstract_write_response_handler;
     friend class speculating_read_executor;
+    friend class speculating_range_slice_read_executor;
     friend class view_update_backlog_broker;
     friend class view_update_write_response_handler;
 };
@@ -123,6 +123,8 @@ struct stats : public write_stats {
     uint64_t read_repair_attempts = 0;
     uint64_t read_repair_repaired_blocking = 0;
     uint64_t read_repair_repaired_background = 0;
+    // background read repairs which reconciled only the rows found to differ
+    uint64_t read_repair_narrowed_background = 0;
     uint64_t global_read_repairs_canceled_due_to_concurrent_write = 0;
 
     // number of mutations received as a coordinator
@@ -151,6 +153,8 @@ struct stats : public write_stats {
     uint64_t read_retries = 0; // read is retried with new limit
     uint64_t speculative_digest_reads = 0;
     uint64_t speculative_data_reads = 0;
+    uint64_t speculative_range_digest_reads = 0;
+    uint64_t speculative_range_data_reads = 0;
 
     // Data read attempts
     split_stats data_read_attempts;
@@ -111,6 +111,11 @@ static const sstring UNBOUNDED_RANGE_TOMBSTONES_FEATURE = "UNBOUNDED_RANGE_TOMBS
 static const sstring VIEW_VIRTUAL_COLUMNS = "VIEW_VIRTUAL_COLUMNS";
 static const sstring DIGEST_INSENSITIVE_TO_EXPIRY = "DIGEST_INSENSITIVE_TO_EXPIRY";
 static const sstring COMPUTED_COLUMNS_FEATURE = "COMPUTED_COLUMNS";
+static const sstring ROW_HASH_READ_REPAIR_FEATURE = "ROW_HASH_READ_REPAIR";
+static const sstring AGGREGATE_PUSHDOWN_FEATURE = "AGGREGATE_PUSHDOWN";
+static const sstring PARALLEL_SCAN_PAGING_FEATURE = "PARALLEL_SCAN_PAGING";
+static const sstring ROW_LEVEL_REPAIR_XXH3_FEATURE = "ROW_LEVEL_REPAIR_XXH3";
+static const sstring STREAM_WHOLE_SSTABLES_FEATURE = "STREAM_WHOLE_SSTABLES";
 
 static const sstring SSTABLE_FORMAT_PARAM_NAME = "sstable_format";
 
@@ -169,6 +174,11 @@ storage_service::storage_service(abort_source& abort_source, distributed<databas
         , _view_virtual_columns(_feature_service, VIEW_VIRTUAL_COLUMNS)
         , _digest_insensitive_to_expiry(_feature_service, DIGEST_INSENSITIVE_TO_EXPIRY)
         , _computed_columns(_feature_service, COMPUTED_COLUMNS_FEATURE)
+        , _row_hash_read_repair_feature(_feature_service, ROW_HASH_READ_REPAIR_FEATURE)
+        , _aggregate_pushdown_feature(_feature_service, AGGREGATE_PUSHDOWN_FEATURE)
+        , _parallel_scan_paging_feature(_feature_service, PARALLEL_SCAN_PAGING_FEATURE)
+        , _row_level_repair_xxh3_feature(_feature_service, ROW_LEVEL_REPAIR_XXH3_FEATURE)
+        , _stream_whole_sstables_feature(_feature_service, STREAM_WHOLE_SSTABLES_FEATURE)
         , _la_feature_listener(*this, _feature_listeners_sem, sstables::sstable_version_types::la)
         , _mc_feature_listener(*this, _feature_listeners_sem, sstables::sstable_version_types::mc)
         , _replicate_action([this] { return do_replicate_to_all_cores(); })
@@ -226,6 +236,11 @@ void storage_service::enable_all_features() {
         std::ref(_view_virtual_columns),
         std::ref(_digest_insensitive_to_expiry),
         std::ref(_computed_columns),
+        std::ref(_row_hash_read_repair_feature),
+        std::ref(_aggregate_pushdown_feature),
+        std::ref(_parallel_scan_paging_feature),
+        std::ref(_row_level_repair_xxh3_feature),
+        std::ref(_stream_whole_sstables_feature),
     })
     {
         if (features.count(f.name())) {
@@ -331,6 +346,11 @@ std::set<sstring> storage_service::get_config_supported_features_set() {
         VIEW_VIRTUAL_COLUMNS,
         DIGEST_INSENSITIVE_TO_EXPIRY,
         COMPUTED_COLUMNS_FEATURE,
+        ROW_HASH_READ_REPAIR_FEATURE,
+        AGGREGATE_PUSHDOWN_FEATURE,
+        PARALLEL_SCAN_PAGING_FEATURE,
+        ROW_LEVEL_REPAIR_XXH3_FEATURE,
+        STREAM_WHOLE_SSTABLES_FEATURE,
     };
 
     // Do not respect config in the case database is not started
@@ -536,6 +556,8 @@ void storage_service::prepare_to_join(std::vector<inet_address> loaded_endpoints
     app_states.emplace(gms::application_state::SCHEMA_TABLES_VERSION, versioned_value(db::schema_tables::version));
     app_states.emplace(gms::application_state::RPC_READY, value_factory.cql_ready(false));
     app_states.emplace(gms::application_state::VIEW_BACKLOG, versioned_value(""));
+    app_states.emplace(gms::application_state::SHARD_COUNT, value_factory.shard_count(smp::count));
+    app_states.emplace(gms::application_state::IGNORE_MSB_BITS, value_factory.ignore_msb_bits(dht::global_partitioner().sharding_ignore_msb()));
     app_states.emplace(gms::application_state::SCHEMA, value_factory.schema(schema_version));
     if (restarting_normal_node) {
         app_states.emplace(gms::application_state::TOKENS, value_factory.tokens(my_tokens));
@@ -1270,6 +1292,9 @@ void storage_service::on_change(inet_address endpoint, application_state state,
             slogger.debug("Ignoring state change for dead or unknown endpoint: {}", endpoint);
             return;
         }
+        if (state == application_state::SHARD_COUNT || state == application_state::IGNORE_MSB_BITS) {
+            update_sharding_info(endpoint, *ep_state);
+        }
         if (get_token_metadata().is_member(endpoint)) {
             do_update_system_peers_table(endpoint, state, value);
             if (state == application_state::SCHEMA) {
@@ -1290,6 +1315,33 @@ void storage_service::on_remove(gms::inet_address endpoint) {
     slogger.debug("endpoint={} on_remove", endpoint);
     _token_metadata.remove_endpoint(endpoint);
     update_pending_ranges().get();
+    netw::get_messaging_service().invoke_on_all([endpoint] (auto& ms) {
+        ms.remove_sharding_info(endpoint);
+    }).get();
+}
+
+// Runs inside seastar::async context
+void storage_service::update_sharding_info(gms::inet_address endpoint, const gms::endpoint_state& ep_state) {
+    auto shard_count = ep_state.get_application_state_ptr(application_state::SHARD_COUNT);
+    auto ignore_msb = ep_state.get_application_state_ptr(application_state::IGNORE_MSB_BITS);
+    if (!shard_count || !ignore_msb) {
+        return;
+    }
+    unsigned shards;
+    unsigned msb;
+    try {
+        shards = std::stoul(shard_count->value);
+        msb = std::stoul(ignore_msb->value);
+        if (!shards) {
+            throw std::invalid_argument("zero shards");
+        }
+    } catch (...) {
+        slogger.warn("Invalid sharding information for {}: shard_count={}, ignore_msb_bits={}", endpoint, shard_count->value, ignore_msb->value);
+        return;
+    }
+    netw::get_messaging_service().invoke_on_all([endpoint, shards, msb] (auto& ms) {
+        ms.set_sharding_info(endpoint, shards, msb);
+    }).get();
 }
 
 void storage_service::on_dead(gms::inet_address endpoint, gms::endpoint_state state) {
@@ -2281,17 +2333,36 @@ future<> storage_service::start_native_transport() {
         cql_server_config.max_request_size = ss._service_memory_total;
         cql_server_config.get_service_memory_limiter_semaphore = [ss = std::ref(get_storage_service())] () -> semaphore& { return ss.get().local()._service_memory_limiter; };
         cql_server_config.allow_shard_aware_drivers = cfg.enable_shard_aware_drivers();
+        cql_server_config.compression_threshold = cfg.native_transport_compression_threshold();
+        bool separate_ssl_port = ceo.at("enabled") == "true"
+                && cfg.native_transport_port_ssl.is_set() && cfg.native_transport_port_ssl() != cfg.native_transport_port();
+        // Without shard-aware drivers, nothing would connect to the shard-aware ports.
+        if (cql_server_config.allow_shard_aware_drivers) {
+            if (cfg.native_shard_aware_transport_port()) {
+                cql_server_config.shard_aware_transport_port = cfg.native_shard_aware_transport_port();
+            }
+            if (separate_ssl_port && cfg.native_shard_aware_transport_port_ssl()) {
+                cql_server_config.shard_aware_transport_port_ssl = cfg.native_shard_aware_transport_port_ssl();
+            }
+        }
         return gms::inet_address::lookup(addr, family, preferred).then([&ss, cserver, addr, &cfg, keepalive, ceo = std::move(ceo), cql_server_config] (seastar::net::inet_address ip) {
-                return cserver->start(std::ref(service::get_storage_proxy()), std::ref(cql3::get_query_processor()), std::ref(ss._auth_service), std::ref(ss._cql_config), cql_server_config).then([cserver, &cfg, addr, ip, ceo, keepalive]() {
+                return cserver->start(std::ref(service::get_storage_proxy()), std::ref(cql3::get_query_processor()), std::ref(ss._auth_service), std::ref(ss._cql_config), cql_server_config).then([cserver, &cfg, addr, ip, ceo, keepalive, cql_server_config]() {
 
                 auto f = make_ready_future();
 
                 struct listen_cfg {
                     socket_address addr;
+                    bool is_shard_aware;
                     std::shared_ptr<seastar::tls::credentials_builder> cred;
                 };
 
-                std::vector<listen_cfg> configs({ { socket_address{ip, cfg.native_transport_port()} }});
+                // The shard-aware ports pick the shard which accepts a connection from the
+                // client's port, instead of letting the kernel choose, so that drivers can
+                // open a connection to each shard deterministically.
+                std::vector<listen_cfg> configs({ { socket_address{ip, cfg.native_transport_port()}, false } });
+                if (cql_server_config.shard_aware_transport_port) {
+                    configs.emplace_back(listen_cfg{ socket_address{ip, *cql_server_config.shard_aware_transport_port}, true });
+                }
 
                 // main should have made sure values are clean and neatish
                 if (ceo.at("enabled") == "true") {
@@ -2316,17 +2387,22 @@ future<> storage_service::start_native_transport() {
                     slogger.info("Enabling encrypted CQL connections between client and server");
 
                     if (cfg.native_transport_port_ssl.is_set() && cfg.native_transport_port_ssl() != cfg.native_transport_port()) {
-                        configs.emplace_back(listen_cfg{{ip, cfg.native_transport_port_ssl()}, std::move(cred)});
+                        configs.emplace_back(listen_cfg{{ip, cfg.native_transport_port_ssl()}, false, cred});
+                        if (cql_server_config.shard_aware_transport_port_ssl) {
+                            configs.emplace_back(listen_cfg{{ip, *cql_server_config.shard_aware_transport_port_ssl}, true, std::move(cred)});
+                        }
                     } else {
-                        configs.back().cred = std::move(cred);
+                        for (auto& c : configs) {
+                            c.cred = cred;
+                        }
                     }
                 }
 
                 return f.then([cserver, configs = std::move(configs), keepalive] {
                     return parallel_for_each(configs, [cserver, keepalive](const listen_cfg & cfg) {
-                        return cserver->invoke_on_all(&cql_transport::cql_server::listen, cfg.addr, cfg.cred, keepalive).then([cfg] {
-                            slogger.info("Starting listening for CQL clients on {} ({})"
-                                            , cfg.addr, cfg.cred ? "encrypted" : "unencrypted"
+                        return cserver->invoke_on_all(&cql_transport::cql_server::listen, cfg.addr, cfg.cred, cfg.is_shard_aware, keepalive).then([cfg] {
+                            slogger.info("Starting listening for CQL clients on {} ({}, {})"
+                                            , cfg.addr, cfg.cred ? "encrypted" : "unencrypted", cfg.is_shard_aware ? "shard-aware" : "non-shard-aware"
                                             );
                         });
                     });
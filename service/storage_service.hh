@@ -341,6 +341,11 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
     gms::feature _view_virtual_columns;
     gms::feature _digest_insensitive_to_expiry;
     gms::feature _computed_columns;
+    gms::feature _row_hash_read_repair_feature;
+    gms::feature _aggregate_pushdown_feature;
+    gms::feature _parallel_scan_paging_feature;
+    gms::feature _row_level_repair_xxh3_feature;
+    gms::feature _stream_whole_sstables_feature;
 
     sstables::sstable_version_types _sstables_format = sstables::sstable_version_types::ka;
     seastar::semaphore _feature_listeners_sem = {1};
@@ -779,6 +784,7 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
     virtual void on_drop_view(const sstring& ks_name, const sstring& view_name) override {}
 private:
     void update_peer_info(inet_address endpoint);
+    void update_sharding_info(gms::inet_address endpoint, const gms::endpoint_state& ep_state);
     void do_update_system_peers_table(gms::inet_address endpoint, const application_state& state, const versioned_value& value);
     sstring get_application_state_value(inet_address endpoint, application_state appstate);
     std::unordered_set<token> get_tokens_for(inet_address endpoint);
@@ -2365,6 +2371,26 @@ class storage_service : public service::migration_listener, public gms::i_endpoi
         return bool(_computed_columns);
     }
 
+    bool cluster_supports_row_hash_read_repair() const {
+        return bool(_row_hash_read_repair_feature);
+    }
+
+    bool cluster_supports_aggregate_pushdown() const {
+        return bool(_aggregate_pushdown_feature);
+    }
+
+    bool cluster_supports_parallel_scan_paging() const {
+        return bool(_parallel_scan_paging_feature);
+    }
+
+    bool cluster_supports_row_level_repair_xxh3() const {
+        return bool(_row_level_repair_xxh3_feature);
+    }
+
+    bool cluster_supports_stream_whole_sstables() const {
+        return bool(_stream_whole_sstables_feature);
+    }
+
     // Returns schema features which all nodes in the cluster advertise as supported.
     db::schema_features cluster_schema_features() const;
 
@@ -317,6 +317,8 @@ class compaction {
     std::vector<unsigned long> _ancestors;
     db::replay_position _rp;
     encoding_stats_collector _stats_collector;
+    // The output is repaired only if all the input is.
+    uint64_t _repaired_at = 0;
 protected:
     compaction(column_family& cf, std::vector<shared_sstable> sstables, uint64_t max_sstable_size, uint32_t sstable_level)
         : _cf(cf)
@@ -329,6 +331,9 @@ class compaction {
         for (auto sst : _sstables) {
             _stats_collector.update(sst->get_encoding_stats_for_compaction());
         }
+        if (!_sstables.empty()) {
+            _repaired_at = *boost::min_element(_sstables | boost::adaptors::transformed(std::mem_fn(&sstable::get_repaired_at)));
+        }
         _cf.get_compaction_manager().register_compaction(_info);
     }
 
@@ -342,6 +347,7 @@ class compaction {
         _new_unused_sstables.push_back(sst);
         sst->get_metadata_collector().set_replay_position(_rp);
         sst->get_metadata_collector().sstable_level(_sstable_level);
+        sst->get_metadata_collector().set_repaired_at(_repaired_at);
         for (auto ancestor : _ancestors) {
             sst->add_ancestor(ancestor);
         }
@@ -228,6 +228,21 @@ std::vector<sstables::shared_sstable> compaction_manager::get_candidates(const c
     return candidates;
 }
 
+// Repaired and unrepaired sstables are never compacted together, so that
+// incremental repair can keep skipping the repaired data. Returns the
+// unrepaired candidates, followed by the repaired ones if there are any.
+// Leveled compaction builds its manifest from the candidates it is given, so
+// each set gets levels of its own.
+static std::vector<std::vector<sstables::shared_sstable>> split_by_repaired_status(std::vector<sstables::shared_sstable> candidates) {
+    auto it = std::stable_partition(candidates.begin(), candidates.end(), [] (const sstables::shared_sstable& sst) { return !sst->is_repaired(); });
+    std::vector<std::vector<sstables::shared_sstable>> sets;
+    sets.emplace_back(candidates.begin(), it);
+    if (it != candidates.end()) {
+        sets.emplace_back(it, candidates.end());
+    }
+    return sets;
+}
+
 void compaction_manager::register_compacting_sstables(const std::vector<sstables::shared_sstable>& sstables) {
     for (auto& sst : sstables) {
         _compacting_sstables.insert(sst);
@@ -274,18 +289,22 @@ future<> compaction_manager::submit_major_compaction(column_family* cf) {
 
             // candidates are sstables that aren't being operated on by other compaction types.
             // those are eligible for major compaction.
-            sstables::compaction_strategy cs = cf->get_compaction_strategy();
-            sstables::compaction_descriptor descriptor = cs.get_major_compaction_job(*cf, get_candidates(*cf));
-            auto compacting = compacting_sstable_registration(this, descriptor.sstables);
-
-            cmlog.info0("User initiated compaction started on behalf of {}.{}", cf->schema()->ks_name(), cf->schema()->cf_name());
-            compaction_backlog_tracker user_initiated(std::make_unique<user_initiated_backlog_tracker>(_compaction_controller.backlog_of_shares(200), _available_memory));
-            return do_with(std::move(user_initiated), [this, cf, descriptor = std::move(descriptor)] (compaction_backlog_tracker& bt) mutable {
-                register_backlog_tracker(bt);
-                return with_scheduling_group(_scheduling_group, [this, cf, descriptor = std::move(descriptor)] () mutable {
-                    return cf->compact_sstables(std::move(descriptor));
-                });
-            }).then([compacting = std::move(compacting)] {});
+            return do_with(split_by_repaired_status(get_candidates(*cf)), [this, cf] (std::vector<std::vector<sstables::shared_sstable>>& candidate_sets) {
+              return do_for_each(candidate_sets, [this, cf] (std::vector<sstables::shared_sstable>& candidates) {
+                sstables::compaction_strategy cs = cf->get_compaction_strategy();
+                sstables::compaction_descriptor descriptor = cs.get_major_compaction_job(*cf, std::move(candidates));
+                auto compacting = compacting_sstable_registration(this, descriptor.sstables);
+
+                cmlog.info0("User initiated compaction started on behalf of {}.{}", cf->schema()->ks_name(), cf->schema()->cf_name());
+                compaction_backlog_tracker user_initiated(std::make_unique<user_initiated_backlog_tracker>(_compaction_controller.backlog_of_shares(200), _available_memory));
+                return do_with(std::move(user_initiated), [this, cf, descriptor = std::move(descriptor)] (compaction_backlog_tracker& bt) mutable {
+                    register_backlog_tracker(bt);
+                    return with_scheduling_group(_scheduling_group, [this, cf, descriptor = std::move(descriptor)] () mutable {
+                        return cf->compact_sstables(std::move(descriptor));
+                    });
+                }).then([compacting = std::move(compacting)] {});
+              });
+            });
         });
     }).then_wrapped([this, task] (future<> f) {
         _stats.active_tasks--;
@@ -517,7 +536,17 @@ void compaction_manager::submit(column_family* cf) {
           return with_scheduling_group(_scheduling_group, [this, task = std::move(task)] () mutable {
             column_family& cf = *task->compacting_cf;
             sstables::compaction_strategy cs = cf.get_compaction_strategy();
-            sstables::compaction_descriptor descriptor = cs.get_sstables_for_compaction(cf, get_candidates(cf));
+            // Alternate between the unrepaired and the repaired sstables, so
+            // that neither starves while the other keeps yielding jobs.
+            auto candidate_sets = split_by_repaired_status(get_candidates(cf));
+            size_t first = candidate_sets.size() > 1 && task->prefer_repaired ? 1 : 0;
+            size_t picked = first;
+            sstables::compaction_descriptor descriptor = cs.get_sstables_for_compaction(cf, std::move(candidate_sets[first]));
+            if (descriptor.sstables.empty() && candidate_sets.size() > 1) {
+                picked = 1 - first;
+                descriptor = cs.get_sstables_for_compaction(cf, std::move(candidate_sets[picked]));
+            }
+            task->prefer_repaired = picked == 0;
             int weight = trim_to_compact(&cf, descriptor);
 
             if (descriptor.sstables.empty() || !can_proceed(task)) {
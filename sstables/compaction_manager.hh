@@ -62,6 +62,9 @@ class compaction_manager {
         bool stopping = false;
         bool cleanup = false;
         bool compaction_running = false;
+        // Whether the next minor compaction job is looked for in the
+        // repaired sstables first, see submit().
+        bool prefer_repaired = false;
     };
 
     // compaction manager may have N fibers to allow parallel compaction per shard.
@@ -592,6 +592,23 @@ class writer : public sstable_writer::writer_impl {
     utils::UUID _run_identifier;
     bool _write_regular_as_static; // See #4139
 
+    // Values larger than this don't go into the column value ranges, and
+    // the column is left out of them.
+    static constexpr size_t max_value_range_bound_size = 256;
+    struct value_range {
+        bytes min;
+        bytes max;
+    };
+    struct tracked_value_range {
+        std::optional<value_range> range;
+        bool too_large = false;
+    };
+    // Indexed by the id of the regular column.
+    std::vector<tracked_value_range> _value_ranges;
+
+    void update_value_range(const column_definition& cdef, atomic_cell_view cell);
+    column_value_ranges make_column_value_ranges() const;
+
     void init_file_writers();
 
     // Returns the closed writer
@@ -744,6 +761,7 @@ class writer : public sstable_writer::writer_impl {
         , _sst_schema(make_sstable_schema(s, _enc_stats, _cfg))
         , _run_identifier(cfg.run_identifier)
         , _write_regular_as_static(cfg.correctly_serialize_static_compact_in_mc && s.is_static_compact_table())
+        , _value_ranges(s.regular_columns_count())
     {
         _sst.generate_toc(_schema.get_compressor_params().get_compressor(), _schema.bloom_filter_fp_chance());
         _sst.write_toc(_pc);
@@ -1008,6 +1026,10 @@ void writer::write_cell(bytes_ostream& writer, const clustering_key_prefix* clus
     }
     write(_sst.get_version(), writer, flags);
 
+    if (!is_deleted && !cell_path && cdef.is_regular() && !cdef.is_counter()) {
+        update_value_range(cdef, cell);
+    }
+
     if (!use_row_timestamp) {
         write_delta_timestamp(writer, cell.timestamp());
     }
@@ -1117,6 +1139,45 @@ void writer::write_collection(bytes_ostream& writer, const clustering_key_prefix
     _sst.get_large_data_handler().maybe_record_large_cells(_sst, *_partition_key, clustering_key, cdef, size).get();
 }
 
+void writer::update_value_range(const column_definition& cdef, atomic_cell_view cell) {
+    auto& tracked = _value_ranges[cdef.id];
+    if (tracked.too_large) {
+        return;
+    }
+    cell.value().with_linearized([&] (bytes_view v) {
+        if (v.size() > max_value_range_bound_size) {
+            tracked.too_large = true;
+            tracked.range.reset();
+            return;
+        }
+        if (!tracked.range) {
+            tracked.range = value_range{bytes(v), bytes(v)};
+            return;
+        }
+        if (cdef.type->compare(v, tracked.range->min) < 0) {
+            tracked.range->min = bytes(v);
+        } else if (cdef.type->compare(v, tracked.range->max) > 0) {
+            tracked.range->max = bytes(v);
+        }
+    });
+}
+
+column_value_ranges writer::make_column_value_ranges() const {
+    column_value_ranges ranges;
+    for (auto& cdef : _schema.regular_columns()) {
+        auto& tracked = _value_ranges[cdef.id];
+        if (!tracked.range) {
+            continue;
+        }
+        ranges.ranges.elements.push_back(column_value_range{
+            {cdef.name()},
+            {to_bytes(cdef.type->name())},
+            {tracked.range->min},
+            {tracked.range->max}});
+    }
+    return ranges;
+}
+
 void writer::write_cells(bytes_ostream& writer, const clustering_key_prefix* clustering_key, column_kind kind, const row& row_body,
     const row_time_properties& properties, bool has_complex_deletion) {
     // Note that missing columns are written based on the whole set of regular columns as defined by schema.
@@ -1420,7 +1481,7 @@ void writer::consume_end_of_stream() {
         features.disable(sstable_feature::CorrectStaticCompact);
     }
     run_identifier identifier{_run_identifier};
-    _sst.write_scylla_metadata(_pc, _shard, std::move(features), std::move(identifier));
+    _sst.write_scylla_metadata(_pc, _shard, std::move(features), std::move(identifier), make_column_value_ranges());
     _cfg.monitor->on_write_completed();
     if (!_cfg.leave_unsealed) {
         _sst.seal_sstable(_cfg.backup).get();
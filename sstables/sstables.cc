@@ -2210,7 +2210,8 @@ sstable::read_scylla_metadata(const io_priority_class& pc) {
 }
 
 void
-sstable::write_scylla_metadata(const io_priority_class& pc, shard_id shard, sstable_enabled_features features, struct run_identifier identifier) {
+sstable::write_scylla_metadata(const io_priority_class& pc, shard_id shard, sstable_enabled_features features, struct run_identifier identifier,
+        std::optional<column_value_ranges> value_ranges) {
     auto&& first_key = get_first_decorated_key();
     auto&& last_key = get_last_decorated_key();
     auto sm = create_sharding_metadata(_schema, first_key, last_key, shard);
@@ -2228,6 +2229,9 @@ sstable::write_scylla_metadata(const io_priority_class& pc, shard_id shard, ssta
     _components->scylla_metadata->data.set<scylla_metadata_type::Sharding>(std::move(sm));
     _components->scylla_metadata->data.set<scylla_metadata_type::Features>(std::move(features));
     _components->scylla_metadata->data.set<scylla_metadata_type::RunIdentifier>(std::move(identifier));
+    if (value_ranges) {
+        _components->scylla_metadata->data.set<scylla_metadata_type::ColumnValueRanges>(std::move(*value_ranges));
+    }
 
     write_simple<component_type::Scylla>(*_components->scylla_metadata, pc);
 }
@@ -2891,12 +2895,61 @@ future<> sstable::mutate_sstable_level(uint32_t new_level) {
     });
 }
 
+future<> sstable::mutate_repaired_at(uint64_t repaired_at) {
+    if (!has_component(component_type::Statistics)) {
+        return make_ready_future<>();
+    }
+
+    auto entry = _components->statistics.contents.find(metadata_type::Stats);
+    if (entry == _components->statistics.contents.end()) {
+        return make_ready_future<>();
+    }
+
+    auto& p = entry->second;
+    if (!p) {
+        throw std::runtime_error("Statistics is malformed");
+    }
+    stats_metadata& s = *static_cast<stats_metadata *>(p.get());
+    if (s.repaired_at == repaired_at) {
+        return make_ready_future<>();
+    }
+
+    sstlog.debug("set repaired_at of {} from {} to {}", get_filename(), s.repaired_at, repaired_at);
+    s.repaired_at = repaired_at;
+    return seastar::async([this] {
+        rewrite_statistics(default_priority_class());
+    });
+}
+
 int sstable::compare_by_max_timestamp(const sstable& other) const {
     auto ts1 = get_stats_metadata().max_timestamp;
     auto ts2 = other.get_stats_metadata().max_timestamp;
     return (ts1 > ts2 ? 1 : (ts1 == ts2 ? 0 : -1));
 }
 
+sstable::files_pin::files_pin(shared_sstable sst)
+        : _sst(std::move(sst)) {
+    ++_sst->_files_pins;
+}
+
+sstable::files_pin::~files_pin() {
+    if (_sst && --_sst->_files_pins == 0) {
+        _sst->_files_unpinned.broadcast();
+    }
+}
+
+std::optional<sstable::files_pin> sstable::pin_files() {
+    if (_deleting_files) {
+        return std::nullopt;
+    }
+    return files_pin(shared_from_this());
+}
+
+future<> sstable::wait_for_files_unpinned() {
+    _deleting_files = true;
+    return _files_unpinned.wait([this] { return _files_pins == 0; });
+}
+
 sstable::~sstable() {
     if (_index_file) {
         // Registered as background job.
@@ -3258,6 +3311,10 @@ delete_atomically(std::vector<shared_sstable> ssts) {
         sstring sstdir;
         min_max_tracker<int64_t> gen_tracker;
 
+        for (const auto& sst : ssts) {
+            sst->wait_for_files_unpinned().get();
+        }
+
         for (const auto& sst : ssts) {
             gen_tracker.update(sst->generation());
 
@@ -31,6 +31,7 @@
 #include <seastar/core/enum.hh>
 #include <seastar/core/shared_ptr.hh>
 #include <seastar/core/distributed.hh>
+#include <seastar/core/condition-variable.hh>
 #include <unordered_set>
 #include <unordered_map>
 #include <variant>
@@ -300,6 +301,26 @@ class sstable : public enable_lw_shared_from_this<sstable> {
         return _marked_for_deletion == mark_for_deletion::marked;
     }
 
+    // Keeps the component files of an sstable from being deleted, e.g. by
+    // the compaction which replaced it, while they are read directly rather
+    // than through a reader, as when they are streamed as they are.
+    // delete_atomically() waits for the pins of the sstables it deletes to
+    // be released.
+    class files_pin {
+        shared_sstable _sst;
+    public:
+        explicit files_pin(shared_sstable sst);
+        files_pin(files_pin&&) noexcept = default;
+        files_pin& operator=(files_pin&&) = delete;
+        ~files_pin();
+    };
+
+    // Returns std::nullopt if the files are being deleted already.
+    std::optional<files_pin> pin_files();
+
+    // Prevents new pins, and waits until the files are no longer pinned.
+    future<> wait_for_files_unpinned();
+
     void add_ancestor(int64_t generation) {
         _collector.add_ancestor(generation);
     }
@@ -337,6 +358,10 @@ class sstable : public enable_lw_shared_from_this<sstable> {
         return _version;
     }
 
+    format_types get_format() const {
+        return _format;
+    }
+
     // Returns the total bytes of all components.
     uint64_t bytes_on_disk();
 
@@ -533,6 +558,10 @@ class sstable : public enable_lw_shared_from_this<sstable> {
         marked = 1
     } _marked_for_deletion = mark_for_deletion::none;
 
+    unsigned _files_pins = 0;
+    bool _deleting_files = false;
+    seastar::condition_variable _files_unpinned;
+
     gc_clock::time_point _now;
 
     io_error_handler _read_error_handler;
@@ -571,7 +600,8 @@ class sstable : public enable_lw_shared_from_this<sstable> {
     void write_compression(const io_priority_class& pc);
 
     future<> read_scylla_metadata(const io_priority_class& pc);
-    void write_scylla_metadata(const io_priority_class& pc, shard_id shard, sstable_enabled_features features, run_identifier identifier);
+    void write_scylla_metadata(const io_priority_class& pc, shard_id shard, sstable_enabled_features features, run_identifier identifier,
+            std::optional<column_value_ranges> value_ranges = {});
 
     future<> read_filter(const io_priority_class& pc);
 
@@ -706,6 +736,14 @@ class sstable : public enable_lw_shared_from_this<sstable> {
         return _run_identifier;
     }
 
+    // Null if the sstable was written without value ranges.
+    const column_value_ranges* get_column_value_ranges() const {
+        if (!has_scylla_component()) {
+            return nullptr;
+        }
+        return _components->scylla_metadata->get_column_value_ranges();
+    }
+
     bool has_correct_max_deletion_time() const {
         return (_version == sstable_version_types::mc) || has_scylla_component();
     }
@@ -804,6 +842,19 @@ class sstable : public enable_lw_shared_from_this<sstable> {
 
     future<> mutate_sstable_level(uint32_t);
 
+    // The time, in milliseconds since the epoch, at which all the data of this
+    // sstable was known to be repaired, or 0 if it wasn't repaired.
+    uint64_t get_repaired_at() const {
+        return get_stats_metadata().repaired_at;
+    }
+
+    bool is_repaired() const {
+        return get_repaired_at() != 0;
+    }
+
+    // Changes repaired_at and rewrites the Statistics component.
+    future<> mutate_repaired_at(uint64_t repaired_at);
+
     const summary& get_summary() const {
         return _components->summary;
     }
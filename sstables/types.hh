@@ -498,6 +498,7 @@ enum class scylla_metadata_type : uint32_t {
     Features = 2,
     ExtensionAttributes = 3,
     RunIdentifier = 4,
+    ColumnValueRanges = 5,
 };
 
 struct run_identifier {
@@ -509,6 +510,29 @@ struct run_identifier {
     auto describe_type(sstable_version_types v, Describer f) { return f(id); }
 };
 
+// The smallest and the largest live value of a regular column in an sstable,
+// serialized with the column's type at the time the sstable was written.
+struct column_value_range {
+    disk_string<uint32_t> column_name;
+    disk_string<uint32_t> type_name;
+    disk_string<uint32_t> min;
+    disk_string<uint32_t> max;
+
+    template <typename Describer>
+    auto describe_type(sstable_version_types v, Describer f) { return f(column_name, type_name, min, max); }
+};
+
+// Value ranges of the regular columns of an sstable, which allow reads with
+// restrictions on regular columns to skip partitions the sstable can't
+// satisfy. Columns without live values, or with values too large to be
+// recorded, are left out.
+struct column_value_ranges {
+    disk_array<uint32_t, column_value_range> ranges;
+
+    template <typename Describer>
+    auto describe_type(sstable_version_types v, Describer f) { return f(ranges); }
+};
+
 struct scylla_metadata {
     using extension_attributes = disk_hash<uint32_t, disk_string<uint32_t>, disk_string<uint32_t>>;
 
@@ -516,7 +540,8 @@ struct scylla_metadata {
             disk_tagged_union_member<scylla_metadata_type, scylla_metadata_type::Sharding, sharding_metadata>,
             disk_tagged_union_member<scylla_metadata_type, scylla_metadata_type::Features, sstable_enabled_features>,
             disk_tagged_union_member<scylla_metadata_type, scylla_metadata_type::ExtensionAttributes, extension_attributes>,
-            disk_tagged_union_member<scylla_metadata_type, scylla_metadata_type::RunIdentifier, run_identifier>
+            disk_tagged_union_member<scylla_metadata_type, scylla_metadata_type::RunIdentifier, run_identifier>,
+            disk_tagged_union_member<scylla_metadata_type, scylla_metadata_type::ColumnValueRanges, column_value_ranges>
             > data;
 
     sstable_enabled_features get_features() const {
@@ -544,6 +569,9 @@ struct scylla_metadata {
         auto* m = data.get<scylla_metadata_type::RunIdentifier, run_identifier>();
         return m ? std::make_optional(m->id) : std::nullopt;
     }
+    const column_value_ranges* get_column_value_ranges() const {
+        return data.get<scylla_metadata_type::ColumnValueRanges, column_value_ranges>();
+    }
 
     template <typename Describer>
     auto describe_type(sstable_version_types v, Describer f) { return f(data); }
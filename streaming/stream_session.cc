@@ -67,6 +67,9 @@
 #include "../db/view/view_update_generator.hh"
 #include "mutation_source_metadata.hh"
 #include "streaming/stream_mutation_fragments_cmd.hh"
+#include "streaming/stream_sstable_files_cmd.hh"
+#include "utils/crc.hh"
+#include <seastar/core/fstream.hh>
 
 namespace streaming {
 
@@ -102,6 +105,194 @@ static auto get_session(utils::UUID plan_id, gms::inet_address from, const char*
     return coordinator->get_or_create_session(from);
 }
 
+// Returns the consumer of distribute_reader_and_consume_on_shards() which
+// writes the streamed data of each shard to new sstables.
+static std::function<future<> (flat_mutation_reader)> make_sstable_writing_consumer(distributed<database>& db,
+        distributed<db::system_distributed_keyspace>& sys_dist_ks, distributed<db::view::view_update_generator>& view_update_generator,
+        uint64_t estimated_partitions, stream_reason reason) {
+    return [&db, &sys_dist_ks, &view_update_generator, estimated_partitions, reason] (flat_mutation_reader reader) {
+        auto& cf = db.local().find_column_family(reader.schema());
+        return db::view::check_needs_view_update_path(sys_dist_ks.local(), cf, reason).then([&view_update_generator, cf = cf.shared_from_this(), estimated_partitions, reader = std::move(reader)] (bool use_view_update_path) mutable {
+            //FIXME: for better estimations this should be transmitted from remote
+            auto metadata = mutation_source_metadata{};
+            auto& cs = cf->get_compaction_strategy();
+            const auto adjusted_estimated_partitions = cs.adjust_partition_estimate(metadata, estimated_partitions);
+            auto consumer = cf->get_compaction_strategy().make_interposer_consumer(metadata,
+                    [&view_update_generator, cf = std::move(cf), adjusted_estimated_partitions, use_view_update_path] (flat_mutation_reader reader) {
+                sstables::shared_sstable sst = use_view_update_path ? cf->make_streaming_staging_sstable() : cf->make_streaming_sstable_for_write();
+                schema_ptr s = reader.schema();
+                auto& pc = service::get_local_streaming_write_priority();
+
+                return sst->write_components(std::move(reader), std::max(1ul, adjusted_estimated_partitions), s,
+                                             sstables::sstable_writer_config{}, encoding_stats{}, pc).then([sst] {
+                    return sst->open_data();
+                }).then([cf, sst] {
+                    return cf->add_sstable_and_update_cache(sst);
+                }).then([&view_update_generator, cf, s, sst, use_view_update_path]() mutable -> future<> {
+                    if (!use_view_update_path) {
+                        return make_ready_future<>();
+                    }
+                    return view_update_generator.local().register_staging_sstable(sst, std::move(cf));
+                });
+            });
+            return consumer(std::move(reader));
+        });
+    };
+}
+
+// Adds an sstable received by STREAM_SSTABLE_FILES to the table. When all of
+// its data belongs to one shard, which is the case when both nodes shard the
+// ring the same way, the sstable is added as is on that shard. Otherwise its
+// data is rewritten to sstables of each shard, like streamed mutation
+// fragments. Must be called in a thread.
+static void add_received_sstable(distributed<database>& db, distributed<db::system_distributed_keyspace>& sys_dist_ks, distributed<db::view::view_update_generator>& view_update_generator,
+        table& cf, sstables::shared_sstable sst, bool use_view_update_path, stream_reason reason) {
+    sst->load().get();
+    auto shards = sst->get_shards_for_this_sstable();
+    if (shards.size() != 1) {
+        sslog.debug("Received sstable {} belongs to {} shards, rewriting it", sst->get_filename(), shards.size());
+        auto s = cf.schema();
+        auto& pc = service::get_local_streaming_read_priority();
+        mutation_writer::distribute_reader_and_consume_on_shards(s, dht::global_partitioner(), sst->read_rows_flat(s, pc),
+                make_sstable_writing_consumer(db, sys_dist_ks, view_update_generator, sst->get_estimated_key_count(), reason),
+                cf.stream_in_progress()).get();
+        sst->mark_for_deletion();
+        return;
+    }
+    // Like the sstables written from streamed mutation fragments, received
+    // sstables are unrepaired and in level 0. The sender's level says nothing
+    // about the overlap with the sstables of this node.
+    if (sst->get_sstable_level() != 0) {
+        sst->mutate_sstable_level(0).get();
+    }
+    if (sst->is_repaired()) {
+        sst->mutate_repaired_at(0).get();
+    }
+    auto add = [&view_update_generator, use_view_update_path] (table& cf, sstables::shared_sstable sst) {
+        return cf.add_sstable_and_update_cache(sst).then([&view_update_generator, &cf, sst, use_view_update_path] {
+            if (!use_view_update_path) {
+                return make_ready_future<>();
+            }
+            return view_update_generator.local().register_staging_sstable(sst, cf.shared_from_this());
+        });
+    };
+    if (shards[0] == engine().cpu_id()) {
+        add(cf, std::move(sst)).get();
+        return;
+    }
+    smp::submit_to(shards[0], [&db, add, cf_id = cf.schema()->id(), dir = sst->get_dir(), generation = sst->generation(), version = sst->get_version()] {
+        auto& cf = db.local().find_column_family(cf_id);
+        auto sst = cf.make_sstable(dir, generation, version, sstables::sstable::format_types::big);
+        return sst->load().then([add, &cf, sst] {
+            return add(cf, sst);
+        });
+    }).get();
+}
+
+future<uint64_t> stream_session::receive_sstable_files(distributed<database>& db, distributed<db::system_distributed_keyspace>& sys_dist_ks,
+        distributed<db::view::view_update_generator>& view_update_generator, schema_ptr s, UUID plan_id, msg_addr from, stream_reason reason,
+        sstable_files_source source) {
+    return seastar::async([&db, &sys_dist_ks, &view_update_generator, s = std::move(s), plan_id, from, reason, source = std::move(source)] () mutable {
+        auto& cf = db.local().find_column_family(s);
+        auto op = cf.stream_in_progress();
+        bool use_view_update_path = db::view::check_needs_view_update_path(sys_dist_ks.local(), cf, reason).get0();
+        uint64_t received_sstables = 0;
+        bool got_end_of_stream = false;
+        sstables::shared_sstable sst;
+        // The files written for the sstable being received, which are removed
+        // if it is not received completely.
+        std::vector<sstring> files;
+        std::optional<output_stream<char>> out;
+        utils::crc32 checksum;
+        auto check = [] (bool cond) {
+            if (!cond) {
+                throw std::runtime_error("Sender sent wrong cmd");
+            }
+        };
+        try {
+            while (!got_end_of_stream) {
+                auto opt = source().get0();
+                if (!opt) {
+                    throw std::runtime_error("Sender did not sent end_of_stream");
+                }
+                auto& chunk = *opt;
+                switch (chunk.cmd) {
+                case stream_sstable_files_cmd::sstable_start: {
+                    check(!sst);
+                    auto version = sstables::from_string(chunk.name);
+                    sst = use_view_update_path ? cf.make_streaming_staging_sstable(version) : cf.make_streaming_sstable_for_write({}, version);
+                    break;
+                }
+                case stream_sstable_files_cmd::component_start: {
+                    check(sst && !out);
+                    if (chunk.name.empty() || chunk.name.find('/') != sstring::npos) {
+                        throw std::runtime_error(format("Sender sent invalid component name {}", chunk.name));
+                    }
+                    // The TOC is written as the TemporaryTOC, which is renamed
+                    // once all components are written, so that an sstable
+                    // which was not received completely is removed on restart.
+                    auto component = sstables::sstable::component_from_sstring(sst->get_version(), chunk.name);
+                    auto name = component == sstables::component_type::TOC
+                            ? sst->filename(sstables::component_type::TemporaryTOC)
+                            : sstables::sstable::filename(sst->get_dir(), s->ks_name(), s->cf_name(), sst->get_version(), sst->generation(), sst->get_format(), chunk.name);
+                    files.push_back(name);
+                    auto f = open_file_dma(name, open_flags::wo | open_flags::create | open_flags::exclusive).get0();
+                    file_output_stream_options options;
+                    options.buffer_size = 128 * 1024;
+                    options.io_priority_class = service::get_local_streaming_write_priority();
+                    out.emplace(make_file_output_stream(std::move(f), std::move(options)));
+                    checksum = utils::crc32();
+                    break;
+                }
+                case stream_sstable_files_cmd::component_data:
+                    check(bool(out));
+                    checksum.process(reinterpret_cast<const uint8_t*>(chunk.data.data()), chunk.data.size());
+                    get_local_stream_manager().update_progress(plan_id, from.addr, progress_info::direction::IN, chunk.data.size());
+                    out->write(reinterpret_cast<const char*>(chunk.data.data()), chunk.data.size()).get();
+                    break;
+                case stream_sstable_files_cmd::component_end:
+                    check(bool(out));
+                    out->close().get();
+                    out.reset();
+                    if (checksum.get() != chunk.checksum) {
+                        throw std::runtime_error(format("Checksum mismatch in received file {}: expected {}, got {}", files.back(), chunk.checksum, checksum.get()));
+                    }
+                    break;
+                case stream_sstable_files_cmd::sstable_end:
+                    check(sst && !out);
+                    sync_directory(sst->get_dir()).get();
+                    rename_file(sst->filename(sstables::component_type::TemporaryTOC), sst->toc_filename()).get();
+                    sync_directory(sst->get_dir()).get();
+                    files.clear();
+                    add_received_sstable(db, sys_dist_ks, view_update_generator, cf, std::move(sst), use_view_update_path, reason);
+                    ++received_sstables;
+                    break;
+                case stream_sstable_files_cmd::end_of_stream:
+                    check(!sst);
+                    got_end_of_stream = true;
+                    break;
+                case stream_sstable_files_cmd::error:
+                    throw std::runtime_error("Sender failed");
+                default:
+                    throw std::runtime_error("Sender sent wrong cmd");
+                }
+            }
+        } catch (...) {
+            auto ep = std::current_exception();
+            if (out) {
+                out->close().handle_exception([] (std::exception_ptr) { }).get();
+            }
+            for (auto& name : files) {
+                remove_file(name).handle_exception([name] (std::exception_ptr ep) {
+                    sslog.warn("Failed to remove {}: {}", name, ep);
+                }).get();
+            }
+            std::rethrow_exception(ep);
+        }
+        return received_sstables;
+    });
+}
+
 void stream_session::init_messaging_service_handler() {
     ms().register_prepare_message([] (const rpc::client_info& cinfo, prepare_message msg, UUID plan_id, sstring description, rpc::optional<stream_reason> reason_opt) {
         const auto& src_cpu_id = cinfo.retrieve_auxiliary<uint32_t>("src_cpu_id");
@@ -216,34 +407,7 @@ void stream_session::init_messaging_service_handler() {
                     //FIXME: discarded future.
                     (void)mutation_writer::distribute_reader_and_consume_on_shards(s, dht::global_partitioner(),
                         make_generating_reader(s, std::move(get_next_mutation_fragment)),
-                        [plan_id, estimated_partitions, reason] (flat_mutation_reader reader) {
-                            auto& cf = get_local_db().find_column_family(reader.schema());
-                            return db::view::check_needs_view_update_path(_sys_dist_ks->local(), cf, reason).then([cf = cf.shared_from_this(), estimated_partitions, reader = std::move(reader)] (bool use_view_update_path) mutable {
-                                //FIXME: for better estimations this should be transmitted from remote
-                                auto metadata = mutation_source_metadata{};
-                                auto& cs = cf->get_compaction_strategy();
-                                const auto adjusted_estimated_partitions = cs.adjust_partition_estimate(metadata, estimated_partitions);
-                                auto consumer = cf->get_compaction_strategy().make_interposer_consumer(metadata,
-                                        [cf = std::move(cf), adjusted_estimated_partitions, use_view_update_path] (flat_mutation_reader reader) {
-                                    sstables::shared_sstable sst = use_view_update_path ? cf->make_streaming_staging_sstable() : cf->make_streaming_sstable_for_write();
-                                    schema_ptr s = reader.schema();
-                                    auto& pc = service::get_local_streaming_write_priority();
-
-                                    return sst->write_components(std::move(reader), std::max(1ul, adjusted_estimated_partitions), s,
-                                                                 sstables::sstable_writer_config{}, encoding_stats{}, pc).then([sst] {
-                                        return sst->open_data();
-                                    }).then([cf, sst] {
-                                        return cf->add_sstable_and_update_cache(sst);
-                                    }).then([cf, s, sst, use_view_update_path]() mutable -> future<> {
-                                        if (!use_view_update_path) {
-                                            return make_ready_future<>();
-                                        }
-                                        return _view_update_generator->local().register_staging_sstable(sst, std::move(cf));
-                                    });
-                                });
-                                return consumer(std::move(reader));
-                            });
-                        },
+                        make_sstable_writing_consumer(*_db, *_sys_dist_ks, *_view_update_generator, estimated_partitions, reason),
                         cf.stream_in_progress()
                     ).then_wrapped([s, plan_id, from, sink, estimated_partitions] (future<uint64_t> f) mutable {
                         int32_t status = 0;
@@ -270,6 +434,46 @@ void stream_session::init_messaging_service_handler() {
                 });
         });
     });
+    ms().register_stream_sstable_files([] (const rpc::client_info& cinfo, UUID plan_id, UUID schema_id, UUID cf_id, stream_reason reason, rpc::source<stream_sstable_files_chunk> source) {
+        auto from = netw::messaging_service::get_source(cinfo);
+        sslog.trace("Got stream_sstable_files from {} reason {}", from, int(reason));
+        if (!_sys_dist_ks->local_is_initialized() || !_view_update_generator->local_is_initialized()) {
+            return make_exception_future<rpc::sink<int>>(std::runtime_error(format("Node {} is not fully initialized for streaming, try again later",
+                    utils::fb_utilities::get_broadcast_address())));
+        }
+        return with_scheduling_group(get_local_db().get_streaming_scheduling_group(), [from, plan_id, schema_id, source, reason] () mutable {
+            return service::get_schema_for_write(schema_id, from).then([from, plan_id, source, reason] (schema_ptr s) mutable {
+                auto sink = ms().make_sink_for_stream_sstable_files(source);
+                auto get_next_chunk = [source] () mutable {
+                    return source().then([] (std::optional<std::tuple<stream_sstable_files_chunk>> opt) -> std::optional<stream_sstable_files_chunk> {
+                        if (!opt) {
+                            return std::nullopt;
+                        }
+                        return std::move(std::get<0>(*opt));
+                    });
+                };
+                //FIXME: discarded future.
+                (void)receive_sstable_files(*_db, *_sys_dist_ks, *_view_update_generator, s, plan_id, from, reason, std::move(get_next_chunk)).then_wrapped([s, plan_id, from, sink] (future<uint64_t> f) mutable {
+                    int32_t status = 0;
+                    if (f.failed()) {
+                        sslog.error("[Stream #{}] Failed to handle STREAM_SSTABLE_FILES (receive phase) for ks={}, cf={}, peer={}: {}",
+                                plan_id, s->ks_name(), s->cf_name(), from.addr, f.get_exception());
+                        status = -1;
+                    } else {
+                        sslog.info("[Stream #{}] Received whole sstables for ks={}, cf={}, received_sstables={}",
+                                plan_id, s->ks_name(), s->cf_name(), f.get0());
+                    }
+                    return sink(status).finally([sink] () mutable {
+                        return sink.close();
+                    });
+                }).handle_exception([s, plan_id, from, sink] (std::exception_ptr ep) {
+                    sslog.error("[Stream #{}] Failed to handle STREAM_SSTABLE_FILES (respond phase) for ks={}, cf={}, peer={}: {}",
+                            plan_id, s->ks_name(), s->cf_name(), from.addr, ep);
+                });
+                return make_ready_future<rpc::sink<int>>(sink);
+            });
+        });
+    });
     ms().register_stream_mutation_done([] (const rpc::client_info& cinfo, UUID plan_id, dht::token_range_vector ranges, UUID cf_id, unsigned dst_cpu_id) {
         const auto& from = cinfo.retrieve_auxiliary<gms::inet_address>("baddr");
         return smp::submit_to(dst_cpu_id, [ranges = std::move(ranges), plan_id, cf_id, from] () mutable {
@@ -40,6 +40,7 @@
 
 #include "gms/i_endpoint_state_change_subscriber.hh"
 #include <seastar/core/distributed.hh>
+#include <seastar/util/noncopyable_function.hh>
 #include "cql3/query_processor.hh"
 #include "message/messaging_service_fwd.hh"
 #include "utils/UUID.hh"
@@ -51,6 +52,7 @@
 #include "streaming/stream_detail.hh"
 #include "streaming/stream_manager.hh"
 #include "streaming/stream_reason.hh"
+#include "streaming/stream_sstable_files_cmd.hh"
 #include "streaming/session_info.hh"
 #include "query-request.hh"
 #include "dht/i_partitioner.hh"
@@ -58,6 +60,7 @@
 #include <map>
 #include <vector>
 #include <memory>
+#include <optional>
 
 namespace db::view {
 
@@ -153,6 +156,14 @@ class stream_session : public enable_shared_from_this<stream_session> {
     static database& get_local_db() { return _db->local(); }
     static distributed<database>& get_db() { return *_db; };
     static future<> init_streaming_service(distributed<database>& db, distributed<db::system_distributed_keyspace>& sys_dist_ks, distributed<db::view::view_update_generator>& view_update_generator);
+    // Returns the next chunk sent by STREAM_SSTABLE_FILES, or a disengaged
+    // optional when the sender closed the stream.
+    using sstable_files_source = noncopyable_function<future<std::optional<stream_sstable_files_chunk>> ()>;
+    // Writes the component files of the sstables received by STREAM_SSTABLE_FILES
+    // and adds the sstables to the table. Returns the number of sstables received.
+    static future<uint64_t> receive_sstable_files(distributed<database>& db, distributed<db::system_distributed_keyspace>& sys_dist_ks,
+            distributed<db::view::view_update_generator>& view_update_generator, schema_ptr s, UUID plan_id, msg_addr from, stream_reason reason,
+            sstable_files_source source);
 public:
     /**
      * Streaming endpoint.
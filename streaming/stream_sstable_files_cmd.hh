@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <seastar/core/sstring.hh>
+#include "bytes.hh"
+
+namespace streaming {
+
+enum class stream_sstable_files_cmd : uint8_t {
+    error,
+    // Starts a new sstable. The name is its sstable version.
+    sstable_start,
+    // Starts a new component file. The name is the component name.
+    component_start,
+    // The next bytes of the current component file.
+    component_data,
+    // Ends the current component file. The checksum is the CRC32 of all its bytes.
+    component_end,
+    // Ends the current sstable, whose component files were all sent.
+    sstable_end,
+    end_of_stream,
+};
+
+struct stream_sstable_files_chunk {
+    stream_sstable_files_cmd cmd;
+    seastar::sstring name;
+    bytes data;
+    uint32_t checksum = 0;
+};
+
+}
@@ -43,6 +43,7 @@
 #include "streaming/stream_manager.hh"
 #include "streaming/stream_reason.hh"
 #include "streaming/stream_mutation_fragments_cmd.hh"
+#include "streaming/stream_sstable_files_cmd.hh"
 #include "mutation_reader.hh"
 #include "frozen_mutation.hh"
 #include "mutation.hh"
@@ -54,8 +55,12 @@
 #include "service/storage_service.hh"
 #include <boost/icl/interval.hpp>
 #include <boost/icl/interval_set.hpp>
+#include <boost/algorithm/cxx11/any_of.hpp>
+#include <boost/range/adaptor/transformed.hpp>
 #include "sstables/sstables.hh"
 #include "database.hh"
+#include "utils/crc.hh"
+#include <seastar/core/fstream.hh>
 
 namespace streaming {
 
@@ -78,6 +83,43 @@ dht::partition_range_vector to_partition_ranges(const dht::token_range_vector& r
     return prs;
 }
 
+// An sstable which lies entirely inside the streamed ranges, and whose
+// component files are streamed as they are.
+struct whole_sstable {
+    sstables::shared_sstable sst;
+    // Keeps compaction from deleting the files while they are sent. Taken
+    // right before the sstable is sent, so that compaction isn't kept from
+    // deleting the sstables which wait for their turn. The files are opened
+    // one at a time too, so that streaming many sstables doesn't hold many
+    // open files.
+    std::optional<sstables::sstable::files_pin> pin;
+};
+
+static bool contained_in_ranges(const sstables::shared_sstable& sst, const dht::token_range_vector& ranges) {
+    const auto& first = sst->get_first_decorated_key().token();
+    const auto& last = sst->get_last_decorated_key().token();
+    return boost::algorithm::any_of(ranges, [&] (const dht::token_range& range) {
+        return range.contains(first, dht::token_comparator()) && range.contains(last, dht::token_comparator());
+    });
+}
+
+std::vector<sstables::shared_sstable> pick_whole_sstables(column_family& cf, const dht::token_range_vector& ranges) {
+    std::vector<sstables::shared_sstable> picked;
+    for (auto& sst : *cf.get_sstables()) {
+        // A shared sstable also has data of other shards, which they stream
+        // themselves.
+        if (!sst->is_shared() && contained_in_ranges(sst, ranges)) {
+            picked.push_back(sst);
+        }
+    }
+    return picked;
+}
+
+static std::unordered_set<sstables::shared_sstable> sstables_of(const std::vector<whole_sstable>& whole_sstables) {
+    return boost::copy_range<std::unordered_set<sstables::shared_sstable>>(whole_sstables
+            | boost::adaptors::transformed([] (const whole_sstable& ws) { return ws.sst; }));
+}
+
 struct send_info {
     database& db;
     utils::UUID plan_id;
@@ -91,10 +133,15 @@ struct send_info {
     column_family& cf;
     dht::token_range_vector ranges;
     dht::partition_range_vector prs;
+    // Streamed with STREAM_SSTABLE_FILES, and not read by the reader.
+    std::vector<whole_sstable> whole_sstables;
+    // The whole sstables whose files were being deleted by the time they
+    // were to be sent, whose data is streamed as mutation fragments instead.
+    std::vector<sstables::shared_sstable> unpinned_sstables;
     flat_mutation_reader reader;
     send_info(database& db_, utils::UUID plan_id_, utils::UUID cf_id_,
               dht::token_range_vector ranges_, netw::messaging_service::msg_addr id_,
-              uint32_t dst_cpu_id_, stream_reason reason_)
+              uint32_t dst_cpu_id_, stream_reason reason_, std::vector<whole_sstable> whole_sstables_ = {})
         : db(db_)
         , plan_id(plan_id_)
         , cf_id(cf_id_)
@@ -104,7 +151,8 @@ struct send_info {
         , cf(db.find_column_family(cf_id))
         , ranges(std::move(ranges_))
         , prs(to_partition_ranges(ranges))
-        , reader(cf.make_streaming_reader(cf.schema(), prs)) {
+        , whole_sstables(std::move(whole_sstables_))
+        , reader(cf.make_streaming_reader(cf.schema(), prs, sstables_of(whole_sstables))) {
     }
     future<bool> has_relevant_range_on_this_shard() {
         return do_with(false, [this] (bool& found_relevant_range) {
@@ -122,8 +170,11 @@ struct send_info {
         });
     }
     future<size_t> estimate_partitions() {
-        return do_with(cf.get_sstables(), size_t(0), [this] (auto& sstables, size_t& partition_count) {
-            return do_for_each(*sstables, [this, &partition_count] (auto& sst) {
+        return do_with(cf.get_sstables(), size_t(0), sstables_of(whole_sstables), [this] (auto& sstables, size_t& partition_count, auto& excluded) {
+            return do_for_each(*sstables, [this, &partition_count, &excluded] (auto& sst) {
+                if (excluded.count(sst)) {
+                    return make_ready_future<>();
+                }
                 return do_for_each(ranges, [this, &sst, &partition_count] (auto& range) {
                     partition_count += sst->estimated_keys_for_range(range);
                 });
@@ -175,10 +226,10 @@ future<> send_mutations(lw_shared_ptr<send_info> si) {
     });
 }
 
-future<> send_mutation_fragments(lw_shared_ptr<send_info> si) {
-  return si->estimate_partitions().then([si] (size_t estimated_partitions) {
-    sslog.info("[Stream #{}] Start sending ks={}, cf={}, estimated_partitions={}, with new rpc streaming", si->plan_id, si->cf.schema()->ks_name(), si->cf.schema()->cf_name(), estimated_partitions);
-    return netw::get_local_messaging_service().make_sink_and_source_for_stream_mutation_fragments(si->reader.schema()->version(), si->plan_id, si->cf_id, estimated_partitions, si->reason, si->id).then([si] (rpc::sink<frozen_mutation_fragment, stream_mutation_fragments_cmd> sink, rpc::source<int32_t> source) mutable {
+// Sends what the reader reads with STREAM_MUTATION_FRAGMENTS. The reader must
+// be kept alive until the returned future resolves.
+static future<> send_mutation_fragments(lw_shared_ptr<send_info> si, flat_mutation_reader& reader, size_t estimated_partitions) {
+    return netw::get_local_messaging_service().make_sink_and_source_for_stream_mutation_fragments(reader.schema()->version(), si->plan_id, si->cf_id, estimated_partitions, si->reason, si->id).then([si, &reader] (rpc::sink<frozen_mutation_fragment, stream_mutation_fragments_cmd> sink, rpc::source<int32_t> source) mutable {
         auto got_error_from_peer = make_lw_shared<bool>(false);
 
         auto source_op = [source, got_error_from_peer, si] () mutable -> future<> {
@@ -200,10 +251,10 @@ future<> send_mutation_fragments(lw_shared_ptr<send_info> si) {
             });
         }();
 
-        auto sink_op = [sink, si, got_error_from_peer] () mutable -> future<> {
-            return do_with(std::move(sink), [si, got_error_from_peer] (rpc::sink<frozen_mutation_fragment, stream_mutation_fragments_cmd>& sink) {
-                return repeat([&sink, si, got_error_from_peer] () mutable {
-                    return si->reader(db::no_timeout).then([&sink, si, s = si->reader.schema(), got_error_from_peer] (mutation_fragment_opt mf) mutable {
+        auto sink_op = [sink, si, &reader, got_error_from_peer] () mutable -> future<> {
+            return do_with(std::move(sink), [si, &reader, got_error_from_peer] (rpc::sink<frozen_mutation_fragment, stream_mutation_fragments_cmd>& sink) {
+                return repeat([&sink, si, &reader, got_error_from_peer] () mutable {
+                    return reader(db::no_timeout).then([&sink, si, s = reader.schema(), got_error_from_peer] (mutation_fragment_opt mf) mutable {
                         if (mf && !(*got_error_from_peer)) {
                             frozen_mutation_fragment fmf = freeze(*s, *mf);
                             auto size = fmf.representation().size();
@@ -232,7 +283,173 @@ future<> send_mutation_fragments(lw_shared_ptr<send_info> si) {
             }
         });
     });
-  });
+}
+
+future<> send_mutation_fragments(lw_shared_ptr<send_info> si) {
+    return si->estimate_partitions().then([si] (size_t estimated_partitions) {
+        sslog.info("[Stream #{}] Start sending ks={}, cf={}, estimated_partitions={}, with new rpc streaming", si->plan_id, si->cf.schema()->ks_name(), si->cf.schema()->cf_name(), estimated_partitions);
+        return send_mutation_fragments(si, si->reader, estimated_partitions);
+    });
+}
+
+// Reads the streamed ranges of the whole sstables which could not be pinned
+// by the time they were to be sent. Their files are being deleted, but the
+// sstables keep the data and index files they have open readable.
+static flat_mutation_reader make_unpinned_sstables_reader(lw_shared_ptr<send_info> si) {
+    auto source = mutation_source([ssts = si->unpinned_sstables] (schema_ptr s, const dht::partition_range& range, const query::partition_slice& slice,
+            const io_priority_class& pc, tracing::trace_state_ptr trace_state, streamed_mutation::forwarding fwd, mutation_reader::forwarding fwd_mr) {
+        std::vector<flat_mutation_reader> readers;
+        readers.reserve(ssts.size());
+        for (auto& sst : ssts) {
+            readers.emplace_back(sst->read_range_rows_flat(s, range, slice, pc, no_resource_tracking(), fwd, fwd_mr));
+        }
+        return make_combined_reader(s, std::move(readers), fwd, fwd_mr);
+    });
+    auto s = si->cf.schema();
+    return make_flat_multi_range_reader(s, std::move(source), si->prs, s->full_slice(), service::get_local_streaming_read_priority(),
+            nullptr, mutation_reader::forwarding::no);
+}
+
+static future<> send_unpinned_sstables(lw_shared_ptr<send_info> si) {
+    if (si->unpinned_sstables.empty()) {
+        return make_ready_future<>();
+    }
+    sslog.info("[Stream #{}] Sending {} sstables of ks={}, cf={} as mutation fragments, as they are being deleted", si->plan_id,
+            si->unpinned_sstables.size(), si->cf.schema()->ks_name(), si->cf.schema()->cf_name());
+    size_t estimated_partitions = 0;
+    for (auto& sst : si->unpinned_sstables) {
+        for (auto& range : si->ranges) {
+            estimated_partitions += sst->estimated_keys_for_range(range);
+        }
+    }
+    return do_with(make_unpinned_sstables_reader(si), [si, estimated_partitions] (flat_mutation_reader& reader) {
+        return send_mutation_fragments(si, reader, estimated_partitions);
+    });
+}
+
+static future<> send_component_file(rpc::sink<stream_sstable_files_chunk>& sink, lw_shared_ptr<send_info> si, const whole_sstable& ws,
+        const sstring& component, lw_shared_ptr<bool> got_error_from_peer) {
+    auto& sst = *ws.sst;
+    auto name = sstables::sstable::filename(sst.get_dir(), sst.get_schema()->ks_name(), sst.get_schema()->cf_name(),
+            sst.get_version(), sst.generation(), sst.get_format(), component);
+    return open_file_dma(name, open_flags::ro).then([&sink, si, &component, got_error_from_peer] (file f) {
+        file_input_stream_options options;
+        options.buffer_size = 128 * 1024;
+        options.read_ahead = 4;
+        options.io_priority_class = service::get_local_streaming_read_priority();
+        auto in = make_file_input_stream(std::move(f), 0, std::move(options));
+        return do_with(std::move(in), utils::crc32(), [&sink, si, &component, got_error_from_peer] (input_stream<char>& in, utils::crc32& checksum) {
+            return sink(stream_sstable_files_chunk{stream_sstable_files_cmd::component_start, component}).then([&sink, si, &in, &checksum, got_error_from_peer] {
+                return repeat([&sink, si, &in, &checksum, got_error_from_peer] {
+                    return in.read().then([&sink, si, &checksum, got_error_from_peer] (temporary_buffer<char> buf) {
+                        if (buf.empty() || *got_error_from_peer) {
+                            return make_ready_future<stop_iteration>(stop_iteration::yes);
+                        }
+                        checksum.process(reinterpret_cast<const uint8_t*>(buf.get()), buf.size());
+                        streaming::get_local_stream_manager().update_progress(si->plan_id, si->id.addr, streaming::progress_info::direction::OUT, buf.size());
+                        auto data = bytes(reinterpret_cast<const bytes::value_type*>(buf.get()), buf.size());
+                        return sink(stream_sstable_files_chunk{stream_sstable_files_cmd::component_data, {}, std::move(data)}).then([] {
+                            return stop_iteration::no;
+                        });
+                    });
+                });
+            }).then([&sink, &checksum] {
+                return sink(stream_sstable_files_chunk{stream_sstable_files_cmd::component_end, {}, {}, checksum.get()});
+            }).finally([&in] {
+                return in.close();
+            });
+        });
+    });
+}
+
+static future<> send_whole_sstable(rpc::sink<stream_sstable_files_chunk>& sink, lw_shared_ptr<send_info> si, whole_sstable& ws, lw_shared_ptr<bool> got_error_from_peer) {
+    ws.pin = ws.sst->pin_files();
+    if (!ws.pin) {
+        sslog.debug("[Stream #{}] Sstable {} is being deleted, sending it as mutation fragments", si->plan_id, ws.sst->get_filename());
+        si->unpinned_sstables.push_back(ws.sst);
+        return make_ready_future<>();
+    }
+    sslog.debug("[Stream #{}] Sending sstable {} to {} as is", si->plan_id, ws.sst->get_filename(), si->id.addr);
+    // The TOC comes first.
+    auto components = ws.sst->all_components();
+    std::stable_partition(components.begin(), components.end(), [] (const std::pair<sstables::component_type, sstring>& c) {
+        return c.first == sstables::component_type::TOC;
+    });
+    return do_with(std::move(components), [&sink, si, &ws, got_error_from_peer] (const std::vector<std::pair<sstables::component_type, sstring>>& components) {
+        return sink(stream_sstable_files_chunk{stream_sstable_files_cmd::sstable_start, sstables::to_string(ws.sst->get_version())}).then([&sink, si, &ws, &components, got_error_from_peer] {
+            return do_for_each(components, [&sink, si, &ws, got_error_from_peer] (const std::pair<sstables::component_type, sstring>& c) {
+                if (*got_error_from_peer) {
+                    return make_ready_future<>();
+                }
+                return send_component_file(sink, si, ws, c.second, got_error_from_peer);
+            });
+        }).then([&sink] {
+            return sink(stream_sstable_files_chunk{stream_sstable_files_cmd::sstable_end});
+        });
+    }).finally([&ws] {
+        // Let compaction delete the files, now that they are sent.
+        ws.pin.reset();
+    });
+}
+
+future<> send_sstable_files(lw_shared_ptr<send_info> si) {
+    if (si->whole_sstables.empty()) {
+        return make_ready_future<>();
+    }
+    sslog.info("[Stream #{}] Start sending ks={}, cf={}, whole_sstables={}", si->plan_id, si->cf.schema()->ks_name(), si->cf.schema()->cf_name(), si->whole_sstables.size());
+    return netw::get_local_messaging_service().make_sink_and_source_for_stream_sstable_files(si->cf.schema()->version(), si->plan_id, si->cf_id, si->reason, si->id).then([si] (rpc::sink<stream_sstable_files_chunk> sink, rpc::source<int32_t> source) mutable {
+        auto got_error_from_peer = make_lw_shared<bool>(false);
+
+        auto source_op = [source, got_error_from_peer, si] () mutable -> future<> {
+            return repeat([source, got_error_from_peer, si] () mutable {
+                return source().then([source, got_error_from_peer, si] (std::optional<std::tuple<int32_t>> status_opt) mutable {
+                    if (status_opt) {
+                        auto status = std::get<0>(*status_opt);
+                        *got_error_from_peer = status == -1;
+                        sslog.debug("Got status code from peer={}, plan_id={}, cf_id={}, status={}", si->id.addr, si->plan_id, si->cf_id, status);
+                        // Read until EOS, like send_mutation_fragments() does.
+                        return stop_iteration::no;
+                    } else {
+                        return stop_iteration::yes;
+                    }
+                });
+            });
+        }();
+
+        auto sink_op = [sink, si, got_error_from_peer] () mutable -> future<> {
+            return do_with(std::move(sink), [si, got_error_from_peer] (rpc::sink<stream_sstable_files_chunk>& sink) {
+                return do_for_each(si->whole_sstables, [&sink, si, got_error_from_peer] (whole_sstable& ws) {
+                    if (*got_error_from_peer) {
+                        return make_ready_future<>();
+                    }
+                    return send_whole_sstable(sink, si, ws, got_error_from_peer);
+                }).then([&sink] () mutable {
+                    return sink(stream_sstable_files_chunk{stream_sstable_files_cmd::end_of_stream});
+                }).handle_exception([&sink] (std::exception_ptr ep) mutable {
+                    // Notify the receiver the sender has failed
+                    return sink(stream_sstable_files_chunk{stream_sstable_files_cmd::error}).then([ep = std::move(ep)] () mutable {
+                        return make_exception_future<>(std::move(ep));
+                    });
+                }).finally([&sink] () mutable {
+                    return sink.close();
+                });
+            });
+        }();
+
+        return when_all_succeed(std::move(source_op), std::move(sink_op)).then([got_error_from_peer, si] {
+            if (*got_error_from_peer) {
+                throw std::runtime_error(format("Peer failed to process sstable files peer={}, plan_id={}, cf_id={}", si->id.addr, si->plan_id, si->cf_id));
+            }
+        });
+    }).then([si] {
+        return send_unpinned_sstables(si);
+    });
+}
+
+// Whole sstables are streamed only by node operations, which move all the
+// data of the ranges. Repair streams only the data a peer is missing.
+static bool can_stream_whole_sstables(stream_reason reason) {
+    return reason == stream_reason::bootstrap || reason == stream_reason::decommission;
 }
 
 future<> stream_transfer_task::execute() {
@@ -244,8 +461,16 @@ future<> stream_transfer_task::execute() {
     sort_and_merge_ranges();
     bool streaming_with_rpc_stream = service::get_local_storage_service().cluster_supports_stream_with_rpc_stream();
     auto reason = session->get_reason();
-    return session->get_db().invoke_on_all([plan_id, cf_id, id, dst_cpu_id, ranges=this->_ranges, streaming_with_rpc_stream, reason] (database& db) {
-        auto si = make_lw_shared<send_info>(db, plan_id, cf_id, std::move(ranges), id, dst_cpu_id, reason);
+    bool streaming_whole_sstables = streaming_with_rpc_stream && can_stream_whole_sstables(reason)
+            && service::get_local_storage_service().cluster_supports_stream_whole_sstables();
+    return session->get_db().invoke_on_all([plan_id, cf_id, id, dst_cpu_id, ranges=this->_ranges, streaming_with_rpc_stream, streaming_whole_sstables, reason] (database& db) {
+        auto whole_sstables = std::vector<whole_sstable>();
+        if (streaming_whole_sstables) {
+            for (auto& sst : pick_whole_sstables(db.find_column_family(cf_id), ranges)) {
+                whole_sstables.push_back(whole_sstable{std::move(sst)});
+            }
+        }
+        auto si = make_lw_shared<send_info>(db, plan_id, cf_id, std::move(ranges), id, dst_cpu_id, reason, std::move(whole_sstables));
         return si->has_relevant_range_on_this_shard().then([si, plan_id, cf_id, streaming_with_rpc_stream] (bool has_relevant_range_on_this_shard) {
             if (!has_relevant_range_on_this_shard) {
                 sslog.debug("[Stream #{}] stream_transfer_task: cf_id={}: ignore ranges on shard={}",
@@ -253,7 +478,7 @@ future<> stream_transfer_task::execute() {
                 return make_ready_future<>();
             }
             if (streaming_with_rpc_stream) {
-                return send_mutation_fragments(std::move(si));
+                return when_all_succeed(send_sstable_files(si), send_mutation_fragments(si));
             } else {
                 return send_mutations(std::move(si));
             }
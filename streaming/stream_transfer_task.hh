@@ -41,6 +41,8 @@
 #include "utils/UUID.hh"
 #include "streaming/stream_task.hh"
 #include "streaming/stream_detail.hh"
+#include "sstables/shared_sstable.hh"
+#include "database_fwd.hh"
 #include <map>
 #include <seastar/core/semaphore.hh>
 
@@ -49,6 +51,10 @@ namespace streaming {
 class stream_session;
 class send_info;
 
+// Picks the sstables of this shard which lie entirely inside the ranges, and
+// whose files can thus be streamed as they are.
+std::vector<sstables::shared_sstable> pick_whole_sstables(column_family& cf, const dht::token_range_vector& ranges);
+
 /**
  * StreamTransferTask sends sections of SSTable files in certain ColumnFamily.
  */
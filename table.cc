@@ -38,6 +38,7 @@
 #include "db/system_keyspace.hh"
 #include "db/query_context.hh"
 #include "query-result-writer.hh"
+#include "query_row_filter.hh"
 #include <boost/algorithm/cxx11/all_of.hpp>
 #include <boost/algorithm/cxx11/any_of.hpp>
 #include <boost/range/adaptor/transformed.hpp>
@@ -483,12 +484,15 @@ table::make_reader(schema_ptr s,
     }
 }
 
-sstables::shared_sstable table::make_streaming_sstable_for_write(std::optional<sstring> subdir) {
+sstables::shared_sstable table::make_streaming_sstable_for_write(std::optional<sstring> subdir,
+        std::optional<sstables::sstable_version_types> version) {
     sstring dir = _config.datadir;
     if (subdir) {
         dir += "/" + *subdir;
     }
-    auto newtab = make_sstable(dir);
+    auto newtab = version
+            ? make_sstable(dir, calculate_generation_for_new_table(), *version, sstables::sstable::format_types::big)
+            : make_sstable(dir);
     tlogger.debug("Created sstable for streaming: ks={}, cf={}, dir={}", schema()->ks_name(), schema()->cf_name(), dir);
     return newtab;
 }
@@ -496,17 +500,35 @@ sstables::shared_sstable table::make_streaming_sstable_for_write(std::optional<s
 flat_mutation_reader
 table::make_streaming_reader(schema_ptr s,
                            const dht::partition_range_vector& ranges) const {
+    return make_streaming_reader(std::move(s), ranges, {});
+}
+
+flat_mutation_reader
+table::make_streaming_reader(schema_ptr s,
+                           const dht::partition_range_vector& ranges,
+                           std::unordered_set<sstables::shared_sstable> excluded_sstables) const {
     auto& slice = s->full_slice();
     auto& pc = service::get_local_streaming_read_priority();
 
-    auto source = mutation_source([this] (schema_ptr s, const dht::partition_range& range, const query::partition_slice& slice,
+    auto source = mutation_source([this, excluded_sstables = std::move(excluded_sstables)] (schema_ptr s, const dht::partition_range& range, const query::partition_slice& slice,
                                       const io_priority_class& pc, tracing::trace_state_ptr trace_state, streamed_mutation::forwarding fwd, mutation_reader::forwarding fwd_mr) {
         std::vector<flat_mutation_reader> readers;
         readers.reserve(_memtables->size() + 1);
         for (auto&& mt : *_memtables) {
             readers.emplace_back(mt->make_flat_reader(s, range, slice, pc, trace_state, fwd, fwd_mr));
         }
-        readers.emplace_back(make_sstable_reader(s, _sstables, range, slice, pc, std::move(trace_state), fwd, fwd_mr));
+        // The sstable set is looked up for each range, like the memtables,
+        // so that a memtable flushed in between is read from its sstable.
+        auto sstables = _sstables;
+        if (!excluded_sstables.empty()) {
+            sstables = make_lw_shared(_compaction_strategy.make_sstable_set(_schema));
+            for (auto& sst : *_sstables->all()) {
+                if (!excluded_sstables.count(sst)) {
+                    sstables->insert(sst);
+                }
+            }
+        }
+        readers.emplace_back(make_sstable_reader(s, std::move(sstables), range, slice, pc, std::move(trace_state), fwd, fwd_mr));
         return make_combined_reader(s, std::move(readers), fwd, fwd_mr);
     });
 
@@ -514,7 +536,7 @@ table::make_streaming_reader(schema_ptr s,
 }
 
 flat_mutation_reader table::make_streaming_reader(schema_ptr schema, const dht::partition_range& range,
-        const query::partition_slice& slice, mutation_reader::forwarding fwd_mr) const {
+        const query::partition_slice& slice, mutation_reader::forwarding fwd_mr, read_unrepaired_only unrepaired_only) const {
     const auto& pc = service::get_local_streaming_read_priority();
     auto trace_state = tracing::trace_state_ptr();
     const auto fwd = streamed_mutation::forwarding::no;
@@ -524,7 +546,16 @@ flat_mutation_reader table::make_streaming_reader(schema_ptr schema, const dht::
     for (auto&& mt : *_memtables) {
         readers.emplace_back(mt->make_flat_reader(schema, range, slice, pc, trace_state, fwd, fwd_mr));
     }
-    readers.emplace_back(make_sstable_reader(schema, _sstables, range, slice, pc, std::move(trace_state), fwd, fwd_mr));
+    auto sstables = _sstables;
+    if (unrepaired_only) {
+        sstables = make_lw_shared(_compaction_strategy.make_sstable_set(_schema));
+        for (auto& sst : *_sstables->all()) {
+            if (!sst->is_repaired()) {
+                sstables->insert(sst);
+            }
+        }
+    }
+    readers.emplace_back(make_sstable_reader(schema, std::move(sstables), range, slice, pc, std::move(trace_state), fwd, fwd_mr));
     return make_combined_reader(std::move(schema), std::move(readers), fwd, fwd_mr);
 }
 
@@ -2162,11 +2193,20 @@ table::local_base_lock(
     if (rows.size() == 1 && rows[0].is_singular() && rows[0].start() && !rows[0].start()->value().is_empty(*s)) {
         // A single clustering row is involved.
         return _row_locker.lock_ck(pk, rows[0].start()->value(), true, timeout, _row_locker_stats);
+    } else if (!rows.empty() && boost::algorithm::all_of(rows, [&] (const query::clustering_range& r) {
+                return r.is_singular() && r.start() && !r.start()->value().is_empty(*s);
+            })) {
+        // A few individual clustering rows are involved, e.g. for a batch of
+        // coalesced writes to different rows (see
+        // coalesce_and_push_view_replica_updates()). Lock just those rows,
+        // so that writes to other rows of the partition can proceed.
+        auto ckps = boost::copy_range<std::vector<clustering_key_prefix>>(rows
+                | boost::adaptors::transformed([] (const query::clustering_range& r) { return r.start()->value(); }));
+        return _row_locker.lock_cks(pk, std::move(ckps), true, timeout, _row_locker_stats);
     } else {
-        // More than a single clustering row is involved. Most commonly it's
-        // the entire partition, so let's lock the entire partition. We could
-        // lock less than the entire partition in more elaborate cases where
-        // just a few individual rows are involved, or row ranges, but we
+        // Row ranges are involved. Most commonly it's the entire partition,
+        // so let's lock the entire partition. We could lock less than the
+        // entire partition when just a few row ranges are involved, but we
         // don't think this will make a practical difference.
         return _row_locker.lock_pk(pk, true, timeout, _row_locker_stats);
     }
@@ -2376,13 +2416,17 @@ table::query(schema_ptr s,
     _stats.reads.set_latency(lc);
     auto f = opts.request == query::result_request::only_digest
              ? memory_limiter.new_digest_read(max_size) : memory_limiter.new_data_read(max_size);
-    return f.then([this, lc, s = std::move(s), &cmd, opts, &partition_ranges,
+    auto source = as_mutation_source();
+    if (auto filter = make_lw_shared<const query::row_filter>(*s, cmd.slice.filter()); *filter) {
+        source = as_mutation_source_skipping(std::move(filter));
+    }
+    return f.then([this, lc, s = std::move(s), &cmd, opts, &partition_ranges, source = std::move(source),
             trace_state = std::move(trace_state), timeout, cache_ctx = std::move(cache_ctx)] (query::result_memory_accounter accounter) mutable {
         auto qs_ptr = std::make_unique<query_state>(std::move(s), cmd, opts, partition_ranges, std::move(accounter));
         auto& qs = *qs_ptr;
-        return do_until(std::bind(&query_state::done, &qs), [this, &qs, trace_state = std::move(trace_state), timeout, cache_ctx = std::move(cache_ctx)] {
+        return do_until(std::bind(&query_state::done, &qs), [this, &qs, source = std::move(source), trace_state = std::move(trace_state), timeout, cache_ctx = std::move(cache_ctx)] {
             auto&& range = *qs.current_partition_range++;
-            return data_query(qs.schema, as_mutation_source(), range, qs.cmd.slice, qs.remaining_rows(),
+            return data_query(qs.schema, source, range, qs.cmd.slice, qs.remaining_rows(),
                               qs.remaining_partitions(), qs.cmd.timestamp, qs.builder, trace_state, timeout, cache_ctx);
         }).then([qs_ptr = std::move(qs_ptr), &qs] {
             return make_ready_future<lw_shared_ptr<query::result>>(
@@ -2409,18 +2453,120 @@ table::as_mutation_source() const {
     });
 }
 
+static bool sstable_may_match(const sstables::sstable& sst, const query::row_filter& filter) {
+    auto* value_ranges = sst.get_column_value_ranges();
+    if (!value_ranges) {
+        return true;
+    }
+    return filter.may_match([value_ranges] (const column_definition& cdef) -> std::optional<query::row_filter::value_range> {
+        for (auto& r : value_ranges->ranges.elements) {
+            if (r.column_name.value == cdef.name()) {
+                // The values can't be compared if the type of the column
+                // was altered since the sstable was written.
+                if (r.type_name.value != to_bytes(cdef.type->name())) {
+                    return std::nullopt;
+                }
+                return query::row_filter::value_range{r.min.value, r.max.value};
+            }
+        }
+        return std::nullopt;
+    });
+}
+
+// A row of a partition can only satisfy the filter if some source of the
+// partition holds a value satisfying it, since the value of a merged cell
+// comes from one of the sources. Partitions held only by sstables whose
+// value ranges can't satisfy the filter are therefore skipped. Skipping
+// single sstables instead would be wrong, as their newer cells may shadow
+// matching ones. Whether an sstable's value ranges can satisfy the filter
+// doesn't depend on the partition, so it is resolved once per sstable, when
+// the reader is created, or when the sstable is first met if it was added
+// to the table afterwards.
+mutation_source
+table::as_mutation_source_skipping(lw_shared_ptr<const query::row_filter> filter) const {
+    return mutation_source([this, filter = std::move(filter)] (schema_ptr s,
+                                   const dht::partition_range& range,
+                                   const query::partition_slice& slice,
+                                   const io_priority_class& pc,
+                                   tracing::trace_state_ptr trace_state,
+                                   streamed_mutation::forwarding fwd,
+                                   mutation_reader::forwarding fwd_mr) {
+        auto rd = this->make_reader(s, range, slice, pc, std::move(trace_state), fwd, fwd_mr);
+        std::unordered_map<int64_t, bool> sstables_may_match;
+        for (auto& sst : *_sstables->all()) {
+            sstables_may_match.emplace(sst->generation(), sstable_may_match(*sst, *filter));
+        }
+        return make_filtering_reader(std::move(rd), [this, s, filter, sstables_may_match = std::move(sstables_may_match)] (const dht::decorated_key& dk) mutable {
+            auto may_match = partition_may_exist(*s, dk, [&] (const sstables::sstable& sst) {
+                auto it = sstables_may_match.find(sst.generation());
+                if (it == sstables_may_match.end()) {
+                    it = sstables_may_match.emplace(sst.generation(), sstable_may_match(sst, *filter)).first;
+                }
+                return it->second;
+            });
+            if (!may_match) {
+                ++_config.cf_stats->skipped_filtered_partitions;
+            }
+            return may_match;
+        });
+    });
+}
+
 void table::add_coordinator_read_latency(utils::estimated_histogram::duration latency) {
     _stats.estimated_coordinator_read.add(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
 }
 
-std::chrono::milliseconds table::get_coordinator_read_latency_percentile(double percentile) {
-    if (_cached_percentile != percentile || lowres_clock::now() - _percentile_cache_timestamp > 1s) {
-        _percentile_cache_timestamp = lowres_clock::now();
-        _cached_percentile = percentile;
-        _percentile_cache_value = std::max(_stats.estimated_coordinator_read.percentile(percentile) / 1000, int64_t(1)) * 1ms;
-        _stats.estimated_coordinator_read *= 0.9; // decay values a little to give new data points more weight
+std::chrono::milliseconds table::get_latency_percentile(utils::estimated_histogram& histogram, latency_percentile_cache& cache, double percentile) {
+    if (cache.percentile != percentile || lowres_clock::now() - cache.timestamp > 1s) {
+        cache.timestamp = lowres_clock::now();
+        cache.percentile = percentile;
+        cache.value = std::max(histogram.percentile(percentile) / 1000, int64_t(1)) * 1ms;
+        histogram *= 0.9; // decay values a little to give new data points more weight
     }
-    return _percentile_cache_value;
+    return cache.value;
+}
+
+std::chrono::milliseconds table::get_coordinator_read_latency_percentile(double percentile) {
+    return get_latency_percentile(_stats.estimated_coordinator_read, _read_percentile_cache, percentile);
+}
+
+void table::add_coordinator_range_read_latency(utils::estimated_histogram::duration latency) {
+    _stats.estimated_coordinator_range_read.add(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+}
+
+std::chrono::milliseconds table::get_coordinator_range_read_latency_percentile(double percentile) {
+    return get_latency_percentile(_stats.estimated_coordinator_range_read, _range_read_percentile_cache, percentile);
+}
+
+future<> table::mark_sstables_repaired(std::unordered_set<int64_t> generations, uint64_t repaired_at) {
+    // Stop compaction so that no sstable is rewritten and deleted while its
+    // statistics are rewritten. Compaction is triggered again when done, and
+    // then keeps the repaired sstables apart from the unrepaired ones.
+    return run_with_compaction_disabled([this, generations = std::move(generations), repaired_at] {
+        auto sstables = boost::copy_range<std::vector<sstables::shared_sstable>>(*get_sstables()
+                | boost::adaptors::filtered([&generations] (const sstables::shared_sstable& sst) {
+            return generations.count(sst->generation()) && !sst->is_repaired();
+        }));
+        tlogger.debug("Marking {} sstables of {}.{} as repaired at {}", sstables.size(), _schema->ks_name(), _schema->cf_name(), repaired_at);
+        return do_with(std::move(sstables), [this, repaired_at] (std::vector<sstables::shared_sstable>& sstables) {
+            return do_for_each(sstables, [this, repaired_at] (const sstables::shared_sstable& sst) {
+                if (sst->get_sstable_level() == 0) {
+                    return sst->mutate_repaired_at(repaired_at);
+                }
+                // The repaired sstables have their own levels, in which this
+                // one would overlap others, so it starts over from level 0.
+                _compaction_strategy.get_backlog_tracker().remove_sstable(sst);
+                return sst->mutate_sstable_level(0).then([sst, repaired_at] {
+                    return sst->mutate_repaired_at(repaired_at);
+                }).finally([this, sst] {
+                    _compaction_strategy.get_backlog_tracker().add_sstable(sst);
+                });
+            }).finally([this] {
+                // The sstable set places sstables by level.
+                rebuild_sstable_list({}, {});
+            });
+        });
+    });
 }
 
 future<>
@@ -2436,8 +2582,8 @@ table::run_with_compaction_disabled(std::function<future<> ()> func) {
 }
 
 flat_mutation_reader
-table::make_reader_excluding_sstable(schema_ptr s,
-        sstables::shared_sstable sst,
+table::make_reader_excluding_sstables(schema_ptr s,
+        const std::vector<sstables::shared_sstable>& excluded_sstables,
         const dht::partition_range& range,
         const query::partition_slice& slice,
         const io_priority_class& pc,
@@ -2452,7 +2598,9 @@ table::make_reader_excluding_sstable(schema_ptr s,
     }
 
     auto effective_sstables = ::make_lw_shared<sstables::sstable_set>(*_sstables);
-    effective_sstables->erase(sst);
+    for (auto& sst : excluded_sstables) {
+        effective_sstables->erase(sst);
+    }
 
     readers.emplace_back(make_sstable_reader(s, std::move(effective_sstables), range, slice, pc, std::move(trace_state), fwd, fwd_mr));
     return make_combined_reader(s, std::move(readers), fwd, fwd_mr);
@@ -2479,7 +2627,8 @@ future<row_locker::lock_holder> table::push_view_replica_updates(const schema_pt
     return push_view_replica_updates(s, std::move(m), timeout);
 }
 
-future<row_locker::lock_holder> table::do_push_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout, mutation_source&& source, const io_priority_class& io_priority) const {
+future<row_locker::lock_holder> table::do_push_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout, mutation_source&& source,
+        const io_priority_class& io_priority, bool coalesce_reads) const {
     if (!_config.view_update_concurrency_semaphore->current()) {
         // We don't have resources to generate view updates for this write. If we reached this point, we failed to
         // throttle the client. The memory queue is already full, waiting on the semaphore would cause this node to
@@ -2503,6 +2652,19 @@ future<row_locker::lock_holder> table::do_push_view_replica_updates(const schema
                 return make_ready_future<row_locker::lock_holder>();
         });
     }
+    if (coalesce_reads) {
+        return coalesce_and_push_view_replica_updates(base, std::move(views), std::move(m), std::move(cr_ranges), timeout);
+    }
+    return read_and_push_view_replica_updates(base, std::move(views), std::move(m), std::move(cr_ranges), timeout, std::move(source), io_priority);
+}
+
+/**
+ * Reads the rows of the base partition affected by an update, within
+ * cr_ranges, and generates and propagates the view updates. Returns the lock
+ * taken on those rows, which the caller holds until the update is applied.
+ */
+future<row_locker::lock_holder> table::read_and_push_view_replica_updates(const schema_ptr& base, std::vector<view_ptr>&& views, mutation&& m,
+        query::clustering_row_ranges&& cr_ranges, db::timeout_clock::time_point timeout, mutation_source&& source, const io_priority_class& io_priority) const {
     // We read the whole set of regular columns in case the update now causes a base row to pass
     // a view's filters, and a view happens to include columns that have no value in this update.
     // Also, one of those columns can determine the lifetime of the base row, if it has a TTL.
@@ -2519,7 +2681,17 @@ future<row_locker::lock_holder> table::do_push_view_replica_updates(const schema
     // We'll return this lock to the caller, which will release it after
     // writing the base-table update.
     future<row_locker::lock_holder> lockf = local_base_lock(base, m.decorated_key(), slice.default_row_ranges(), timeout);
-    return lockf.then([m = std::move(m), slice = std::move(slice), views = std::move(views), base, this, timeout, source = std::move(source), &io_priority] (row_locker::lock_holder lock) {
+    return lockf.then([m = std::move(m), slice = std::move(slice), views = std::move(views), base, this, timeout, source = std::move(source), &io_priority] (row_locker::lock_holder lock) mutable {
+      // Inserts of new partitions are common, and for them the read would
+      // just go through the sstables to find nothing. The lock ensures no
+      // write to the rows we would read is in flight, so if the partition
+      // isn't there now, there is nothing to read.
+      if (!partition_may_exist(*base, m.decorated_key())) {
+        ++_config.cf_stats->skipped_view_update_reads;
+        return this->generate_and_propagate_view_updates(base, std::move(views), std::move(m), { }).then([lock = std::move(lock)] () mutable {
+            return std::move(lock);
+        });
+      }
       return do_with(
         dht::partition_range::make_singular(m.decorated_key()),
         std::move(slice),
@@ -2536,24 +2708,151 @@ future<row_locker::lock_holder> table::do_push_view_replica_updates(const schema
     });
 }
 
+/**
+ * Returns false if the partition is known not to exist in the table, i.e. it
+ * is in none of the memtables, and the bloom filters of the sstables which
+ * may hold it say it is absent. The cache only holds data which is in either
+ * of them, so it doesn't need to be consulted.
+ *
+ * If sstable_may_match is given, sstables for which it returns false are
+ * ignored.
+ */
+bool table::partition_may_exist(const schema& s, const dht::decorated_key& key,
+        const std::function<bool(const sstables::sstable&)>& sstable_may_match) const {
+    for (auto&& mt : *_memtables) {
+        if (mt->contains_partition(key)) {
+            return true;
+        }
+    }
+    auto hk = sstables::sstable::make_hashed_key(s, key.key());
+    for (auto&& sst : _sstables->select(dht::partition_range::make_singular(key))) {
+        if ((!sstable_may_match || sstable_may_match(*sst)) && sst->filter_has_key(hk)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void resolve_view_update_lock(promise<row_locker::lock_holder>& p, future<row_locker::lock_holder> f) {
+    if (f.failed()) {
+        p.set_exception(f.get_exception());
+    } else {
+        p.set_value(f.get0());
+    }
+}
+
+/**
+ * Under a heavy write load, a partition often receives several writes at
+ * about the same time, each of which would read the existing rows and lock
+ * them in turn. Instead, a write to a partition which is already locked by
+ * another write opens a batch, which writes to the same partition arriving
+ * before the next scheduling point join. A write to a partition nobody else
+ * is writing to reads the rows right away. The updates
+ * of the batch are then merged, the union of the affected rows read once,
+ * and the view updates generated for the whole batch, as if it were a
+ * single write. This gives the same view updates as processing the writes
+ * one by one, since only the state before and after all of them matters.
+ *
+ * All the writes of the batch share the lock on the rows, and keep it until
+ * the last of them is applied. If the view updates of the batch can't be
+ * generated, they are generated for each of its writes instead.
+ */
+future<row_locker::lock_holder> table::coalesce_and_push_view_replica_updates(const schema_ptr& base, std::vector<view_ptr>&& views, mutation&& m,
+        query::clustering_row_ranges&& cr_ranges, db::timeout_clock::time_point timeout) const {
+    auto token = m.token();
+    auto [first, last] = _view_update_read_batches.equal_range(token);
+    for (auto it = first; it != last; ++it) {
+        auto& b = *it->second;
+        auto& first_update = b.writes.front().update;
+        auto same_views = std::equal(views.begin(), views.end(), b.views.begin(), b.views.end(), [] (const view_ptr& v1, const view_ptr& v2) {
+            return v1.get() == v2.get();
+        });
+        if (first_update.schema() == base && same_views && first_update.decorated_key().equal(*base, m.decorated_key())) {
+            ++_config.cf_stats->coalesced_view_update_reads;
+            b.writes.push_back({std::move(m), std::move(cr_ranges), timeout});
+            return b.writes.back().lock.get_future();
+        }
+    }
+
+    // Deferring the read only pays off when other writes to the partition
+    // are likely to arrive meanwhile, i.e., when it is already being
+    // written to. Otherwise, don't delay the write.
+    _row_locker.upgrade(base);
+    if (!_row_locker.is_locked(m.decorated_key())) {
+        return read_and_push_view_replica_updates(base, std::move(views), std::move(m), std::move(cr_ranges), timeout,
+                as_mutation_source(), service::get_local_sstable_query_read_priority());
+    }
+
+    auto batch = make_lw_shared<view_update_read_batch>(std::move(views));
+    batch->writes.push_back({std::move(m), std::move(cr_ranges), timeout});
+    auto f = batch->writes.back().lock.get_future();
+    // Let the writes to this partition which are already queued join the
+    // batch before its rows are read.
+    (void)later().then([this, batch, token] {
+        auto [first, last] = _view_update_read_batches.equal_range(token);
+        _view_update_read_batches.erase(std::find_if(first, last, [&] (auto& e) { return e.second == batch; }));
+        if (batch->writes.size() == 1) {
+            auto& w = batch->writes.front();
+            return read_and_push_view_replica_updates(w.update.schema(), std::move(batch->views), std::move(w.update), std::move(w.ranges), w.timeout,
+                    as_mutation_source(), service::get_local_sstable_query_read_priority()).then_wrapped([batch] (future<row_locker::lock_holder> f) {
+                resolve_view_update_lock(batch->writes.front().lock, std::move(f));
+            });
+        }
+        // The writes are merged into a copy, so that their view updates can
+        // still be generated one by one if those of the batch can't be.
+        auto base = batch->writes.front().update.schema();
+        mutation updates(base, batch->writes.front().update.decorated_key());
+        query::clustering_row_ranges ranges;
+        auto timeout = db::timeout_clock::time_point::min();
+        for (auto& w : batch->writes) {
+            updates.apply(w.update);
+            ranges.insert(ranges.end(), w.ranges.begin(), w.ranges.end());
+            // Don't let the batch fail to take the lock because of the
+            // earliest deadline; each write is timed out by its caller.
+            timeout = std::max(timeout, w.timeout);
+        }
+        ranges = query::clustering_range::deoverlap(std::move(ranges), clustering_key_prefix::tri_compare(*base));
+        return read_and_push_view_replica_updates(base, std::vector<view_ptr>(batch->views), std::move(updates), std::move(ranges), timeout,
+                as_mutation_source(), service::get_local_sstable_query_read_priority()).then_wrapped([this, batch] (future<row_locker::lock_holder> f) {
+            if (!f.failed()) {
+                auto lock = std::make_shared<row_locker::lock_holder>(f.get0());
+                for (auto& w : batch->writes) {
+                    w.lock.set_value(row_locker::lock_holder(lock));
+                }
+                return make_ready_future<>();
+            }
+            // Don't fail all the writes of the batch because of one of them.
+            tlogger.debug("Failed to generate view updates of {} coalesced writes to {}.{}, generating them for each write: {}",
+                    batch->writes.size(), _schema->ks_name(), _schema->cf_name(), f.get_exception());
+            return parallel_for_each(batch->writes, [this, batch] (view_update_read_batch::write& w) {
+                return read_and_push_view_replica_updates(w.update.schema(), std::vector<view_ptr>(batch->views), std::move(w.update), std::move(w.ranges), w.timeout,
+                        as_mutation_source(), service::get_local_sstable_query_read_priority()).then_wrapped([&w] (future<row_locker::lock_holder> f) {
+                    resolve_view_update_lock(w.lock, std::move(f));
+                });
+            });
+        });
+    });
+    return f;
+}
+
 future<row_locker::lock_holder> table::push_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout) const {
-    return do_push_view_replica_updates(s, std::move(m), timeout, as_mutation_source(), service::get_local_sstable_query_read_priority());
+    return do_push_view_replica_updates(s, std::move(m), timeout, as_mutation_source(), service::get_local_sstable_query_read_priority(), true);
 }
 
-future<row_locker::lock_holder> table::stream_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout, sstables::shared_sstable excluded_sstable) const {
-    return do_push_view_replica_updates(s, std::move(m), timeout, as_mutation_source_excluding(std::move(excluded_sstable)), service::get_local_streaming_write_priority());
+future<row_locker::lock_holder> table::stream_view_replica_updates(const schema_ptr& s, mutation&& m, db::timeout_clock::time_point timeout, std::vector<sstables::shared_sstable> excluded_sstables) const {
+    return do_push_view_replica_updates(s, std::move(m), timeout, as_mutation_source_excluding(std::move(excluded_sstables)), service::get_local_streaming_write_priority(), false);
 }
 
 mutation_source
-table::as_mutation_source_excluding(sstables::shared_sstable sst) const {
-    return mutation_source([this, sst = std::move(sst)] (schema_ptr s,
+table::as_mutation_source_excluding(std::vector<sstables::shared_sstable> excluded_sstables) const {
+    return mutation_source([this, excluded_sstables = std::move(excluded_sstables)] (schema_ptr s,
                                    const dht::partition_range& range,
                                    const query::partition_slice& slice,
                                    const io_priority_class& pc,
                                    tracing::trace_state_ptr trace_state,
                                    streamed_mutation::forwarding fwd,
                                    mutation_reader::forwarding fwd_mr) {
-        return this->make_reader_excluding_sstable(std::move(s), std::move(sst), range, slice, pc, std::move(trace_state), fwd, fwd_mr);
+        return this->make_reader_excluding_sstables(std::move(s), excluded_sstables, range, slice, pc, std::move(trace_state), fwd, fwd_mr);
     });
 }
 
@@ -2562,7 +2861,7 @@ stop_iteration db::view::view_updating_consumer::consume_end_of_partition() {
         return stop_iteration::yes;
     }
     try {
-        auto lock_holder = _table->stream_view_replica_updates(_schema, std::move(*_m), db::no_timeout, _excluded_sstable).get();
+        auto lock_holder = _table->stream_view_replica_updates(_schema, std::move(*_m), db::no_timeout, _excluded_sstables).get();
     } catch (...) {
         tlogger.warn("Failed to push replica updates for table {}.{}: {}", _schema->ks_name(), _schema->cf_name(), std::current_exception());
     }
@@ -129,6 +129,10 @@ boost_tests = [
     'data_listeners_test',
     'truncation_migration_test',
     'like_matcher_test',
+    'endpoint_load_tracker_test',
+    'messaging_service_test',
+    'repair_hash_ibf_test',
+    'repair_hash_set_test',
 ]
 
 other_tests = [
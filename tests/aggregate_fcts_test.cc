@@ -259,3 +259,48 @@ SEASTAR_TEST_CASE(test_reverse_type_aggregation) {
         }
     });
 }
+
+SEASTAR_TEST_CASE(test_aggregates_computed_by_replicas) {
+    return do_with_cql_env_thread([&] (cql_test_env& e) {
+        e.execute_cql("CREATE TABLE test (p int, c int, s int static, v int, primary key (p, c))").get();
+        e.execute_cql("INSERT INTO test (p, c, s, v) VALUES (1, 1, 5, 1)").get();
+        e.execute_cql("INSERT INTO test (p, c, v) VALUES (1, 2, 2)").get();
+        e.execute_cql("INSERT INTO test (p, c) VALUES (1, 3)").get();
+        e.execute_cql("INSERT INTO test (p, c, v) VALUES (2, 1, 10)").get();
+        e.execute_cql("INSERT INTO test (p, c, v) VALUES (2, 2, 20)").get();
+        e.execute_cql("DELETE FROM test WHERE p = 2 AND c = 2").get();
+        // A partition with only a static row counts as a row.
+        e.execute_cql("INSERT INTO test (p, s) VALUES (3, 7)").get();
+
+        auto& stats = e.local_qp().get_cql_stats();
+        auto replica_aggregate_queries = stats.replica_aggregate_queries;
+
+        auto msg = e.execute_cql("SELECT count(*), count(v), sum(v), avg(v), min(v), max(v), sum(s) FROM test").get0();
+        assert_that(msg).is_rows().with_size(1).with_row({{long_type->decompose(int64_t(5))},
+                                                          {long_type->decompose(int64_t(3))},
+                                                          {int32_type->decompose(int32_t(13))},
+                                                          {int32_type->decompose(int32_t(4))},
+                                                          {int32_type->decompose(int32_t(1))},
+                                                          {int32_type->decompose(int32_t(10))},
+                                                          {int32_type->decompose(int32_t(22))}});
+        BOOST_REQUIRE_EQUAL(stats.replica_aggregate_queries, replica_aggregate_queries + 1);
+
+        msg = e.execute_cql("SELECT count(*), sum(v) FROM test WHERE p = 1 AND c > 1").get0();
+        assert_that(msg).is_rows().with_size(1).with_row({{long_type->decompose(int64_t(2))},
+                                                          {int32_type->decompose(int32_t(2))}});
+        BOOST_REQUIRE_EQUAL(stats.replica_aggregate_queries, replica_aggregate_queries + 2);
+
+        msg = e.execute_cql("SELECT count(*), max(v) FROM test WHERE p = 4").get0();
+        assert_that(msg).is_rows().with_size(1).with_row({{long_type->decompose(int64_t(0))}, {}});
+
+        // Filtering is done by the coordinator, so the aggregates are too.
+        msg = e.execute_cql("SELECT count(*) FROM test WHERE v > 1 ALLOW FILTERING").get0();
+        assert_that(msg).is_rows().with_size(1).with_row({{long_type->decompose(int64_t(2))}});
+        BOOST_REQUIRE_EQUAL(stats.replica_aggregate_queries, replica_aggregate_queries + 3);
+
+        // The replicas can't enforce the LIMIT, so the coordinator aggregates too.
+        msg = e.execute_cql("SELECT count(*) FROM test LIMIT 2").get0();
+        assert_that(msg).is_rows().with_size(1).with_row({{long_type->decompose(int64_t(2))}});
+        BOOST_REQUIRE_EQUAL(stats.replica_aggregate_queries, replica_aggregate_queries + 3);
+    });
+}
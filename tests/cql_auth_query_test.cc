@@ -22,9 +22,12 @@
 #include <string_view>
 
 #include <seastar/core/future.hh>
+#include <seastar/core/lowres_clock.hh>
 #include <seastar/core/shared_ptr.hh>
+#include <seastar/core/sleep.hh>
 #include <seastar/core/sstring.hh>
 #include <seastar/core/thread.hh>
+#include <seastar/net/inet_address.hh>
 #include <seastar/util/defer.hh>
 
 #include "auth/authenticated_user.hh"
@@ -38,6 +41,7 @@
 #include "exceptions/exceptions.hh"
 #include "seastarx.hh"
 #include "service/client_state.hh"
+#include "tests/cql_test_connection.hh"
 #include "tests/cql_test_env.hh"
 #include <seastar/testing/test_case.hh>
 
@@ -326,3 +330,68 @@ SEASTAR_TEST_CASE(create_table_default_permissions) {
                 auth::make_data_resource("ks", "orcs"));
     }, db_config_with_auth());
 }
+
+//
+// Prepared statements authorized on a connection
+//
+
+static constexpr int32_t unauthorized_error = 0x2100;
+
+// Prepares a SELECT from ks.t as alice, who may read it, on a fresh connection.
+static std::pair<cql_test_connection, bytes> prepare_as_alice(cql_test_env& env, uint16_t port) {
+    env.execute_cql("CREATE TABLE IF NOT EXISTS ks.t (p int PRIMARY KEY)").get0();
+    create_user_if_not_exists(env, alice);
+    env.execute_cql("GRANT SELECT ON ks.t TO alice").get0();
+
+    auto conn = cql_test_connection::connect(socket_address(net::inet_address("127.0.0.1"), port));
+    conn.startup();
+    conn.login(sstring(alice), sstring(alice));
+    auto id = conn.prepare("SELECT * FROM ks.t");
+    return {std::move(conn), std::move(id)};
+}
+
+SEASTAR_TEST_CASE(revoked_permission_is_enforced_on_execute) {
+    return do_with_cql_env_thread([](auto&& env) {
+        cql_test_server server(env);
+        auto [conn, id] = prepare_as_alice(env, server.listen());
+        conn.execute(id).check_no_error();
+
+        env.execute_cql("REVOKE SELECT ON ks.t FROM alice").get0();
+
+        auto response = conn.execute(id);
+        BOOST_REQUIRE(response.opcode == cql_transport::cql_binary_opcode::ERROR);
+        BOOST_REQUIRE_EQUAL(response.error_code(), unauthorized_error);
+        conn.close();
+    }, db_config_with_auth());
+}
+
+SEASTAR_TEST_CASE(revoked_permission_is_enforced_on_execute_with_permission_caching) {
+    auto config = db_config_with_auth();
+    config->permissions_validity_in_ms.set(3000);
+    config->permissions_update_interval_in_ms.set(100);
+
+    return do_with_cql_env_thread([](auto&& env) {
+        cql_test_server server(env);
+        auto [conn, id] = prepare_as_alice(env, server.listen());
+        // Authorized through the shared cache, then by the connection.
+        for (int i = 0; i < 3; ++i) {
+            conn.execute(id).check_no_error();
+        }
+
+        env.execute_cql("REVOKE SELECT ON ks.t FROM alice").get0();
+
+        // The revocation is enforced once the caches are refreshed, even
+        // though the statement is executed more often than they expire.
+        auto deadline = lowres_clock::now() + std::chrono::seconds(30);
+        while (true) {
+            auto response = conn.execute(id);
+            if (response.opcode == cql_transport::cql_binary_opcode::ERROR) {
+                BOOST_REQUIRE_EQUAL(response.error_code(), unauthorized_error);
+                break;
+            }
+            BOOST_REQUIRE(lowres_clock::now() < deadline);
+            sleep(std::chrono::milliseconds(10)).get();
+        }
+        conn.close();
+    }, config);
+}
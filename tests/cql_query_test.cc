@@ -44,8 +44,10 @@
 #include "types/set.hh"
 #include "db/config.hh"
 #include "cql3/cql_config.hh"
+#include "cql3/simple_statement_parser.hh"
 #include "sstables/compaction_manager.hh"
 #include "exception_utils.hh"
+#include "service/pager/paging_state.hh"
 #include "json.hh"
 
 using namespace std::literals::chrono_literals;
@@ -853,6 +855,59 @@ SEASTAR_TEST_CASE(test_limit_is_respected_across_partitions) {
     });
 }
 
+// The replicas apply PER PARTITION LIMIT to each page, so the pager must
+// count the rows it already returned for a partition split across pages.
+SEASTAR_THREAD_TEST_CASE(test_per_partition_limit_is_respected_across_pages) {
+    do_with_cql_env_thread([] (cql_test_env& e) {
+        cquery_nofail(e, "CREATE TABLE t (pk int, ck int, v int, PRIMARY KEY (pk, ck))");
+        for (int pk = 0; pk < 5; ++pk) {
+            for (int ck = 0; ck < 5; ++ck) {
+                cquery_nofail(e, format("INSERT INTO t (pk, ck, v) VALUES ({}, {}, {})", pk, ck, pk * 10 + ck).c_str());
+            }
+        }
+        std::vector<bytes_opt> partitions;
+        auto msg = cquery_nofail(e, "SELECT DISTINCT pk FROM t");
+        for (auto& row : dynamic_pointer_cast<cql_transport::messages::result_message::rows>(msg)->rs().result_set().rows()) {
+            partitions.push_back(row[0]);
+        }
+        BOOST_REQUIRE_EQUAL(partitions.size(), 5);
+
+        auto fetch_all = [&e] (const sstring& query, int32_t page_size) {
+            std::vector<std::vector<bytes_opt>> fetched;
+            ::shared_ptr<service::pager::paging_state> paging_state;
+            do {
+                auto qo = std::make_unique<cql3::query_options>(db::consistency_level::LOCAL_ONE, infinite_timeout_config, std::vector<cql3::raw_value>{},
+                        cql3::query_options::specific_options{page_size, paging_state, {}, api::new_timestamp()});
+                auto msg = e.execute_cql(query, std::move(qo)).get0();
+                auto rows = dynamic_pointer_cast<cql_transport::messages::result_message::rows>(msg);
+                BOOST_REQUIRE(rows);
+                boost::copy(rows->rs().result_set().rows(), std::back_inserter(fetched));
+                auto state = rows->rs().get_metadata().paging_state();
+                paging_state = state ? ::make_shared<service::pager::paging_state>(*state) : nullptr;
+            } while (paging_state);
+            return fetched;
+        };
+
+        for (int ppl = 1; ppl <= 3; ++ppl) {
+            std::vector<std::vector<bytes_opt>> expected;
+            for (auto& pk : partitions) {
+                auto pk_value = value_cast<int32_t>(int32_type->deserialize(*pk));
+                for (int ck = 0; ck < ppl; ++ck) {
+                    expected.push_back({pk, int32_type->decompose(ck), int32_type->decompose(pk_value * 10 + ck)});
+                }
+            }
+            for (int32_t page_size = 1; page_size <= 7; ++page_size) {
+                BOOST_TEST_MESSAGE(format("PER PARTITION LIMIT {}, page size {}", ppl, page_size));
+                BOOST_REQUIRE(fetch_all(format("SELECT pk, ck, v FROM t PER PARTITION LIMIT {}", ppl), page_size) == expected);
+
+                auto single = fetch_all(format("SELECT pk, ck, v FROM t WHERE pk = {} PER PARTITION LIMIT {}",
+                        value_cast<int32_t>(int32_type->deserialize(*partitions.front())), ppl), page_size);
+                BOOST_REQUIRE(single == std::vector<std::vector<bytes_opt>>(expected.begin(), expected.begin() + ppl));
+            }
+        }
+    }).get();
+}
+
 SEASTAR_TEST_CASE(test_partitions_have_consistent_ordering_in_range_query) {
     return do_with_cql_env([] (cql_test_env& e) {
         return e.execute_cql("create table cf (k blob, v int, primary key (k));").discard_result().then([&e] {
@@ -4154,3 +4209,93 @@ SEASTAR_TEST_CASE(test_rf_expand) {
         });
     });
 }
+
+SEASTAR_THREAD_TEST_CASE(test_parallel_scan_paging) {
+    auto cfg = make_shared<db::config>();
+    cfg->parallel_scan_concurrency(4);
+    do_with_cql_env_thread([] (cql_test_env& e) {
+        cquery_nofail(e, "CREATE TABLE t (pk int, ck int, v int, PRIMARY KEY (pk, ck))");
+        std::vector<std::vector<bytes_opt>> rows;
+        std::vector<std::vector<bytes_opt>> filtered_rows;
+        for (int pk = 0; pk < 10; ++pk) {
+            for (int ck = 0; ck < 5; ++ck) {
+                cquery_nofail(e, format("INSERT INTO t (pk, ck, v) VALUES ({}, {}, {})", pk, ck, pk + ck).c_str());
+                rows.push_back({int32_type->decompose(pk), int32_type->decompose(ck), int32_type->decompose(pk + ck)});
+                if (ck == 3) {
+                    filtered_rows.push_back(rows.back());
+                }
+            }
+        }
+
+        auto fetch_all = [&e] (const sstring& query, bool parallel) {
+            std::vector<std::vector<bytes_opt>> fetched;
+            ::shared_ptr<service::pager::paging_state> paging_state;
+            do {
+                auto qo = std::make_unique<cql3::query_options>(db::consistency_level::LOCAL_ONE, infinite_timeout_config, std::vector<cql3::raw_value>{},
+                        cql3::query_options::specific_options{3, paging_state, {}, api::new_timestamp()});
+                auto msg = e.execute_cql(query, std::move(qo)).get0();
+                auto rows = dynamic_pointer_cast<cql_transport::messages::result_message::rows>(msg);
+                auto rs = rows->rs().result_set();
+                BOOST_REQUIRE_LE(rs.size(), 3);
+                boost::copy(rs.rows(), std::back_inserter(fetched));
+                auto state = rows->rs().get_metadata().paging_state();
+                if (state) {
+                    BOOST_REQUIRE_EQUAL(state->is_parallel_scan(), parallel);
+                    paging_state = ::make_shared<service::pager::paging_state>(*state);
+                } else {
+                    paging_state = nullptr;
+                }
+            } while (paging_state);
+            return fetched;
+        };
+
+        auto require_rows = [] (std::vector<std::vector<bytes_opt>> fetched, std::vector<std::vector<bytes_opt>> expected) {
+            boost::sort(fetched);
+            boost::sort(expected);
+            BOOST_REQUIRE(fetched == expected);
+        };
+
+        require_rows(fetch_all("SELECT * FROM t PARALLEL SCAN", true), rows);
+        require_rows(fetch_all("SELECT * FROM t WHERE ck = 3 ALLOW FILTERING PARALLEL SCAN", true), filtered_rows);
+
+        // Without the clause, or with a LIMIT, the rows are returned in token order.
+        auto in_order = fetch_all("SELECT * FROM t", false);
+        require_rows(in_order, rows);
+        auto limited = fetch_all("SELECT * FROM t LIMIT 7 PARALLEL SCAN", false);
+        BOOST_REQUIRE(limited == std::vector<std::vector<bytes_opt>>(in_order.begin(), in_order.begin() + 7));
+    }, cfg).get();
+}
+
+SEASTAR_THREAD_TEST_CASE(test_simple_statement_parser) {
+    BOOST_REQUIRE(cql3::parse_simple_statement("SELECT * FROM t WHERE k = 1"));
+    BOOST_REQUIRE(cql3::parse_simple_statement("INSERT INTO ks.t (k, v) VALUES (?, :v) USING TTL 10"));
+    BOOST_REQUIRE(cql3::parse_simple_statement("UPDATE t SET v = 'x' WHERE k = 1;"));
+    // Anything else is left to the full parser.
+    BOOST_REQUIRE(!cql3::parse_simple_statement("SELECT * FROM t WHERE k IN (1, 2)"));
+    BOOST_REQUIRE(!cql3::parse_simple_statement("SELECT * FROM t WHERE key = 1"));
+    BOOST_REQUIRE(!cql3::parse_simple_statement("SELECT * FROM t WHERE k = 12345678-1234-1234-1234-123456789012"));
+    BOOST_REQUIRE(!cql3::parse_simple_statement("SELECT * FROM t WHERE k = 1.5"));
+    BOOST_REQUIRE(!cql3::parse_simple_statement("SELECT * FROM t -- comment"));
+    BOOST_REQUIRE(!cql3::parse_simple_statement("INSERT INTO t (k) VALUES (1) IF NOT EXISTS"));
+    BOOST_REQUIRE(!cql3::parse_simple_statement("UPDATE t SET v = v + 1 WHERE k = 1"));
+
+    do_with_cql_env_thread([] (cql_test_env& e) {
+        cquery_nofail(e, "CREATE TABLE t (k int, c int, \"V\" text, b blob, f boolean, PRIMARY KEY (k, c))");
+        cquery_nofail(e, "INSERT INTO t (k, c, \"V\", b, f) VALUES (1, -1, 'it''s', 0x01, true) USING TTL 1000");
+        cquery_nofail(e, "UPDATE ks.t SET \"V\" = 'x', f = false WHERE k = 1 AND c = 2");
+        // The second execution is served from the cache of parsed statements.
+        for (int i = 0; i < 2; ++i) {
+            auto msg = cquery_nofail(e, "SELECT c, \"V\", b, f FROM t WHERE k = 1 AND c >= -1 LIMIT 10;");
+            assert_that(msg).is_rows().with_rows({
+                {int32_type->decompose(-1), utf8_type->decompose("it's"), bytes_type->decompose(bytes({1})), boolean_type->decompose(true)},
+                {int32_type->decompose(2), utf8_type->decompose("x"), std::nullopt, boolean_type->decompose(false)},
+            });
+        }
+
+        auto id = e.prepare("SELECT c FROM t WHERE k = ? AND c > :c").get0();
+        auto msg = e.execute_prepared(id, {cql3::raw_value::make_value(int32_type->decompose(1)), cql3::raw_value::make_value(int32_type->decompose(0))}).get0();
+        assert_that(msg).is_rows().with_rows({{int32_type->decompose(2)}});
+
+        BOOST_REQUIRE_THROW(e.execute_cql("UPDATE t SET f = true, f = false WHERE k = 1 AND c = 1").get(), exceptions::syntax_exception);
+    }).get();
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tests/cql_test_connection.hh"
+
+#include <seastar/core/memory.hh>
+#include <seastar/core/semaphore.hh>
+#include <seastar/net/inet_address.hh>
+
+#include "service/storage_proxy.hh"
+#include "tests/random-utils.hh"
+
+#define ZSTD_STATIC_LINKING_ONLY
+#include "zstd/lib/zstd.h"
+
+cql_test_server::cql_test_server(cql_test_env& env, cql_transport::cql_server_config config) {
+    _cql_config.start().get();
+    try {
+        _server.start(std::ref(service::get_storage_proxy()), std::ref(env.qp()), std::ref(env.auth_service()), std::ref(_cql_config), std::move(config)).get();
+    } catch (...) {
+        _cql_config.stop().get();
+        throw;
+    }
+}
+
+cql_test_server::~cql_test_server() {
+    stop();
+}
+
+uint16_t cql_test_server::listen(bool shard_aware) {
+    static constexpr int max_attempts = 100;
+    for (int attempt = 1; ; ++attempt) {
+        auto port = tests::random::get_int<uint16_t>(10000, 60000);
+        auto addr = socket_address(net::inet_address("127.0.0.1"), port);
+        try {
+            _server.invoke_on_all(&cql_transport::cql_server::listen, addr, std::shared_ptr<seastar::tls::credentials_builder>(), shard_aware, false).get();
+            return port;
+        } catch (...) {
+            if (attempt == max_attempts) {
+                throw;
+            }
+        }
+    }
+}
+
+void cql_test_server::stop() {
+    if (!std::exchange(_stopped, true)) {
+        _server.stop().get();
+        _cql_config.stop().get();
+    }
+}
+
+cql_transport::cql_server_config cql_test_server::make_config() {
+    cql_transport::cql_server_config config;
+    config.timeout_config = infinite_timeout_config;
+    config.max_request_size = memory::stats().total_memory() / 10;
+    config.get_service_memory_limiter_semaphore = [] () -> semaphore& {
+        static thread_local semaphore memory_limiter(memory::stats().total_memory() / 10);
+        return memory_limiter;
+    };
+    return config;
+}
+
+static bytes decompress_zstd(bytes_view in) {
+    auto size = ZSTD_getFrameContentSize(in.data(), in.size());
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+        throw std::runtime_error("invalid zstd frame");
+    }
+    bytes out(bytes::initialized_later(), size);
+    auto ret = ZSTD_decompress(out.begin(), out.size(), in.data(), in.size());
+    if (ZSTD_isError(ret) || ret != size) {
+        throw std::runtime_error(format("zstd decompression failed: {}", ZSTD_getErrorName(ret)));
+    }
+    return out;
+}
+
+cql_transport::request_reader cql_test_connection::frame::reader(bytes_ostream& linearization_buffer) {
+    std::vector<temporary_buffer<char>> fragments;
+    fragments.emplace_back(reinterpret_cast<const char*>(body.data()), body.size());
+    _buffer = fragmented_temporary_buffer(std::move(fragments), body.size());
+    return cql_transport::request_reader(_buffer.get_istream(), linearization_buffer);
+}
+
+int32_t cql_test_connection::frame::error_code() {
+    bytes_ostream linearization_buffer;
+    return reader(linearization_buffer).read_int();
+}
+
+void cql_test_connection::frame::check_no_error() {
+    if (opcode != cql_transport::cql_binary_opcode::ERROR) {
+        return;
+    }
+    bytes_ostream linearization_buffer;
+    auto in = reader(linearization_buffer);
+    auto code = in.read_int();
+    auto message = in.read_string();
+    throw std::runtime_error(format("CQL error {:#x}: {}", code, message));
+}
+
+cql_test_connection::cql_test_connection(connected_socket fd)
+    : _fd(std::move(fd))
+    , _in(_fd.input())
+    , _out(_fd.output()) {
+}
+
+cql_test_connection cql_test_connection::connect(socket_address server, socket_address local) {
+    return cql_test_connection(engine().net().connect(server, local).get0());
+}
+
+cql_transport::response cql_test_connection::make_request(cql_transport::cql_binary_opcode opcode) {
+    return cql_transport::response(_next_stream++, opcode, tracing::trace_state_ptr());
+}
+
+cql_test_connection::frame cql_test_connection::send(cql_transport::response& request) {
+    auto packet = request.make_message(version, _compression).release();
+    packet.linearize();
+    // make_message() makes response frames.
+    packet.frag(0).base[0] = version;
+    _out.write(std::move(packet)).get();
+    _out.flush().get();
+
+    auto header = _in.read_exactly(9).get0();
+    if (header.size() != 9) {
+        throw std::runtime_error("connection closed by the server");
+    }
+    auto p = reinterpret_cast<const uint8_t*>(header.get());
+    if (p[0] != (version | 0x80)) {
+        throw std::runtime_error(format("unexpected response version {:#x}", p[0]));
+    }
+    frame f;
+    f.flags = p[1];
+    f.stream = int16_t((p[2] << 8) | p[3]);
+    f.opcode = cql_transport::cql_binary_opcode(p[4]);
+    uint32_t length = (uint32_t(p[5]) << 24) | (uint32_t(p[6]) << 16) | (uint32_t(p[7]) << 8) | uint32_t(p[8]);
+    auto body = _in.read_exactly(length).get0();
+    if (body.size() != length) {
+        throw std::runtime_error("connection closed by the server");
+    }
+    f.body = bytes(reinterpret_cast<const int8_t*>(body.get()), body.size());
+    if (f.flags & cql_transport::cql_frame_flags::compression) {
+        f.body = decompress_zstd(f.body);
+    }
+    return f;
+}
+
+cql_test_connection::frame cql_test_connection::startup(std::map<sstring, sstring> options) {
+    auto compression = options.count("COMPRESSION") ? options["COMPRESSION"] : sstring();
+    options.emplace("CQL_VERSION", "3.0.0");
+    auto request = make_request(cql_transport::cql_binary_opcode::STARTUP);
+    request.write_string_map(std::move(options));
+    auto response = send(request);
+    response.check_no_error();
+    if (compression == "zstd") {
+        _compression = cql_transport::cql_compression::zstd;
+    } else if (!compression.empty()) {
+        throw std::invalid_argument(format("unsupported compression {}", compression));
+    }
+    return response;
+}
+
+void cql_test_connection::login(const sstring& user, const sstring& password) {
+    auto request = make_request(cql_transport::cql_binary_opcode::AUTH_RESPONSE);
+    auto token = bytes(1, 0) + to_bytes(user) + bytes(1, 0) + to_bytes(password);
+    request.write_bytes(std::move(token));
+    auto response = send(request);
+    response.check_no_error();
+    if (response.opcode != cql_transport::cql_binary_opcode::AUTH_SUCCESS) {
+        throw std::runtime_error(format("unexpected response to AUTH_RESPONSE: {:d}", int(response.opcode)));
+    }
+}
+
+std::multimap<sstring, sstring> cql_test_connection::options() {
+    auto request = make_request(cql_transport::cql_binary_opcode::OPTIONS);
+    auto response = send(request);
+    response.check_no_error();
+    bytes_ostream linearization_buffer;
+    auto in = response.reader(linearization_buffer);
+    std::multimap<sstring, sstring> options;
+    for (auto n = in.read_short(); n; --n) {
+        auto key = in.read_string();
+        std::vector<sstring> values;
+        in.read_string_list(values);
+        for (auto& value : values) {
+            options.emplace(key, std::move(value));
+        }
+    }
+    return options;
+}
+
+cql_test_connection::frame cql_test_connection::query(const sstring& text, db::consistency_level cl) {
+    auto request = make_request(cql_transport::cql_binary_opcode::QUERY);
+    request.write_long_string(text);
+    request.write_consistency(cl);
+    request.write_byte(0);
+    return send(request);
+}
+
+bytes cql_test_connection::prepare(const sstring& text) {
+    auto request = make_request(cql_transport::cql_binary_opcode::PREPARE);
+    request.write_long_string(text);
+    auto response = send(request);
+    response.check_no_error();
+    bytes_ostream linearization_buffer;
+    auto in = response.reader(linearization_buffer);
+    static constexpr int32_t prepared_kind = 0x0004;
+    if (in.read_int() != prepared_kind) {
+        throw std::runtime_error("unexpected response to PREPARE");
+    }
+    return in.read_short_bytes();
+}
+
+cql_test_connection::frame cql_test_connection::execute(const bytes& id, std::vector<bytes_opt> values, db::consistency_level cl) {
+    static constexpr uint8_t values_flag = 0x01;
+    auto request = make_request(cql_transport::cql_binary_opcode::EXECUTE);
+    request.write_short_bytes(id);
+    request.write_consistency(cl);
+    if (values.empty()) {
+        request.write_byte(0);
+    } else {
+        request.write_byte(values_flag);
+        request.write_short(values.size());
+        for (auto& value : values) {
+            request.write_value(std::move(value));
+        }
+    }
+    return send(request);
+}
+
+void cql_test_connection::close() {
+    _out.close().get();
+    _in.close().get();
+}
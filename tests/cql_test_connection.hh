@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <map>
+#include <seastar/core/iostream.hh>
+#include <seastar/core/sharded.hh>
+#include <seastar/net/api.hh>
+
+#include "bytes.hh"
+#include "cql3/cql_config.hh"
+#include "db/consistency_level_type.hh"
+#include "tests/cql_test_env.hh"
+#include "transport/request.hh"
+#include "transport/response.hh"
+#include "transport/server.hh"
+#include "utils/fragmented_temporary_buffer.hh"
+
+// For the tests which need to go through the CQL binary protocol, rather than
+// through the query processor as cql_test_env does. All calls must be made in
+// the context of a seastar::thread.
+
+// A cql_transport::cql_server running on all shards of a cql_test_env.
+class cql_test_server {
+    sharded<cql3::cql_config> _cql_config;
+    sharded<cql_transport::cql_server> _server;
+    bool _stopped = false;
+public:
+    explicit cql_test_server(cql_test_env& env, cql_transport::cql_server_config config = make_config());
+    ~cql_test_server();
+
+    // Listens on the loopback address, on a port not used by another listener
+    // and which is returned.
+    uint16_t listen(bool shard_aware = false);
+    void stop();
+
+    static cql_transport::cql_server_config make_config();
+};
+
+// A client connection speaking version 4 of the CQL binary protocol.
+class cql_test_connection {
+public:
+    static constexpr uint8_t version = 4;
+
+    struct frame {
+        uint8_t flags;
+        int16_t stream;
+        cql_transport::cql_binary_opcode opcode;
+        // Decompressed if the frame was.
+        bytes body;
+
+        // Reads the body. The frame must outlive the reader.
+        cql_transport::request_reader reader(bytes_ostream& linearization_buffer);
+        // Throws if the frame is an ERROR, with its code and message.
+        void check_no_error();
+        // The code of an ERROR frame.
+        int32_t error_code();
+    private:
+        fragmented_temporary_buffer _buffer;
+    };
+private:
+    connected_socket _fd;
+    input_stream<char> _in;
+    output_stream<char> _out;
+    int16_t _next_stream = 0;
+    cql_transport::cql_compression _compression = cql_transport::cql_compression::none;
+public:
+    explicit cql_test_connection(connected_socket fd);
+    cql_test_connection(cql_test_connection&&) = default;
+
+    static cql_test_connection connect(socket_address server, socket_address local = {});
+
+    // A request to be filled in and passed to send().
+    cql_transport::response make_request(cql_transport::cql_binary_opcode opcode);
+    // Sends the request, compressed if the connection negotiated compression,
+    // and returns the response.
+    frame send(cql_transport::response& request);
+
+    // Sends STARTUP. A "COMPRESSION" option makes the following requests and
+    // responses compressed with that algorithm, which must be zstd.
+    frame startup(std::map<sstring, sstring> options = {});
+    // Logs in with a PasswordAuthenticator.
+    void login(const sstring& user, const sstring& password);
+    std::multimap<sstring, sstring> options();
+    frame query(const sstring& text, db::consistency_level cl = db::consistency_level::ONE);
+    // Returns the id of the prepared statement.
+    bytes prepare(const sstring& text);
+    frame execute(const bytes& id, std::vector<bytes_opt> values = {}, db::consistency_level cl = db::consistency_level::ONE);
+    // Must be called before the connection is destroyed.
+    void close();
+};
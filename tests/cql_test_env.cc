@@ -287,6 +287,10 @@ class single_node_cql_env : public cql_test_env {
         return _auth_service->local();
     }
 
+    sharded<auth::service>& auth_service() override {
+        return *_auth_service;
+    }
+
     virtual db::view::view_builder& local_view_builder() override {
         return _view_builder->local();
     }
@@ -295,6 +299,10 @@ class single_node_cql_env : public cql_test_env {
         return _view_update_generator->local();
     }
 
+    virtual distributed<db::view::view_update_generator>& view_update_generator() override {
+        return *_view_update_generator;
+    }
+
     future<> start() {
         return _core_local.start(std::ref(*_auth_service));
     }
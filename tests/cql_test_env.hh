@@ -119,9 +119,13 @@ class cql_test_env {
 
     virtual auth::service& local_auth_service() = 0;
 
+    virtual sharded<auth::service>& auth_service() = 0;
+
     virtual db::view::view_builder& local_view_builder() = 0;
 
     virtual db::view::view_update_generator& local_view_update_generator() = 0;
+
+    virtual distributed<db::view::view_update_generator>& view_update_generator() = 0;
 };
 
 future<> do_with_cql_env(std::function<future<>(cql_test_env&)> func, cql_test_config = {});
@@ -21,12 +21,24 @@
 
 
 #include <seastar/core/reactor.hh>
+#include <seastar/core/sleep.hh>
 #include <seastar/core/thread.hh>
 #include <seastar/testing/test_case.hh>
 #include <seastar/testing/thread_test_case.hh>
+#include <seastar/core/fstream.hh>
+#include <seastar/util/defer.hh>
+
+#include <boost/range/adaptor/transformed.hpp>
+#include <boost/range/algorithm/count_if.hpp>
+#include <boost/range/algorithm/find.hpp>
+#include <boost/range/algorithm/find_if.hpp>
+#include <boost/range/algorithm/max_element.hpp>
+#include <boost/range/irange.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 
 #include "tests/cql_test_env.hh"
 #include "tests/result_set_assertions.hh"
+#include "tests/cql_assertions.hh"
 
 #include "database.hh"
 #include "partition_slice_builder.hh"
@@ -39,6 +51,15 @@
 #include "db/commitlog/commitlog_replayer.hh"
 #include "tmpdir.hh"
 #include "db/data_listeners.hh"
+#include "flat_mutation_reader_assertions.hh"
+#include "db/system_distributed_keyspace.hh"
+#include "db/view/view_update_generator.hh"
+#include "message/msg_addr.hh"
+#include "streaming/stream_session.hh"
+#include "streaming/stream_manager.hh"
+#include "streaming/stream_transfer_task.hh"
+#include "utils/crc.hh"
+#include "utils/fb_utilities.hh"
 
 using namespace std::chrono_literals;
 
@@ -469,3 +490,294 @@ SEASTAR_TEST_CASE(toppartitions_cross_shard_schema_ptr) {
         tq.gather().get();
     });
 }
+
+SEASTAR_TEST_CASE(test_repaired_sstables_are_kept_apart) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        e.execute_cql("create table ks.cf (k int, v int, primary key (k));").get();
+        auto& db = e.local_db();
+        auto& cf = db.find_column_family("ks", "cf");
+        auto s = cf.schema();
+
+        auto write_and_flush = [&] (int32_t k) {
+            mutation m(s, partition_key::from_single_value(*s, int32_type->decompose(k)));
+            m.set_clustered_cell(clustering_key::make_empty(), "v", data_value(k), api::new_timestamp());
+            db.apply(s, freeze(m)).get();
+            cf.flush().get();
+            return m;
+        };
+
+        write_and_flush(1);
+        auto generations = boost::copy_range<std::unordered_set<int64_t>>(*cf.get_sstables()
+                | boost::adaptors::transformed(std::mem_fn(&sstables::sstable::generation)));
+        BOOST_REQUIRE_EQUAL(generations.size(), 1);
+        cf.mark_sstables_repaired(generations, 1000).get();
+        BOOST_REQUIRE_EQUAL((*cf.get_sstables()->begin())->get_repaired_at(), 1000);
+
+        auto m2 = write_and_flush(2);
+        assert_that(cf.make_streaming_reader(s, query::full_partition_range, read_unrepaired_only::yes))
+            .produces(m2)
+            .produces_end_of_stream();
+
+        write_and_flush(3);
+        cf.compact_all_sstables().get();
+        auto ssts = *cf.get_sstables();
+        BOOST_REQUIRE_EQUAL(ssts.size(), 2);
+        BOOST_REQUIRE_EQUAL(boost::count_if(ssts, std::mem_fn(&sstables::sstable::is_repaired)), 1);
+    });
+}
+
+SEASTAR_TEST_CASE(test_streaming_reader_excludes_sstables) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        e.execute_cql("create table ks.cf (k int, v int, primary key (k));").get();
+        auto& db = e.local_db();
+        auto& cf = db.find_column_family("ks", "cf");
+        auto s = cf.schema();
+
+        auto write_and_flush = [&] (int32_t k) {
+            mutation m(s, partition_key::from_single_value(*s, int32_type->decompose(k)));
+            m.set_clustered_cell(clustering_key::make_empty(), "v", data_value(k), api::new_timestamp());
+            db.apply(s, freeze(m)).get();
+            cf.flush().get();
+            return m;
+        };
+
+        write_and_flush(1);
+        auto excluded = boost::copy_range<std::unordered_set<sstables::shared_sstable>>(*cf.get_sstables());
+        BOOST_REQUIRE_EQUAL(excluded.size(), 1);
+
+        auto m2 = write_and_flush(2);
+        assert_that(cf.make_streaming_reader(s, dht::partition_range_vector{query::full_partition_range}, excluded))
+            .produces(m2)
+            .produces_end_of_stream();
+    });
+}
+
+SEASTAR_TEST_CASE(test_pick_whole_sstables) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        e.execute_cql("create table ks.cf (k int, v int, primary key (k));").get();
+        auto& db = e.local_db();
+        auto& cf = db.find_column_family("ks", "cf");
+        auto s = cf.schema();
+
+        // Writes the keys to a new sstable, and returns it.
+        auto write_and_flush = [&] (const std::vector<int32_t>& keys) {
+            for (auto k : keys) {
+                mutation m(s, partition_key::from_single_value(*s, int32_type->decompose(k)));
+                m.set_clustered_cell(clustering_key::make_empty(), "v", data_value(k), api::new_timestamp());
+                db.apply(s, freeze(m)).get();
+            }
+            cf.flush().get();
+            auto ssts = *cf.get_sstables();
+            return *boost::max_element(ssts, [] (const sstables::shared_sstable& a, const sstables::shared_sstable& b) {
+                return a->generation() < b->generation();
+            });
+        };
+        auto token_range_of = [] (const sstables::shared_sstable& sst) {
+            return dht::token_range::make({sst->get_first_decorated_key().token(), true}, {sst->get_last_decorated_key().token(), true});
+        };
+
+        auto sst1 = write_and_flush({1});
+        auto sst2 = write_and_flush({2, 3});
+
+        auto picked = streaming::pick_whole_sstables(cf, {token_range_of(sst1)});
+        BOOST_REQUIRE(picked == std::vector<sstables::shared_sstable>{sst1});
+
+        picked = streaming::pick_whole_sstables(cf, {dht::token_range::make_open_ended_both_sides()});
+        BOOST_REQUIRE_EQUAL(picked.size(), 2);
+
+        // An sstable only partly inside the ranges is streamed as mutation fragments.
+        picked = streaming::pick_whole_sstables(cf, {dht::token_range::make_singular(sst2->get_first_decorated_key().token())});
+        BOOST_REQUIRE(boost::find(picked, sst2) == picked.end());
+    });
+}
+
+SEASTAR_TEST_CASE(test_sstable_files_pin_delays_deletion) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        e.execute_cql("create table ks.cf (k int, v int, primary key (k));").get();
+        auto& db = e.local_db();
+        auto& cf = db.find_column_family("ks", "cf");
+        auto s = cf.schema();
+
+        mutation m(s, partition_key::from_single_value(*s, int32_type->decompose(1)));
+        m.set_clustered_cell(clustering_key::make_empty(), "v", data_value(1), api::new_timestamp());
+        db.apply(s, freeze(m)).get();
+        cf.flush().get();
+        auto sst = *cf.get_sstables()->begin();
+        auto toc = sst->toc_filename();
+
+        auto pin = sst->pin_files();
+        BOOST_REQUIRE(pin);
+        auto deleted = sstables::delete_atomically({sst});
+        sleep(std::chrono::milliseconds(100)).get();
+        BOOST_REQUIRE(!deleted.available());
+        BOOST_REQUIRE(file_exists(toc).get0());
+        // The files can't be pinned anymore, once their deletion started.
+        BOOST_REQUIRE(!sst->pin_files());
+
+        pin.reset();
+        deleted.get();
+        BOOST_REQUIRE(!file_exists(toc).get0());
+    });
+}
+
+// Returns the chunks STREAM_SSTABLE_FILES sends for the sstable.
+static std::vector<streaming::stream_sstable_files_chunk> make_sstable_files_chunks(sstables::shared_sstable sst) {
+    using streaming::stream_sstable_files_cmd;
+    std::vector<streaming::stream_sstable_files_chunk> chunks;
+    chunks.push_back({stream_sstable_files_cmd::sstable_start, sstables::to_string(sst->get_version())});
+    auto components = sst->all_components();
+    std::stable_partition(components.begin(), components.end(), [] (const std::pair<sstables::component_type, sstring>& c) {
+        return c.first == sstables::component_type::TOC;
+    });
+    for (auto& c : components) {
+        auto s = sst->get_schema();
+        auto name = sstables::sstable::filename(sst->get_dir(), s->ks_name(), s->cf_name(), sst->get_version(), sst->generation(), sst->get_format(), c.second);
+        auto in = make_file_input_stream(open_file_dma(name, open_flags::ro).get0());
+        utils::crc32 checksum;
+        chunks.push_back({stream_sstable_files_cmd::component_start, c.second});
+        for (auto buf = in.read().get0(); !buf.empty(); buf = in.read().get0()) {
+            checksum.process(reinterpret_cast<const uint8_t*>(buf.get()), buf.size());
+            chunks.push_back({stream_sstable_files_cmd::component_data, {}, bytes(reinterpret_cast<const bytes::value_type*>(buf.get()), buf.size())});
+        }
+        in.close().get();
+        chunks.push_back({stream_sstable_files_cmd::component_end, {}, {}, checksum.get()});
+    }
+    chunks.push_back({stream_sstable_files_cmd::sstable_end});
+    chunks.push_back({stream_sstable_files_cmd::end_of_stream});
+    return chunks;
+}
+
+SEASTAR_TEST_CASE(test_receive_sstable_files) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        sharded<db::system_distributed_keyspace> sys_dist_ks;
+        sys_dist_ks.start(std::ref(e.qp()), std::ref(service::get_migration_manager())).get();
+        auto stop_sys_dist_ks = defer([&sys_dist_ks] { sys_dist_ks.stop().get(); });
+        streaming::get_stream_manager().start().get();
+        auto stop_stream_manager = defer([] { streaming::get_stream_manager().stop().get(); });
+
+        e.execute_cql("create table ks.src (k int, v int, primary key (k));").get();
+        auto& db = e.local_db();
+        auto& src = db.find_column_family("ks", "src");
+        auto s = src.schema();
+
+        auto shard_of_key = [&] (int32_t k) {
+            return dht::shard_of(dht::global_partitioner().decorate_key(*s, partition_key::from_single_value(*s, int32_type->decompose(k))).token());
+        };
+        // Writes the keys to a new sstable of ks.src, on this shard.
+        auto write_and_flush = [&] (const std::vector<int32_t>& keys) {
+            for (auto k : keys) {
+                mutation m(s, partition_key::from_single_value(*s, int32_type->decompose(k)));
+                m.set_clustered_cell(clustering_key::make_empty(), "v", data_value(k), api::new_timestamp());
+                db.apply(s, freeze(m)).get();
+            }
+            src.flush().get();
+            auto ssts = *src.get_sstables();
+            return *boost::max_element(ssts, [] (const sstables::shared_sstable& a, const sstables::shared_sstable& b) {
+                return a->generation() < b->generation();
+            });
+        };
+        auto receive = [&] (const sstring& cf_name, std::vector<streaming::stream_sstable_files_chunk> chunks) {
+            auto dst_schema = db.find_schema("ks", cf_name);
+            auto source = [chunks = std::move(chunks), i = size_t(0)] () mutable {
+                std::optional<streaming::stream_sstable_files_chunk> chunk;
+                if (i < chunks.size()) {
+                    chunk = std::move(chunks[i++]);
+                }
+                return make_ready_future<std::optional<streaming::stream_sstable_files_chunk>>(std::move(chunk));
+            };
+            return streaming::stream_session::receive_sstable_files(e.db(), sys_dist_ks, e.view_update_generator(), dst_schema, utils::make_random_uuid(),
+                    netw::msg_addr{utils::fb_utilities::get_broadcast_address(), 0}, streaming::stream_reason::repair, std::move(source)).get0();
+        };
+        auto sstables_count = [&] (const sstring& cf_name) {
+            return e.db().map_reduce0([cf_name] (database& db) {
+                return db.find_column_family("ks", cf_name).get_sstables()->size();
+            }, size_t(0), std::plus<size_t>()).get0();
+        };
+        auto files_in_dir = [&] (const sstring& cf_name) {
+            std::vector<sstring> files;
+            lister::scan_dir(fs::path(db.find_column_family("ks", cf_name).dir()), { directory_entry_type::regular }, [&files] (fs::path parent_dir, directory_entry de) {
+                files.push_back(de.name);
+                return make_ready_future<>();
+            }).get();
+            return files;
+        };
+        auto expected_rows = [] (const std::vector<int32_t>& keys) {
+            return boost::copy_range<std::vector<std::vector<bytes_opt>>>(keys | boost::adaptors::transformed([] (int32_t k) {
+                return std::vector<bytes_opt>{int32_type->decompose(k), int32_type->decompose(k)};
+            }));
+        };
+
+        // An sstable whose data belongs to one shard is added as is on that shard.
+        {
+            e.execute_cql("create table ks.dst1 (k int, v int, primary key (k));").get();
+            auto owner = smp::count - 1;
+            std::vector<int32_t> keys;
+            for (int32_t k = 0; keys.size() < 10; ++k) {
+                if (shard_of_key(k) == owner) {
+                    keys.push_back(k);
+                }
+            }
+            auto sst = write_and_flush(keys);
+            BOOST_REQUIRE(sst->get_shards_for_this_sstable() == std::vector<unsigned>{owner});
+            // As if the sender had leveled and repaired it.
+            sst->mutate_sstable_level(2).get();
+            sst->mutate_repaired_at(1000).get();
+
+            BOOST_REQUIRE_EQUAL(receive("dst1", make_sstable_files_chunks(sst)), 1);
+            BOOST_REQUIRE_EQUAL(sstables_count("dst1"), 1);
+            e.db().invoke_on(owner, [] (database& db) {
+                auto ssts = db.find_column_family("ks", "dst1").get_sstables();
+                BOOST_REQUIRE_EQUAL(ssts->size(), 1);
+                // Received sstables are unrepaired, in level 0.
+                BOOST_REQUIRE_EQUAL((*ssts->begin())->get_sstable_level(), 0);
+                BOOST_REQUIRE(!(*ssts->begin())->is_repaired());
+            }).get();
+            // The TemporaryTOC was renamed to the TOC.
+            auto files = files_in_dir("dst1");
+            BOOST_REQUIRE_EQUAL(boost::count_if(files, [] (const sstring& name) { return boost::ends_with(name, "-TOC.txt"); }), 1);
+            BOOST_REQUIRE_EQUAL(boost::count_if(files, [] (const sstring& name) { return boost::ends_with(name, ".tmp"); }), 0);
+            assert_that(e.execute_cql("select k, v from ks.dst1;").get0())
+                .is_rows()
+                .with_rows_ignore_order(expected_rows(keys));
+        }
+
+        // An sstable whose data belongs to several shards is rewritten to
+        // sstables of each shard.
+        if (smp::count > 1) {
+            e.execute_cql("create table ks.dst2 (k int, v int, primary key (k));").get();
+            std::vector<int32_t> keys = boost::copy_range<std::vector<int32_t>>(boost::irange(0, 20));
+            auto sst = write_and_flush(keys);
+            BOOST_REQUIRE_GT(sst->get_shards_for_this_sstable().size(), 1);
+
+            BOOST_REQUIRE_EQUAL(receive("dst2", make_sstable_files_chunks(sst)), 1);
+            BOOST_REQUIRE_GT(sstables_count("dst2"), 1);
+            e.db().invoke_on_all([] (database& db) {
+                for (auto& sst : *db.find_column_family("ks", "dst2").get_sstables()) {
+                    BOOST_REQUIRE(sst->get_shards_for_this_sstable() == std::vector<unsigned>{engine().cpu_id()});
+                }
+            }).get();
+            assert_that(e.execute_cql("select k, v from ks.dst2;").get0())
+                .is_rows()
+                .with_rows_ignore_order(expected_rows(keys));
+        }
+
+        // A corrupted component fails the checksum, and the files written for
+        // the sstable are removed.
+        {
+            e.execute_cql("create table ks.dst3 (k int, v int, primary key (k));").get();
+            auto sst = write_and_flush({1, 2, 3});
+            auto chunks = make_sstable_files_chunks(sst);
+            auto data_start = boost::find_if(chunks, [] (const streaming::stream_sstable_files_chunk& c) {
+                return c.cmd == streaming::stream_sstable_files_cmd::component_start && c.name == "Data.db";
+            });
+            BOOST_REQUIRE(data_start != chunks.end());
+            auto& data = std::next(data_start)->data;
+            BOOST_REQUIRE(!data.empty());
+            data[0] ^= 1;
+
+            BOOST_REQUIRE_THROW(receive("dst3", std::move(chunks)), std::runtime_error);
+            BOOST_REQUIRE_EQUAL(sstables_count("dst3"), 0);
+            BOOST_REQUIRE(files_in_dir("dst3").empty());
+        }
+    });
+}
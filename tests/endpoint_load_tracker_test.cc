@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "service/endpoint_load_tracker.hh"
+
+using namespace std::chrono_literals;
+using clock_type = service::endpoint_load_tracker::clock_type;
+
+static const gms::inet_address a("127.0.0.1");
+static const gms::inet_address b("127.0.0.2");
+static const gms::inet_address c("127.0.0.3");
+
+BOOST_AUTO_TEST_CASE(test_unknown_endpoints_are_preferred) {
+    service::endpoint_load_tracker tracker;
+    auto now = clock_type::now();
+
+    tracker.request_sent(a);
+    tracker.request_completed(a, 1ms, {}, now);
+
+    BOOST_REQUIRE_GT(tracker.score(a, now), 0);
+    BOOST_REQUIRE_EQUAL(tracker.score(b, now), 0);
+
+    std::vector<gms::inet_address> eps{a, b};
+    tracker.sort_by_score(eps.begin(), eps.end(), now);
+    BOOST_REQUIRE(eps == std::vector<gms::inet_address>({b, a}));
+}
+
+BOOST_AUTO_TEST_CASE(test_slow_and_loaded_endpoints_are_ranked_last) {
+    service::endpoint_load_tracker tracker;
+    auto now = clock_type::now();
+
+    for (auto ep : {a, b, c}) {
+        tracker.request_sent(ep);
+    }
+    tracker.request_completed(a, 10ms, {}, now);
+    tracker.request_completed(b, 1ms, {}, now);
+    tracker.request_completed(c, 1ms, 4, now);
+
+    std::vector<gms::inet_address> eps{a, b, c};
+    tracker.sort_by_score(eps.begin(), eps.end(), now);
+    BOOST_REQUIRE(eps == std::vector<gms::inet_address>({b, a, c}));
+
+    // Outstanding requests count against an endpoint too.
+    for (int i = 0; i < 3; ++i) {
+        tracker.request_sent(b);
+    }
+    tracker.sort_by_score(eps.begin(), eps.end(), now);
+    BOOST_REQUIRE(eps == std::vector<gms::inet_address>({a, b, c}));
+}
+
+BOOST_AUTO_TEST_CASE(test_stale_statistics_are_ignored) {
+    service::endpoint_load_tracker tracker(0.75, 1s);
+    auto now = clock_type::now();
+
+    tracker.request_sent(a);
+    tracker.request_completed(a, 10ms, 100, now);
+    BOOST_REQUIRE_GT(tracker.score(a, now), 0);
+    BOOST_REQUIRE_EQUAL(tracker.score(a, now + 2s), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_stale_endpoint_with_outstanding_requests_is_not_preferred) {
+    service::endpoint_load_tracker tracker(0.75, 1s);
+    auto now = clock_type::now();
+
+    for (auto ep : {a, b}) {
+        tracker.request_sent(ep);
+        tracker.request_completed(ep, 1ms, {}, now);
+    }
+    // a hangs: its statistics go stale while a request is outstanding.
+    tracker.request_sent(a);
+    tracker.request_sent(b);
+    tracker.request_completed(b, 1ms, {}, now + 2s);
+
+    BOOST_REQUIRE_GT(tracker.score(a, now + 2s), tracker.score(b, now + 2s));
+    std::vector<gms::inet_address> eps{a, b};
+    tracker.sort_by_score(eps.begin(), eps.end(), now + 2s);
+    BOOST_REQUIRE(eps == std::vector<gms::inet_address>({b, a}));
+}
+
+BOOST_AUTO_TEST_CASE(test_failed_request_counts_as_slow_response) {
+    service::endpoint_load_tracker tracker(0.75, 1s, 1s);
+    auto now = clock_type::now();
+
+    for (auto ep : {a, b}) {
+        tracker.request_sent(ep);
+        tracker.request_completed(ep, 1ms, {}, now);
+    }
+    // A request to a which fails right away, e.g. because a is down.
+    tracker.request_sent(a);
+    tracker.request_failed(a, 0ms, now);
+
+    BOOST_REQUIRE_GT(tracker.score(a, now), tracker.score(b, now));
+    BOOST_REQUIRE_GT(tracker.score(a, now + 500ms), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_abandoned_request_is_not_outstanding) {
+    service::endpoint_load_tracker tracker;
+    auto now = clock_type::now();
+
+    tracker.request_sent(a);
+    tracker.request_completed(a, 1ms, {}, now);
+    auto idle_score = tracker.score(a, now);
+
+    {
+        auto req = tracker.start_request(a);
+        BOOST_REQUIRE_GT(tracker.score(a, now), idle_score);
+    }
+    // The abandoned request counts as a slow response, not as outstanding.
+    auto req = tracker.start_request(a);
+    req.complete();
+    tracker.request_sent(b);
+    tracker.request_completed(b, 1ms, {}, now);
+    BOOST_REQUIRE_GT(tracker.score(a), tracker.score(b));
+}
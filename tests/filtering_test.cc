@@ -39,6 +39,7 @@
 #include "types/list.hh"
 #include "types/set.hh"
 #include "types/map.hh"
+#include "query_row_filter.hh"
 
 using namespace std::literals::chrono_literals;
 
@@ -1160,3 +1161,132 @@ SEASTAR_TEST_CASE(test_filtering) {
 
     });
 }
+
+SEASTAR_TEST_CASE(test_filtering_on_replicas) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        cquery_nofail(e, "CREATE TABLE t (p int, c int, s int static, v int, w text, PRIMARY KEY(p, c))");
+        for (int p = 0; p < 4; ++p) {
+            cquery_nofail(e, format("INSERT INTO t (p, s) VALUES ({}, {})", p, p).c_str());
+            for (int c = 0; c < 5; ++c) {
+                if (c == 4) {
+                    // A row without v, which no restriction on v matches.
+                    cquery_nofail(e, format("INSERT INTO t (p, c, w) VALUES ({}, {}, 'x')", p, c).c_str());
+                } else {
+                    cquery_nofail(e, format("INSERT INTO t (p, c, v, w) VALUES ({}, {}, {}, '{}')", p, c, p * 10 + c, c % 2 ? "odd" : "even").c_str());
+                }
+            }
+        }
+        // A partition with a static row only.
+        cquery_nofail(e, "INSERT INTO t (p, s) VALUES (4, 4)");
+
+        auto& stats = e.local_qp().get_cql_stats();
+        auto require_rows_read = [&] (const char* query, int64_t expected_rows) {
+            auto rows_read = stats.filtered_rows_read_total;
+            auto msg = cquery_nofail(e, query);
+            assert_that(msg).is_rows().with_size(expected_rows);
+            // The replica returned only the matching rows.
+            BOOST_REQUIRE_EQUAL(stats.filtered_rows_read_total - rows_read, expected_rows);
+            return msg;
+        };
+
+        assert_that(require_rows_read("SELECT p, c FROM t WHERE v = 12 ALLOW FILTERING", 1)).is_rows().with_rows({
+            {int32_type->decompose(1), int32_type->decompose(2)},
+        });
+        assert_that(require_rows_read("SELECT p, c FROM t WHERE v > 10 AND v <= 21 ALLOW FILTERING", 5)).is_rows().with_rows_ignore_order({
+            {int32_type->decompose(1), int32_type->decompose(1)},
+            {int32_type->decompose(1), int32_type->decompose(2)},
+            {int32_type->decompose(1), int32_type->decompose(3)},
+            {int32_type->decompose(2), int32_type->decompose(0)},
+            {int32_type->decompose(2), int32_type->decompose(1)},
+        });
+        assert_that(require_rows_read("SELECT p, c FROM t WHERE v IN (3, 33, 34) ALLOW FILTERING", 2)).is_rows().with_rows_ignore_order({
+            {int32_type->decompose(0), int32_type->decompose(3)},
+            {int32_type->decompose(3), int32_type->decompose(3)},
+        });
+        require_rows_read("SELECT p, c FROM t WHERE w = 'odd' AND v < 20 ALLOW FILTERING", 4);
+
+        // Restrictions the replicas can't evaluate are still applied.
+        assert_that(cquery_nofail(e, "SELECT p, c FROM t WHERE v < 20 AND s = 1 ALLOW FILTERING")).is_rows().with_size(4);
+        assert_that(cquery_nofail(e, "SELECT p, c FROM t WHERE w LIKE 'od%' AND v < 10 ALLOW FILTERING")).is_rows().with_size(2);
+
+        // Rows dropped by the replica don't count against the limit.
+        assert_that(cquery_nofail(e, "SELECT p, c FROM t WHERE v > 30 LIMIT 2 ALLOW FILTERING")).is_rows().with_size(2);
+    });
+}
+
+SEASTAR_TEST_CASE(test_filtering_skips_partitions_by_sstable_value_ranges) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        // A low false positive chance, so that the bloom filters reliably tell which sstables hold a partition.
+        cquery_nofail(e, "CREATE TABLE t (p int, c int, v int, PRIMARY KEY(p, c)) WITH bloom_filter_fp_chance = 0.001");
+        auto flush = [&] {
+            e.db().invoke_on_all([] (database& db) {
+                return db.flush_all_memtables();
+            }).get();
+        };
+        auto skipped_partitions = [&] {
+            return e.db().map_reduce0([] (database& db) {
+                return db.find_column_family("ks", "t").cf_stats()->skipped_filtered_partitions;
+            }, int64_t(0), std::plus<int64_t>()).get0();
+        };
+
+        // Partitions 0-4 have values 0-44 and partitions 5-9 values 50-94,
+        // in separate sstables.
+        for (int p = 0; p < 10; ++p) {
+            for (int c = 0; c < 5; ++c) {
+                cquery_nofail(e, format("INSERT INTO t (p, c, v) VALUES ({}, {}, {})", p, c, p * 10 + c).c_str());
+            }
+            if (p == 4 || p == 9) {
+                flush();
+            }
+        }
+
+        auto skipped = skipped_partitions();
+        assert_that(cquery_nofail(e, "SELECT p, c FROM t WHERE v = 12 ALLOW FILTERING")).is_rows().with_rows({
+            {int32_type->decompose(1), int32_type->decompose(2)},
+        });
+        BOOST_REQUIRE_EQUAL(skipped_partitions(), skipped + 5);
+
+        // A newer value in an sstable whose range doesn't include 12 still
+        // shadows the older matching one.
+        cquery_nofail(e, "INSERT INTO t (p, c, v) VALUES (1, 2, 70)");
+        flush();
+        assert_that(cquery_nofail(e, "SELECT p, c FROM t WHERE v = 12 ALLOW FILTERING")).is_rows().with_size(0);
+        assert_that(cquery_nofail(e, "SELECT p, c FROM t WHERE v >= 70 AND v < 72 ALLOW FILTERING")).is_rows().with_rows_ignore_order({
+            {int32_type->decompose(1), int32_type->decompose(2)},
+            {int32_type->decompose(7), int32_type->decompose(0)},
+            {int32_type->decompose(7), int32_type->decompose(1)},
+        });
+
+        // Partitions in memtables are never skipped.
+        cquery_nofail(e, "INSERT INTO t (p, c, v) VALUES (8, 0, 12)");
+        assert_that(cquery_nofail(e, "SELECT p, c FROM t WHERE v = 12 ALLOW FILTERING")).is_rows().with_rows({
+            {int32_type->decompose(8), int32_type->decompose(0)},
+        });
+    });
+}
+
+SEASTAR_TEST_CASE(test_filtering_on_replicas_bounds_rows_skipped_per_page) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        cquery_nofail(e, "CREATE TABLE t (p int, c int, v int, PRIMARY KEY(p, c))");
+        const int rejected = query::max_filtered_out_rows_per_page + 5;
+        for (int c = 0; c < rejected; c += 1000) {
+            sstring batch = "BEGIN UNLOGGED BATCH\n";
+            for (int i = c; i < std::min(c + 1000, rejected); ++i) {
+                batch += format("INSERT INTO t (p, c, v) VALUES (0, {}, 0);\n", i);
+            }
+            batch += "APPLY BATCH;";
+            cquery_nofail(e, batch.c_str());
+        }
+        cquery_nofail(e, format("INSERT INTO t (p, c, v) VALUES (0, {}, 1)", rejected).c_str());
+
+        auto& stats = e.local_qp().get_cql_stats();
+        auto rows_read = stats.filtered_rows_read_total;
+        auto msg = cquery_nofail(e, "SELECT c FROM t WHERE v = 1 ALLOW FILTERING");
+        assert_that(msg).is_rows().with_rows({
+            {int32_type->decompose(rejected)},
+        });
+        // The replica ended a page with the last of the rows it could skip,
+        // which the coordinator dropped.
+        BOOST_REQUIRE_EQUAL(stats.filtered_rows_read_total - rows_read, int64_t(2));
+    });
+}
@@ -434,3 +434,30 @@ BOOST_AUTO_TEST_CASE(test_dollar) {
     BOOST_TEST(matches(matcher(u8"a$bc"), u8"a$bc"));
     BOOST_TEST(matches(matcher(u8R"(a\$bc)"), u8"a$bc"));
 }
+
+BOOST_AUTO_TEST_CASE(test_prefix_and_suffix_dont_overlap) {
+    auto m = matcher(u8"ab%ba");
+    BOOST_TEST(matches(m, u8"abba"));
+    BOOST_TEST(matches(m, u8"abШba"));
+    BOOST_TEST(!matches(m, u8"aba"));
+    BOOST_TEST(!matches(m, u8"ab"));
+
+    auto mid = matcher(u8"ab%b%ba");
+    BOOST_TEST(matches(mid, u8"abbba"));
+    BOOST_TEST(!matches(mid, u8"abba"));
+}
+
+BOOST_AUTO_TEST_CASE(test_both_wildcards) {
+    auto m = matcher(u8"%a_c%");
+    BOOST_TEST(matches(m, u8"abc"));
+    BOOST_TEST(matches(m, u8"ШaШcШ"));
+    BOOST_TEST(matches(m, u8"aacc"));
+    BOOST_TEST(!matches(m, u8"ac"));
+    BOOST_TEST(!matches(m, u8"abbc"));
+}
+
+BOOST_AUTO_TEST_CASE(test_underscore_truncated_utf8) {
+    auto m = matcher(u8"a_");
+    BOOST_TEST(!matches(m, "a\xd0"));
+    BOOST_TEST(!matches(m, "a\x98"));
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/unit_test.hpp>
+#include <set>
+
+#include "message/messaging_service.hh"
+
+using msg_addr = netw::messaging_service::msg_addr;
+
+static const gms::inet_address ep("127.0.0.1");
+
+BOOST_AUTO_TEST_CASE(test_unresolved_address_uses_any_shard_slot) {
+    BOOST_REQUIRE_EQUAL(netw::messaging_service::shard_slot(msg_addr(ep), 4), 0u);
+    // A cpu id alone, as in msg_addr{ep, 0}, does not pin the connection.
+    BOOST_REQUIRE_EQUAL(netw::messaging_service::shard_slot(msg_addr{ep, 0}, 4), 0u);
+    BOOST_REQUIRE_EQUAL(netw::messaging_service::shard_slot(msg_addr{ep, 3}, 4), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_resolved_address_uses_shard_slot) {
+    BOOST_REQUIRE_EQUAL(netw::messaging_service::shard_slot(msg_addr::for_shard(ep, 0), 4), 1u);
+    BOOST_REQUIRE_EQUAL(netw::messaging_service::shard_slot(msg_addr::for_shard(ep, 3), 4), 4u);
+    // Shards beyond the known shard count wrap around.
+    BOOST_REQUIRE_EQUAL(netw::messaging_service::shard_slot(msg_addr::for_shard(ep, 5), 4), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(test_unknown_shard_count_uses_any_shard_slot) {
+    BOOST_REQUIRE_EQUAL(netw::messaging_service::shard_slot(msg_addr::for_shard(ep, 1), 0), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_shard_resolution_does_not_affect_address_equality) {
+    BOOST_REQUIRE(msg_addr(ep) == msg_addr::for_shard(ep, 2));
+    BOOST_REQUIRE_EQUAL(msg_addr::hash()(msg_addr(ep)), msg_addr::hash()(msg_addr::for_shard(ep, 2)));
+}
+
+BOOST_AUTO_TEST_CASE(test_source_port_leads_to_shard) {
+    for (unsigned shard_count : {1u, 3u, 16u, 64u}) {
+        for (unsigned shard = 0; shard < shard_count; ++shard) {
+            for (unsigned attempt = 0; attempt < 1000; ++attempt) {
+                auto port = netw::messaging_service::source_port_for_shard(shard, shard_count, 5, 8, attempt);
+                BOOST_REQUIRE_EQUAL(port % shard_count, shard);
+                BOOST_REQUIRE_GE(port, 32768);
+                BOOST_REQUIRE_LE(port, 60999);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_source_ports_differ_between_local_shards_and_attempts) {
+    std::set<uint16_t> ports;
+    for (unsigned local_shard = 0; local_shard < 4; ++local_shard) {
+        for (unsigned attempt = 0; attempt < 10; ++attempt) {
+            auto inserted = ports.insert(netw::messaging_service::source_port_for_shard(2, 8, local_shard, 4, attempt)).second;
+            BOOST_REQUIRE(inserted);
+        }
+    }
+}
@@ -36,6 +36,7 @@
 #include "tests/mutation_source_test.hh"
 
 #include "mutation_query.hh"
+#include "repair/repair.hh"
 #include <seastar/core/do_with.hh>
 #include <seastar/core/thread.hh>
 #include "schema_builder.hh"
@@ -549,3 +550,84 @@ SEASTAR_THREAD_TEST_CASE(test_result_size_calculation) {
     BOOST_REQUIRE_EQUAL(digest_only_builder.memory_accounter().used_memory(), result_and_digest_builder.memory_accounter().used_memory());
 }
 
+
+SEASTAR_THREAD_TEST_CASE(test_row_hashes_read_from_source_match_mutation_hashes) {
+    random_mutation_generator gen(random_mutation_generator::generate_counters::no);
+    schema_ptr s = gen.schema();
+    auto slice = make_full_slice(*s);
+    auto now = gc_clock::now();
+
+    for (int i = 0; i < 10; ++i) {
+        mutation_source source = make_source({gen()});
+        reconcilable_result result = mutation_query(s, source,
+            query::full_partition_range, slice, query::max_rows, query::max_partitions, now).get0();
+        partition_row_hashes hashes = query_partition_row_hashes(s, source,
+            query::full_partition_range, slice, query::max_rows, now, nullptr, db::no_timeout).get0();
+
+        if (result.partitions().empty()) {
+            BOOST_REQUIRE(hashes.rows.empty());
+            continue;
+        }
+        auto expected = hash_partition_rows(*s, result.partitions().front().mut().unfreeze(s));
+        BOOST_REQUIRE(hashes.partition_hash == expected.partition_hash);
+        BOOST_REQUIRE_EQUAL(hashes.rows.size(), expected.rows.size());
+        for (size_t j = 0; j < hashes.rows.size(); ++j) {
+            BOOST_REQUIRE(hashes.rows[j].key.equal(*s, expected.rows[j].key));
+            BOOST_REQUIRE(hashes.rows[j].hash == expected.rows[j].hash);
+        }
+    }
+}
+
+SEASTAR_THREAD_TEST_CASE(test_diverging_rows) {
+    auto s = make_schema();
+    auto now = gc_clock::now();
+    auto slice = make_full_slice(*s);
+    auto pk = partition_key::from_single_value(*s, "key1");
+    auto ck = [&] (const char* v) {
+        return clustering_key::from_single_value(*s, bytes(v));
+    };
+    auto hash = [&] (const mutation& m) {
+        return query_partition_row_hashes(s, make_source({m}),
+            query::full_partition_range, slice, query::max_rows, now, nullptr, db::no_timeout).get0();
+    };
+
+    mutation m1(s, pk);
+    m1.set_static_cell("s1", data_value(bytes("s1:v")), 1);
+    m1.set_clustered_cell(ck("A"), "v1", data_value(bytes("A:v")), 1);
+    m1.set_clustered_cell(ck("B"), "v1", data_value(bytes("B:v")), 1);
+    m1.set_clustered_cell(ck("C"), "v1", data_value(bytes("C:v")), 1);
+
+    // B was overwritten and C is missing.
+    mutation m2(s, pk);
+    m2.set_static_cell("s1", data_value(bytes("s1:v")), 1);
+    m2.set_clustered_cell(ck("A"), "v1", data_value(bytes("A:v")), 1);
+    m2.set_clustered_cell(ck("B"), "v1", data_value(bytes("B:v2")), 2);
+
+    auto h1 = hash(m1);
+    auto h2 = hash(m2);
+    BOOST_REQUIRE(h1.partition_hash == h2.partition_hash);
+    BOOST_REQUIRE_EQUAL(h1.rows.size(), 3);
+    BOOST_REQUIRE_EQUAL(h2.rows.size(), 2);
+    BOOST_REQUIRE(h1.rows[0].hash == h2.rows[0].hash);
+    BOOST_REQUIRE(h1.rows[1].hash != h2.rows[1].hash);
+
+    auto agreed = diverging_rows(*s, {h1, hash(m1)});
+    BOOST_REQUIRE(agreed);
+    BOOST_REQUIRE(agreed->empty());
+
+    auto ranges = diverging_rows(*s, {h1, h2});
+    BOOST_REQUIRE(ranges);
+    BOOST_REQUIRE_EQUAL(ranges->size(), 2);
+    BOOST_REQUIRE((*ranges)[0].is_singular());
+    BOOST_REQUIRE((*ranges)[0].start()->value().equal(*s, ck("B")));
+    BOOST_REQUIRE((*ranges)[1].is_singular());
+    BOOST_REQUIRE((*ranges)[1].start()->value().equal(*s, ck("C")));
+
+    // Partition-level data can't be repaired row by row.
+    mutation m3(m1);
+    m3.set_static_cell("s1", data_value(bytes("s1:v2")), 2);
+    auto h3 = hash(m3);
+    BOOST_REQUIRE(h3.partition_hash != h1.partition_hash);
+    BOOST_REQUIRE(h3.rows.size() == h1.rows.size());
+    BOOST_REQUIRE(!diverging_rows(*s, {h1, h3}));
+}
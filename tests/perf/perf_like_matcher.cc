@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ *
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <seastar/tests/perf/perf_tests.hh>
+#include <seastar/testing/test_runner.hh>
+
+#include <boost/regex/icu.hpp>
+#include <cstring>
+#include <random>
+
+#include "utils/like_matcher.hh"
+
+// Compares like_matcher with matching the equivalent boost::u32regex, which
+// is what like_matcher used to do for every pattern.
+class like {
+public:
+    static constexpr size_t count = 1000;
+private:
+    std::vector<bytes> _texts;
+public:
+    like() {
+        static const std::vector<const char*> alphabet = {
+            u8"a", u8"b", u8"c", u8"d", u8"e", u8"f", u8"g", u8"h", u8" ", u8"Ш", u8"ж",
+        };
+        auto eng = seastar::testing::local_random_engine;
+        auto len_dist = std::uniform_int_distribution<size_t>(8, 64);
+        auto char_dist = std::uniform_int_distribution<size_t>(0, alphabet.size() - 1);
+        _texts.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            std::string text;
+            for (auto len = len_dist(eng); len; --len) {
+                text += alphabet[char_dist(eng)];
+            }
+            _texts.emplace_back(reinterpret_cast<const int8_t*>(text.data()), text.size());
+        }
+    }
+
+    size_t run(const like_matcher& m) const {
+        for (auto& text : _texts) {
+            perf_tests::do_not_optimize(m(text));
+        }
+        return count;
+    }
+
+    size_t run(const boost::u32regex& re) const {
+        for (auto& text : _texts) {
+            perf_tests::do_not_optimize(boost::u32regex_match(text.begin(), text.end(), re));
+        }
+        return count;
+    }
+};
+
+static like_matcher make_matcher(const char* pattern) {
+    return like_matcher(bytes(reinterpret_cast<const int8_t*>(pattern), std::strlen(pattern)));
+}
+
+static boost::u32regex make_regex(const char* re) {
+    return boost::make_u32regex(re, boost::u32regex::basic | boost::u32regex::optimize);
+}
+
+PERF_TEST_F(like, exact_like_matcher) {
+    static const auto m = make_matcher(u8"abc deШ");
+    return run(m);
+}
+
+PERF_TEST_F(like, exact_regex) {
+    static const auto re = make_regex(u8"abc deШ");
+    return run(re);
+}
+
+PERF_TEST_F(like, prefix_like_matcher) {
+    static const auto m = make_matcher(u8"ab%");
+    return run(m);
+}
+
+PERF_TEST_F(like, prefix_regex) {
+    static const auto re = make_regex(u8"ab.*");
+    return run(re);
+}
+
+PERF_TEST_F(like, suffix_like_matcher) {
+    static const auto m = make_matcher(u8"%ж");
+    return run(m);
+}
+
+PERF_TEST_F(like, suffix_regex) {
+    static const auto re = make_regex(u8".*ж");
+    return run(re);
+}
+
+PERF_TEST_F(like, contains_like_matcher) {
+    static const auto m = make_matcher(u8"%cШd%");
+    return run(m);
+}
+
+PERF_TEST_F(like, contains_regex) {
+    static const auto re = make_regex(u8".*cШd.*");
+    return run(re);
+}
+
+PERF_TEST_F(like, single_chars_like_matcher) {
+    static const auto m = make_matcher(u8"a_c_______");
+    return run(m);
+}
+
+PERF_TEST_F(like, single_chars_regex) {
+    static const auto re = make_regex(u8"a.c.......");
+    return run(re);
+}
+
+PERF_TEST_F(like, mixed_like_matcher) {
+    static const auto m = make_matcher(u8"%a_c%");
+    return run(m);
+}
+
+PERF_TEST_F(like, mixed_regex) {
+    static const auto re = make_regex(u8".*a.c.*");
+    return run(re);
+}
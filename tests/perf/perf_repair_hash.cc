@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <seastar/tests/perf/perf_tests.hh>
+#include <seastar/testing/test_runner.hh>
+
+#include <iterator>
+#include <random>
+#include <unordered_set>
+
+#include "repair/hash_set.hh"
+#include "tests/simple_schema.hh"
+#include "xx_hasher.hh"
+
+// Hashing of rows the way row level repair feeds them to the hasher, with
+// the XXH64 hasher repair used to use and the XXH3 one.
+class repair_row_hashing {
+    simple_schema _schema;
+    mutation _rows;
+public:
+    static constexpr size_t nr_rows = 1000;
+
+    repair_row_hashing()
+        : _rows(_schema.schema(), _schema.make_pkey(0)) {
+        for (uint32_t i = 0; i < nr_rows; ++i) {
+            _schema.add_row(_rows, _schema.make_ckey(i), format("value{:d}", i));
+        }
+    }
+
+    template <typename Hasher>
+    size_t run() const {
+        Hasher h(0x1234);
+        feed_hash(h, _rows);
+        perf_tests::do_not_optimize(h.finalize_uint64());
+        return nr_rows;
+    }
+};
+
+PERF_TEST_F(repair_row_hashing, xxh64) {
+    return run<xx_hasher>();
+}
+
+PERF_TEST_F(repair_row_hashing, xxh3) {
+    return run<xxh3_hasher>();
+}
+
+// Building row hash sets and finding the hashes one set has and the other
+// does not, with std::unordered_set, which repair used to use, and with
+// repair_hash_set. The sets differ by about 1%.
+class repair_hash_diff {
+    std::vector<repair_hash> _x;
+    std::vector<repair_hash> _y;
+    std::unordered_set<repair_hash> _unordered_x;
+    std::unordered_set<repair_hash> _unordered_y;
+    repair_hash_set _flat_x;
+    repair_hash_set _flat_y;
+public:
+    static constexpr size_t nr_hashes = 1000000;
+
+    repair_hash_diff() {
+        auto& eng = seastar::testing::local_random_engine;
+        auto dist = std::uniform_int_distribution<uint64_t>();
+        for (size_t i = 0; i < nr_hashes; ++i) {
+            auto h = repair_hash(dist(eng));
+            auto which = dist(eng) % 200;
+            if (which) {
+                _x.push_back(h);
+            }
+            if (which != 1) {
+                _y.push_back(h);
+            }
+        }
+        _unordered_x.insert(_x.begin(), _x.end());
+        _unordered_y.insert(_y.begin(), _y.end());
+        _flat_x.insert(_x.begin(), _x.end());
+        _flat_y.insert(_y.begin(), _y.end());
+    }
+
+    size_t build_unordered() const {
+        std::unordered_set<repair_hash> set;
+        for (auto& h : _x) {
+            set.emplace(h);
+        }
+        perf_tests::do_not_optimize(set);
+        return _x.size();
+    }
+
+    size_t build_flat() const {
+        repair_hash_set set;
+        for (auto& h : _x) {
+            set.emplace(h);
+        }
+        perf_tests::do_not_optimize(set);
+        return _x.size();
+    }
+
+    size_t diff_unordered() const {
+        std::unordered_set<repair_hash> set_diff;
+        std::copy_if(_unordered_x.begin(), _unordered_x.end(), std::inserter(set_diff, set_diff.end()),
+                [this] (auto& item) { return _unordered_y.find(item) == _unordered_y.end(); });
+        perf_tests::do_not_optimize(set_diff);
+        return _unordered_x.size();
+    }
+
+    size_t diff_flat() const {
+        auto set_diff = _flat_x.difference(_flat_y);
+        perf_tests::do_not_optimize(set_diff);
+        return _flat_x.size();
+    }
+};
+
+PERF_TEST_F(repair_hash_diff, build_unordered_set) {
+    return build_unordered();
+}
+
+PERF_TEST_F(repair_hash_diff, build_repair_hash_set) {
+    return build_flat();
+}
+
+PERF_TEST_F(repair_hash_diff, difference_unordered_set) {
+    return diff_unordered();
+}
+
+PERF_TEST_F(repair_hash_diff, difference_repair_hash_set) {
+    return diff_flat();
+}
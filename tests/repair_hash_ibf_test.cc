@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+
+#include "repair/hash_ibf.hh"
+
+static repair_hash_set random_hashes(std::mt19937_64& rnd, size_t n) {
+    repair_hash_set hashes;
+    while (hashes.size() < n) {
+        hashes.emplace(rnd());
+    }
+    return hashes;
+}
+
+static repair_hash_ibf make_ibf(const repair_hash_set& hashes, size_t nr_cells) {
+    repair_hash_ibf ibf(nr_cells);
+    for (auto& h : hashes) {
+        ibf.add(h);
+    }
+    return ibf;
+}
+
+BOOST_AUTO_TEST_CASE(test_identical_sets_have_no_difference) {
+    std::mt19937_64 rnd(1);
+    auto hashes = random_hashes(rnd, 10000);
+    auto ibf = make_ibf(hashes, repair_hash_ibf::cells_for_differences(0));
+    ibf.subtract(make_ibf(hashes, ibf.size()));
+    auto diff = ibf.decode();
+    BOOST_REQUIRE(diff);
+    BOOST_REQUIRE(diff->only_local.empty());
+    BOOST_REQUIRE(diff->only_remote.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_difference_is_decoded) {
+    std::mt19937_64 rnd(2);
+    for (size_t nr_differences : {1, 10, 100, 1000}) {
+        auto common = random_hashes(rnd, 10000);
+        auto local = common;
+        auto remote = common;
+        repair_hash_set only_local;
+        repair_hash_set only_remote;
+        for (auto& h : random_hashes(rnd, nr_differences)) {
+            if (h.hash % 2) {
+                only_local.insert(h);
+                local.insert(h);
+            } else {
+                only_remote.insert(h);
+                remote.insert(h);
+            }
+        }
+
+        auto ibf = make_ibf(local, repair_hash_ibf::cells_for_differences(nr_differences));
+        ibf.subtract(make_ibf(remote, ibf.size()));
+        auto diff = ibf.decode();
+        BOOST_REQUIRE(diff);
+        BOOST_REQUIRE(diff->only_local == only_local);
+        BOOST_REQUIRE(diff->only_remote == only_remote);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_too_large_difference_is_detected) {
+    std::mt19937_64 rnd(3);
+    auto local = random_hashes(rnd, 1000);
+    auto remote = random_hashes(rnd, 1000);
+    auto ibf = make_ibf(local, repair_hash_ibf::cells_for_differences(10));
+    ibf.subtract(make_ibf(remote, ibf.size()));
+    BOOST_REQUIRE(!ibf.decode());
+}
+
+BOOST_AUTO_TEST_CASE(test_ibfs_of_different_sizes_can_not_be_subtracted) {
+    repair_hash_ibf a(30);
+    repair_hash_ibf b(60);
+    BOOST_REQUIRE_THROW(a.subtract(b), std::runtime_error);
+    BOOST_REQUIRE_THROW(repair_hash_ibf(std::vector<repair_hash_ibf_cell>(4)), std::runtime_error);
+}
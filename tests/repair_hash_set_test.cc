@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_MODULE core
+
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+#include <unordered_set>
+
+#include "repair/hash_set.hh"
+
+static void check_same(const repair_hash_set& set, const std::unordered_set<repair_hash>& expected) {
+    BOOST_REQUIRE_EQUAL(set.size(), expected.size());
+    BOOST_REQUIRE_EQUAL(set.empty(), expected.empty());
+    size_t nr_iterated = 0;
+    for (auto& h : set) {
+        BOOST_REQUIRE(expected.count(h));
+        ++nr_iterated;
+    }
+    BOOST_REQUIRE_EQUAL(nr_iterated, expected.size());
+    for (auto& h : expected) {
+        BOOST_REQUIRE(set.contains(h));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_insert_erase_and_lookup) {
+    std::mt19937_64 rnd(1);
+    repair_hash_set set;
+    std::unordered_set<repair_hash> expected;
+    check_same(set, expected);
+    BOOST_REQUIRE(!set.contains(repair_hash(1)));
+    BOOST_REQUIRE(!set.erase(repair_hash(1)));
+
+    for (int i = 0; i < 100000; ++i) {
+        // Draw from a small range, so that the same hashes keep coming
+        // back, including zero.
+        auto h = repair_hash(rnd() % 20000);
+        if (rnd() % 3) {
+            BOOST_REQUIRE_EQUAL(set.insert(h), expected.insert(h).second);
+        } else {
+            BOOST_REQUIRE_EQUAL(set.erase(h), expected.erase(h));
+        }
+        BOOST_REQUIRE_EQUAL(set.contains(h), bool(expected.count(h)));
+    }
+    check_same(set, expected);
+
+    set.clear();
+    expected.clear();
+    check_same(set, expected);
+    BOOST_REQUIRE(set.insert(repair_hash(0)));
+    BOOST_REQUIRE(!set.insert(repair_hash(0)));
+    expected.insert(repair_hash(0));
+    check_same(set, expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_colliding_hashes) {
+    // Hashes which differ only in their low bits, and ones which differ only
+    // in their high bits.
+    repair_hash_set set;
+    std::unordered_set<repair_hash> expected;
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        for (auto h : {repair_hash(i), repair_hash(i << 48)}) {
+            set.insert(h);
+            expected.insert(h);
+        }
+    }
+    check_same(set, expected);
+    for (uint64_t i = 1; i <= 1000; i += 2) {
+        BOOST_REQUIRE_EQUAL(set.erase(repair_hash(i << 48)), 1);
+        expected.erase(repair_hash(i << 48));
+    }
+    check_same(set, expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_difference) {
+    std::mt19937_64 rnd(2);
+    repair_hash_set x;
+    repair_hash_set y;
+    std::unordered_set<repair_hash> expected;
+    for (int i = 0; i < 50000; ++i) {
+        auto h = repair_hash(rnd());
+        switch (rnd() % 3) {
+        case 0:
+            x.insert(h);
+            expected.insert(h);
+            break;
+        case 1:
+            y.insert(h);
+            break;
+        default:
+            x.insert(h);
+            y.insert(h);
+        }
+    }
+    x.insert(repair_hash(0));
+    expected.insert(repair_hash(0));
+
+    check_same(x.difference(y), expected);
+    check_same(x.difference(repair_hash_set()), std::unordered_set<repair_hash>(x.begin(), x.end()));
+    check_same(repair_hash_set().difference(x), {});
+
+    // Computed in pieces.
+    repair_hash_set diff;
+    for (size_t start = 0; start < x.slot_count(); start += 1000) {
+        x.difference(y, start, std::min(start + 1000, x.slot_count()), diff);
+    }
+    check_same(diff, expected);
+    BOOST_REQUIRE(diff == x.difference(y));
+    BOOST_REQUIRE(diff != y.difference(x));
+}
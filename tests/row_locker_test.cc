@@ -236,6 +236,80 @@ SEASTAR_TEST_CASE(test_block_exclusive_twice_row) {
         flock1.get0();
     });
 }
+// A lock shared by several holders should be released only when the last of
+// them is dropped.
+SEASTAR_TEST_CASE(test_block_shared_holders) {
+    return seastar::async([&] {
+        auto s = make_schema();
+        row_locker rl(s);
+        auto pk = make_pk(s, "pk1");
+        auto ck = make_ck(s, "ck1") ;
+        auto shared = std::make_shared<row_locker::lock_holder>(
+                rl.lock_ck(pk, ck, true, db::timeout_clock::time_point::max(), row_locker_stats).get0());
+        auto lock1 = row_locker::lock_holder(shared);
+        auto lock2 = row_locker::lock_holder(std::move(shared));
+        auto flock = rl.lock_ck(pk, ck, true, db::timeout_clock::time_point::max(), row_locker_stats);
+        auto ignore = [] (auto) { };
+        ignore(std::move(lock1));
+        BOOST_REQUIRE(!flock.available());
+        ignore(std::move(lock2));
+        ignore(flock.get0());
+        BOOST_REQUIRE(rl.empty() == true);
+    });
+}
+// Locking several rows at once should block on a row locked by another
+// holder, but not on the other rows of the partition, and release all the
+// rows together.
+SEASTAR_TEST_CASE(test_block_several_rows) {
+    return seastar::async([&] {
+        auto s = make_schema();
+        row_locker rl(s);
+        auto pk = make_pk(s, "pk1");
+        auto ck1 = make_ck(s, "ck1") ;
+        auto ck2 = make_ck(s, "ck2") ;
+        auto ck3 = make_ck(s, "ck3") ;
+        BOOST_REQUIRE(!rl.is_locked(pk));
+        auto lock = rl.lock_ck(pk, ck2, true, db::timeout_clock::time_point::max(), row_locker_stats).get0();
+        BOOST_REQUIRE(rl.is_locked(pk));
+        auto flock = rl.lock_cks(pk, {ck2, ck1, ck1}, true, db::timeout_clock::time_point::max(), row_locker_stats);
+        BOOST_REQUIRE(!flock.available());
+        // A row which isn't part of either lock can still be locked.
+        auto ignore = [] (auto) { };
+        ignore(rl.lock_ck(pk, ck3, true, db::timeout_clock::time_point::max(), row_locker_stats).get0());
+        ignore(std::move(lock));
+        lock = flock.get0();
+        auto flock1 = rl.lock_ck(pk, ck1, true, db::timeout_clock::time_point::max(), row_locker_stats);
+        BOOST_REQUIRE(!flock1.available());
+        ignore(std::move(lock));
+        ignore(flock1.get0());
+        BOOST_REQUIRE(rl.empty() == true);
+        BOOST_REQUIRE(!rl.is_locked(pk));
+    });
+}
+// Locking several rows must not ask for the shared partition lock again
+// while waiting for a row: an exclusive partition lock queued meanwhile would
+// then wait for the several rows' shared lock, and the rows for it.
+SEASTAR_TEST_CASE(test_block_several_rows_and_partition) {
+    return seastar::async([&] {
+        auto s = make_schema();
+        row_locker rl(s);
+        auto pk = make_pk(s, "pk1");
+        auto ck1 = make_ck(s, "ck1") ;
+        auto ck2 = make_ck(s, "ck2") ;
+        auto lock = rl.lock_ck(pk, ck1, true, db::timeout_clock::time_point::max(), row_locker_stats).get0();
+        auto flock = rl.lock_cks(pk, {ck1, ck2}, true, db::timeout_clock::time_point::max(), row_locker_stats);
+        BOOST_REQUIRE(!flock.available());
+        auto fplock = rl.lock_pk(pk, true, db::timeout_clock::time_point::max(), row_locker_stats);
+        BOOST_REQUIRE(!fplock.available());
+        auto ignore = [] (auto) { };
+        ignore(std::move(lock));
+        lock = flock.get0();
+        BOOST_REQUIRE(!fplock.available());
+        ignore(std::move(lock));
+        ignore(fplock.get0());
+        BOOST_REQUIRE(rl.empty() == true);
+    });
+}
 // Trying to lock the same partition a second time with an exclusive lock should
 // block until the first lock is released.
 SEASTAR_TEST_CASE(test_block_exclusive_twice_partition) {
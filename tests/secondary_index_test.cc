@@ -1223,3 +1223,52 @@ SEASTAR_TEST_CASE(test_computed_columns) {
         });
     });
 }
+
+// The base rows matched by an index are read partition by partition, with
+// all the rows needed from a partition fetched at once.
+SEASTAR_TEST_CASE(test_secondary_index_many_rows_per_partition) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        cquery_nofail(e, "CREATE TABLE t (p int, c int, v int, PRIMARY KEY (p, c))");
+        cquery_nofail(e, "CREATE INDEX ON t(v)");
+        std::vector<std::vector<bytes_opt>> expected_rows;
+        for (int p = 0; p < 5; ++p) {
+            for (int c = 0; c < 20; ++c) {
+                cquery_nofail(e, format("INSERT INTO t (p, c, v) VALUES ({}, {}, {})", p, c, c % 2).c_str());
+                if (c % 2 == 0) {
+                    expected_rows.push_back({int32_type->decompose(p), int32_type->decompose(c)});
+                }
+            }
+        }
+
+        eventually([&] {
+            auto msg = cquery_nofail(e, "SELECT p, c FROM t WHERE v = 0");
+            assert_that(msg).is_rows().with_rows_ignore_order(expected_rows);
+        });
+
+        // Paging through the same rows returns each of them once.
+        eventually([&] {
+            std::vector<std::vector<bytes_opt>> rows;
+            ::shared_ptr<service::pager::paging_state> paging_state;
+            bool has_more_pages = true;
+            while (has_more_pages) {
+                auto qo = std::make_unique<cql3::query_options>(db::consistency_level::LOCAL_ONE, infinite_timeout_config, std::vector<cql3::raw_value>{},
+                        cql3::query_options::specific_options{7, paging_state, {}, api::new_timestamp()});
+                auto msg = cquery_nofail(e, "SELECT p, c FROM t WHERE v = 0", std::move(qo));
+                auto res = dynamic_pointer_cast<cql_transport::messages::result_message::rows>(msg);
+                auto rs = res->rs().result_set();
+                for (auto& row : rs.rows()) {
+                    rows.push_back(row);
+                }
+                has_more_pages = res->rs().get_metadata().flags().contains(cql3::metadata::flag::HAS_MORE_PAGES);
+                if (has_more_pages) {
+                    paging_state = ::make_shared<service::pager::paging_state>(*res->rs().get_metadata().paging_state());
+                }
+            }
+            BOOST_REQUIRE_EQUAL(rows.size(), expected_rows.size());
+            std::sort(rows.begin(), rows.end());
+            auto sorted_expected = expected_rows;
+            std::sort(sorted_expected.begin(), sorted_expected.end());
+            BOOST_REQUIRE(rows == sorted_expected);
+        });
+    });
+}
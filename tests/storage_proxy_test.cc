@@ -28,6 +28,7 @@
 #include "tests/mutation_source_test.hh"
 #include "tests/result_set_assertions.hh"
 #include "service/storage_proxy.hh"
+#include "service/pager/paging_state.hh"
 #include "partition_slice_builder.hh"
 #include "schema_builder.hh"
 
@@ -112,3 +113,81 @@ SEASTAR_TEST_CASE(test_get_restricted_ranges) {
         });
     });
 }
+
+// The number of ranges a range scan reads concurrently must stay within the
+// memory budget, however few rows per range are expected.
+SEASTAR_TEST_CASE(test_range_concurrency_is_capped) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        auto& sp = service::get_local_storage_proxy();
+        const auto max = sp.max_concurrent_range_requests();
+        BOOST_REQUIRE_GE(max, 1);
+        BOOST_REQUIRE_EQUAL(sp.range_concurrency_for(1e-9, std::numeric_limits<uint32_t>::max(), 1), max);
+        BOOST_REQUIRE_EQUAL(sp.range_concurrency_for(0, std::numeric_limits<uint32_t>::max(), max), max);
+        BOOST_REQUIRE_EQUAL(sp.range_concurrency_for(0, 100, 1), std::min(2, max));
+        BOOST_REQUIRE_EQUAL(sp.range_concurrency_for(10, 100, 1), std::min(10, max));
+        BOOST_REQUIRE_EQUAL(sp.range_concurrency_for(1000, 100, 1), 1);
+    });
+}
+
+// The estimate of rows per range carried by a paging state comes from the
+// client, and is dropped when it can't be valid.
+SEASTAR_TEST_CASE(test_paging_state_drops_invalid_estimate) {
+    return seastar::async([] {
+        auto s = schema_builder("ks", "cf")
+                .with_column("pk", bytes_type, column_kind::partition_key)
+                .with_column("v", bytes_type, column_kind::regular_column)
+                .build();
+        auto make_state = [&] (std::optional<float> estimate) {
+            auto state = service::pager::paging_state(partition_key::from_single_value(*s, to_bytes("key")), std::nullopt, 100, utils::make_random_uuid(),
+                    {}, std::nullopt, 0, {}, std::nullopt, estimate);
+            return service::pager::paging_state::deserialize(state.serialize());
+        };
+        BOOST_REQUIRE(make_state(2.5)->get_estimated_result_rows_per_range() == 2.5f);
+        BOOST_REQUIRE(make_state(0)->get_estimated_result_rows_per_range() == 0.0f);
+        BOOST_REQUIRE(!make_state(std::nullopt)->get_estimated_result_rows_per_range());
+        BOOST_REQUIRE(!make_state(-1)->get_estimated_result_rows_per_range());
+        BOOST_REQUIRE(!make_state(std::numeric_limits<float>::quiet_NaN())->get_estimated_result_rows_per_range());
+        BOOST_REQUIRE(!make_state(std::numeric_limits<float>::infinity())->get_estimated_result_rows_per_range());
+    });
+}
+
+// Range scans speculate based on the latency of the sub-range reads, which
+// must not include the reads that failed.
+SEASTAR_TEST_CASE(test_range_read_latency_counts_successful_reads) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        e.execute_cql("CREATE TABLE ks.t (pk int PRIMARY KEY, v int) WITH speculative_retry = '99.0PERCENTILE'").get();
+        for (int pk = 0; pk < 10; ++pk) {
+            e.execute_cql(format("INSERT INTO ks.t (pk, v) VALUES ({}, {})", pk, pk)).get();
+        }
+        auto& cf = e.local_db().find_column_family("ks", "t");
+        auto range_reads = [&cf] {
+            return cf.get_stats().estimated_coordinator_range_read.count();
+        };
+        auto reads = [&cf] {
+            return cf.get_stats().estimated_coordinator_read.count();
+        };
+
+        auto range_reads_before = range_reads();
+        auto reads_before = reads();
+        e.execute_cql("SELECT * FROM ks.t").get();
+        BOOST_REQUIRE_GT(range_reads(), range_reads_before);
+        BOOST_REQUIRE_EQUAL(reads(), reads_before);
+
+        range_reads_before = range_reads();
+        e.execute_cql("SELECT * FROM ks.t WHERE pk = 1").get();
+        BOOST_REQUIRE_GT(reads(), reads_before);
+        BOOST_REQUIRE_EQUAL(range_reads(), range_reads_before);
+
+        // The replicas fail the read of an unknown table.
+        auto s = cf.schema();
+        auto cmd = make_lw_shared<query::read_command>(utils::make_random_uuid(), s->version(), partition_slice_builder(*s).build());
+        auto timeout = service::storage_proxy::clock_type::now() + std::chrono::seconds(10);
+        BOOST_REQUIRE_THROW(service::get_local_storage_proxy().query(s, cmd, {query::full_partition_range}, db::consistency_level::ONE,
+                service::storage_proxy::coordinator_query_options(timeout, empty_service_permit(), service::client_state::for_internal_calls())).get(),
+                std::exception);
+        BOOST_REQUIRE_EQUAL(range_reads(), range_reads_before);
+
+        // The speculation delay of range reads comes from their own latencies.
+        BOOST_REQUIRE_GE(cf.get_coordinator_range_read_latency_percentile(99.0), std::chrono::milliseconds(1));
+    });
+}
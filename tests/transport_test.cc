@@ -19,12 +19,19 @@
  * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <seastar/net/inet_address.hh>
 #include <seastar/testing/thread_test_case.hh>
 
 #include "transport/request.hh"
 #include "transport/response.hh"
+#include "exceptions/exceptions.hh"
+#include "schema_builder.hh"
+#include "service/pager/paging_state.hh"
 
 #include "random-utils.hh"
+#include "tests/cql_assertions.hh"
+#include "tests/cql_test_connection.hh"
+#include "tests/cql_test_env.hh"
 
 SEASTAR_THREAD_TEST_CASE(test_response_request_reader) {
     auto stream_id = tests::random::get_int<int16_t>();
@@ -113,3 +120,166 @@ SEASTAR_THREAD_TEST_CASE(test_response_request_reader) {
     auto received_string_map = req.read_string_map();
     BOOST_CHECK_EQUAL(received_string_map, string_unordered_map);
 }
+
+// Splits the message in buffers of at most max_size bytes, so that the
+// values it holds span several buffers, as in large requests.
+static fragmented_temporary_buffer make_fragmented_buffer(net::packet p, size_t max_size) {
+    auto total_length = p.len();
+    p.linearize();
+    auto data = p.frag(0).base;
+    std::vector<temporary_buffer<char>> buffers;
+    for (size_t pos = 0; pos < total_length; pos += max_size) {
+        buffers.emplace_back(data + pos, std::min(max_size, total_length - pos));
+    }
+    return fragmented_temporary_buffer(std::move(buffers), total_length);
+}
+
+SEASTAR_THREAD_TEST_CASE(test_request_reader_views) {
+    auto s = schema_builder("ks", "cf")
+            .with_column("pk", bytes_type, column_kind::partition_key)
+            .with_column("v", bytes_type, column_kind::regular_column)
+            .build();
+    auto res = cql_transport::response(0, cql_transport::cql_binary_opcode::QUERY, tracing::trace_state_ptr());
+
+    auto valid_string = sstring("za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87 g\xc4\x99\xc5\x9bl\xc4\x85 ja\xc5\xba\xc5\x84") + tests::random::get_sstring(64);
+    res.write_long_string(valid_string);
+    res.write_long_string(sstring("\xc3\x28"));
+    res.write_value(bytes_opt());
+    auto value = tests::random::get_bytes(1000);
+    res.write_value(bytes_opt(value));
+    auto paging_state = service::pager::paging_state(partition_key::from_single_value(*s, to_bytes("key")), std::nullopt, 100, utils::make_random_uuid(),
+            {}, std::nullopt, 0);
+    res.write_value(paging_state.serialize());
+    res.write_value(bytes_opt(bytes(2, 0)));
+
+    static constexpr auto version = 4;
+    auto fbufs = make_fragmented_buffer(res.make_message(version, cql_transport::cql_compression::none).release(), 7);
+    bytes_ostream linearization_buffer;
+    auto req = cql_transport::request_reader(fbufs.get_istream(), linearization_buffer);
+    for (auto i = 0; i < 5; ++i) {
+        req.read_byte(); // version, flags, stream and opcode
+    }
+    req.read_int();
+
+    BOOST_CHECK_EQUAL(req.read_long_string_view(), valid_string);
+    BOOST_CHECK_THROW(req.read_long_string_view(), exceptions::protocol_exception);
+    BOOST_CHECK(!req.read_bytes_view_opt());
+    auto value_view = req.read_bytes_view_opt();
+    BOOST_REQUIRE(value_view);
+    BOOST_CHECK_EQUAL(to_bytes(*value_view), value);
+
+    auto deserialized = service::pager::paging_state::deserialize(req.read_bytes_view_opt());
+    BOOST_REQUIRE(deserialized);
+    BOOST_CHECK(deserialized->get_partition_key().equal(*s, paging_state.get_partition_key()));
+    BOOST_CHECK_EQUAL(deserialized->get_remaining(), paging_state.get_remaining());
+    BOOST_CHECK(deserialized->get_query_uuid() == paging_state.get_query_uuid());
+    BOOST_CHECK_THROW(service::pager::paging_state::deserialize(req.read_bytes_view_opt()), exceptions::protocol_exception);
+}
+
+// Bound blobs are not validated, but other bound values still are.
+SEASTAR_THREAD_TEST_CASE(test_execute_with_large_bound_values) {
+    do_with_cql_env_thread([] (cql_test_env& env) {
+        env.execute_cql("CREATE TABLE ks.t (pk int PRIMARY KEY, b blob, s text)").get();
+        cql_test_server server(env);
+        auto conn = cql_test_connection::connect(socket_address(net::inet_address("127.0.0.1"), server.listen()));
+        conn.startup();
+
+        auto id = conn.prepare("INSERT INTO ks.t (pk, b, s) VALUES (?, ?, ?)");
+        auto blob = tests::random::get_bytes(256 * 1024);
+        auto text = to_bytes(tests::random::get_sstring(64 * 1024));
+        conn.execute(id, {int32_type->decompose(1), blob, text}).check_no_error();
+        auto msg = env.execute_cql("SELECT b, s FROM ks.t WHERE pk = 1").get0();
+        assert_that(msg).is_rows().with_rows({{blob, text}});
+
+        auto invalid_text = bytes(64 * 1024, 'a') + bytes(1, int8_t(0xff));
+        auto response = conn.execute(id, {int32_type->decompose(2), blob, invalid_text});
+        BOOST_REQUIRE(response.opcode == cql_transport::cql_binary_opcode::ERROR);
+        msg = env.execute_cql("SELECT b FROM ks.t WHERE pk = 2").get0();
+        assert_that(msg).is_rows().is_empty();
+        conn.close();
+    }).get();
+}
+
+SEASTAR_THREAD_TEST_CASE(test_shard_aware_port_routes_connections_by_client_port) {
+    do_with_cql_env_thread([] (cql_test_env& env) {
+        auto config = cql_test_server::make_config();
+        config.allow_shard_aware_drivers = true;
+        cql_test_server server(env, std::move(config));
+        auto server_addr = socket_address(net::inet_address("127.0.0.1"), server.listen(true));
+
+        for (unsigned shard = 0; shard < smp::count; ++shard) {
+            // Drivers pick a free client port which maps to the shard they want.
+            std::optional<cql_test_connection> conn;
+            while (!conn) {
+                auto client_port = tests::random::get_int<uint16_t>(10000, 60000) / smp::count * smp::count + shard;
+                try {
+                    conn.emplace(cql_test_connection::connect(server_addr, socket_address(net::inet_address("127.0.0.1"), client_port)));
+                } catch (const std::system_error&) {
+                    // The port is in use.
+                }
+            }
+            conn->startup();
+            auto options = conn->options();
+            BOOST_REQUIRE_EQUAL(options.count("SCYLLA_SHARD"), 1);
+            BOOST_CHECK_EQUAL(options.find("SCYLLA_SHARD")->second, format("{:d}", shard));
+            BOOST_CHECK_EQUAL(options.find("SCYLLA_NR_SHARDS")->second, format("{:d}", smp::count));
+            conn->close();
+        }
+    }).get();
+}
+
+SEASTAR_THREAD_TEST_CASE(test_zstd_compression) {
+    do_with_cql_env_thread([] (cql_test_env& env) {
+        env.execute_cql("CREATE TABLE ks.t (pk int PRIMARY KEY, v blob)").get();
+
+        auto config = cql_test_server::make_config();
+        config.compression_threshold = env.local_db().get_config().native_transport_compression_threshold();
+        BOOST_REQUIRE_EQUAL(config.compression_threshold, 512);
+        cql_test_server server(env, std::move(config));
+        auto server_addr = socket_address(net::inet_address("127.0.0.1"), server.listen());
+
+        auto conn = cql_test_connection::connect(server_addr);
+        conn.startup({{"COMPRESSION", "zstd"}});
+
+        auto is_compressed = [] (const cql_test_connection::frame& f) {
+            return bool(f.flags & cql_transport::cql_frame_flags::compression);
+        };
+        auto contains = [] (const bytes& body, const bytes& value) {
+            return std::search(body.begin(), body.end(), value.begin(), value.end()) != body.end();
+        };
+
+        // The request is larger than the threshold too, so it is compressed
+        // and the server must decompress it.
+        auto value = tests::random::get_bytes(2000);
+        auto response = conn.query(format("INSERT INTO ks.t (pk, v) VALUES (1, 0x{})", to_hex(value)));
+        response.check_no_error();
+        BOOST_REQUIRE(!is_compressed(response));
+
+        response = conn.query("SELECT v FROM ks.t WHERE pk = 1");
+        response.check_no_error();
+        BOOST_REQUIRE(is_compressed(response));
+        BOOST_REQUIRE(contains(response.body, value));
+
+        // Responses below the threshold are not worth compressing.
+        auto small_value = tests::random::get_bytes(16);
+        conn.query(format("INSERT INTO ks.t (pk, v) VALUES (2, 0x{})", to_hex(small_value))).check_no_error();
+        response = conn.query("SELECT v FROM ks.t WHERE pk = 2");
+        response.check_no_error();
+        BOOST_REQUIRE_LT(response.body.size(), 512);
+        BOOST_REQUIRE(!is_compressed(response));
+        BOOST_REQUIRE(contains(response.body, small_value));
+        conn.close();
+        server.stop();
+
+        // Without a threshold, every response of a compressed connection is.
+        config = cql_test_server::make_config();
+        cql_test_server eager_server(env, std::move(config));
+        auto eager_conn = cql_test_connection::connect(socket_address(net::inet_address("127.0.0.1"), eager_server.listen()));
+        eager_conn.startup({{"COMPRESSION", "zstd"}});
+        response = eager_conn.query("SELECT v FROM ks.t WHERE pk = 2");
+        response.check_no_error();
+        BOOST_REQUIRE(is_compressed(response));
+        BOOST_REQUIRE(contains(response.body, small_value));
+        eager_conn.close();
+    }).get();
+}
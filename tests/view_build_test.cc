@@ -302,6 +302,41 @@ SEASTAR_TEST_CASE(test_builder_across_tokens_with_small_partitions) {
     });
 }
 
+// A shard keeps up to view_building_concurrency batches of view updates in
+// flight, and must still build every row of every batch.
+SEASTAR_TEST_CASE(test_builder_with_concurrent_batches) {
+    return seastar::async([] {
+        for (uint32_t concurrency : {1u, 8u}) {
+            BOOST_TEST_MESSAGE(format("view_building_concurrency: {}", concurrency));
+            auto cfg = make_shared<db::config>();
+            cfg->view_building_concurrency(concurrency);
+            do_with_cql_env_thread([] (cql_test_env& e) {
+                e.execute_cql("create table cf (p int, c int, v int, primary key (p, c))").get();
+                // Many more rows than view_builder::batch_size.
+                for (auto p = 0; p < 500; ++p) {
+                    for (auto c = 0; c < 4; ++c) {
+                        e.execute_cql(format("insert into cf (p, c, v) values ({:d}, {:d}, {:d})", p, c, p % 10)).get();
+                    }
+                }
+
+                auto f = e.local_view_builder().wait_until_built("ks", "vcf");
+                e.execute_cql("create materialized view vcf as select * from cf "
+                              "where p is not null and c is not null and v is not null "
+                              "primary key (v, p, c)").get();
+                f.get();
+
+                auto built = db::system_keyspace::load_built_views().get0();
+                BOOST_REQUIRE_EQUAL(built.size(), 1);
+
+                for (auto v = 0; v < 10; ++v) {
+                    auto msg = e.execute_cql(format("select count(*) from vcf where v = {:d}", v)).get0();
+                    assert_that(msg).is_rows().with_rows({{{long_type->decompose(200L)}}});
+                }
+            }, cfg).get();
+        }
+    });
+}
+
 SEASTAR_TEST_CASE(test_builder_with_tombstones) {
     return do_with_cql_env_thread([] (cql_test_env& e) {
         e.execute_cql("create table cf (p int, c1 int, c2 int, v int, primary key (p, c1, c2))").get();
@@ -458,3 +493,50 @@ SEASTAR_TEST_CASE(test_view_update_generator) {
         });
     });
 }
+
+SEASTAR_TEST_CASE(test_view_update_generator_with_overlapping_staging_sstables) {
+    return do_with_cql_env_thread([] (cql_test_env& e) {
+        e.execute_cql("create table t (p text, c text, v text, primary key (p, c))").get();
+        e.execute_cql("create materialized view tv as select * from t "
+                      "where p is not null and c is not null and v is not null "
+                      "primary key (v, p, c)").get();
+        auto& view_update_generator = e.local_view_update_generator();
+        lw_shared_ptr<table> t = e.local_db().find_column_family("ks", "t").shared_from_this();
+        auto s = t->schema();
+        auto col = s->get_column_definition("v");
+        auto key = partition_key::from_exploded(*s, {to_bytes("a")});
+
+        // All the sstables hold the same partition, and are processed by a
+        // single reader.
+        std::vector<sstables::shared_sstable> ssts;
+        for (int i = 0; i < 3; ++i) {
+            mutation m(s, key);
+            for (int j = 0; j < 10; ++j) {
+                auto& row = m.partition().clustered_row(*s, clustering_key::from_exploded(*s, {to_bytes(fmt::format("c{}", i * 10 + j))}));
+                row.cells().apply(*col, atomic_cell::make_live(*col->type, 2345, col->type->decompose(sstring(fmt::format("v{}", i)))));
+            }
+            auto sst = t->make_streaming_staging_sstable();
+            sstables::sstable_writer_config sst_cfg;
+            auto& pc = service::get_local_streaming_write_priority();
+            sst->write_components(flat_mutation_reader_from_mutations({m}), 1ul, s, sst_cfg, {}, pc).get();
+            sst->open_data().get();
+            t->add_sstable_and_update_cache(sst).get();
+            ssts.push_back(sst);
+        }
+        for (auto& sst : ssts) {
+            view_update_generator.register_staging_sstable(sst, t).get();
+        }
+
+        eventually([&] {
+            for (int i = 0; i < 3; ++i) {
+                auto msg = e.execute_cql(fmt::format("SELECT * FROM tv WHERE v = 'v{}'", i)).get0();
+                assert_that(msg).is_rows().with_size(10);
+            }
+            BOOST_REQUIRE_EQUAL(view_update_generator.queued_sstables(), 0);
+            BOOST_REQUIRE_EQUAL(view_update_generator.pending_bytes(), 0);
+            for (auto& sst : ssts) {
+                BOOST_REQUIRE(!t->get_staging_sstable(sst->generation()));
+            }
+        });
+    });
+}
@@ -22,6 +22,7 @@
 
 #include <boost/test/unit_test.hpp>
 #include <boost/range/adaptor/map.hpp>
+#include <boost/range/irange.hpp>
 
 #include "database.hh"
 #include "types/user.hh"
@@ -182,6 +183,75 @@ SEASTAR_TEST_CASE(test_updates_no_read_before_update) {
     });
 }
 
+// Writes to partitions which don't exist yet shouldn't need to read the
+// base table, whether older partitions are in a memtable or in sstables.
+SEASTAR_TEST_CASE(test_updates_of_new_partitions_skip_read) {
+    return do_with_cql_env_thread([] (auto& e) {
+        // A low false positive chance, so that the bloom filter reliably tells k = 1 is absent.
+        e.execute_cql("create table base (k int, c int, v int, primary key (k, c)) with bloom_filter_fp_chance = 0.001;").get();
+        e.execute_cql("create materialized view mv as select * from base "
+                              "where k is not null and c is not null and v is not null primary key (v, k, c)").get();
+        auto skipped_reads = [&] {
+            return e.local_db().find_column_family("ks", "base").cf_stats()->skipped_view_update_reads;
+        };
+
+        auto skipped = skipped_reads();
+        e.execute_cql("insert into base (k, c, v) values (0, 0, 0);").get();
+        BOOST_REQUIRE_EQUAL(skipped_reads(), skipped + 1);
+
+        // The partition is in the memtable now.
+        e.execute_cql("insert into base (k, c, v) values (0, 0, 1);").get();
+        BOOST_REQUIRE_EQUAL(skipped_reads(), skipped + 1);
+
+        e.local_db().flush_all_memtables().get();
+        e.execute_cql("insert into base (k, c, v) values (0, 1, 2);").get();
+        BOOST_REQUIRE_EQUAL(skipped_reads(), skipped + 1);
+        e.execute_cql("insert into base (k, c, v) values (1, 0, 3);").get();
+        BOOST_REQUIRE_EQUAL(skipped_reads(), skipped + 2);
+
+        eventually([&] {
+        auto msg = e.execute_cql("select k, c from mv where v = 0").get0();
+        assert_that(msg).is_rows().with_size(0);
+        msg = e.execute_cql("select k, c from mv where v = 1").get0();
+        assert_that(msg).is_rows()
+                .with_size(1)
+                .with_row({ {int32_type->decompose(0)}, {int32_type->decompose(0)} });
+        msg = e.execute_cql("select k, c from mv where v = 3").get0();
+        assert_that(msg).is_rows()
+                .with_size(1)
+                .with_row({ {int32_type->decompose(1)}, {int32_type->decompose(0)} });
+        });
+    });
+}
+
+// Concurrent writes to a partition are coalesced, and the view updates
+// generated for the group of writes must be the same as if the writes were
+// processed one by one, whatever the order in which they are applied.
+SEASTAR_TEST_CASE(test_concurrent_updates_to_partition) {
+    return do_with_cql_env_thread([] (auto& e) {
+        e.execute_cql("create table base (k int, c int, v int, primary key (k, c));").get();
+        e.execute_cql("create materialized view mv as select * from base "
+                              "where k is not null and c is not null and v is not null primary key (v, k, c)").get();
+        constexpr int rows = 5;
+        constexpr int writes = 100;
+        // Each row is written to several times, the last write by timestamp
+        // being the one that must end up in the view.
+        parallel_for_each(boost::irange(0, writes), [&] (int i) {
+            return e.execute_cql(format("update base using timestamp {} set v = {} where k = 0 and c = {};", i + 1, i, i % rows)).discard_result();
+        }).get();
+
+        eventually([&] {
+        auto msg = e.execute_cql("select v, k, c from mv").get0();
+        std::vector<std::vector<bytes_opt>> expected;
+        for (int c = 0; c < rows; ++c) {
+            int v = writes - rows + c;
+            expected.push_back({ {int32_type->decompose(v)}, {int32_type->decompose(0)}, {int32_type->decompose(c)} });
+        }
+        assert_that(msg).is_rows().with_rows_ignore_order(std::move(expected));
+        });
+    });
+}
+
 SEASTAR_TEST_CASE(test_reuse_name) {
     return do_with_cql_env_thread([] (auto& e) {
         e.execute_cql("create table cf (p int primary key, v int);").get();
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020 ScyllaDB
+ */
+
+/*
+ * This file is part of Scylla.
+ *
+ * Scylla is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Scylla is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Scylla.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+#include "cql3/authorized_prepared_statements_cache.hh"
+#include "cql3/prepared_statements_cache.hh"
+#include "cql3/statements/prepared_statement.hh"
+
+namespace cql_transport {
+
+/// Prepared statements the user of a connection is known to be authorized to
+/// execute. Spares EXECUTE a lookup in the shared
+/// authorized_prepared_statements_cache, which is keyed by user as well.
+///
+/// Entries are only added after a hit in the shared cache. They go away when
+/// the statement is invalidated, e.g. by a schema change, and as soon as any
+/// entry leaves the shared cache of the shard, so that none outlives the
+/// entry it copies. A revoked permission is thus enforced within the same
+/// time with and without them.
+class authorized_prepared_statements {
+public:
+    using checked_weak_ptr = cql3::statements::prepared_statement::checked_weak_ptr;
+private:
+    size_t _max_size;
+    std::unordered_map<cql3::prepared_cache_key_type, checked_weak_ptr> _entries;
+    // The generation of the shared cache when the entries were inserted.
+    uint64_t _generation = cql3::authorized_prepared_statements_cache::generation();
+public:
+    explicit authorized_prepared_statements(size_t max_size = 1000)
+        : _max_size(max_size) {
+    }
+
+    /// The statement with the given key, unless it was invalidated or the
+    /// shared cache dropped entries since it was inserted. Null if not found.
+    checked_weak_ptr find(const cql3::prepared_cache_key_type& key) {
+        maybe_clear();
+        auto it = _entries.find(key);
+        if (it == _entries.end()) {
+            return checked_weak_ptr();
+        }
+        if (it->second) {
+            return it->second->checked_weak_from_this();
+        }
+        _entries.erase(it);
+        return checked_weak_ptr();
+    }
+
+    /// Records that the user is authorized to execute prepared, as found in
+    /// the shared cache.
+    void insert(const cql3::prepared_cache_key_type& key, cql3::statements::prepared_statement& prepared) {
+        maybe_clear();
+        if (_entries.size() >= _max_size) {
+            _entries.clear();
+        }
+        _entries.insert_or_assign(key, prepared.checked_weak_from_this());
+    }
+
+    void clear() {
+        _entries.clear();
+    }
+
+    size_t size() const {
+        return _entries.size();
+    }
+private:
+    void maybe_clear() {
+        auto generation = cql3::authorized_prepared_statements_cache::generation();
+        if (generation != _generation) {
+            _entries.clear();
+            _generation = generation;
+        }
+    }
+};
+
+}
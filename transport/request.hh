@@ -21,11 +21,10 @@
 
 #pragma once
 
-#include <boost/locale/encoding_utf.hpp>
-
 #include "server.hh"
 #include "utils/reusable_buffer.hh"
 #include "utils/fragmented_temporary_buffer.hh"
+#include "utils/utf8.hh"
 
 namespace cql_transport {
 
@@ -39,10 +38,10 @@ class request_reader {
             throw exceptions::protocol_exception(format("truncated frame: expected {:d} bytes, length is {:d}", attempted_read, actual_left));
         };
     };
+    // Validates in place; query strings can be large, converting them just
+    // to check the encoding would copy them.
     static void validate_utf8(sstring_view s) {
-        try {
-            boost::locale::conv::utf_to_utf<char>(s.begin(), s.end(), boost::locale::conv::stop);
-        } catch (const boost::locale::conv::conversion_error& ex) {
+        if (!utils::utf8::validate(reinterpret_cast<const uint8_t*>(s.data()), s.size())) {
             throw exceptions::protocol_exception("Cannot decode string as UTF8");
         }
     }
@@ -127,6 +126,16 @@ class request_reader {
         return {std::move(b)};
     }
 
+    // Like read_bytes(), but the returned view is only valid as long as the
+    // request buffer is.
+    std::optional<bytes_view> read_bytes_view_opt() {
+        auto len = read_int();
+        if (len < 0) {
+            return {};
+        }
+        return _in.read_bytes_view(len, *_linearization_buffer, exception_thrower());
+    }
+
     bytes read_short_bytes() {
         auto n = read_short();
         bytes b(bytes::initialized_later(), n);
@@ -245,7 +254,7 @@ class request_reader {
             ::shared_ptr<service::pager::paging_state> paging_state;
             int32_t page_size = flags.contains<options_flag::PAGE_SIZE>() ? read_int() : -1;
             if (flags.contains<options_flag::PAGING_STATE>()) {
-                paging_state = service::pager::paging_state::deserialize(read_bytes());
+                paging_state = service::pager::paging_state::deserialize(read_bytes_view_opt());
             }
 
             db::consistency_level serial_consistency = db::consistency_level::SERIAL;
@@ -53,6 +53,11 @@
 
 #include <snappy-c.h>
 #include <lz4.h>
+// We need to use experimental features of the zstd library (to allocate compression/decompression context),
+// which are available only when the library is linked statically.
+#define ZSTD_STATIC_LINKING_ONLY
+#include "zstd/lib/zstd.h"
+#include <seastar/core/aligned_buffer.hh>
 
 #include "response.hh"
 #include "request.hh"
@@ -201,9 +206,14 @@ future<> cql_server::stop() {
 }
 
 future<>
-cql_server::listen(socket_address addr, std::shared_ptr<seastar::tls::credentials_builder> creds, bool keepalive) {
+cql_server::listen(socket_address addr, std::shared_ptr<seastar::tls::credentials_builder> creds, bool is_shard_aware, bool keepalive) {
     listen_options lo;
     lo.reuse_address = true;
+    if (is_shard_aware) {
+        // Connections go to shard (client port % smp::count), so a driver can
+        // reach a given shard by choosing its local port.
+        lo.lba = server_socket::load_balancing_algorithm::port;
+    }
     server_socket ss;
     try {
         ss = creds
@@ -608,6 +618,42 @@ void on_compression_buffer_use() {
     }
 }
 
+// Favour speed over ratio, as responses are compressed on the request path.
+static constexpr int zstd_compression_level = 1;
+
+// zstd contexts are expensive to set up, so they are created once per shard
+// and shared by all connections. As in the zstd sstable compressor, their
+// memory is allocated by us; it is sized for inputs of any length.
+static thread_local std::unique_ptr<char[], free_deleter> zstd_cctx_raw;
+static thread_local ZSTD_CCtx* zstd_cctx = nullptr;
+static thread_local std::unique_ptr<char[], free_deleter> zstd_dctx_raw;
+static thread_local ZSTD_DCtx* zstd_dctx = nullptr;
+
+ZSTD_CCtx* get_zstd_cctx() {
+    if (!zstd_cctx) {
+        auto cctx_size = ZSTD_estimateCCtxSize(zstd_compression_level);
+        // According to the ZSTD documentation, pointer to the context buffer must be 8-bytes aligned.
+        zstd_cctx_raw = allocate_aligned_buffer<char>(cctx_size, 8);
+        zstd_cctx = ZSTD_initStaticCCtx(zstd_cctx_raw.get(), cctx_size);
+        if (!zstd_cctx) {
+            throw std::runtime_error("Unable to initialize ZSTD compression context");
+        }
+    }
+    return zstd_cctx;
+}
+
+ZSTD_DCtx* get_zstd_dctx() {
+    if (!zstd_dctx) {
+        auto dctx_size = ZSTD_estimateDCtxSize();
+        zstd_dctx_raw = allocate_aligned_buffer<char>(dctx_size, 8);
+        zstd_dctx = ZSTD_initStaticDCtx(zstd_dctx_raw.get(), dctx_size);
+        if (!zstd_dctx) {
+            throw std::runtime_error("Unable to initialize ZSTD decompression context");
+        }
+    }
+    return zstd_dctx;
+}
+
 }
 
 future<fragmented_temporary_buffer> cql_server::connection::read_and_decompress_frame(size_t length, uint8_t flags)
@@ -654,6 +700,26 @@ future<fragmented_temporary_buffer> cql_server::connection::read_and_decompress_
                 on_compression_buffer_use();
                 return uncomp;
             });
+        } else if (_compression == cql_compression::zstd) {
+            return _buffer_reader.read_exactly(_read_buf, length).then([this] (fragmented_temporary_buffer buf) {
+                auto in = input_buffer.get_linearized_view(fragmented_temporary_buffer::view(buf));
+                auto uncomp_len = ZSTD_getFrameContentSize(in.data(), in.size());
+                if (uncomp_len == ZSTD_CONTENTSIZE_UNKNOWN || uncomp_len == ZSTD_CONTENTSIZE_ERROR) {
+                    throw std::runtime_error("CQL frame zstd uncompressed size is unknown");
+                }
+                if (uncomp_len > _server._max_request_size) {
+                    throw std::runtime_error(format("CQL frame zstd uncompressed size is too large: {:d}", uncomp_len));
+                }
+              auto uncomp = output_buffer.make_fragmented_temporary_buffer(uncomp_len, fragmented_temporary_buffer::default_fragment_size, [&] (bytes_mutable_view out) {
+                auto ret = ZSTD_decompressDCtx(get_zstd_dctx(), out.data(), out.size(), in.data(), in.size());
+                if (ZSTD_isError(ret)) {
+                    throw std::runtime_error(format("CQL frame zstd uncompression failure: {}", ZSTD_getErrorName(ret)));
+                }
+                return ret;
+              });
+                on_compression_buffer_use();
+                return uncomp;
+            });
         } else {
             throw exceptions::protocol_exception(format("Unknown compression algorithm"));
         }
@@ -672,6 +738,8 @@ future<std::unique_ptr<cql_server::response>> cql_server::connection::process_st
              _compression = cql_compression::lz4;
          } else if (compression == "snappy") {
              _compression = cql_compression::snappy;
+         } else if (compression == "zstd") {
+             _compression = cql_compression::zstd;
          } else {
              throw exceptions::protocol_exception(format("Unknown compression algorithm: {}", compression));
          }
@@ -691,6 +759,7 @@ future<std::unique_ptr<cql_server::response>> cql_server::connection::process_au
     if (sasl_challenge->is_complete()) {
         return sasl_challenge->get_authenticated_user().then([this, sasl_challenge, stream, &client_state, challenge = std::move(challenge)](auth::authenticated_user user) mutable {
             client_state.set_login(::make_shared<auth::authenticated_user>(std::move(user)));
+            _authorized_prepared.clear();
             auto f = client_state.check_user_can_login();
             return f.then([this, stream, &client_state, challenge = std::move(challenge)]() mutable {
                 auto tr_state = client_state.get_trace_state();
@@ -771,7 +840,7 @@ future<std::unique_ptr<cql_server::response>> cql_server::connection::process_ex
 
     // First, try to lookup in the cache of already authorized statements. If the corresponding entry is not found there
     // look for the prepared statement and then authorize it.
-    auto prepared = _server._query_processor.local().get_prepared(client_state.user().get(), cache_key);
+    auto prepared = get_authorized_prepared(client_state, cache_key);
     if (!prepared) {
         needs_authorization = true;
         prepared = _server._query_processor.local().get_prepared(cache_key);
@@ -787,7 +856,7 @@ future<std::unique_ptr<cql_server::response>> cql_server::connection::process_ex
         std::vector<cql3::raw_value_view> values;
         in.read_value_view_list(_version, values);
         auto consistency = in.read_consistency();
-        q_state->options = std::make_unique<cql3::query_options>(_server._cql_config, consistency, timeout_config(), std::nullopt, values, false,
+        q_state->options = std::make_unique<cql3::query_options>(_server._cql_config, consistency, timeout_config(), std::nullopt, std::move(values), false,
                                                                  cql3::query_options::specific_options::DEFAULT, _cql_serialization_format);
     } else {
         q_state->options = in.read_options(_version, _cql_serialization_format, this->timeout_config(), _server._cql_config);
@@ -824,6 +893,18 @@ future<std::unique_ptr<cql_server::response>> cql_server::connection::process_ex
     });
 }
 
+cql3::statements::prepared_statement::checked_weak_ptr
+cql_server::connection::get_authorized_prepared(const service::client_state& client_state, const cql3::prepared_cache_key_type& key) {
+    if (auto prepared = _authorized_prepared.find(key)) {
+        return prepared;
+    }
+    auto prepared = _server._query_processor.local().get_prepared(client_state.user().get(), key);
+    if (prepared) {
+        _authorized_prepared.insert(key, *prepared);
+    }
+    return prepared;
+}
+
 future<std::unique_ptr<cql_server::response>>
 cql_server::connection::process_batch(uint16_t stream, request_reader in, service::client_state& client_state, service_permit permit)
 {
@@ -1060,6 +1141,7 @@ std::unique_ptr<cql_server::response> cql_server::connection::make_supported(int
     opts.insert({"CQL_VERSION", cql3::query_processor::CQL_VERSION});
     opts.insert({"COMPRESSION", "lz4"});
     opts.insert({"COMPRESSION", "snappy"});
+    opts.insert({"COMPRESSION", "zstd"});
     if (_server._config.allow_shard_aware_drivers) {
         auto& part = dht::global_partitioner();
         opts.insert({"SCYLLA_SHARD", format("{:d}", engine().cpu_id())});
@@ -1067,6 +1149,12 @@ std::unique_ptr<cql_server::response> cql_server::connection::make_supported(int
         opts.insert({"SCYLLA_SHARDING_ALGORITHM", part.cpu_sharding_algorithm_name()});
         opts.insert({"SCYLLA_SHARDING_IGNORE_MSB", format("{:d}", part.sharding_ignore_msb())});
         opts.insert({"SCYLLA_PARTITIONER", part.name()});
+        if (_server._config.shard_aware_transport_port) {
+            opts.insert({"SCYLLA_SHARD_AWARE_PORT", format("{:d}", *_server._config.shard_aware_transport_port)});
+        }
+        if (_server._config.shard_aware_transport_port_ssl) {
+            opts.insert({"SCYLLA_SHARD_AWARE_PORT_SSL", format("{:d}", *_server._config.shard_aware_transport_port_ssl)});
+        }
     }
     auto response = std::make_unique<cql_server::response>(stream, cql_binary_opcode::SUPPORTED, tr_state);
     response->write_string_multimap(opts);
@@ -1190,6 +1278,11 @@ cql_server::connection::make_schema_change_event(const event::schema_change& eve
 
 void cql_server::connection::write_response(foreign_ptr<std::unique_ptr<cql_server::response>>&& response, service_permit permit, cql_compression compression)
 {
+    // Compressing a small frame costs more CPU than it saves on the wire, and
+    // the protocol lets us leave any frame uncompressed.
+    if (response->size() < _server._config.compression_threshold) {
+        compression = cql_compression::none;
+    }
     _ready_to_respond = _ready_to_respond.then([this, compression, response = std::move(response), permit = std::move(permit)] () mutable {
         auto message = response->make_message(_version, compression);
         message.on_delete([response = std::move(response)] { });
@@ -1221,6 +1314,9 @@ void cql_server::response::compress(cql_compression compression)
     case cql_compression::snappy:
         compress_snappy();
         break;
+    case cql_compression::zstd:
+        compress_zstd();
+        break;
     default:
         throw std::invalid_argument("Invalid CQL compression algorithm");
     }
@@ -1272,6 +1368,27 @@ void cql_server::response::compress_snappy()
     on_compression_buffer_use();
 }
 
+void cql_server::response::compress_zstd()
+{
+    using namespace compression_buffers;
+    auto view = input_buffer.get_linearized_view(_body);
+    const char* input = reinterpret_cast<const char*>(view.data());
+    size_t input_len = view.size();
+
+    size_t output_len = ZSTD_compressBound(input_len);
+  _body = output_buffer.make_buffer(output_len, [&] (bytes_mutable_view output_view) {
+    char* output = reinterpret_cast<char*>(output_view.data());
+    // The frame header records the uncompressed size, which the receiver
+    // needs to allocate the output buffer.
+    auto ret = ZSTD_compressCCtx(get_zstd_cctx(), output, output_len, input, input_len, zstd_compression_level);
+    if (ZSTD_isError(ret)) {
+        throw std::runtime_error(format("CQL frame zstd compression failure: {}", ZSTD_getErrorName(ret)));
+    }
+    return ret;
+  });
+    on_compression_buffer_use();
+}
+
 void cql_server::response::serialize(const event::schema_change& event, uint8_t version)
 {
     if (version >= 3) {
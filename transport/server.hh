@@ -38,6 +38,7 @@
 #include <seastar/core/metrics_registration.hh>
 #include "utils/fragmented_temporary_buffer.hh"
 #include "service_permit.hh"
+#include "transport/authorized_prepared_statements.hh"
 
 namespace scollectd {
 
@@ -56,6 +57,7 @@ enum class cql_compression {
     none,
     lz4,
     snappy,
+    zstd,
 };
 
 enum cql_frame_flags {
@@ -104,6 +106,14 @@ struct cql_server_config {
     size_t max_request_size;
     std::function<semaphore& ()> get_service_memory_limiter_semaphore;
     bool allow_shard_aware_drivers = true;
+    // Ports on which connections are accepted by the shard selected by the
+    // client's port, advertised to the drivers as SCYLLA_SHARD_AWARE_PORT
+    // and SCYLLA_SHARD_AWARE_PORT_SSL.
+    std::optional<uint16_t> shard_aware_transport_port;
+    std::optional<uint16_t> shard_aware_transport_port_ssl;
+    // Responses with a body smaller than this are sent uncompressed, even
+    // if the connection negotiated compression.
+    size_t compression_threshold = 0;
 };
 
 class cql_server {
@@ -131,7 +141,7 @@ class cql_server {
 public:
     cql_server(distributed<service::storage_proxy>& proxy, distributed<cql3::query_processor>& qp, auth::service&,
             const cql3::cql_config& cql_config, cql_server_config config);
-    future<> listen(socket_address addr, std::shared_ptr<seastar::tls::credentials_builder> = {}, bool keepalive = false);
+    future<> listen(socket_address addr, std::shared_ptr<seastar::tls::credentials_builder> = {}, bool is_shard_aware = false, bool keepalive = false);
     future<> do_accepts(int which, bool keepalive, socket_address server_addr);
     future<> stop();
 public:
@@ -155,6 +165,8 @@ class cql_server {
         std::unordered_map<uint16_t, cql_query_state> _query_states;
         unsigned _request_cpu = 0;
 
+        authorized_prepared_statements _authorized_prepared;
+
         enum class tracing_request_type : uint8_t {
             not_requested,
             no_write_on_close,
@@ -192,6 +204,7 @@ class cql_server {
         future<std::unique_ptr<cql_server::response>> process_query(uint16_t stream, request_reader in, service::client_state& client_state, service_permit permit);
         future<std::unique_ptr<cql_server::response>> process_prepare(uint16_t stream, request_reader in, service::client_state& client_state);
         future<std::unique_ptr<cql_server::response>> process_execute(uint16_t stream, request_reader in, service::client_state& client_state, service_permit permit);
+        cql3::statements::prepared_statement::checked_weak_ptr get_authorized_prepared(const service::client_state& client_state, const cql3::prepared_cache_key_type& key);
         future<std::unique_ptr<cql_server::response>> process_batch(uint16_t stream, request_reader in, service::client_state& client_state, service_permit permit);
         future<std::unique_ptr<cql_server::response>> process_register(uint16_t stream, request_reader in, service::client_state& client_state);
 
@@ -23,7 +23,9 @@
 
 #include "like_matcher.hh"
 
+#include <algorithm>
 #include <boost/locale/encoding.hpp>
+#include <cstring>
 #include <string>
 
 namespace {
@@ -87,12 +89,129 @@ wstring regex_from_pattern(bytes_view pattern) {
     return re;
 }
 
+/// A pattern split at its unescaped wildcards.
+struct split_pattern {
+    std::vector<bytes> segments; // Unescaped literals; one more than wildcards.
+    std::vector<int8_t> wildcards; // wildcards[i] separates segments[i] and segments[i+1].
+};
+
+split_pattern split_at_wildcards(bytes_view pattern) {
+    split_pattern split;
+    split.segments.emplace_back();
+    bool escaping = false;
+    for (auto c : pattern) {
+        if (!escaping && (c == '_' || c == '%')) {
+            split.wildcards.push_back(c);
+            split.segments.emplace_back();
+            continue;
+        }
+        if (!escaping && c == '\\') {
+            escaping = true;
+            continue;
+        }
+        // Bytes of a multi-byte UTF-8 character are never ASCII, so escaping its first byte is
+        // the same as escaping the character.
+        split.segments.back().push_back(c);
+        escaping = false;
+    }
+    if (escaping) {
+        // An unescaped backslash at the end matches verbatim.
+        split.segments.back().push_back('\\');
+    }
+    return split;
+}
+
+/// Length of the UTF-8 sequence starting with \c c, or 0 if c cannot start one.
+size_t utf8_sequence_length(int8_t c) {
+    auto u = static_cast<uint8_t>(c);
+    if (u < 0x80) {
+        return 1;
+    } else if ((u & 0xe0) == 0xc0) {
+        return 2;
+    } else if ((u & 0xf0) == 0xe0) {
+        return 3;
+    } else if ((u & 0xf8) == 0xf0) {
+        return 4;
+    }
+    return 0;
+}
+
+bool starts_with(bytes_view text, bytes_view prefix) {
+    return text.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), text.begin());
+}
+
 } // anonymous namespace
 
-like_matcher::like_matcher(bytes_view pattern) :
-        _re(boost::make_u32regex(regex_from_pattern(pattern), boost::u32regex::basic | boost::u32regex::optimize)) {
+like_matcher::like_matcher(bytes_view pattern) {
+    auto split = split_at_wildcards(pattern);
+    auto is = [&split] (int8_t wildcard) {
+        return std::all_of(split.wildcards.begin(), split.wildcards.end(), [wildcard] (int8_t c) { return c == wildcard; });
+    };
+    if (is('%')) {
+        _strategy = strategy::literals;
+        _segments = std::move(split.segments);
+        // Empty segments in the middle come from consecutive '%' and match trivially.
+        if (_segments.size() > 2) {
+            _segments.erase(std::remove_if(_segments.begin() + 1, _segments.end() - 1, [] (const bytes& s) { return s.empty(); }), _segments.end() - 1);
+        }
+    } else if (is('_')) {
+        _strategy = strategy::single_chars;
+        _segments = std::move(split.segments);
+    } else {
+        _strategy = strategy::regex;
+        _re = boost::make_u32regex(regex_from_pattern(pattern), boost::u32regex::basic | boost::u32regex::optimize);
+    }
+}
+
+bool like_matcher::match_literals(bytes_view text) const {
+    if (_segments.size() == 1) {
+        return text == bytes_view(_segments.front());
+    }
+    bytes_view first = _segments.front();
+    bytes_view last = _segments.back();
+    if (text.size() < first.size() + last.size()
+            || !starts_with(text, first)
+            || !std::equal(last.begin(), last.end(), text.end() - last.size())) {
+        return false;
+    }
+    text = text.substr(first.size(), text.size() - first.size() - last.size());
+    // Taking the leftmost occurrence of each middle segment leaves the most room for the
+    // following ones, so there is no need to backtrack.
+    for (auto it = _segments.begin() + 1; it != _segments.end() - 1; ++it) {
+        auto found = static_cast<const int8_t*>(::memmem(text.data(), text.size(), it->data(), it->size()));
+        if (!found) {
+            return false;
+        }
+        text.remove_prefix(found - text.data() + it->size());
+    }
+    return true;
+}
+
+bool like_matcher::match_single_chars(bytes_view text) const {
+    for (auto it = _segments.begin(); it != _segments.end(); ++it) {
+        if (it != _segments.begin()) {
+            auto len = text.empty() ? 0 : utf8_sequence_length(text.front());
+            if (!len || len > text.size()) {
+                return false;
+            }
+            text.remove_prefix(len);
+        }
+        if (!starts_with(text, *it)) {
+            return false;
+        }
+        text.remove_prefix(it->size());
+    }
+    return text.empty();
 }
 
 bool like_matcher::operator()(bytes_view text) const {
-    return boost::u32regex_match(text.begin(), text.end(), _re);
+    switch (_strategy) {
+    case strategy::literals:
+        return match_literals(text);
+    case strategy::single_chars:
+        return match_single_chars(text);
+    case strategy::regex:
+        return boost::u32regex_match(text.begin(), text.end(), *_re);
+    }
+    std::abort();
 }
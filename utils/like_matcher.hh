@@ -22,6 +22,8 @@
 #pragma once
 
 #include <boost/regex/icu.hpp>
+#include <optional>
+#include <vector>
 
 #include "bytes.hh"
 
@@ -35,15 +37,31 @@
 ///
 /// The whole text must match the pattern; thus <code>'abc' LIKE 'a'</code> doesn't match, but
 /// <code>'abc' LIKE 'a%'</code> matches.
+///
+/// The common pattern shapes are matched directly on the UTF-8 bytes of the text: patterns
+/// without '_' (exact, prefix, suffix, contains, or any other mix of literals and '%') and
+/// patterns without '%'.  Only patterns mixing both wildcards are compiled to a regex.
 class like_matcher {
-    boost::u32regex _re; // Performs pattern matching.
+    enum class strategy {
+        literals,     // Literal segments separated by '%'.
+        single_chars, // Literal segments separated by '_'.
+        regex,
+    };
+    strategy _strategy;
+    // The unescaped pattern, split at the wildcard the strategy is named after.  There is
+    // always at least one segment; empty segments are kept, so e.g. "%abc" is {"", "abc"}.
+    std::vector<bytes> _segments;
+    std::optional<boost::u32regex> _re; // Performs pattern matching for the regex strategy.
+
+    bool match_literals(bytes_view text) const;
+    bool match_single_chars(bytes_view text) const;
 public:
     /// Compiles \c pattern and stores the result.
     ///
     /// \param pattern UTF-8 encoded pattern with wildcards '_' and '%'.
     explicit like_matcher(bytes_view pattern);
 
-    /// Runs the compiled pattern on \c text.
+    /// Matches \c text against the pattern.
     ///
     /// \return true iff text matches constructor's pattern.
     bool operator()(bytes_view text) const;